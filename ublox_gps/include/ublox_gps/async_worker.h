@@ -31,11 +31,13 @@
 
 #include <ublox_gps/gps.h>
 
+#include <algorithm>
 #include <boost/asio.hpp>
 #include <boost/bind.hpp>
 #include <boost/format.hpp>
 #include <boost/thread.hpp>
 #include <boost/thread/condition.hpp>
+#include <sys/ioctl.h>
 
 
 #include "worker.h"
@@ -44,8 +46,35 @@ namespace ublox_gps {
 
 int debug; //!< Used to determine which debug messages to display
 
+//! Upper bounds of the read delay histogram buckets [s]
+static const double kReadDelayBounds[] = {0.0005, 0.001, 0.002, 0.005, 0.01,
+                                          0.02, 0.05, 0.1};
+//! Delay before the first retry of a failed read [s]
+static const double kReadRetryMin = 0.1;
+//! Maximum delay between the retries of a failed read [s]
+static const double kReadRetryMax = 5.0;
+
 /**
  * @brief Handles Asynchronous I/O reading and writing.
+ *
+ * @details By default the stream is read again as soon as a read returns,
+ * which wakes the I/O thread for every few bytes at high baudrates. If the
+ * reads are coalesced, the worker waits for data as usual, but after each
+ * read it holds the next read with a timer, so that the bytes accumulate in
+ * the kernel and are read at once:
+ * - The receiver outputs a burst of messages each measurement epoch. The
+ *   first hold of a burst ends when the burst is expected to be complete,
+ *   learned from the previous bursts, so most epochs are read at once. The
+ *   next holds of the burst are a quarter of its expected duration.
+ * - A hold is extended while less than the minimum bytes are pending.
+ * - No hold is longer than the latency budget, so no byte, including the
+ *   critical frames, waits longer than the budget.
+ * - When no bytes are pending after a hold, the burst is over and the worker
+ *   waits for the next burst.
+ *
+ * A failed read is retried after a delay which doubles with each failure up
+ * to kReadRetryMax, so that a failed link, e.g. an unplugged device, does not
+ * spin the I/O thread. The failure & the recovery are logged once.
  */
 template <typename StreamT>
 class AsyncWorker : public Worker {
@@ -90,6 +119,22 @@ class AsyncWorker : public Worker {
 
   bool isOpen() const { return stream_->is_open(); }
 
+  /**
+   * @brief Set how the reads are coalesced.
+   */
+  void setReadCoalescing(const ReadCoalescing& coalescing);
+
+  /**
+   * @brief Get the wakeups, reads & read delays.
+   */
+  bool getReadStatistics(ReadStatistics& statistics) const;
+
+  bool isReadFailing() const {
+    return read_failing_.load(boost::memory_order_relaxed);
+  }
+
+  void getReadErrors(ReadErrors& errors) const;
+
  protected:
   /**
    * @brief Read the input stream.
@@ -103,6 +148,25 @@ class AsyncWorker : public Worker {
    */
   void readEnd(const boost::system::error_code&, std::size_t);
 
+  /**
+   * @brief Hold the next read, see the class description.
+   * @param now the end of the last read
+   */
+  void holdRead(const boost::posix_time::ptime& now);
+
+  /**
+   * @brief Read the pending bytes, or extend the hold, or wait for the next
+   * burst.
+   * @param error an error code, set if the hold was cancelled
+   */
+  void holdEnd(const boost::system::error_code& error);
+
+  /**
+   * @brief Retry a failed read.
+   * @param error an error code, set if the retry was cancelled
+   */
+  void retryEnd(const boost::system::error_code& error);
+
   /**
    * @brief Send all the data in the output buffer.
    */
@@ -132,13 +196,43 @@ class AsyncWorker : public Worker {
   Callback write_callback_; //!< Callback function to handle raw data
 
   bool stopping_; //!< Whether or not the I/O service is closed
+
+  ReadCoalescing coalescing_; //!< How the reads are coalesced
+  boost::asio::deadline_timer hold_timer_; //!< Holds the next read
+  boost::posix_time::ptime hold_start_; //!< End of the last read
+  boost::posix_time::ptime hold_deadline_; //!< Latest end of the hold
+  bool held_; //!< Whether the current read was held
+  boost::posix_time::ptime burst_start_; //!< First read of the burst, not a
+                                         //!< date time between bursts
+  boost::posix_time::ptime burst_end_; //!< Last read of the burst with data
+  uint32_t burst_reads_; //!< Reads of the burst which returned data
+  double burst_duration_; //!< Expected duration of the bursts [s], 0 if
+                          //!< unknown
+
+  boost::atomic<uint64_t> wakeups_; //!< Wakeups for reading
+  boost::atomic<uint64_t> reads_; //!< Reads which returned data
+  boost::atomic<uint64_t> bytes_; //!< Bytes read
+  Histogram read_delay_; //!< Time the bytes of each read may have waited
+  boost::atomic<double> max_read_delay_; //!< The longest read delay [s]
+
+  boost::asio::deadline_timer retry_timer_; //!< Delays the retry of a read
+  double retry_delay_; //!< Delay of the next retry of a failed read [s]
+  boost::atomic<bool> read_failing_; //!< Whether the reads currently fail
+  boost::atomic<uint64_t> read_errors_; //!< Failed reads since startup
+  mutable Mutex error_mutex_; //!< Lock for the last read error
+  std::string read_error_; //!< The last read error
 };
 
 template <typename StreamT>
 AsyncWorker<StreamT>::AsyncWorker(boost::shared_ptr<StreamT> stream,
         boost::shared_ptr<boost::asio::io_service> io_service,
         std::size_t buffer_size)
-    : stopping_(false) {
+    : stopping_(false), hold_timer_(*io_service), held_(false),
+      burst_reads_(0), burst_duration_(0), wakeups_(0), reads_(0), bytes_(0),
+      read_delay_(std::vector<double>(kReadDelayBounds, kReadDelayBounds +
+          sizeof(kReadDelayBounds) / sizeof(kReadDelayBounds[0]))),
+      max_read_delay_(0), retry_timer_(*io_service),
+      retry_delay_(kReadRetryMin), read_failing_(false), read_errors_(0) {
   stream_ = stream;
   io_service_ = io_service;
   in_.resize(buffer_size);
@@ -185,7 +279,12 @@ void AsyncWorker<StreamT>::doWrite() {
     return;
   }
   // Write all the data in the out buffer
-  boost::asio::write(*stream_, boost::asio::buffer(out_.data(), out_.size()));
+  boost::system::error_code error;
+  boost::asio::write(*stream_, boost::asio::buffer(out_.data(), out_.size()),
+                     error);
+  if (error)
+    ROS_ERROR("U-Blox ASIO output buffer write error: %s",
+              error.message().c_str());
 
   if (debug >= 2) {
     // Print the data that was sent
@@ -215,11 +314,38 @@ template <typename StreamT>
 void AsyncWorker<StreamT>::readEnd(const boost::system::error_code& error,
                                    std::size_t bytes_transfered) {
   ScopedLock lock(read_mutex_);
-  if (error) {
-    ROS_ERROR("U-Blox ASIO input buffer read error: %s, %li",
-              error.message().c_str(),
-              bytes_transfered);
-  } else if (bytes_transfered > 0) {
+  const boost::posix_time::ptime now =
+      boost::posix_time::microsec_clock::universal_time();
+  wakeups_.fetch_add(1, boost::memory_order_relaxed);
+  if (error && !stopping_) {
+    read_errors_.fetch_add(1, boost::memory_order_relaxed);
+    {
+      ScopedLock error_lock(error_mutex_);
+      read_error_ = error.message();
+    }
+    if (!read_failing_.exchange(true))
+      ROS_ERROR("U-Blox ASIO input buffer read error: %s, %li, retrying",
+                error.message().c_str(), bytes_transfered);
+  } else if (!error && bytes_transfered > 0) {
+    if (read_failing_.exchange(false))
+      ROS_INFO("U-Blox ASIO input recovered after %lu read errors",
+               static_cast<unsigned long>(
+                   read_errors_.load(boost::memory_order_relaxed)));
+    retry_delay_ = kReadRetryMin;
+    // Without a hold, the read returned when the first bytes were received
+    const double delay =
+        held_ ? (now - hold_start_).total_microseconds() * 1e-6 : 0.0;
+    read_delay_.observe(delay);
+    if (delay > max_read_delay_.load(boost::memory_order_relaxed))
+      max_read_delay_.store(delay, boost::memory_order_relaxed);
+    reads_.fetch_add(1, boost::memory_order_relaxed);
+    bytes_.fetch_add(bytes_transfered, boost::memory_order_relaxed);
+    if (burst_start_.is_not_a_date_time()) {
+      burst_start_ = now;
+      burst_reads_ = 0;
+    }
+    burst_end_ = now;
+    burst_reads_++;
     in_buffer_size_ += bytes_transfered;
 
     unsigned char *pRawDataStart = &(*(in_.begin() + (in_buffer_size_ - bytes_transfered)));
@@ -244,8 +370,94 @@ void AsyncWorker<StreamT>::readEnd(const boost::system::error_code& error,
     read_condition_.notify_all();
   }
 
-  if (!stopping_)
+  held_ = false;
+  if (stopping_)
+    return;
+  if (error) {
+    retry_timer_.expires_from_now(boost::posix_time::microseconds(
+        static_cast<int64_t>(retry_delay_ * 1e6)));
+    retry_timer_.async_wait(boost::bind(&AsyncWorker<StreamT>::retryEnd,
+        this, boost::asio::placeholders::error));
+    retry_delay_ = std::min(retry_delay_ * 2, kReadRetryMax);
+  } else if (coalescing_.enabled) {
+    holdRead(now);
+  } else {
+    io_service_->post(boost::bind(&AsyncWorker<StreamT>::doRead, this));
+  }
+}
+
+template <typename StreamT>
+void AsyncWorker<StreamT>::retryEnd(const boost::system::error_code& error) {
+  if (error || stopping_)
+    return;
+  doRead();
+}
+
+template <typename StreamT>
+void AsyncWorker<StreamT>::holdRead(const boost::posix_time::ptime& now) {
+  const boost::posix_time::time_duration budget =
+      boost::posix_time::microseconds(
+          static_cast<int64_t>(coalescing_.max_latency * 1e6));
+  hold_start_ = now;
+  hold_deadline_ = now + budget;
+  boost::posix_time::ptime end = hold_deadline_;
+  if (burst_duration_ > 0) {
+    // End the first hold of a burst with the expected end of the burst, the
+    // next holds only wait for its remainder
+    const boost::posix_time::ptime expected = burst_reads_ == 1 ?
+        burst_start_ + boost::posix_time::microseconds(
+            static_cast<int64_t>(burst_duration_ * 1e6)) :
+        now + boost::posix_time::microseconds(
+            static_cast<int64_t>(burst_duration_ * 0.25e6));
+    if (expected > now && expected < end)
+      end = expected;
+  }
+  hold_timer_.expires_at(end);
+  hold_timer_.async_wait(boost::bind(&AsyncWorker<StreamT>::holdEnd, this,
+                                     boost::asio::placeholders::error));
+}
+
+template <typename StreamT>
+void AsyncWorker<StreamT>::holdEnd(const boost::system::error_code& error) {
+  ScopedLock lock(read_mutex_);
+  if (error || stopping_)
+    return;
+  const boost::posix_time::ptime now =
+      boost::posix_time::microsec_clock::universal_time();
+  wakeups_.fetch_add(1, boost::memory_order_relaxed);
+  int pending = 0;
+  if (ioctl(stream_->native_handle(), FIONREAD, &pending) < 0)
+    pending = coalescing_.min_bytes;
+
+  if (pending == 0) {
+    // The burst is over, learn its duration & wait for the next burst. If
+    // the first hold read the whole burst, the burst may be shorter, try a
+    // shorter hold. Otherwise the hold was too short, the measured duration
+    // is an upper bound.
+    if (!burst_start_.is_not_a_date_time()) {
+      const double measured =
+          (burst_end_ - burst_start_).total_microseconds() * 1e-6;
+      if (burst_duration_ <= 0)
+        burst_duration_ = measured;
+      else if (burst_reads_ <= 2)
+        burst_duration_ *= 0.9;
+      else
+        burst_duration_ = std::min(measured, burst_duration_ * 1.25);
+      burst_start_ = boost::posix_time::not_a_date_time;
+    }
     io_service_->post(boost::bind(&AsyncWorker<StreamT>::doRead, this));
+    return;
+  }
+  if (static_cast<uint32_t>(pending) < coalescing_.min_bytes
+      && now < hold_deadline_) {
+    hold_timer_.expires_at(hold_deadline_);
+    hold_timer_.async_wait(boost::bind(&AsyncWorker<StreamT>::holdEnd, this,
+                                       boost::asio::placeholders::error));
+    return;
+  }
+  // The read returns the pending bytes right away
+  held_ = true;
+  io_service_->post(boost::bind(&AsyncWorker<StreamT>::doRead, this));
 }
 
 template <typename StreamT>
@@ -253,12 +465,40 @@ void AsyncWorker<StreamT>::doClose() {
   ScopedLock lock(read_mutex_);
   stopping_ = true;
   boost::system::error_code error;
+  hold_timer_.cancel(error);
+  retry_timer_.cancel(error);
   stream_->close(error);
   if(error)
     ROS_ERROR_STREAM(
         "Error while closing the AsyncWorker stream: " << error.message());
 }
 
+template <typename StreamT>
+void AsyncWorker<StreamT>::setReadCoalescing(
+    const ReadCoalescing& coalescing) {
+  ScopedLock lock(read_mutex_);
+  coalescing_ = coalescing;
+}
+
+template <typename StreamT>
+bool AsyncWorker<StreamT>::getReadStatistics(
+    ReadStatistics& statistics) const {
+  statistics.wakeups = wakeups_.load(boost::memory_order_relaxed);
+  statistics.reads = reads_.load(boost::memory_order_relaxed);
+  statistics.bytes = bytes_.load(boost::memory_order_relaxed);
+  statistics.delay = read_delay_.snapshot();
+  statistics.max_delay = max_read_delay_.load(boost::memory_order_relaxed);
+  return true;
+}
+
+template <typename StreamT>
+void AsyncWorker<StreamT>::getReadErrors(ReadErrors& errors) const {
+  errors.failing = read_failing_.load(boost::memory_order_relaxed);
+  errors.count = read_errors_.load(boost::memory_order_relaxed);
+  ScopedLock lock(error_mutex_);
+  errors.message = read_error_;
+}
+
 template <typename StreamT>
 void AsyncWorker<StreamT>::wait(
     const boost::posix_time::time_duration& timeout) {
@@ -29,8 +29,11 @@
 #ifndef UBLOX_GPS_CALLBACK_H
 #define UBLOX_GPS_CALLBACK_H
 
+#include <set>
+#include <vector>
 #include <ros/console.h>
 #include <ublox/serialization/ublox_msgs.h>
+#include <boost/atomic.hpp>
 #include <boost/format.hpp>
 #include <boost/function.hpp>
 #include <boost/thread.hpp>
@@ -44,8 +47,9 @@ class CallbackHandler {
  public:
   /**
    * @brief Decode the u-blox message.
+   * @return true if the message was decoded, false on decoder errors
    */
-  virtual void handle(ublox::Reader& reader) = 0;
+  virtual bool handle(ublox::Reader& reader) = 0;
 
   /**
    * @brief Wait for on the condition.
@@ -83,8 +87,9 @@ class CallbackHandler_ : public CallbackHandler {
   /**
    * @brief Decode the U-Blox message & call the callback function if it exists.
    * @param reader a reader to decode the message buffer
+   * @return true if the message was decoded, false on decoder errors
    */
-  void handle(ublox::Reader& reader) {
+  bool handle(ublox::Reader& reader) {
     boost::mutex::scoped_lock lock(mutex_);
     try {
       if (!reader.read<T>(message_)) {
@@ -94,7 +99,7 @@ class CallbackHandler_ : public CallbackHandler {
                        static_cast<unsigned int>(reader.messageId()),
                        reader.length());
         condition_.notify_all();
-        return;
+        return false;
       }
     } catch (std::runtime_error& e) {
       ROS_DEBUG_COND(debug >= 2, 
@@ -103,11 +108,12 @@ class CallbackHandler_ : public CallbackHandler {
                      static_cast<unsigned int>(reader.messageId()),
                      reader.length());
       condition_.notify_all();
-      return;
+      return false;
     }
 
     if (func_) func_(message_);
     condition_.notify_all();
+    return true;
   }
   
  private:
@@ -115,11 +121,116 @@ class CallbackHandler_ : public CallbackHandler {
   T message_; //!< The last received message
 };
 
+/**
+ * @brief A callback handler for undecoded u-blox frames, e.g. to store them.
+ */
+class RawCallbackHandler : public CallbackHandler {
+ public:
+  //! A callback function, receives the frame incl. header and checksum
+  typedef boost::function<void(const uint8_t*, uint32_t)> Callback;
+
+  /**
+   * @brief Initialize the Callback Handler with a callback function
+   * @param func a callback function for the frames
+   */
+  RawCallbackHandler(const Callback& func) : func_(func) {}
+
+  /**
+   * @brief Check the checksum & call the callback function.
+   * @param reader a reader containing the frame
+   * @return false on checksum errors
+   */
+  bool handle(ublox::Reader& reader) {
+    uint16_t checksum;
+    if (ublox::calculateChecksum(reader.pos() + 2, reader.length() + 4,
+                                 checksum) != reader.checksum())
+      return false;
+    func_(reader.pos(), reader.length() + 8);
+    return true;
+  }
+
+ private:
+  Callback func_; //!< the callback function to handle the frames
+};
+
 /**
  * @brief Callback handlers for incoming u-blox messages.
  */
 class CallbackHandlers {
  public:
+  //! A callback which is called for every u-blox frame before it is decoded,
+  //! the frame is not decoded if it returns false
+  typedef boost::function<bool(ublox::Reader&)> FrameCallback;
+  //! A callback which is called just before a frame is decoded, with the
+  //! number of received bytes not yet dispatched, including the frame. The
+  //! frame is not decoded if it returns false.
+  typedef boost::function<bool(ublox::Reader&, uint32_t)> DispatchCallback;
+
+  CallbackHandlers() : frames_(0), discarded_bytes_(0), foreign_bytes_(0),
+                       decode_errors_(0) {}
+
+  /**
+   * @brief Set the callback which is called for every u-blox frame found in
+   * the input stream, regardless of the subscribed message types.
+   * @param callback the frame callback, which returns false to drop the frame
+   * without decoding it
+   */
+  void setFrameCallback(const FrameCallback& callback) {
+    frame_callback_ = callback;
+  }
+
+  /**
+   * @brief Set the callback which is called for every frame just before it
+   * is decoded, e.g. to shed frames when the dispatch falls behind.
+   * @param callback the dispatch callback, which returns false to drop the
+   * frame without decoding it
+   */
+  void setDispatchCallback(const DispatchCallback& callback) {
+    dispatch_callback_ = callback;
+  }
+
+  /**
+   * @brief Dispatch the given message type ahead of other messages.
+   *
+   * @details When several frames are in the input buffer at once, the frames
+   * of priority message types are handed to their callbacks first. Frames of
+   * the same type are always dispatched in the order they were received.
+   * @param class_id the u-blox message class
+   * @param message_id the u-blox message ID
+   */
+  void addPriority(uint8_t class_id, uint8_t message_id) {
+    boost::mutex::scoped_lock lock(callback_mutex_);
+    priority_.insert(std::make_pair(class_id, message_id));
+  }
+
+  /**
+   * @brief Get the number of u-blox frames found in the input stream.
+   */
+  uint64_t frames() const { return frames_; }
+
+  /**
+   * @brief Get the number of bytes skipped while searching for u-blox frames,
+   * excluding NMEA sentences and RTCM frames.
+   */
+  uint64_t discardedBytes() const { return discarded_bytes_; }
+
+  /**
+   * @brief Get the number of skipped bytes which belonged to NMEA sentences
+   * or RTCM frames.
+   */
+  uint64_t foreignBytes() const { return foreign_bytes_; }
+
+  /**
+   * @brief Get the number of frames with an invalid checksum and of
+   * subscribed frames which failed to decode.
+   */
+  uint64_t decodeErrors() const { return decode_errors_; }
+
+  /**
+   * @brief Count a frame which failed to decode, e.g. a checksum error.
+   */
+  void addDecodeError() { ++decode_errors_; }
+
   /**
    * @brief Add a callback handler for the given message type.
    * @param callback the callback handler for the message
@@ -153,6 +264,22 @@ class CallbackHandlers {
                      boost::shared_ptr<CallbackHandler>(handler)));
   }
 
+  /**
+   * @brief Add a callback handler for the undecoded frames of the given
+   * message.
+   * @param callback the callback handler for the frames
+   * @param class_id the class ID of the message
+   * @param message_id the ID of the message
+   */
+  void insertRaw(const RawCallbackHandler::Callback& callback,
+                 uint8_t class_id, uint8_t message_id) {
+    boost::mutex::scoped_lock lock(callback_mutex_);
+    callbacks_.insert(
+      std::make_pair(std::make_pair(class_id, message_id),
+                     boost::shared_ptr<CallbackHandler>(
+                         new RawCallbackHandler(callback))));
+  }
+
   /**
    * @brief Calls the callback handler for the message in the reader.
    * @param reader a reader containing a u-blox message
@@ -162,9 +289,12 @@ class CallbackHandlers {
     boost::mutex::scoped_lock lock(callback_mutex_);
     Callbacks::key_type key =
         std::make_pair(reader.classId(), reader.messageId());
+    bool decoded = true;
     for (Callbacks::iterator callback = callbacks_.lower_bound(key);
          callback != callbacks_.upper_bound(key); ++callback)
-      callback->second->handle(reader);
+      decoded &= callback->second->handle(reader);
+    if (!decoded)
+      ++decode_errors_;
   }
 
   /**
@@ -199,13 +329,23 @@ class CallbackHandlers {
   /**
    * @brief Processes u-blox messages in the given buffer & clears the read
    * messages from the buffer.
+   *
+   * @details Calls for different streams must not run concurrently.
    * @param data the buffer of u-blox messages to process
    * @param size the size of the buffer
+   * @param stream the index of the input stream, for receivers connected over
+   * several links
    */
-  void readCallback(unsigned char* data, std::size_t& size) {
+  void readCallback(unsigned char* data, std::size_t& size,
+                    std::size_t stream = 0) {
+    if (stream >= streams_.size())
+      streams_.resize(stream + 1);
     ublox::Reader reader(data, size);
+    // End of the last frame, bytes between it and the next frame are skipped
+    ublox::Reader::iterator last = data;
     // Read all U-Blox messages in buffer
     while (reader.search() != reader.end() && reader.found()) {
+      countSkipped(streams_[stream], last, reader.pos());
       if (debug >= 3) {
         // Print the received bytes
         std::ostringstream oss;
@@ -216,8 +356,13 @@ class CallbackHandlers {
                  oss.str().c_str());
       }
 
-      handle(reader);
+      ++frames_;
+      if (!frame_callback_ || frame_callback_(reader))
+        pending_.push_back(std::make_pair(reader.pos(), reader.length() + 8));
+      last = reader.pos() + reader.length() + 8;
     }
+    countSkipped(streams_[stream], last, reader.pos());
+    dispatch(reader.end() - reader.pos());
 
     // delete read bytes from ASIO input buffer
     std::copy(reader.pos(), reader.end(), data);
@@ -228,9 +373,118 @@ class CallbackHandlers {
   typedef std::multimap<std::pair<uint8_t, uint8_t>,
                         boost::shared_ptr<CallbackHandler> > Callbacks;
 
+  //! Parser state of an input stream, kept across reads
+  struct StreamState {
+    StreamState() : nmea(false), rtcm_remaining(0) {}
+
+    //! Whether the skipped bytes are inside an NMEA sentence
+    bool nmea;
+    //! Remaining bytes of the RTCM frame in the skipped bytes
+    uint32_t rtcm_remaining;
+  };
+
+  /**
+   * @brief Dispatch the pending frames, priority message types first.
+   * @param remaining the number of bytes after the last frame, which belong
+   * to an incomplete frame
+   */
+  void dispatch(uint32_t remaining) {
+    bool prioritize;
+    {
+      boost::mutex::scoped_lock lock(callback_mutex_);
+      prioritize = pending_.size() > 1 && !priority_.empty();
+    }
+    for (std::size_t i = 0; i < pending_.size(); ++i)
+      remaining += pending_[i].second;
+    // Frames of priority message types, or all frames
+    for (std::size_t i = 0; i < pending_.size(); ++i) {
+      ublox::Reader frame(pending_[i].first, pending_[i].second);
+      if (!prioritize || isPriority(frame)) {
+        dispatch(frame, remaining);
+        pending_[i].second = 0;
+      }
+    }
+    // Remaining frames
+    for (std::size_t i = 0; prioritize && i < pending_.size(); ++i) {
+      if (pending_[i].second == 0) continue;
+      ublox::Reader frame(pending_[i].first, pending_[i].second);
+      dispatch(frame, remaining);
+    }
+    pending_.clear();
+  }
+
+  /**
+   * @brief Dispatch a frame unless the dispatch callback drops it.
+   * @param frame a reader containing the frame
+   * @param remaining the number of bytes not yet dispatched, including the
+   * frame, decreased by the frame size
+   */
+  void dispatch(ublox::Reader& frame, uint32_t& remaining) {
+    const uint32_t size = frame.length() + 8;
+    if (!dispatch_callback_ || dispatch_callback_(frame, remaining))
+      handle(frame);
+    remaining -= size;
+  }
+
+  /**
+   * @brief Whether the frame is of a priority message type.
+   */
+  bool isPriority(ublox::Reader& frame) {
+    boost::mutex::scoped_lock lock(callback_mutex_);
+    return priority_.count(std::make_pair(frame.classId(),
+                                          frame.messageId())) > 0;
+  }
+
+  /**
+   * @brief Count the bytes skipped between u-blox frames.
+   *
+   * @details NMEA sentences and RTCM 3 frames are expected on ports with
+   * multiple output protocols and are counted separately from discarded
+   * bytes. The state is kept across calls since they may be split between
+   * reads.
+   * @param state the parser state of the input stream
+   * @param begin the first skipped byte
+   * @param end the end of the skipped bytes
+   */
+  void countSkipped(StreamState& state, ublox::Reader::iterator begin,
+                    ublox::Reader::iterator end) {
+    for (ublox::Reader::iterator it = begin; it < end; ++it) {
+      if (state.rtcm_remaining > 0) {
+        --state.rtcm_remaining;
+        ++foreign_bytes_;
+      } else if (state.nmea || *it == '$') {
+        state.nmea = *it != '\n';
+        ++foreign_bytes_;
+      } else if (*it == 0xD3 && end - it >= 3 && (it[1] & 0xFC) == 0) {
+        // RTCM 3 preamble, 10 bit length, payload and 24 bit CRC
+        state.rtcm_remaining = ((it[1] & 0x03) << 8 | it[2]) + 5;
+        ++foreign_bytes_;
+      } else {
+        ++discarded_bytes_;
+      }
+    }
+  }
+
   // Call back handlers for u-blox messages
   Callbacks callbacks_;
   boost::mutex callback_mutex_;
+  //! Called for every u-blox frame
+  FrameCallback frame_callback_;
+  //! Called for every u-blox frame just before it is decoded
+  DispatchCallback dispatch_callback_;
+  //! Message types which are dispatched first, (class ID, message ID)
+  std::set<std::pair<uint8_t, uint8_t> > priority_;
+  //! Frames found in the input buffer which are not yet dispatched,
+  //! (start, size)
+  std::vector<std::pair<ublox::Reader::iterator, uint32_t> > pending_;
+
+  // Input stream statistics, read by other threads
+  boost::atomic<uint64_t> frames_; //!< Number of u-blox frames
+  boost::atomic<uint64_t> discarded_bytes_; //!< Number of discarded bytes
+  boost::atomic<uint64_t> foreign_bytes_; //!< Number of NMEA & RTCM bytes
+  boost::atomic<uint64_t> decode_errors_; //!< Number of decoder errors
+  //! Parser state of each input stream
+  std::vector<StreamState> streams_;
 };
 
 }  // namespace ublox_gps
@@ -0,0 +1,97 @@
+//==============================================================================
+// Copyright (c) 2012, Johannes Meyer, TU Darmstadt
+// All rights reserved.
+
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//     * Neither the name of the Flight Systems and Automatic Control group,
+//       TU Darmstadt, nor the names of its contributors may be used to
+//       endorse or promote products derived from this software without
+//       specific prior written permission.
+
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" 
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE 
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE 
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER BE LIABLE FOR ANY
+// DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+// (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+// LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+// ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+// SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//==============================================================================
+
+#ifndef UBLOX_GPS_CALLBACK_LATENCY_H
+#define UBLOX_GPS_CALLBACK_LATENCY_H
+
+#include <algorithm>
+#include <stdint.h>
+#include <boost/thread.hpp>
+
+namespace ublox_node {
+
+/**
+ * @brief Latency statistics of the callbacks of a ROS callback queue.
+ *
+ * @details The latency is the time a callback waited in its queue, e.g. from
+ * the receipt of a message or the expected time of a timer until the callback
+ * runs. The window statistics are reset each time they are read.
+ */
+class CallbackLatency {
+ public:
+  /**
+   * @brief Latency snapshot.
+   */
+  struct Statistics {
+    uint64_t total; //!< Number of callbacks since startup
+    uint32_t count; //!< Number of callbacks in the window
+    double mean; //!< Mean latency in the window [s]
+    double max; //!< Maximum latency in the window [s]
+  };
+
+  CallbackLatency() : total_(0), count_(0), sum_(0), max_(0) {}
+
+  /**
+   * @brief Add the latency of a callback.
+   * @param latency the latency [s]
+   */
+  void add(double latency) {
+    boost::mutex::scoped_lock lock(mutex_);
+    ++total_;
+    ++count_;
+    sum_ += latency;
+    max_ = std::max(max_, latency);
+  }
+
+  /**
+   * @brief Get the statistics and start a new window.
+   */
+  Statistics read() {
+    boost::mutex::scoped_lock lock(mutex_);
+    Statistics stats;
+    stats.total = total_;
+    stats.count = count_;
+    stats.mean = count_ > 0 ? sum_ / count_ : 0;
+    stats.max = max_;
+    count_ = 0;
+    sum_ = 0;
+    max_ = 0;
+    return stats;
+  }
+
+ private:
+  boost::mutex mutex_; //!< Lock, accessed by the spinner threads
+  uint64_t total_; //!< Number of callbacks since startup
+  uint32_t count_; //!< Number of callbacks in the window
+  double sum_; //!< Sum of the latencies in the window [s]
+  double max_; //!< Maximum latency in the window [s]
+};
+
+}  // namespace ublox_node
+
+#endif  // UBLOX_GPS_CALLBACK_LATENCY_H
@@ -0,0 +1,137 @@
+//==============================================================================
+// Copyright (c) 2012, Johannes Meyer, TU Darmstadt
+// All rights reserved.
+
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//     * Neither the name of the Flight Systems and Automatic Control group,
+//       TU Darmstadt, nor the names of its contributors may be used to
+//       endorse or promote products derived from this software without
+//       specific prior written permission.
+
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" 
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE 
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE 
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER BE LIABLE FOR ANY
+// DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+// (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+// LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+// ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+// SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//==============================================================================
+
+#ifndef UBLOX_GPS_CAPTURE_H
+#define UBLOX_GPS_CAPTURE_H
+
+#include <fstream>
+#include <string>
+#include <vector>
+#include <stdint.h>
+#include <boost/thread.hpp>
+
+namespace ublox_gps {
+
+/**
+ * @brief A chunk of bytes received from or sent to the device.
+ */
+struct CaptureRecord {
+  enum Direction {
+    RX = 0, //!< Received from the device
+    TX = 1  //!< Sent to the device
+  };
+
+  uint8_t direction; //!< RX or TX
+  uint64_t monotonic; //!< Monotonic clock time of the chunk [ns]
+  uint64_t realtime; //!< Realtime (UTC) clock time of the chunk [ns]
+  std::vector<unsigned char> data; //!< The bytes
+};
+
+/**
+ * @brief Writes the bytes received from and sent to the device, as read and
+ * written, to a capture file.
+ *
+ * @details The file starts with the 8 byte header "UBXCAP" and the version
+ * (uint16). Each chunk is stored as a 24 byte record header followed by the
+ * bytes: the size (uint32), the direction (uint8), 3 reserved bytes, the
+ * monotonic and the realtime clock time in ns (uint64). All numbers are
+ * little endian.
+ */
+class CaptureWriter {
+ public:
+  CaptureWriter() : records_(0) {}
+
+  /**
+   * @brief Create the capture file & write the file header.
+   * @return true if the file was created
+   */
+  bool open(const std::string& path);
+
+  /**
+   * @brief Close the capture file.
+   */
+  void close();
+
+  bool isOpen() const { return file_.is_open(); }
+
+  /**
+   * @brief Write a chunk, timestamped with the current clock times.
+   * @param direction the direction, see CaptureRecord
+   * @param data the bytes
+   * @param size the number of bytes
+   */
+  void write(uint8_t direction, const unsigned char* data, std::size_t size);
+
+  /**
+   * @brief Get the number of written records.
+   */
+  uint64_t records() const;
+
+ private:
+  mutable boost::mutex mutex_; //!< Lock, written by the I/O & sending threads
+  std::ofstream file_; //!< The capture file
+  uint64_t records_; //!< Number of written records
+};
+
+/**
+ * @brief Reads the records of a capture file, see CaptureWriter.
+ */
+class CaptureReader {
+ public:
+  /**
+   * @brief Open the capture file & check the file header.
+   * @return true if the file is a capture file of a supported version
+   */
+  bool open(const std::string& path);
+
+  /**
+   * @brief Read the next record.
+   * @return false at the end of the file, a truncated last record or a record
+   * larger than kCaptureMaxRecordSize is treated as the end of the file
+   */
+  bool read(CaptureRecord& record);
+
+ private:
+  std::ifstream file_; //!< The capture file
+};
+
+//! The magic bytes at the start of a capture file
+const char kCaptureMagic[] = "UBXCAP";
+//! The version of the capture format
+const uint16_t kCaptureVersion = 1;
+//! Size of the capture file header
+const std::size_t kCaptureHeaderSize = 8;
+//! Size of the header of each record
+const std::size_t kCaptureRecordHeaderSize = 24;
+//! Maximum size of the bytes of a record, larger than the I/O buffers and
+//! any u-blox or RTCM message, so larger sizes are corrupted
+const std::size_t kCaptureMaxRecordSize = 65536;
+
+}  // namespace ublox_gps
+
+#endif  // UBLOX_GPS_CAPTURE_H
@@ -0,0 +1,180 @@
+//==============================================================================
+// Copyright (c) 2012, Johannes Meyer, TU Darmstadt
+// All rights reserved.
+
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//     * Neither the name of the Flight Systems and Automatic Control group,
+//       TU Darmstadt, nor the names of its contributors may be used to
+//       endorse or promote products derived from this software without
+//       specific prior written permission.
+
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" 
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE 
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE 
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER BE LIABLE FOR ANY
+// DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+// (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+// LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+// ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+// SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//==============================================================================
+
+#ifndef UBLOX_GPS_CHRONY_REFCLOCK_H
+#define UBLOX_GPS_CHRONY_REFCLOCK_H
+
+#include <time.h>
+#include <string>
+#include <boost/date_time/posix_time/posix_time.hpp>
+#include <boost/thread.hpp>
+// ROS messages
+#include <ublox_msgs/NavCLOCK.h>
+#include <ublox_msgs/NavTIMEUTC.h>
+#include <ublox_msgs/TimTP.h>
+
+namespace ublox_node {
+
+/**
+ * @brief Writes GNSS time samples to the shared memory refclock segments of
+ * chrony (or ntpd).
+ *
+ * @details Each NAV-TIMEUTC epoch is paired with the time the host received
+ * the message and written to the segment of the configured unit. These
+ * samples contain the latency of the serial link, which must be compensated
+ * by the offset of the refclock.
+ *
+ * If a PPS device is given, its assert events are paired with the UTC
+ * second of the following NAV-TIMEUTC epoch, corrected by the quantization
+ * error of the TIM-TP message which preceded the pulse, and written to the
+ * segment of the next unit.
+ *
+ * No sample is written while the NAV-CLOCK time or frequency accuracy exceed
+ * the limits.
+ */
+class ChronyRefclock {
+ public:
+  /**
+   * @brief Refclock statistics.
+   */
+  struct Statistics {
+    uint32_t samples; //!< Samples written to the serial segment
+    uint32_t pps_samples; //!< Samples written to the PPS segment
+    uint32_t rejected; //!< Epochs without a valid or accurate time
+    double last_offset; //!< Last host minus GNSS time of the serial
+                        //!< samples [s]
+    int32_t clock_drift; //!< Last NAV-CLOCK drift [ns/s]
+    uint32_t time_acc; //!< Last NAV-CLOCK time accuracy [ns]
+    uint32_t freq_acc; //!< Last NAV-CLOCK frequency accuracy [ps/s]
+    int32_t last_qerr; //!< Quantization error of the last PPS sample [ps]
+  };
+
+  /**
+   * @param unit the SHM unit of the serial samples, the PPS samples are
+   * written to unit + 1
+   * @param pps_device the PPS device, e.g. /dev/pps0, empty if not used
+   * @param max_time_acc the maximum NAV-CLOCK time accuracy [ns]
+   * @param max_freq_acc the maximum NAV-CLOCK frequency accuracy [ps/s],
+   * 0 to ignore
+   */
+  ChronyRefclock(int unit, const std::string& pps_device,
+                 uint32_t max_time_acc, uint32_t max_freq_acc);
+
+  ~ChronyRefclock();
+
+  /**
+   * @brief Attach the SHM segments & open the PPS device.
+   * @return true on success, false otherwise
+   */
+  bool open();
+
+  /**
+   * @brief Write the samples of a NAV-TIMEUTC epoch.
+   * @param m the message
+   * @param arrival when the host received the message (UTC)
+   */
+  void addTimeUtc(const ublox_msgs::NavTIMEUTC& m,
+                  const boost::posix_time::ptime& arrival);
+
+  /**
+   * @brief Update the clock quality from a NAV-CLOCK message.
+   */
+  void addClock(const ublox_msgs::NavCLOCK& m);
+
+  /**
+   * @brief Keep the quantization error of the next time pulse.
+   * @param m the message
+   * @param arrival when the host received the message (UTC)
+   */
+  void addTimePulse(const ublox_msgs::TimTP& m,
+                    const boost::posix_time::ptime& arrival);
+
+  /**
+   * @brief Get the refclock statistics.
+   */
+  Statistics statistics() const;
+
+  /**
+   * @brief Get the SHM unit of the serial samples.
+   */
+  int unit() const { return unit_; }
+
+ private:
+  struct ShmTime;
+
+  /**
+   * @brief Attach the SHM segment of the given unit, create it if needed.
+   * @return the segment, null on failure
+   */
+  static volatile ShmTime* attach(int unit);
+
+  /**
+   * @brief Write a sample to a SHM segment.
+   * @param shm the segment
+   * @param clock the reference (GNSS) time
+   * @param receive the host time
+   * @param precision the precision of the sample [log2 s]
+   */
+  static void write(volatile ShmTime* shm, const struct timespec& clock,
+                    const struct timespec& receive, int precision);
+
+  /**
+   * @brief Pair the last PPS assert event with an epoch & write it.
+   * @param second the UTC second of the epoch
+   * @param arrival when the host received the epoch (UTC)
+   * @param precision the precision of the sample [log2 s]
+   */
+  void writePps(time_t second, const struct timespec& arrival,
+                int precision);
+
+  int unit_; //!< SHM unit of the serial samples
+  std::string pps_device_; //!< The PPS device, empty if not used
+  uint32_t max_time_acc_; //!< The maximum NAV-CLOCK time accuracy [ns]
+  uint32_t max_freq_acc_; //!< The maximum NAV-CLOCK frequency accuracy
+  volatile ShmTime* shm_; //!< Segment of the serial samples
+  volatile ShmTime* pps_shm_; //!< Segment of the PPS samples
+  int pps_fd_; //!< File descriptor of the PPS device, -1 if not open
+  unsigned int pps_sequence_; //!< Sequence of the last used assert event
+
+  mutable boost::mutex mutex_; //!< Lock, accessed by the I/O & ROS threads
+  bool clock_valid_; //!< Whether a NAV-CLOCK message was received
+  //! The time pulse data of a TIM-TP message
+  struct TimePulse {
+    bool valid; //!< Whether the qErr is valid
+    int32_t qerr; //!< Quantization error of the pulse [ps]
+    struct timespec arrival; //!< When the host received the message
+  };
+  //! The last two TIM-TP messages, the next one may be received before the
+  //! epoch of the previous pulse
+  TimePulse time_pulses_[2];
+  Statistics statistics_; //!< Refclock statistics
+};
+
+}  // namespace ublox_node
+
+#endif  // UBLOX_GPS_CHRONY_REFCLOCK_H
@@ -0,0 +1,130 @@
+//==============================================================================
+// Copyright (c) 2012, Johannes Meyer, TU Darmstadt
+// All rights reserved.
+
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//     * Neither the name of the Flight Systems and Automatic Control group,
+//       TU Darmstadt, nor the names of its contributors may be used to
+//       endorse or promote products derived from this software without
+//       specific prior written permission.
+
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" 
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE 
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE 
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER BE LIABLE FOR ANY
+// DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+// (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+// LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+// ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+// SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//==============================================================================
+
+#ifndef UBLOX_GPS_CONFIG_MONITOR_H
+#define UBLOX_GPS_CONFIG_MONITOR_H
+
+#include <boost/thread.hpp>
+#include <ros/time.h>
+#include <ublox_gps/config_shadow.h>
+// ROS messages
+#include <ublox_msgs/NavSTATUS.h>
+
+namespace ublox_node {
+
+/**
+ * @brief Detects receiver resets & configuration drift from the polled
+ * configuration blocks and the receiver uptime.
+ *
+ * @details The polled blocks are compared with the blocks applied by the
+ * node (see ublox_gps::ConfigShadow). A reset is detected when the uptime of
+ * NavSTATUS decreases. The detections are kept until the configuration is
+ * recovered.
+ */
+class ConfigMonitor {
+ public:
+  /**
+   * @brief Configuration monitor statistics.
+   */
+  struct Statistics {
+    uint32_t checks; //!< Number of poll rounds
+    uint32_t unanswered; //!< Poll rounds without a NavSTATUS response
+    uint32_t resets; //!< Detected receiver resets
+    uint32_t drifts; //!< Detected drifted blocks
+    uint32_t recoveries; //!< Successful recoveries
+    uint32_t failed_recoveries; //!< Failed recoveries
+    double last_detection; //!< Time from the reset or the last matching
+                           //!< poll round to the last detection [s]
+    double last_recovery; //!< Time from the last detection to the recovery
+                          //!< [s]
+  };
+
+  /**
+   * @param shadow the configuration applied by the node
+   */
+  explicit ConfigMonitor(const ublox_gps::ConfigShadow& shadow);
+
+  /**
+   * @brief Start a poll round.
+   * @return the blocks to poll, see ublox_gps::ConfigShadow::Block
+   */
+  uint32_t startRound();
+
+  /**
+   * @brief Compare a polled configuration block with the applied block.
+   */
+  template <typename ConfigT>
+  void check(const ConfigT& message, uint32_t block) {
+    if (!shadow_.matches(message))
+      detect(block);
+  }
+
+  /**
+   * @brief Check the receiver uptime for a reset.
+   */
+  void checkStatus(const ublox_msgs::NavSTATUS& m);
+
+  /**
+   * @brief Get the detections which are not recovered yet.
+   * @param reset whether the receiver was reset
+   * @param blocks the drifted blocks
+   * @return true if anything must be recovered
+   */
+  bool pending(bool& reset, uint32_t& blocks) const;
+
+  /**
+   * @brief Report the result of a recovery of the pending detections.
+   */
+  void recovered(bool success);
+
+  /**
+   * @brief Get the configuration monitor statistics.
+   */
+  Statistics statistics() const;
+
+ private:
+  /**
+   * @brief Record a drifted block.
+   */
+  void detect(uint32_t block);
+
+  const ublox_gps::ConfigShadow& shadow_; //!< The applied configuration
+  mutable boost::mutex mutex_; //!< Lock, accessed by the I/O & ROS threads
+  bool answered_; //!< Whether the last round received a NavSTATUS
+  bool uptime_valid_; //!< Whether an uptime was received
+  uint32_t uptime_; //!< The last uptime [ms]
+  bool reset_; //!< Whether a reset is pending
+  uint32_t blocks_; //!< The pending drifted blocks
+  ros::Time last_match_; //!< Start of the last round without detections
+  ros::Time detected_; //!< Time of the first pending detection
+  Statistics statistics_; //!< Configuration monitor statistics
+};
+
+}  // namespace ublox_node
+
+#endif  // UBLOX_GPS_CONFIG_MONITOR_H
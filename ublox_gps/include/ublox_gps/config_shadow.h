@@ -0,0 +1,109 @@
+//==============================================================================
+// Copyright (c) 2012, Johannes Meyer, TU Darmstadt
+// All rights reserved.
+
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//     * Neither the name of the Flight Systems and Automatic Control group,
+//       TU Darmstadt, nor the names of its contributors may be used to
+//       endorse or promote products derived from this software without
+//       specific prior written permission.
+
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" 
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE 
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE 
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER BE LIABLE FOR ANY
+// DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+// (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+// LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+// ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+// SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//==============================================================================
+
+#ifndef UBLOX_GPS_CONFIG_SHADOW_H
+#define UBLOX_GPS_CONFIG_SHADOW_H
+
+#include <map>
+#include <boost/thread.hpp>
+// ROS messages
+#include <ublox_msgs/CfgMSG.h>
+#include <ublox_msgs/CfgNAV5.h>
+#include <ublox_msgs/CfgRATE.h>
+#include <ublox_msgs/CfgTMODE3.h>
+
+namespace ublox_gps {
+
+/**
+ * @brief Keeps the monitored configuration blocks as applied to the device,
+ * to detect configuration drift, e.g. after a reset to the default
+ * configuration.
+ *
+ * @details Only acknowledged configuration messages are kept. The CfgNAV5
+ * settings of all applied masks are merged.
+ */
+class ConfigShadow {
+ public:
+  //! The monitored configuration blocks
+  enum Block {
+    BLOCK_RATE = 1, //!< CfgRATE
+    BLOCK_NAV5 = 2, //!< CfgNAV5
+    BLOCK_TMODE3 = 4 //!< CfgTMODE3
+  };
+
+  ConfigShadow() : blocks_(0) {}
+
+  /**
+   * @brief Keep an applied configuration message, other messages than the
+   * monitored ones are ignored.
+   */
+  template <typename ConfigT>
+  void applied(const ConfigT&) {}
+  void applied(const ublox_msgs::CfgRATE& message);
+  void applied(const ublox_msgs::CfgNAV5& message);
+  void applied(const ublox_msgs::CfgTMODE3& message);
+  void applied(const ublox_msgs::CfgMSG& message);
+
+  /**
+   * @brief Get the applied blocks, see Block.
+   */
+  uint32_t blocks() const;
+
+  /**
+   * @brief Whether the configuration read from the device matches the
+   * applied configuration.
+   */
+  bool matches(const ublox_msgs::CfgRATE& message) const;
+  bool matches(const ublox_msgs::CfgNAV5& message) const;
+  bool matches(const ublox_msgs::CfgTMODE3& message) const;
+
+  /**
+   * @brief Get the applied configuration of a block.
+   */
+  ublox_msgs::CfgRATE rate() const;
+  ublox_msgs::CfgNAV5 nav5() const;
+  ublox_msgs::CfgTMODE3 tmode3() const;
+
+  /**
+   * @brief Get the applied message rates.
+   * @return the rates, by class ID << 8 | message ID
+   */
+  std::map<uint16_t, uint8_t> messageRates() const;
+
+ private:
+  mutable boost::mutex mutex_; //!< Lock, accessed by the I/O & ROS threads
+  uint32_t blocks_; //!< The applied blocks
+  ublox_msgs::CfgRATE rate_; //!< The applied rate
+  ublox_msgs::CfgNAV5 nav5_; //!< The merged navigation settings
+  ublox_msgs::CfgTMODE3 tmode3_; //!< The applied time mode
+  std::map<uint16_t, uint8_t> message_rates_; //!< The applied message rates
+};
+
+}  // namespace ublox_gps
+
+#endif  // UBLOX_GPS_CONFIG_SHADOW_H
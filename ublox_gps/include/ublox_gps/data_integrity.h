@@ -0,0 +1,222 @@
+//==============================================================================
+// Copyright (c) 2012, Johannes Meyer, TU Darmstadt
+// All rights reserved.
+
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//     * Neither the name of the Flight Systems and Automatic Control group,
+//       TU Darmstadt, nor the names of its contributors may be used to
+//       endorse or promote products derived from this software without
+//       specific prior written permission.
+
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" 
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE 
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE 
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER BE LIABLE FOR ANY
+// DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+// (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+// LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+// ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+// SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//==============================================================================
+
+#ifndef UBLOX_GPS_DATA_INTEGRITY_H
+#define UBLOX_GPS_DATA_INTEGRITY_H
+
+#include <map>
+#include <stdint.h>
+#include <sys/ioctl.h>
+#include <linux/serial.h>
+#include <boost/atomic.hpp>
+#include <boost/thread.hpp>
+#include <ublox_msgs/ublox_msgs.h>
+
+namespace ublox_gps {
+
+/**
+ * @brief Error counters of the Linux serial driver, see TIOCGICOUNT.
+ */
+struct SerialErrorCounters {
+  SerialErrorCounters() : overrun(0), frame(0), parity(0), brk(0),
+                          buf_overrun(0) {}
+
+  uint64_t overrun; //!< Hardware FIFO overruns
+  uint64_t frame; //!< Framing errors
+  uint64_t parity; //!< Parity errors
+  uint64_t brk; //!< Break conditions
+  uint64_t buf_overrun; //!< Driver (tty flip buffer) overruns
+};
+
+/**
+ * @brief Read the error counters of a serial port.
+ * @param fd the file descriptor of the serial port
+ * @param counters the counters output
+ * @return true if the driver supports TIOCGICOUNT, false otherwise
+ */
+inline bool readSerialErrorCounters(int fd, SerialErrorCounters& counters) {
+  if (fd < 0)
+    return false;
+  struct serial_icounter_struct icount;
+  if (ioctl(fd, TIOCGICOUNT, &icount) < 0)
+    return false;
+  counters.overrun = icount.overrun;
+  counters.frame = icount.frame;
+  counters.parity = icount.parity;
+  counters.brk = icount.brk;
+  counters.buf_overrun = icount.buf_overrun;
+  return true;
+}
+
+/**
+ * @brief Snapshot of the counters used to detect lost data.
+ */
+struct DataIntegrity {
+  DataIntegrity() : serial_counters_valid(false), frames(0),
+                    discarded_bytes(0), foreign_bytes(0), decode_errors(0),
+                    missing_epochs(0) {}
+
+  //! Whether the serial counters were read from the driver
+  bool serial_counters_valid;
+  //! Serial driver error counters
+  SerialErrorCounters serial;
+  //! Number of u-blox frames found in the input stream
+  uint64_t frames;
+  //! Number of bytes skipped while searching for u-blox frames
+  uint64_t discarded_bytes;
+  //! Number of skipped bytes which belonged to NMEA sentences or RTCM frames
+  uint64_t foreign_bytes;
+  //! Number of frames which failed to decode (e.g. checksum errors)
+  uint64_t decode_errors;
+  //! Number of navigation epochs missing from periodic NAV messages
+  uint64_t missing_epochs;
+};
+
+/**
+ * @brief Counts missing navigation epochs from the iTOW of periodic NAV
+ * messages.
+ *
+ * @details The expected iTOW increment of a message is the navigation period
+ * (meas_rate * nav_rate) times the rate the message was configured with, see
+ * CfgMSG. A larger increment is counted as missing epochs.
+ */
+class ItowContinuity {
+ public:
+  //! Number of milliseconds in a GPS week
+  constexpr static uint32_t kWeekMs = 604800000;
+
+  ItowContinuity() : nav_period_(0), missing_(0) {}
+
+  /**
+   * @brief Set the navigation period, resets the last iTOW of all messages.
+   * @param period the navigation period [ms], i.e. meas_rate * nav_rate
+   */
+  void setNavPeriod(uint32_t period) {
+    boost::mutex::scoped_lock lock(mutex_);
+    nav_period_ = period;
+    for (Streams::iterator it = streams_.begin(); it != streams_.end(); ++it)
+      it->second.initialized = false;
+  }
+
+  /**
+   * @brief Set the rate of the message, see CfgMSG.
+   * @param class_id the class ID of the message
+   * @param message_id the message ID of the message
+   * @param rate the message rate in navigation solutions, 0 stops tracking
+   */
+  void setRate(uint8_t class_id, uint8_t message_id, uint8_t rate) {
+    // Only NAV messages are output once per navigation solution
+    if (itowOffset(class_id, message_id) < 0)
+      return;
+    boost::mutex::scoped_lock lock(mutex_);
+    Key key = std::make_pair(class_id, message_id);
+    if (rate == 0) {
+      streams_.erase(key);
+      return;
+    }
+    Stream& stream = streams_[key];
+    stream.rate = rate;
+    stream.initialized = false;
+  }
+
+  /**
+   * @brief Update the iTOW of the message and count the missing epochs.
+   * @param class_id the class ID of the message
+   * @param message_id the message ID of the message
+   * @param payload the message payload
+   * @param length the length of the payload
+   */
+  void update(uint8_t class_id, uint8_t message_id, const uint8_t* payload,
+              uint32_t length) {
+    int offset = itowOffset(class_id, message_id);
+    if (offset < 0 || length < static_cast<uint32_t>(offset) + 4)
+      return;
+    boost::mutex::scoped_lock lock(mutex_);
+    Streams::iterator it = streams_.find(std::make_pair(class_id, message_id));
+    if (it == streams_.end() || nav_period_ == 0)
+      return;
+    Stream& stream = it->second;
+    uint32_t itow = payload[offset] | payload[offset + 1] << 8
+                    | payload[offset + 2] << 16 | payload[offset + 3] << 24;
+    if (stream.initialized) {
+      uint32_t delta = (itow + kWeekMs - stream.last_itow) % kWeekMs;
+      uint32_t expected = nav_period_ * stream.rate;
+      // A backward jump is a receiver reset, not lost data
+      if (delta > expected + expected / 2 && delta < kWeekMs / 2)
+        missing_ += (delta + expected / 2) / expected - 1;
+    }
+    stream.last_itow = itow;
+    stream.initialized = true;
+  }
+
+  /**
+   * @brief Get the byte offset of the iTOW in the message payload.
+   * @return the offset, or -1 if the message is not a NAV message
+   */
+  static int itowOffset(uint8_t class_id, uint8_t message_id) {
+    if (class_id != ublox_msgs::Class::NAV)
+      return -1;
+    // Messages starting with a version field
+    if (message_id == ublox_msgs::Message::NAV::RELPOSNED
+        || message_id == ublox_msgs::Message::NAV::SVIN
+        || message_id == ublox_msgs::Message::NAV::HPPOSECEF
+        || message_id == ublox_msgs::Message::NAV::HPPOSLLH)
+      return 4;
+    return 0;
+  }
+
+  /**
+   * @brief Get the total number of missing epochs of all messages.
+   *
+   * @details Lock-free, so it never blocks the data path.
+   */
+  uint64_t missing() const { return missing_; }
+
+ private:
+  typedef std::pair<uint8_t, uint8_t> Key;
+
+  //! The iTOW state of a message type
+  struct Stream {
+    Stream() : rate(1), initialized(false), last_itow(0) {}
+
+    uint8_t rate; //!< Rate in navigation solutions
+    bool initialized; //!< Whether last_itow is valid
+    uint32_t last_itow; //!< iTOW of the last received message [ms]
+  };
+
+  typedef std::map<Key, Stream> Streams;
+
+  mutable boost::mutex mutex_; //!< Lock for the message states
+  uint32_t nav_period_; //!< Navigation period [ms]
+  Streams streams_; //!< The iTOW state of each tracked message type
+  boost::atomic<uint64_t> missing_; //!< Number of missing epochs
+};
+
+}  // namespace ublox_gps
+
+#endif  // UBLOX_GPS_DATA_INTEGRITY_H
@@ -0,0 +1,262 @@
+//==============================================================================
+// Copyright (c) 2012, Johannes Meyer, TU Darmstadt
+// All rights reserved.
+
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//     * Neither the name of the Flight Systems and Automatic Control group,
+//       TU Darmstadt, nor the names of its contributors may be used to
+//       endorse or promote products derived from this software without
+//       specific prior written permission.
+
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" 
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE 
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE 
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER BE LIABLE FOR ANY
+// DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+// (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+// LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+// ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+// SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//==============================================================================
+
+#ifndef UBLOX_GPS_EPHEMERIS_H
+#define UBLOX_GPS_EPHEMERIS_H
+
+#include <vector>
+#include <boost/thread.hpp>
+// ROS messages
+#include <ublox_msgs/AidEPH.h>
+#include <ublox_msgs/RxmEPH.h>
+#include <ublox_msgs/RxmRAWX.h>
+
+namespace ublox_node {
+
+/**
+ * @brief Broadcast Keplerian ephemeris of a GPS, Galileo, BeiDou or QZSS
+ * satellite.
+ *
+ * @details Angles are in radians, times in seconds of the week of the GNSS
+ * time system.
+ */
+struct Ephemeris {
+  uint8_t gnss_id; //!< GNSS identifier, see the u-blox Satellite Numbering
+  uint8_t sv_id; //!< Satellite identifier
+  uint16_t week; //!< Week number as broadcast (GPS: modulo 1024)
+  uint16_t iode; //!< Issue of data
+  double toe; //!< Reference time of the ephemeris [s]
+  double toc; //!< Reference time of the clock [s]
+  double sqrt_a; //!< Square root of the semi-major axis [m^0.5]
+  double e; //!< Eccentricity
+  double i0; //!< Inclination angle at the reference time
+  double omega0; //!< Longitude of the ascending node at the week epoch
+  double omega; //!< Argument of perigee
+  double m0; //!< Mean anomaly at the reference time
+  double delta_n; //!< Mean motion difference [rad/s]
+  double idot; //!< Rate of the inclination angle [rad/s]
+  double omega_dot; //!< Rate of the right ascension [rad/s]
+  double cuc; //!< Argument of latitude cosine correction [rad]
+  double cus; //!< Argument of latitude sine correction [rad]
+  double crc; //!< Orbit radius cosine correction [m]
+  double crs; //!< Orbit radius sine correction [m]
+  double cic; //!< Inclination cosine correction [rad]
+  double cis; //!< Inclination sine correction [rad]
+  double af0; //!< Clock bias [s]
+  double af1; //!< Clock drift [s/s]
+  double af2; //!< Clock drift rate [s/s^2]
+  double tgd; //!< Group delay of the first frequency [s]
+};
+
+/**
+ * @brief Decode a GPS ephemeris from the data words of subframes 1 to 3.
+ *
+ * @details The words are the words 3 to 10 of each subframe without parity,
+ * the data bits are bits 0 to 23, as in RXM-EPH and AID-EPH.
+ * @param sv_id the GPS PRN
+ * @param sf1d the data words of subframe 1
+ * @param sf2d the data words of subframe 2
+ * @param sf3d the data words of subframe 3
+ * @param eph the decoded ephemeris
+ * @return false if a subframe is missing or the issues of data do not match
+ */
+bool decodeGpsEphemeris(uint8_t sv_id, const std::vector<uint32_t>& sf1d,
+                        const std::vector<uint32_t>& sf2d,
+                        const std::vector<uint32_t>& sf3d, Ephemeris& eph);
+
+/**
+ * @brief Evaluates the satellite positions, velocities and clock corrections
+ * of all satellites with an ephemeris.
+ *
+ * @details Keeps the latest ephemeris of each satellite. The ephemerides are
+ * stored as a structure of arrays and evaluated together in one loop without
+ * data-dependent branches, so that the compiler can vectorize it. The
+ * evaluation times are recorded to report the throughput in satellites per
+ * second.
+ */
+class EphemerisEngine {
+ public:
+  /**
+   * @brief Satellite states in ECEF, one entry per satellite.
+   */
+  struct States {
+    std::vector<uint8_t> gnss_id; //!< GNSS identifier
+    std::vector<uint8_t> sv_id; //!< Satellite identifier
+    std::vector<double> x; //!< ECEF X [m]
+    std::vector<double> y; //!< ECEF Y [m]
+    std::vector<double> z; //!< ECEF Z [m]
+    std::vector<double> vx; //!< ECEF X velocity [m/s]
+    std::vector<double> vy; //!< ECEF Y velocity [m/s]
+    std::vector<double> vz; //!< ECEF Z velocity [m/s]
+    //! Clock correction incl. relativistic correction & group delay [s]
+    std::vector<double> clock_bias;
+    std::vector<double> clock_drift; //!< Clock drift [s/s]
+    //! Time since the ephemeris reference time [s]
+    std::vector<double> age;
+
+    /**
+     * @brief Set the number of satellites.
+     */
+    void resize(std::size_t size);
+  };
+
+  /**
+   * @brief Pseudorange residual of a satellite, see check().
+   */
+  struct Residual {
+    uint8_t gnss_id; //!< GNSS identifier
+    uint8_t sv_id; //!< Satellite identifier
+    double elevation; //!< Elevation [rad]
+    double azimuth; //!< Azimuth, clockwise from north [rad]
+    double residual; //!< Pseudorange residual [m]
+  };
+
+  /**
+   * @brief Evaluation statistics.
+   */
+  struct Statistics {
+    std::size_t satellites; //!< Number of satellites with an ephemeris
+    uint32_t updates; //!< Number of new ephemerides
+    uint32_t epochs; //!< Number of evaluations
+    uint64_t evaluated; //!< Number of evaluated satellites
+    double time; //!< Total evaluation time [s]
+    uint32_t checks; //!< Number of checked RXM-RAWX epochs
+    //! Residuals of the last checked epoch, empty if too few satellites
+    std::vector<Residual> residuals;
+  };
+
+  EphemerisEngine();
+
+  /**
+   * @brief Set the ephemeris of a satellite, replaces the previous ephemeris.
+   * @return false if the ephemeris is the same as the current one or the GNSS
+   * is not supported
+   */
+  bool update(const Ephemeris& eph);
+
+  /**
+   * @brief Decode and set a GPS ephemeris from a RXM-EPH message.
+   */
+  void update(const ublox_msgs::RxmEPH& m);
+
+  /**
+   * @brief Decode and set a GPS ephemeris from an AID-EPH message.
+   */
+  void update(const ublox_msgs::AidEPH& m);
+
+  /**
+   * @brief Evaluate the states of all satellites.
+   * @param tow the GPS time of week of the signal transmission [s]
+   * @param states the satellite states
+   */
+  void evaluate(double tow, States& states);
+
+  /**
+   * @brief Check the satellite states against the pseudoranges of a RXM-RAWX
+   * epoch.
+   *
+   * @details Each satellite is evaluated at its signal transmission time,
+   * rcvTOW - prMes / c, and rotated with the Earth during the signal travel
+   * time. The receiver clock bias is removed as the median of the residuals.
+   * The ionosphere & troposphere are not corrected, so residuals of a few
+   * meters, more at low elevations, are normal, while a wrong ephemeris is
+   * off by kilometers.
+   * @param m the measurements
+   * @param receiver the ECEF position of the receiver [m]
+   * @param min_elevation the elevation mask [rad]
+   * @param residuals the residuals of the satellites with an ephemeris and a
+   * valid pseudorange above the mask, empty if there are too few
+   */
+  void check(const ublox_msgs::RxmRAWX& m, const double receiver[3],
+             double min_elevation, std::vector<Residual>& residuals);
+
+  /**
+   * @brief Get the evaluation statistics.
+   */
+  Statistics statistics() const;
+
+  /**
+   * @brief Compute the elevation and azimuth of a satellite.
+   * @param receiver the ECEF position of the receiver [m]
+   * @param x the ECEF X of the satellite [m]
+   * @param y the ECEF Y of the satellite [m]
+   * @param z the ECEF Z of the satellite [m]
+   * @param elev the elevation [rad]
+   * @param azim the azimuth, clockwise from north [rad]
+   */
+  static void elevationAzimuth(const double receiver[3], double x, double y,
+                               double z, double& elev, double& azim);
+
+ private:
+  /**
+   * @brief Decode and set a GPS ephemeris from RXM-EPH or AID-EPH.
+   */
+  template <typename EphT>
+  void updateGps(const EphT& m);
+
+  mutable boost::mutex mutex_; //!< Lock, the statistics are read by ROS
+  //! Row of each (gnssId, svId), -1 if no ephemeris
+  std::vector<int16_t> index_;
+
+  // Columns
+  std::vector<uint8_t> gnss_id_; //!< GNSS identifier
+  std::vector<uint8_t> sv_id_; //!< Satellite identifier
+  std::vector<uint16_t> iode_; //!< Issue of data
+  std::vector<double> gm_; //!< Gravitational constant of the GNSS [m^3/s^2]
+  std::vector<double> omega_e_; //!< Earth rotation rate of the GNSS [rad/s]
+  std::vector<double> time_offset_; //!< GNSS time - GPS time [s]
+  std::vector<double> geo_; //!< 1 for BeiDou GEO satellites, 0 otherwise
+  std::vector<double> toe_;
+  std::vector<double> toc_;
+  std::vector<double> sqrt_a_;
+  std::vector<double> e_;
+  std::vector<double> i0_;
+  std::vector<double> omega0_;
+  std::vector<double> omega_;
+  std::vector<double> m0_;
+  std::vector<double> delta_n_;
+  std::vector<double> idot_;
+  std::vector<double> omega_dot_;
+  std::vector<double> cuc_;
+  std::vector<double> cus_;
+  std::vector<double> crc_;
+  std::vector<double> crs_;
+  std::vector<double> cic_;
+  std::vector<double> cis_;
+  std::vector<double> af0_;
+  std::vector<double> af1_;
+  std::vector<double> af2_;
+  std::vector<double> tgd_;
+
+  Statistics statistics_; //!< Evaluation statistics
+  States states_; //!< The states evaluated by check()
+};
+
+}  // namespace ublox_node
+
+#endif  // UBLOX_GPS_EPHEMERIS_H
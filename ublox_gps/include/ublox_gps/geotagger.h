@@ -0,0 +1,209 @@
+//==============================================================================
+// Copyright (c) 2012, Johannes Meyer, TU Darmstadt
+// All rights reserved.
+
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//     * Neither the name of the Flight Systems and Automatic Control group,
+//       TU Darmstadt, nor the names of its contributors may be used to
+//       endorse or promote products derived from this software without
+//       specific prior written permission.
+
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" 
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE 
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE 
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER BE LIABLE FOR ANY
+// DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+// (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+// LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+// ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+// SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//==============================================================================
+
+#ifndef UBLOX_GPS_GEOTAGGER_H
+#define UBLOX_GPS_GEOTAGGER_H
+
+#include <deque>
+#include <vector>
+#include <boost/function.hpp>
+#include <boost/thread.hpp>
+#include <ros/time.h>
+// ROS messages
+#include <ublox_msgs/Geotag.h>
+#include <ublox_msgs/NavATT.h>
+#include <ublox_msgs/NavPVT.h>
+#include <ublox_msgs/TimTM2.h>
+
+namespace ublox_node {
+
+/**
+ * @brief Tags TIM-TM2 time marks with the position, velocity and attitude at
+ * the mark time.
+ *
+ * @details The recent navigation epochs are kept in fixed size rings. A mark
+ * is interpolated between the epochs before and after it once the epoch after
+ * it arrived, until then it waits in a bounded queue. The position is
+ * interpolated with a cubic Hermite spline, which uses the velocities of both
+ * epochs, the velocity and attitude are interpolated linearly. The memory is
+ * bounded by the ring and queue sizes, independent of the mark rate.
+ */
+class Geotagger {
+ public:
+  //! Callback for each tagged mark
+  typedef boost::function<void(const ublox_msgs::Geotag&)> Callback;
+
+  /**
+   * @brief Geotagger statistics.
+   */
+  struct Statistics {
+    uint32_t marks; //!< Number of received marks
+    uint32_t tagged; //!< Number of tagged marks
+    uint32_t rejected; //!< Marks without a valid GPS time
+    uint32_t dropped_old; //!< Marks older than the buffered epochs
+    uint32_t dropped_gap; //!< Marks between epochs too far apart
+    uint32_t dropped_overflow; //!< Marks dropped from the full queue
+    double last_interval; //!< Interval of the last interpolation [s]
+  };
+
+  /**
+   * @param capacity the number of buffered epochs
+   * @param max_pending the maximum number of marks waiting for an epoch
+   * @param max_gap the maximum time between the interpolated epochs [s]
+   * @param falling_edge whether to tag the falling instead of the rising edge
+   */
+  Geotagger(std::size_t capacity, std::size_t max_pending, double max_gap,
+            bool falling_edge);
+
+  /**
+   * @brief Set the callback which is called for each tagged mark.
+   */
+  void setCallback(const Callback& callback) { callback_ = callback; }
+
+  /**
+   * @brief Add a navigation epoch & tag the marks before it.
+   */
+  void addPvt(const ublox_msgs::NavPVT& m);
+
+  /**
+   * @brief Add the attitude of a navigation epoch.
+   *
+   * @details The attitude must be added before the NavPVT of the epoch, as
+   * output by the receiver.
+   */
+  void addAttitude(const ublox_msgs::NavATT& m);
+
+  /**
+   * @brief Add a time mark.
+   *
+   * @details The geotag is stamped with the receive time of the mark.
+   */
+  void addMark(const ublox_msgs::TimTM2& m);
+
+  /**
+   * @brief Get the geotagger statistics.
+   */
+  Statistics statistics() const;
+
+ private:
+  //! A navigation epoch, in the units of the geotag
+  struct Epoch {
+    double tow; //!< GPS time of week [ms]
+    double lat; //!< Latitude [deg]
+    double lon; //!< Longitude [deg]
+    double height; //!< Height above ellipsoid [m]
+    float vel[3]; //!< NED velocity [m/s]
+    float h_acc; //!< Horizontal accuracy estimate [m]
+    float v_acc; //!< Vertical accuracy estimate [m]
+    float s_acc; //!< Speed accuracy estimate [m/s]
+  };
+
+  //! The attitude of a navigation epoch
+  struct Attitude {
+    double tow; //!< GPS time of week [ms]
+    float angles[3]; //!< Roll, pitch & heading [deg]
+    float acc[3]; //!< Roll, pitch & heading accuracy [deg]
+  };
+
+  //! A mark waiting for the epoch after it
+  struct Mark {
+    double tow; //!< GPS time of week [ms]
+    ublox_msgs::Geotag tag; //!< The geotag, with the mark fields set
+  };
+
+  //! Ring of fixed capacity, overwrites the oldest element
+  template <typename T>
+  class Ring {
+   public:
+    explicit Ring(std::size_t capacity) : data_(capacity), head_(0),
+                                          size_(0) {}
+    void push(const T& t) {
+      data_[(head_ + size_) % data_.size()] = t;
+      if (size_ < data_.size())
+        ++size_;
+      else
+        head_ = (head_ + 1) % data_.size();
+    }
+    //! Get the i-th oldest element
+    const T& operator[](std::size_t i) const {
+      return data_[(head_ + i) % data_.size()];
+    }
+    std::size_t size() const { return size_; }
+    bool empty() const { return size_ == 0; }
+    const T& back() const { return (*this)[size_ - 1]; }
+
+   private:
+    std::vector<T> data_; //!< The elements
+    std::size_t head_; //!< Index of the oldest element
+    std::size_t size_; //!< Number of elements
+  };
+
+  /**
+   * @brief Find the elements before & after the given time.
+   * @param ring the ring to search
+   * @param tow the GPS time of week [ms]
+   * @param index the index of the element before the time
+   * @return true if found, false if the time isn't within the ring
+   */
+  template <typename T>
+  static bool bracket(const Ring<T>& ring, double tow, std::size_t& index);
+
+  /**
+   * @brief Tag a mark, if the epochs around it are available.
+   * @param mark the mark to tag
+   * @param tagged the tagged marks, to which the geotag is appended
+   * @return true if the mark was tagged or dropped, false if it must wait
+   */
+  bool tag(Mark& mark, std::vector<ublox_msgs::Geotag>& tagged);
+
+  /**
+   * @brief Call the callback for the tagged marks, outside of the lock.
+   */
+  void publish(const std::vector<ublox_msgs::Geotag>& tagged,
+               boost::mutex::scoped_lock& lock);
+
+  /**
+   * @brief Get the difference a - b of two times of week, wrapped at the week
+   * end [ms].
+   */
+  static double towDiff(double a, double b);
+
+  mutable boost::mutex mutex_; //!< Lock, accessed by the I/O & ROS threads
+  double max_gap_; //!< Maximum time between the interpolated epochs [ms]
+  bool falling_edge_; //!< Whether to tag the falling edge
+  std::size_t max_pending_; //!< Maximum number of waiting marks
+  Ring<Epoch> epochs_; //!< The recent navigation epochs
+  Ring<Attitude> attitudes_; //!< The recent attitudes
+  std::deque<Mark> pending_; //!< Marks waiting for the epoch after them
+  Statistics statistics_; //!< Geotagger statistics
+  Callback callback_; //!< Called for each tagged mark
+};
+
+}  // namespace ublox_node
+
+#endif  // UBLOX_GPS_GEOTAGGER_H
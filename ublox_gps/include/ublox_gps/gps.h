@@ -39,6 +39,7 @@
 #include <boost/asio/serial_port.hpp>
 #include <boost/asio/io_service.hpp>
 #include <boost/atomic.hpp>
+#include <boost/thread/recursive_mutex.hpp>
 // ROS
 #include <ros/console.h>
 // Other u-blox packages
@@ -46,6 +47,12 @@
 // u-blox gps
 #include <ublox_gps/async_worker.h>
 #include <ublox_gps/callback.h>
+#include <ublox_gps/config_shadow.h>
+#include <ublox_gps/data_integrity.h>
+#include <ublox_gps/metrics.h>
+#include <ublox_gps/overload.h>
+#include <ublox_gps/redundant_link.h>
+#include <ublox_gps/replay_worker.h>
 
 /**
  * @namespace ublox_gps
@@ -71,6 +78,9 @@ class Gps {
   constexpr static double kDefaultAckTimeout = 1.0;
   //! Size of write buffer for output messages
   constexpr static int kWriterSize = 2056;
+  //! Callback for the bytes sent to the device
+  typedef boost::function<void(const unsigned char*, std::size_t)>
+      SentDataCallback;
 
   Gps();
   virtual ~Gps();
@@ -89,6 +99,12 @@ class Gps {
    */
   void setConfigOnStartup(const bool config_on_startup) { config_on_startup_flag_ = config_on_startup; }
 
+  /**
+   * @brief Open the serial ports in exclusive mode (TIOCEXCL), so they are
+   * not probed or opened by other processes. Root can still open them.
+   */
+  void setExclusive(bool exclusive) { exclusive_ = exclusive; }
+
   /**
    * @brief Initialize TCP I/O.
    * @param host the TCP host
@@ -117,6 +133,40 @@ class Gps {
    */
   void resetSerial(std::string port);
 
+  /**
+   * @brief Open a second serial link to the same receiver.
+   *
+   * @details Frames are read from both links and the first copy of each frame
+   * is delivered, so that delivery continues if one link fails. Messages are
+   * sent over the primary link while it receives data, otherwise over the
+   * redundant link. Message rates are configured on both links. Call after
+   * initializing the primary link.
+   * @param port the device port address
+   * @param baudrate the desired baud rate of the port, the port is not
+   * configured by the node
+   */
+  void initializeRedundantSerial(std::string port, unsigned int baudrate);
+
+  /**
+   * @brief Initialize the replay of a capture file instead of a device.
+   *
+   * @details The received bytes are replayed with the original timing, see
+   * ReplayWorker.
+   * @param path the path of the capture file
+   * @param speed the replay speed factor, 0 to replay as fast as possible
+   */
+  void initializeReplay(std::string path, double speed);
+
+  /**
+   * @brief Initialize Serial I/O to probe a device, without configuring it.
+   *
+   * @details The port is opened in exclusive mode & the host baudrate is set
+   * directly. Throws std::runtime_error if the port can not be opened.
+   * @param port the device port address
+   * @param baudrate the host baudrate
+   */
+  void initializeProbe(std::string port, unsigned int baudrate);
+
   /**
    * @brief Closes the I/O port, and initiates save on shutdown procedure
    * if enabled.
@@ -154,6 +204,17 @@ class Gps {
    */
   bool clearBbr();
 
+  /**
+   * @brief Save the BBR data to flash while the receiver keeps running.
+   *
+   * @details Unlike the save on shutdown procedure, the GNSS is only stopped
+   * if requested, in which case it is restarted after the backup.
+   * @param stop_gnss whether to stop the GNSS during the backup, as
+   * recommended for a consistent BBR content, which interrupts the output
+   * @return true if the receiver acknowledged the backup, false otherwise
+   */
+  bool createBackup(bool stop_gnss);
+
   /**
    * @brief Configure the UART1 Port.
    * @param baudrate the baudrate of the port
@@ -229,6 +290,17 @@ class Gps {
                          std::vector<int8_t> arp_position_hp,
                          float fixed_pos_acc);
 
+  /**
+   * @brief Set the TMODE3 settings to fixed at the given ECEF position.
+   *
+   * @details Unlike the float arguments of configTmode3Fixed, the position
+   * keeps the full 0.1 mm precision of TMODE3.
+   * @param ecef the ARP position in ECEF coordinates [m]
+   * @param fixed_pos_acc Fixed position 3D accuracy [m]
+   * @return true on ACK, false on other conditions.
+   */
+  bool configTmode3FixedEcef(const double ecef[3], double fixed_pos_acc);
+
   /**
    * @brief Set the TMODE3 settings to survey-in.
    * @param svin_min_dur Survey-in minimum duration [s]
@@ -244,6 +316,34 @@ class Gps {
    */
   bool disableTmode3();
 
+  /**
+   * @brief Defer the rate configuration of subscribed messages.
+   *
+   * @details Used to subscribe to the messages the device already outputs
+   * before it is configured.
+   * @param defer whether to defer the rates of subsequent subscriptions
+   */
+  void setDeferRates(bool defer) { defer_rates_ = defer; }
+
+  /**
+   * @brief Configure the rates of the messages subscribed while rates were
+   * deferred & stop deferring rates.
+   * @return true if all rates were configured, false otherwise
+   */
+  bool setDeferredRates();
+
+  /**
+   * @brief Configure the rates of all messages again, e.g. after the device
+   * was reset to the default configuration.
+   * @return true if all rates were configured, false otherwise
+   */
+  bool reapplyRates();
+
+  /**
+   * @brief Get the monitored configuration blocks as applied to the device.
+   */
+  const ConfigShadow& getConfigShadow() const { return config_shadow_; }
+
   /**
    * @brief Set the rate at which the U-Blox device sends the given message
    * @param class_id the class identifier of the message
@@ -320,6 +420,9 @@ class Gps {
   /**
    * @brief Configure the U-Blox send rate of the message & subscribe to the
    * given message
+   *
+   * @details If rates are deferred, the rate is configured by
+   * setDeferredRates and the callback is subscribed immediately.
    * @param the callback handler for the message
    * @param rate the rate in Hz of the message
    */
@@ -344,6 +447,18 @@ class Gps {
   void subscribeId(typename CallbackHandler_<T>::Callback callback,
                    unsigned int message_id);
 
+  /**
+   * @brief Subscribe to the undecoded frames of the given message, does not
+   * configure the rate.
+   * @param callback the callback handler for the frames
+   * @param class_id the U-Blox message class ID
+   * @param message_id the U-Blox message ID
+   */
+  void subscribeRaw(const RawCallbackHandler::Callback& callback,
+                    uint8_t class_id, uint8_t message_id) {
+    callbacks_.insertRaw(callback, class_id, message_id);
+  }
+
   /**
    * Read a u-blox message of the given type.
    * @param message the received u-blox message
@@ -353,12 +468,18 @@ class Gps {
   bool read(T& message,
             const boost::posix_time::time_duration& timeout = default_timeout_);
 
-  bool isInitialized() const { return worker_ != 0; }
+  bool isInitialized() const { return primaryWorker() != 0; }
   bool isConfigured() const { return isInitialized() && configured_; }
-  bool isOpen() const { return worker_->isOpen(); }
+  bool isOpen() const {
+    boost::shared_ptr<Worker> worker = primaryWorker();
+    return worker && worker->isOpen();
+  }
 
   /**
    * Poll a u-blox message of the given type.
+   *
+   * @details Serialized with other polls and configuration messages, so
+   * concurrent callers never receive each other's replies.
    * @param message the received u-blox message output
    * @param payload the poll message payload sent to the device
    * defaults to empty
@@ -381,6 +502,10 @@ class Gps {
 
   /**
    * @brief Send the given configuration message.
+   *
+   * @details If waiting, serialized with other configuration messages and
+   * polls, so concurrent callers never consume each other's ACK / NAK. Must
+   * not wait from the I/O thread, which dispatches the ACK.
    * @param message the configuration message
    * @param wait if true, wait for an ACK
    * @return true if message sent successfully and either ACK was received or
@@ -405,6 +530,166 @@ class Gps {
    */
   void setRawDataCallback(const Worker::Callback& callback);
 
+  /**
+   * @brief Set the callback function which handles the sent data.
+   *
+   * @details Set before initializing the I/O to include the configuration of
+   * the port.
+   * @param callback the callback which handles the sent bytes
+   */
+  void setSentDataCallback(const SentDataCallback& callback) {
+    sent_data_callback_ = callback;
+  }
+
+  /**
+   * @brief Set the expected navigation period used to detect missing epochs.
+   *
+   * @details Called by configRate, set it explicitly if the rate is not
+   * configured by the node.
+   * @param meas_rate the measurement period [ms]
+   * @param nav_rate the navigation rate in number of measurement cycles
+   */
+  void setNavPeriod(uint16_t meas_rate, uint16_t nav_rate) {
+    itow_continuity_.setNavPeriod(meas_rate * nav_rate);
+  }
+
+  /**
+   * @brief Get the counters used to detect lost data.
+   *
+   * @details Includes the serial driver error counters (serial ports only),
+   * parser statistics and the number of missing navigation epochs.
+   * @param serial_counters whether to read the serial driver error counters,
+   * which needs an ioctl. The other counters are read lock-free.
+   */
+  DataIntegrity getDataIntegrity(bool serial_counters = true) const;
+
+  /**
+   * @brief Enable shedding of low-priority messages when the dispatch of
+   * incoming messages falls behind.
+   * @param max_pending the maximum number of undecoded bytes
+   * @param max_lag the maximum age of the oldest undecoded frame [s]
+   * @param restore_time how long the lag must stay below half of the limits
+   * before shedding stops [s]
+   */
+  void setOverloadLimits(uint32_t max_pending, double max_lag,
+                         double restore_time) {
+    overload_.setLimits(max_pending, max_lag, restore_time);
+  }
+
+  /**
+   * @brief Drop all messages of the given class without decoding them while
+   * overloaded.
+   * @param class_id the u-blox message class
+   */
+  void shedOnOverload(uint8_t class_id) { overload_.addSheddable(class_id); }
+
+  /**
+   * @brief Drop the given message type without decoding it while overloaded.
+   * @param class_id the u-blox message class
+   * @param message_id the u-blox message ID
+   */
+  void shedOnOverload(uint8_t class_id, uint8_t message_id) {
+    overload_.addSheddable(class_id, message_id);
+  }
+
+  /**
+   * @brief Dispatch the given message type ahead of other messages when
+   * several messages are received at once.
+   * @param class_id the u-blox message class
+   * @param message_id the u-blox message ID
+   */
+  void setPriority(uint8_t class_id, uint8_t message_id) {
+    callbacks_.addPriority(class_id, message_id);
+  }
+
+  /**
+   * @brief Whether the receiver is connected over a redundant link.
+   */
+  bool hasRedundantLink() const { return redundant_worker_ != 0; }
+
+  /**
+   * @brief Get the statistics of the primary (0) or redundant (1) link.
+   */
+  LinkStatistics getLinkStatistics(std::size_t link) const {
+    return deduplicator_.statistics(link);
+  }
+
+  /**
+   * @brief Get the read errors of the primary (0) or redundant (1) link.
+   */
+  ReadErrors getReadErrors(std::size_t link) const {
+    ReadErrors errors;
+    boost::shared_ptr<Worker> worker =
+        link == 0 ? primaryWorker() : redundant_worker_;
+    if (worker)
+      worker->getReadErrors(errors);
+    return errors;
+  }
+
+  /**
+   * @brief Whether low-priority messages are currently shed.
+   */
+  bool isOverloaded() const { return overload_.overloaded(); }
+
+  /**
+   * @brief Get the dispatch lag and the shedding counters.
+   */
+  OverloadStatus getOverloadStatus() const { return overload_.status(); }
+
+  /**
+   * @brief Get the frame & byte counters per message type.
+   *
+   * @details The counters include duplicate frames of a redundant link.
+   */
+  const FrameCounters& getFrameCounters() const { return frame_counters_; }
+
+  /**
+   * @brief Get the latency of the ACKs of configuration messages.
+   */
+  const Histogram& getAckLatency() const { return ack_latency_; }
+
+  /**
+   * @brief Get the number of undecoded bytes when the last frame was
+   * dispatched.
+   */
+  uint32_t getPendingBytes() const {
+    return pending_bytes_.load(boost::memory_order_relaxed);
+  }
+
+  /**
+   * @brief Get the age of the last frame when it was dispatched [s].
+   */
+  double getDispatchLag() const {
+    return dispatch_lag_.load(boost::memory_order_relaxed);
+  }
+
+  /**
+   * @brief Set how the reads of the serial & TCP links are coalesced, see
+   * AsyncWorker. Call before initializing the I/O.
+   */
+  void setReadCoalescing(const ReadCoalescing& coalescing) {
+    coalescing_ = coalescing;
+  }
+
+  /**
+   * @brief Get the read statistics of the primary link.
+   * @return false if the link does not keep them
+   */
+  bool getReadStatistics(ReadStatistics& statistics) const {
+    boost::shared_ptr<Worker> worker = primaryWorker();
+    return worker && worker->getReadStatistics(statistics);
+  }
+
+  /**
+   * @brief Get when the buffer holding the frame currently dispatched was
+   * received by the host (UTC).
+   *
+   * @details Only meaningful when called from a message callback.
+   */
+  const boost::posix_time::ptime& getArrivalTime() const {
+    return buffer_time_[link_];
+  }
+
  private:
   //! Types for ACK/NACK messages, WAIT is used when waiting for an ACK
   enum AckType {
@@ -431,6 +716,67 @@ class Gps {
    */
   void subscribeAcks();
 
+  /**
+   * @brief Process the input buffer of the I/O worker.
+   *
+   * @details Measures the dispatch lag and passes the buffer to the callback
+   * handlers.
+   * @param link the link the data was received on, 0 for the primary link
+   * @param data the buffer of u-blox messages to process
+   * @param size the size of the buffer
+   */
+  void readCallback(std::size_t link, unsigned char* data, std::size_t& size);
+
+  /**
+   * @brief Get the worker of the link to send messages over.
+   *
+   * @details The redundant link is used if the primary link stopped receiving
+   * data and the redundant link did not.
+   */
+  boost::shared_ptr<Worker> sendWorker() const;
+
+  /**
+   * @brief Get the worker of the primary link, null while the I/O is reset.
+   *
+   * @details The worker is replaced when the I/O is reset, e.g. by the
+   * configuration thread, while the other threads send over it.
+   */
+  boost::shared_ptr<Worker> primaryWorker() const {
+    boost::mutex::scoped_lock lock(worker_mutex_);
+    return worker_;
+  }
+
+  /**
+   * @brief Send the data bytes to the device.
+   * @param data the bytes to send
+   * @param size the size of the buffer
+   */
+  bool send(const unsigned char* data, const unsigned int size) {
+    boost::shared_ptr<Worker> worker = sendWorker();
+    if (!worker)
+      return false;
+    if (sent_data_callback_)
+      sent_data_callback_(data, size);
+    return worker->send(data, size);
+  }
+
+  /**
+   * @brief Process a u-blox frame when it is found in the input stream.
+   * @param reader a reader positioned at the frame
+   * @return false if the checksum is invalid or the frame is a duplicate,
+   * true otherwise
+   */
+  bool processFrame(ublox::Reader& reader);
+
+  /**
+   * @brief Measure the dispatch lag just before a frame is decoded.
+   * @param reader a reader containing the frame
+   * @param remaining the number of received bytes not yet dispatched,
+   * including the frame
+   * @return false if the frame should be shed, true otherwise
+   */
+  bool dispatchFrame(ublox::Reader& reader, uint32_t remaining);
+
   /**
    * @brief Callback handler for UBX-ACK message.
    * @param m the message to process
@@ -461,23 +807,85 @@ class Gps {
    */
   bool saveOnShutdown();
 
+  //! A message rate which is not configured yet
+  struct DeferredRate {
+    uint8_t class_id; //!< The class ID of the message
+    uint8_t message_id; //!< The message ID of the message
+    uint8_t rate; //!< The rate, see CfgMSG
+  };
+
   //! Processes I/O stream data
   boost::shared_ptr<Worker> worker_;
+  //! Lock for replacing worker_, read it with primaryWorker()
+  mutable boost::mutex worker_mutex_;
+  //! Handles the received raw data, passed to the worker
+  Worker::Callback raw_data_callback_;
+  //! Handles the sent data
+  SentDataCallback sent_data_callback_;
   //! Whether or not the I/O port has been configured
   bool configured_;
   //! Whether or not to save Flash BBR on shutdown
   bool save_on_shutdown_;
   //!< Whether or not initial configuration to the hardware is done
   bool config_on_startup_flag_;
+  //! Whether to open the serial ports in exclusive mode
+  bool exclusive_;
+  //! How the reads are coalesced
+  ReadCoalescing coalescing_;
 
 
   //! The default timeout for ACK messages
   static const boost::posix_time::time_duration default_timeout_;
   //! Stores last received ACK accessed by multiple threads
   mutable boost::atomic<Ack> ack_;
+  //! Serializes configuration & poll transactions, which wait for a reply
+  /*!
+   * Recursive, since some transactions consist of several configuration
+   * messages and polls.
+   */
+  boost::recursive_mutex transaction_mutex_;
+
+  //! Whether to defer the rate configuration of subscribed messages
+  bool defer_rates_;
+  //! Rates of the messages subscribed while rates were deferred
+  std::vector<DeferredRate> deferred_rates_;
+  //! The monitored configuration blocks as applied to the device
+  ConfigShadow config_shadow_;
 
   //! Callback handlers for u-blox messages
   CallbackHandlers callbacks_;
+  //! Counts missing epochs of periodic NAV messages
+  ItowContinuity itow_continuity_;
+  //! File descriptor of the I/O stream, -1 if not open
+  boost::atomic<int> stream_handle_;
+  //! Sheds low-priority messages when the dispatch falls behind
+  OverloadController overload_;
+  //! Number of bytes waiting in the kernel when the buffer was read
+  uint32_t kernel_pending_;
+  //! When the oldest byte in the input buffer of each link was received
+  boost::posix_time::ptime buffer_time_[FrameDeduplicator::kLinks];
+  //! Whether bytes of an incomplete frame are left in the input buffer
+  bool buffered_[FrameDeduplicator::kLinks];
+
+  //! Processes I/O stream data of the redundant link
+  boost::shared_ptr<Worker> redundant_worker_;
+  //! File descriptor of the redundant link, -1 if not open
+  boost::atomic<int> redundant_handle_;
+  //! Serializes the dispatch of frames received over different links
+  boost::mutex dispatch_mutex_;
+  //! The link of the frames currently dispatched
+  std::size_t link_;
+  //! Delivers the first copy of frames received over both links
+  FrameDeduplicator deduplicator_;
+
+  //! Frame & byte counters per message type
+  FrameCounters frame_counters_;
+  //! Latency of the ACKs of configuration messages [s]
+  Histogram ack_latency_;
+  //! Number of undecoded bytes when the last frame was dispatched
+  boost::atomic<uint32_t> pending_bytes_;
+  //! Age of the last frame when it was dispatched [s]
+  boost::atomic<double> dispatch_lag_;
 
   std::string host_, port_;
 };
@@ -485,7 +893,13 @@ class Gps {
 template <typename T>
 void Gps::subscribe(
     typename CallbackHandler_<T>::Callback callback, unsigned int rate) {
-  if (!setRate(T::CLASS_ID, T::MESSAGE_ID, rate)) return;
+  if (defer_rates_) {
+    DeferredRate deferred = {T::CLASS_ID, T::MESSAGE_ID,
+                             static_cast<uint8_t>(rate)};
+    deferred_rates_.push_back(deferred);
+  } else if (!setRate(T::CLASS_ID, T::MESSAGE_ID, rate)) {
+    return;
+  }
   subscribe<T>(callback);
 }
 
@@ -504,24 +918,20 @@ template <typename ConfigT>
 bool Gps::poll(ConfigT& message,
                const std::vector<uint8_t>& payload,
                const boost::posix_time::time_duration& timeout) {
+  boost::recursive_mutex::scoped_lock lock(transaction_mutex_);
   if (!poll(ConfigT::CLASS_ID, ConfigT::MESSAGE_ID, payload)) return false;
   return read(message, timeout);
 }
 
 template <typename T>
 bool Gps::read(T& message, const boost::posix_time::time_duration& timeout) {
-  if (!worker_) return false;
+  if (!primaryWorker()) return false;
   return callbacks_.read(message, timeout);
 }
 
 template <typename ConfigT>
 bool Gps::configure(const ConfigT& message, bool wait) {
-  if (!worker_) return false;
-
-  // Reset ack
-  Ack ack;
-  ack.type = WAIT;
-  ack_.store(ack, boost::memory_order_seq_cst);
+  if (!primaryWorker()) return false;
 
   // Encode the message
   std::vector<unsigned char> out(kWriterSize);
@@ -531,15 +941,28 @@ bool Gps::configure(const ConfigT& message, bool wait) {
               message.CLASS_ID, message.MESSAGE_ID);
     return false;
   }
-  // Send the message to the device
-  worker_->send(out.data(), writer.end() - out.data());
 
-  if (!wait) return true;
+  // Without waiting, the message is not part of a transaction. It may be sent
+  // from the I/O thread, which must never block on the transaction lock.
+  if (!wait) {
+    send(out.data(), writer.end() - out.data());
+    return true;
+  }
+
+  boost::recursive_mutex::scoped_lock lock(transaction_mutex_);
+  // Reset ack
+  Ack ack;
+  ack.type = WAIT;
+  ack_.store(ack, boost::memory_order_seq_cst);
+  // Send the message to the device
+  send(out.data(), writer.end() - out.data());
 
   // Wait for an acknowledgment and return whether or not it was received
-  return waitForAcknowledge(default_timeout_,
-                            message.CLASS_ID,
-                            message.MESSAGE_ID);
+  if (!waitForAcknowledge(default_timeout_, message.CLASS_ID,
+                          message.MESSAGE_ID))
+    return false;
+  config_shadow_.applied(message);
+  return true;
 }
 
 }  // namespace ublox_gps
@@ -0,0 +1,165 @@
+//==============================================================================
+// Copyright (c) 2012, Johannes Meyer, TU Darmstadt
+// All rights reserved.
+
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//     * Neither the name of the Flight Systems and Automatic Control group,
+//       TU Darmstadt, nor the names of its contributors may be used to
+//       endorse or promote products derived from this software without
+//       specific prior written permission.
+
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" 
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE 
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE 
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER BE LIABLE FOR ANY
+// DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+// (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+// LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+// ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+// SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//==============================================================================
+
+#ifndef UBLOX_GPS_HISTORY_STORE_H
+#define UBLOX_GPS_HISTORY_STORE_H
+
+#include <string>
+#include <vector>
+#include <boost/shared_ptr.hpp>
+#include <boost/thread.hpp>
+#include <ros/time.h>
+// ROS messages
+#include <ublox_msgs/HistoryRecord.h>
+
+namespace ublox_node {
+
+/**
+ * @brief Bounded in-memory history of one u-blox message.
+ *
+ * @details The frames are stored back to back in a fixed size byte ring. The
+ * receive time, iTOW, offset and size of each frame are stored in columns of
+ * a fixed capacity. Adding a frame evicts the oldest frames which overlap its
+ * space or which are older than the maximum age.
+ */
+class HistoryRing {
+ public:
+  /**
+   * @param name the name of the message, e.g. nav_pvt
+   * @param budget the size of the byte ring [bytes]
+   * @param max_age the maximum age of the stored frames [s]
+   * @param itow_offset the offset of the iTOW in the payload, -1 if none
+   */
+  HistoryRing(const std::string& name, std::size_t budget, double max_age,
+              int itow_offset);
+
+  /**
+   * @brief Add a frame.
+   * @param frame the frame incl. header and checksum
+   * @param size the size of the frame
+   */
+  void add(const uint8_t* frame, uint32_t size);
+
+  /**
+   * @brief Get the frames received in the given time range.
+   * @param start the start of the range
+   * @param end the end of the range
+   * @param records the matching frames are appended
+   */
+  void query(const ros::Time& start, const ros::Time& end,
+             std::vector<ublox_msgs::HistoryRecord>& records) const;
+
+  /**
+   * @brief Get the frames with an iTOW in the given range.
+   *
+   * @details If end is less than start, the range wraps at the week end.
+   * @param start the start of the range [ms]
+   * @param end the end of the range [ms]
+   * @param records the matching frames are appended
+   */
+  void queryItow(uint32_t start, uint32_t end,
+                 std::vector<ublox_msgs::HistoryRecord>& records) const;
+
+  /**
+   * @brief Get the name of the message.
+   */
+  const std::string& name() const { return name_; }
+
+ private:
+  /**
+   * @brief Remove the oldest frame.
+   */
+  void pop();
+
+  /**
+   * @brief Append the frame in the given column row to the records.
+   */
+  void append(std::size_t i,
+              std::vector<ublox_msgs::HistoryRecord>& records) const;
+
+  mutable boost::mutex mutex_; //!< Lock, accessed by the I/O & ROS threads
+  std::string name_; //!< The name of the message
+  double max_age_; //!< Maximum age of the stored frames [s]
+  int itow_offset_; //!< Offset of the iTOW in the payload, -1 if none
+
+  std::vector<uint8_t> data_; //!< The byte ring
+  std::size_t write_; //!< Offset in the byte ring of the next frame
+
+  // Columns, ring of fixed capacity
+  std::vector<ros::Time> stamp_; //!< Receive time
+  std::vector<uint32_t> itow_; //!< iTOW [ms]
+  std::vector<uint32_t> offset_; //!< Offset of the frame in the byte ring
+  std::vector<uint32_t> size_; //!< Size of the frame
+  std::size_t head_; //!< Row of the oldest frame
+  std::size_t count_; //!< Number of stored frames
+};
+
+/**
+ * @brief Histories of several u-blox messages.
+ */
+class HistoryStore {
+ public:
+  /**
+   * @brief Add the history of a message.
+   * @return the history, to which the frames are added
+   */
+  boost::shared_ptr<HistoryRing> add(const std::string& name,
+                                     std::size_t budget, double max_age,
+                                     int itow_offset);
+
+  /**
+   * @brief Get the frames of the given messages by time or iTOW range.
+   * @param names the names of the messages, all if empty
+   * @param use_itow whether to use the iTOW range instead of the time range
+   * @param start the start of the time range
+   * @param end the end of the time range
+   * @param start_itow the start of the iTOW range [ms]
+   * @param end_itow the end of the iTOW range [ms]
+   * @param records the frames, sorted by receive time
+   */
+  void query(const std::vector<std::string>& names, bool use_itow,
+             const ros::Time& start, const ros::Time& end,
+             uint32_t start_itow, uint32_t end_itow,
+             std::vector<ublox_msgs::HistoryRecord>& records) const;
+
+  /**
+   * @brief Save all stored frames, sorted by receive time, to a UBX file.
+   * @param path the path of the file
+   * @param num_records the number of saved frames
+   * @return false if the file could not be written
+   */
+  bool save(const std::string& path, uint32_t& num_records) const;
+
+ private:
+  //! The message histories
+  std::vector<boost::shared_ptr<HistoryRing> > rings_;
+};
+
+}  // namespace ublox_node
+
+#endif  // UBLOX_GPS_HISTORY_STORE_H
@@ -0,0 +1,161 @@
+//==============================================================================
+// Copyright (c) 2012, Johannes Meyer, TU Darmstadt
+// All rights reserved.
+
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//     * Neither the name of the Flight Systems and Automatic Control group,
+//       TU Darmstadt, nor the names of its contributors may be used to
+//       endorse or promote products derived from this software without
+//       specific prior written permission.
+
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" 
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE 
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE 
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER BE LIABLE FOR ANY
+// DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+// (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+// LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+// ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+// SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//==============================================================================
+
+#ifndef UBLOX_GPS_LOCAL_FRAME_H
+#define UBLOX_GPS_LOCAL_FRAME_H
+
+#include <cstddef>
+#include <boost/thread.hpp>
+
+namespace ublox_node {
+
+/**
+ * @brief Converts WGS 84 positions to a local East-North-Up frame.
+ *
+ * @details The ECEF position and the rotation of the origin are computed once
+ * when the origin is set. The conversion kernels work on arrays, so they can
+ * also be used to convert recorded positions offline.
+ */
+class LocalFrame {
+ public:
+  //! How the origin is determined
+  enum OriginSource {
+    ORIGIN_FIXED, //!< Set from parameters
+    ORIGIN_FIRST_FIX, //!< The first 3D fix
+    ORIGIN_SURVEY_IN //!< The survey-in position of the base station
+  };
+
+  /**
+   * @param source how the origin is determined
+   */
+  explicit LocalFrame(OriginSource source);
+
+  /**
+   * @brief How the origin is determined.
+   */
+  OriginSource source() const { return source_; }
+
+  /**
+   * @brief Whether the origin is set.
+   */
+  bool valid() const;
+
+  /**
+   * @brief Set the origin.
+   * @param lat the latitude [deg]
+   * @param lon the longitude [deg]
+   * @param height the height above the ellipsoid [m]
+   */
+  void setOrigin(double lat, double lon, double height);
+
+  /**
+   * @brief Set the origin.
+   * @param ecef the ECEF position [m]
+   */
+  void setOriginEcef(const double ecef[3]);
+
+  /**
+   * @brief Get the origin.
+   * @param lla the latitude [deg], longitude [deg] & height [m]
+   * @return false if the origin is not set
+   */
+  bool origin(double lla[3]) const;
+
+  /**
+   * @brief Convert a position to the local frame.
+   * @param lat the latitude [deg]
+   * @param lon the longitude [deg]
+   * @param height the height above the ellipsoid [m]
+   * @param enu the position in the local frame [m]
+   * @param rotation if not null, the row-major rotation from the ENU frame at
+   * the position to the local frame
+   * @return false if the origin is not set
+   */
+  bool toEnu(double lat, double lon, double height, double enu[3],
+             double rotation[9] = 0) const;
+
+  /**
+   * @brief Convert positions to the local frame.
+   * @param lat the latitudes [deg]
+   * @param lon the longitudes [deg]
+   * @param height the heights above the ellipsoid [m]
+   * @param n the number of positions
+   * @param east the East coordinates [m]
+   * @param north the North coordinates [m]
+   * @param up the Up coordinates [m]
+   * @return false if the origin is not set
+   */
+  bool toEnu(const double* lat, const double* lon, const double* height,
+             std::size_t n, double* east, double* north, double* up) const;
+
+  /**
+   * @brief Rotate a vector.
+   * @param rotation the row-major rotation
+   * @param v the vector
+   * @param out the rotated vector, must not be v
+   */
+  static void rotate(const double rotation[9], const double v[3],
+                     double out[3]);
+
+  /**
+   * @brief Rotate a covariance matrix, R * C * R^T.
+   * @param rotation the row-major rotation
+   * @param covariance the row-major 3x3 covariance
+   * @param out the rotated covariance, must not be covariance
+   */
+  static void rotateCovariance(const double rotation[9],
+                               const double covariance[9], double out[9]);
+
+  /**
+   * @brief Convert a WGS 84 position to ECEF.
+   * @param lat the latitude [deg]
+   * @param lon the longitude [deg]
+   * @param height the height above the ellipsoid [m]
+   * @param ecef the ECEF position [m]
+   */
+  static void toEcef(double lat, double lon, double height, double ecef[3]);
+
+  /**
+   * @brief Convert an ECEF position to WGS 84.
+   * @param ecef the ECEF position [m]
+   * @param lla the latitude [deg], longitude [deg] & height [m]
+   */
+  static void toLla(const double ecef[3], double lla[3]);
+
+ private:
+  mutable boost::mutex mutex_; //!< Lock, the origin may be set by callbacks
+  OriginSource source_; //!< How the origin is determined
+  bool valid_; //!< Whether the origin is set
+  double origin_lla_[3]; //!< The origin [deg, deg, m]
+  double origin_ecef_[3]; //!< The ECEF position of the origin [m]
+  double rotation_[9]; //!< Row-major rotation from ECEF to the local frame
+};
+
+}  // namespace ublox_node
+
+#endif  // UBLOX_GPS_LOCAL_FRAME_H
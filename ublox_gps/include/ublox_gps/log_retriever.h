@@ -0,0 +1,169 @@
+//==============================================================================
+// Copyright (c) 2012, Johannes Meyer, TU Darmstadt
+// All rights reserved.
+
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//     * Neither the name of the Flight Systems and Automatic Control group,
+//       TU Darmstadt, nor the names of its contributors may be used to
+//       endorse or promote products derived from this software without
+//       specific prior written permission.
+
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" 
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE 
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE 
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER BE LIABLE FOR ANY
+// DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+// (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+// LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+// ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+// SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//==============================================================================
+
+#ifndef UBLOX_GPS_LOG_RETRIEVER_H
+#define UBLOX_GPS_LOG_RETRIEVER_H
+
+#include <vector>
+#include <boost/function.hpp>
+#include <boost/thread.hpp>
+#include <ros/time.h>
+// ROS messages
+#include <ublox_msgs/LogRETRIEVE.h>
+
+namespace ublox_node {
+
+/**
+ * @brief Drains the log or the batched fixes stored on the device.
+ *
+ * @details The log entries are requested in windows of up to
+ * LogRETRIEVE::ENTRY_COUNT_MAX entries. The receiver runs one retrieval at a
+ * time, so the request of the next window is sent as soon as the last entry
+ * of the current window arrives instead of waiting for a timer. Each window
+ * starts at the first missing entry and ends before the next received entry,
+ * so lost entries are requested again with the next window or when no entry
+ * arrived within the timeout, without retrieving received entries again.
+ * Entries which were already received are rejected.
+ * Batches are sent by the receiver in one go, the retrieval ends when no
+ * LOG-BATCH arrived within the timeout.
+ */
+class LogRetriever {
+ public:
+  //! Sends a LOG-RETRIEVE request to the device
+  typedef boost::function<bool(const ublox_msgs::LogRETRIEVE&)> Request;
+
+  /**
+   * @brief The progress of the current or last retrieval.
+   */
+  struct Progress {
+    bool active; //!< Whether a retrieval is running
+    bool batch; //!< Whether batches or log entries are retrieved
+    bool complete; //!< Whether all entries were received
+    uint32_t total; //!< The number of log entries, 0 for batches
+    uint32_t received; //!< The number of received entries or batches
+    uint32_t requests; //!< The number of sent requests
+    uint32_t retries; //!< The number of requests for missing entries
+    uint32_t missing; //!< Batches lost according to the message counter
+    uint64_t bytes; //!< Received bytes, incl. the UBX frame
+    double elapsed; //!< Time since the start [s]
+    double throughput; //!< Received bytes per second
+  };
+
+  /**
+   * @param request sends a LOG-RETRIEVE request to the device
+   * @param window the number of entries per request
+   * @param timeout time without entries until the entries are requested again
+   * or the batch retrieval ends [s]
+   * @param max_retries the maximum number of repeated requests starting at the
+   * same entry
+   */
+  LogRetriever(const Request& request, uint32_t window, double timeout,
+               uint32_t max_retries);
+
+  /**
+   * @brief Start retrieving log entries.
+   * @param start the index of the first entry
+   * @param count the number of entries
+   * @return false if a retrieval is running or the first request failed
+   */
+  bool start(uint32_t start, uint32_t count);
+
+  /**
+   * @brief Start a batch retrieval, the caller sends the LOG-RETRIEVEBATCH.
+   * @return false if a retrieval is running
+   */
+  bool startBatch();
+
+  /**
+   * @brief Count a received log entry & request the next window.
+   * @param index the index of the entry
+   * @return false if the entry was not requested or is a duplicate
+   */
+  bool addEntry(uint32_t index);
+
+  /**
+   * @brief Count a received batch.
+   * @param msg_cnt the message counter of the LOG-BATCH
+   * @return false if no batch retrieval is running
+   */
+  bool addBatch(uint16_t msg_cnt);
+
+  /**
+   * @brief Count the received bytes of a LOG frame.
+   */
+  void addBytes(uint32_t size);
+
+  /**
+   * @brief Request missing entries or end the batch retrieval if no entry
+   * arrived within the timeout.
+   */
+  void checkTimeout();
+
+  /**
+   * @brief Get the progress of the current or last retrieval.
+   */
+  Progress progress() const;
+
+ private:
+  /**
+   * @brief Fill the request of the missing entries starting at the first
+   * missing entry.
+   * @return false if the maximum number of requests for the entry was reached
+   */
+  bool nextRequest(ublox_msgs::LogRETRIEVE& m);
+
+  /**
+   * @brief Send a request, stop the retrieval if it fails.
+   */
+  void send(const ublox_msgs::LogRETRIEVE& m);
+
+  /**
+   * @brief Stop the retrieval.
+   */
+  void finish(bool complete);
+
+  mutable boost::mutex mutex_; //!< Lock, the service & I/O threads use it
+  Request request_; //!< Sends a LOG-RETRIEVE request to the device
+  uint32_t window_; //!< The number of entries per request
+  double timeout_; //!< Time without entries until the next action [s]
+  uint32_t max_retries_; //!< The maximum number of repeated requests
+  uint32_t start_; //!< The index of the first entry to retrieve
+  std::vector<bool> received_; //!< Whether each entry was received
+  uint32_t next_; //!< The index of the first missing entry
+  uint32_t window_start_; //!< The index of the first requested entry
+  uint32_t window_end_; //!< One past the index of the last requested entry
+  uint32_t attempts_; //!< The number of requests starting at next_
+  uint16_t msg_cnt_; //!< The message counter of the last batch
+  ros::Time start_time_; //!< The start of the retrieval
+  ros::Time last_time_; //!< The time of the last entry or request
+  Progress progress_; //!< The progress
+};
+
+}  // namespace ublox_node
+
+#endif  // UBLOX_GPS_LOG_RETRIEVER_H
@@ -0,0 +1,137 @@
+//==============================================================================
+// Copyright (c) 2012, Johannes Meyer, TU Darmstadt
+// All rights reserved.
+
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//     * Neither the name of the Flight Systems and Automatic Control group,
+//       TU Darmstadt, nor the names of its contributors may be used to
+//       endorse or promote products derived from this software without
+//       specific prior written permission.
+
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" 
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE 
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE 
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER BE LIABLE FOR ANY
+// DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+// (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+// LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+// ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+// SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//==============================================================================
+
+#ifndef UBLOX_GPS_MEASUREMENT_QUALITY_H
+#define UBLOX_GPS_MEASUREMENT_QUALITY_H
+
+#include <vector>
+// ROS messages
+#include <ublox_msgs/RxmRAWX.h>
+#include <ublox_msgs/RxmQuality.h>
+
+namespace ublox_node {
+
+/**
+ * @brief Detects carrier phase cycle slips and summarizes the measurement
+ * quality of RXM-RAWX epochs.
+ *
+ * @details Keeps the previous measurement of each signal (gnssId, svId,
+ * sigId) and flags a cycle slip if the locktime was reset, the half cycle
+ * correction changed, the phase differs from the phase predicted from the
+ * Doppler or the phase minus code jumped. The measurements of an epoch are
+ * gathered into arrays and the tests are evaluated in branch-free loops over
+ * all measurements.
+ */
+class MeasurementQuality {
+ public:
+  /**
+   * @param doppler_threshold the maximum difference between the phase and
+   * the Doppler prediction [cycles]
+   * @param code_phase_threshold the maximum difference between the phase
+   * minus code and its average [m]
+   */
+  MeasurementQuality(double doppler_threshold, double code_phase_threshold);
+
+  /**
+   * @brief Process an RXM-RAWX epoch.
+   * @param m the RXM-RAWX message
+   * @param quality the quality summary, the header is not set
+   */
+  void process(const ublox_msgs::RxmRAWX& m, ublox_msgs::RxmQuality& quality);
+
+  /**
+   * @brief Get the carrier wavelength of a signal.
+   * @param gnss_id the GNSS identifier
+   * @param sig_id the signal identifier
+   * @param freq_id the GLONASS frequency slot + 7
+   * @return the wavelength [m], 0 if unknown
+   */
+  static double wavelength(uint8_t gnss_id, uint8_t sig_id, uint8_t freq_id);
+
+ private:
+  //! Number of signal identifiers per satellite
+  constexpr static std::size_t kNumSig = 8;
+  //! Maximum time between measurements to test for slips [s]
+  constexpr static double kMaxGap = 2.0;
+  //! Locktime tolerance [ms]
+  constexpr static double kLocktimeTolerance = 100;
+  //! Maximum locktime [ms]
+  constexpr static double kMaxLocktime = 64500;
+  //! Number of epochs to average the phase minus code
+  constexpr static double kCodePhaseWindow = 100;
+  //! Minimum number of epochs before testing the phase minus code
+  constexpr static double kCodePhaseMinEpochs = 5;
+  //! Time constant of the cno average [epochs]
+  constexpr static double kCnoWindow = 30;
+  //! Cno drop which is counted [dBHz]
+  constexpr static double kCnoDrop = 6;
+
+  /**
+   * @brief Get the row of the signal, add it if it is not in the table.
+   */
+  std::size_t row(uint8_t gnss_id, uint8_t sv_id, uint8_t sig_id);
+
+  double doppler_threshold_; //!< Doppler test threshold [cycles]
+  double code_phase_threshold_; //!< Phase minus code test threshold [m]
+  //! Row of each (gnssId, svId, sigId), -1 if not seen
+  std::vector<int16_t> index_;
+
+  // Columns, the state of each signal at its last measurement
+  std::vector<double> tow_; //!< Time of the last measurement [s]
+  std::vector<double> cp_; //!< Carrier phase [cycles]
+  std::vector<double> doppler_; //!< Doppler [Hz]
+  std::vector<double> locktime_; //!< Locktime [ms]
+  std::vector<double> cp_valid_; //!< 1 if the carrier phase was valid
+  std::vector<double> sub_half_; //!< 1 if a half cycle was subtracted
+  std::vector<double> code_phase_; //!< Average phase minus code [m]
+  std::vector<double> code_phase_n_; //!< Epochs in the average
+  std::vector<double> cno_; //!< Average cno [dBHz]
+
+  // Measurements of the current epoch
+  std::vector<std::size_t> rows_;
+  std::vector<uint8_t> e_gnss_id_;
+  std::vector<uint8_t> e_sv_id_;
+  std::vector<uint8_t> e_sig_id_;
+  std::vector<double> e_cp_;
+  std::vector<double> e_pr_;
+  std::vector<double> e_doppler_;
+  std::vector<double> e_locktime_;
+  std::vector<double> e_cp_valid_;
+  std::vector<double> e_pr_valid_;
+  std::vector<double> e_half_valid_;
+  std::vector<double> e_sub_half_;
+  std::vector<double> e_cno_;
+  std::vector<double> e_wavelength_;
+  std::vector<uint8_t> e_flags_;
+  std::vector<double> e_doppler_residual_;
+  std::vector<double> e_code_phase_jump_;
+};
+
+}  // namespace ublox_node
+
+#endif  // UBLOX_GPS_MEASUREMENT_QUALITY_H
@@ -0,0 +1,201 @@
+//==============================================================================
+// Copyright (c) 2012, Johannes Meyer, TU Darmstadt
+// All rights reserved.
+
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//     * Neither the name of the Flight Systems and Automatic Control group,
+//       TU Darmstadt, nor the names of its contributors may be used to
+//       endorse or promote products derived from this software without
+//       specific prior written permission.
+
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" 
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE 
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE 
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER BE LIABLE FOR ANY
+// DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+// (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+// LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+// ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+// SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//==============================================================================
+
+#ifndef UBLOX_GPS_METRICS_H
+#define UBLOX_GPS_METRICS_H
+
+#include <vector>
+#include <stdint.h>
+#include <boost/atomic.hpp>
+#include <boost/scoped_array.hpp>
+
+namespace ublox_gps {
+
+/**
+ * @brief Lock-free histogram with fixed bucket bounds.
+ *
+ * @details Observations only update atomic counters, so a snapshot can be
+ * taken by another thread at any time without blocking the observer.
+ */
+class Histogram {
+ public:
+  /**
+   * @brief Histogram snapshot.
+   */
+  struct Snapshot {
+    std::vector<double> bounds; //!< The upper bounds of the buckets
+    std::vector<uint64_t> counts; //!< Cumulative count of each bucket
+    uint64_t count; //!< Number of observations
+    double sum; //!< Sum of the observations
+  };
+
+  /**
+   * @param bounds the upper bounds of the buckets in increasing order, the
+   * +Inf bucket is implicit
+   */
+  explicit Histogram(const std::vector<double>& bounds) :
+      bounds_(bounds), buckets_(new boost::atomic<uint64_t>[bounds.size()]),
+      count_(0), sum_(0) {
+    for (std::size_t i = 0; i < bounds_.size(); ++i)
+      buckets_[i].store(0, boost::memory_order_relaxed);
+  }
+
+  /**
+   * @brief Add an observation.
+   */
+  void observe(double value) {
+    for (std::size_t i = 0; i < bounds_.size(); ++i) {
+      if (value <= bounds_[i]) {
+        buckets_[i].fetch_add(1, boost::memory_order_relaxed);
+        break;
+      }
+    }
+    double sum = sum_.load(boost::memory_order_relaxed);
+    while (!sum_.compare_exchange_weak(sum, sum + value,
+                                       boost::memory_order_relaxed)) {}
+    count_.fetch_add(1, boost::memory_order_relaxed);
+  }
+
+  /**
+   * @brief Get the cumulative bucket counts, the count and the sum.
+   */
+  Snapshot snapshot() const {
+    Snapshot snapshot;
+    snapshot.bounds = bounds_;
+    snapshot.counts.resize(bounds_.size());
+    uint64_t cumulative = 0;
+    for (std::size_t i = 0; i < bounds_.size(); ++i) {
+      cumulative += buckets_[i].load(boost::memory_order_relaxed);
+      snapshot.counts[i] = cumulative;
+    }
+    snapshot.count = count_.load(boost::memory_order_relaxed);
+    snapshot.sum = sum_.load(boost::memory_order_relaxed);
+    // The count is updated last, it can't be less than the buckets
+    if (snapshot.count < cumulative)
+      snapshot.count = cumulative;
+    return snapshot;
+  }
+
+ private:
+  std::vector<double> bounds_; //!< The upper bounds of the buckets
+  //! Number of observations per bucket, excl. the +Inf bucket
+  boost::scoped_array<boost::atomic<uint64_t> > buckets_;
+  boost::atomic<uint64_t> count_; //!< Number of observations
+  boost::atomic<double> sum_; //!< Sum of the observations
+};
+
+/**
+ * @brief The number of frames and bytes of a u-blox message type.
+ */
+struct FrameCount {
+  uint8_t class_id; //!< The class ID of the message
+  uint8_t message_id; //!< The message ID of the message
+  uint64_t frames; //!< Number of frames
+  uint64_t bytes; //!< Number of bytes incl. header and checksum
+};
+
+/**
+ * @brief Lock-free frame & byte counters per u-blox message type.
+ *
+ * @details The counters are stored in an open addressing table of fixed size.
+ * A message type claims a slot with a compare and swap the first time it is
+ * counted, message types which don't fit are counted as overflow.
+ */
+class FrameCounters {
+ public:
+  //! Number of message types which can be counted
+  static const std::size_t kSize = 256;
+
+  FrameCounters() : overflow_(0) {
+    for (std::size_t i = 0; i < kSize; ++i) {
+      keys_[i].store(0, boost::memory_order_relaxed);
+      frames_[i].store(0, boost::memory_order_relaxed);
+      bytes_[i].store(0, boost::memory_order_relaxed);
+    }
+  }
+
+  /**
+   * @brief Count a frame.
+   * @param class_id the class ID of the message
+   * @param message_id the message ID of the message
+   * @param bytes the size of the frame incl. header and checksum
+   */
+  void add(uint8_t class_id, uint8_t message_id, uint32_t bytes) {
+    const uint32_t key = 0x10000 | class_id << 8 | message_id;
+    std::size_t slot = (class_id * 31u + message_id) % kSize;
+    for (std::size_t n = 0; n < kSize; ++n, slot = (slot + 1) % kSize) {
+      uint32_t current = keys_[slot].load(boost::memory_order_acquire);
+      if (current == 0 &&
+          keys_[slot].compare_exchange_strong(current, key,
+                                              boost::memory_order_acq_rel))
+        current = key;
+      if (current == key) {
+        frames_[slot].fetch_add(1, boost::memory_order_relaxed);
+        bytes_[slot].fetch_add(bytes, boost::memory_order_relaxed);
+        return;
+      }
+    }
+    overflow_.fetch_add(1, boost::memory_order_relaxed);
+  }
+
+  /**
+   * @brief Get the counters of all counted message types.
+   * @param counts the counters are appended
+   */
+  void snapshot(std::vector<FrameCount>& counts) const {
+    for (std::size_t i = 0; i < kSize; ++i) {
+      const uint32_t key = keys_[i].load(boost::memory_order_acquire);
+      if (key == 0)
+        continue;
+      FrameCount count;
+      count.class_id = (key >> 8) & 0xFF;
+      count.message_id = key & 0xFF;
+      count.frames = frames_[i].load(boost::memory_order_relaxed);
+      count.bytes = bytes_[i].load(boost::memory_order_relaxed);
+      counts.push_back(count);
+    }
+  }
+
+  /**
+   * @brief Get the number of frames which didn't fit in the table.
+   */
+  uint64_t overflow() const {
+    return overflow_.load(boost::memory_order_relaxed);
+  }
+
+ private:
+  //! The message type of each slot, 0 if free
+  boost::atomic<uint32_t> keys_[kSize];
+  boost::atomic<uint64_t> frames_[kSize]; //!< Number of frames per slot
+  boost::atomic<uint64_t> bytes_[kSize]; //!< Number of bytes per slot
+  boost::atomic<uint64_t> overflow_; //!< Frames which didn't fit
+};
+
+}  // namespace ublox_gps
+
+#endif  // UBLOX_GPS_METRICS_H
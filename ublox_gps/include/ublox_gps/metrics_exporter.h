@@ -0,0 +1,220 @@
+//==============================================================================
+// Copyright (c) 2012, Johannes Meyer, TU Darmstadt
+// All rights reserved.
+
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//     * Neither the name of the Flight Systems and Automatic Control group,
+//       TU Darmstadt, nor the names of its contributors may be used to
+//       endorse or promote products derived from this software without
+//       specific prior written permission.
+
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" 
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE 
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE 
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER BE LIABLE FOR ANY
+// DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+// (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+// LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+// ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+// SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//==============================================================================
+
+#ifndef UBLOX_GPS_METRICS_EXPORTER_H
+#define UBLOX_GPS_METRICS_EXPORTER_H
+
+#include <sstream>
+#include <string>
+#include <boost/asio/io_service.hpp>
+#include <boost/asio/deadline_timer.hpp>
+#include <boost/asio/ip/tcp.hpp>
+#include <boost/atomic.hpp>
+#include <boost/function.hpp>
+#include <boost/thread.hpp>
+#include <ublox_gps/metrics.h>
+
+namespace ublox_node {
+
+/**
+ * @brief Node metrics which are not counted by the Gps class.
+ *
+ * @details Written by the I/O & ROS threads and read by the exporter, all
+ * values are atomic.
+ */
+struct NodeMetrics {
+  NodeMetrics();
+
+  /**
+   * @brief Set the fix gauges.
+   * @param type the fix type
+   * @param ok whether the fix is within DOP & accuracy masks
+   * @param sv the number of satellites used in the solution
+   */
+  void setFix(int type, bool ok, int sv) {
+    fix_type = type;
+    fix_ok = ok;
+    num_sv = sv;
+  }
+
+  /**
+   * @brief Set the accuracy gauges.
+   * @param horizontal the horizontal accuracy estimate [m]
+   * @param vertical the vertical accuracy estimate [m]
+   */
+  void setAccuracy(double horizontal, double vertical) {
+    h_acc = horizontal;
+    v_acc = vertical;
+  }
+
+  boost::atomic<int> fix_type; //!< NavPVT fix type, -1 if none
+  boost::atomic<bool> fix_ok; //!< Whether the fix is within DOP & accuracy
+  boost::atomic<int> num_sv; //!< Number of satellites used in the solution
+  boost::atomic<double> h_acc; //!< Horizontal accuracy estimate [m]
+  boost::atomic<double> v_acc; //!< Vertical accuracy estimate [m]
+  boost::atomic<double> last_rtcm; //!< Receipt time of the last RTCM [s]
+  boost::atomic<uint64_t> rtcm_messages; //!< Number of RTCM messages sent
+  boost::atomic<uint64_t> rtcm_bytes; //!< Number of RTCM bytes sent
+  ublox_gps::Histogram rtcm_latency; //!< RTCM callback queue latency [s]
+};
+
+/**
+ * @brief Formats metrics in the Prometheus text exposition format.
+ */
+class MetricsWriter {
+ public:
+  /**
+   * @brief Start a metric family.
+   * @param name the name of the family
+   * @param type counter, gauge or histogram
+   * @param help the description of the family
+   */
+  void family(const std::string& name, const std::string& type,
+              const std::string& help);
+
+  /**
+   * @brief Add a sample of the current family.
+   * @param name the name of the sample
+   * @param value the value of the sample
+   * @param labels the labels of the sample without braces, e.g. a="1",b="2"
+   */
+  void sample(const std::string& name, double value,
+              const std::string& labels = "");
+
+  /**
+   * @brief Add a histogram family.
+   */
+  void histogram(const std::string& name, const std::string& help,
+                 const ublox_gps::Histogram::Snapshot& snapshot);
+
+  /**
+   * @brief Get the formatted metrics.
+   */
+  std::string str() const { return out_.str(); }
+
+ private:
+  std::ostringstream out_; //!< The formatted metrics
+};
+
+/**
+ * @brief Minimal HTTP server which serves the metrics on GET /metrics.
+ *
+ * @details The server runs on its own thread. The metrics are rendered on
+ * each request by the render function, which should only read atomic
+ * snapshots so a scrape never blocks the data path. Connections which don't
+ * complete within the session timeout are closed.
+ */
+class MetricsExporter {
+ public:
+  //! Time a connection may take to send the request & receive the response
+  constexpr static int kSessionTimeout = 5; // [s]
+  //! Delay before accepting again after an accept error, e.g. EMFILE
+  constexpr static int kAcceptRetryDelay = 1000; // [ms]
+
+  //! Renders the metrics in the text exposition format
+  typedef boost::function<std::string()> Render;
+
+  /**
+   * @param address the address to listen on, e.g. 127.0.0.1
+   * @param port the TCP port to listen on
+   * @param render renders the metrics
+   */
+  MetricsExporter(const std::string& address, uint16_t port,
+                  const Render& render);
+
+  ~MetricsExporter();
+
+  /**
+   * @brief Bind the port and start the server thread.
+   * @return true if the server was started, false otherwise
+   */
+  bool start();
+
+  /**
+   * @brief Stop the server thread.
+   */
+  void stop();
+
+  /**
+   * @brief Get the number of served scrapes.
+   */
+  uint64_t scrapes() const { return scrapes_; }
+
+ private:
+  struct Session;
+
+  /**
+   * @brief Accept the next connection.
+   */
+  void accept();
+
+  /**
+   * @brief Read the request of an accepted connection.
+   *
+   * @details After an accept error, the next accept is delayed.
+   */
+  void handleAccept(boost::shared_ptr<Session> session,
+                    const boost::system::error_code& error);
+
+  /**
+   * @brief Accept again once the retry delay expired.
+   */
+  void handleAcceptRetry(const boost::system::error_code& error);
+
+  /**
+   * @brief Close the connection if the session timeout expired.
+   */
+  void handleTimeout(boost::shared_ptr<Session> session,
+                     const boost::system::error_code& error);
+
+  /**
+   * @brief Send the response to the request.
+   */
+  void handleRequest(boost::shared_ptr<Session> session,
+                     const boost::system::error_code& error);
+
+  /**
+   * @brief Close the connection once the response is sent.
+   */
+  void handleResponse(boost::shared_ptr<Session> session,
+                      const boost::system::error_code& error);
+
+  std::string address_; //!< The address to listen on
+  uint16_t port_; //!< The TCP port to listen on
+  Render render_; //!< Renders the metrics
+  boost::asio::io_service io_service_; //!< Runs the server
+  boost::asio::ip::tcp::acceptor acceptor_; //!< Accepts the connections
+  //! Delays the next accept after an accept error
+  boost::asio::deadline_timer accept_timer_;
+  boost::thread thread_; //!< Runs the io_service
+  boost::atomic<uint64_t> scrapes_; //!< Number of served scrapes
+};
+
+}  // namespace ublox_node
+
+#endif  // UBLOX_GPS_METRICS_EXPORTER_H
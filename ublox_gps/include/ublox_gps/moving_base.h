@@ -0,0 +1,136 @@
+//==============================================================================
+// Copyright (c) 2012, Johannes Meyer, TU Darmstadt
+// All rights reserved.
+
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//     * Neither the name of the Flight Systems and Automatic Control group,
+//       TU Darmstadt, nor the names of its contributors may be used to
+//       endorse or promote products derived from this software without
+//       specific prior written permission.
+
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" 
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE 
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE 
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER BE LIABLE FOR ANY
+// DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+// (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+// LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+// ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+// SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//==============================================================================
+
+#ifndef UBLOX_GPS_MOVING_BASE_H
+#define UBLOX_GPS_MOVING_BASE_H
+
+#include <map>
+#include <boost/function.hpp>
+#include <boost/thread.hpp>
+#include <ros/time.h>
+// ROS messages
+#include <ublox_msgs/NavPVT.h>
+#include <ublox_msgs/NavRELPOSNED9.h>
+#include <ublox_msgs/MovingBasePose.h>
+
+namespace ublox_node {
+
+/**
+ * @brief Pairs the NAV-PVT of a moving base receiver with the NAV-RELPOSNED
+ * of the rover receiver of the same navigation epoch.
+ *
+ * @details The messages are matched by iTOW. Messages which are not matched
+ * within the maximum delay are dropped and counted.
+ */
+class MovingBaseSynchronizer {
+ public:
+  //! Callback for each matched epoch
+  typedef boost::function<void(const ublox_msgs::MovingBasePose&)> Callback;
+
+  /**
+   * @brief Synchronizer statistics.
+   */
+  struct Statistics {
+    uint32_t matched; //!< Number of matched epochs
+    uint32_t unmatched_base; //!< Number of moving base messages dropped
+    uint32_t unmatched_rover; //!< Number of rover messages dropped
+    double last_latency; //!< Latency of the last matched epoch [s]
+    double mean_latency; //!< Mean latency [s]
+    double max_latency; //!< Maximum absolute latency [s]
+  };
+
+  /**
+   * @param max_delay the maximum time to wait for the other receiver [s]
+   */
+  explicit MovingBaseSynchronizer(double max_delay);
+
+  /**
+   * @brief Set the callback which is called for each matched epoch.
+   */
+  void setCallback(const Callback& callback) { callback_ = callback; }
+
+  /**
+   * @brief Add a NAV-PVT message of the moving base receiver.
+   */
+  void addBase(const ublox_msgs::NavPVT& m);
+
+  /**
+   * @brief Add a NAV-RELPOSNED message of the rover receiver.
+   */
+  void addRover(const ublox_msgs::NavRELPOSNED9& m);
+
+  /**
+   * @brief Get the synchronizer statistics.
+   */
+  Statistics statistics() const;
+
+  /**
+   * @brief Combine the messages of the moving base and the rover.
+   * @param base the moving base NAV-PVT
+   * @param rover the rover NAV-RELPOSNED
+   * @param pose the combined pose, the header is not set
+   */
+  static void combine(const ublox_msgs::NavPVT& base,
+                      const ublox_msgs::NavRELPOSNED9& rover,
+                      ublox_msgs::MovingBasePose& pose);
+
+ private:
+  //! A message waiting for the other receiver
+  template <typename T>
+  struct Pending {
+    T message; //!< The message
+    ros::Time stamp; //!< The receive time
+  };
+
+  /**
+   * @brief Drop the messages which waited longer than the maximum delay.
+   */
+  void expire(const ros::Time& now);
+
+  /**
+   * @brief Count a matched epoch & call the callback.
+   * @param lock the lock of the mutex, released before the callback
+   */
+  void match(const ublox_msgs::NavPVT& base, const ros::Time& base_stamp,
+             const ublox_msgs::NavRELPOSNED9& rover,
+             const ros::Time& rover_stamp, boost::mutex::scoped_lock& lock);
+
+  mutable boost::mutex mutex_; //!< Lock, the receivers have own I/O threads
+  double max_delay_; //!< Maximum time to wait for the other receiver [s]
+  //! Moving base messages waiting for the rover, by iTOW
+  std::map<uint32_t, Pending<ublox_msgs::NavPVT> > base_;
+  //! Rover messages waiting for the moving base, by iTOW
+  std::map<uint32_t, Pending<ublox_msgs::NavRELPOSNED9> > rover_;
+  double latency_sum_; //!< Sum of the latencies [s]
+  Statistics statistics_; //!< Synchronizer statistics
+  Callback callback_; //!< Called for each matched epoch
+};
+
+}  // namespace ublox_node
+
+#endif  // UBLOX_GPS_MOVING_BASE_H
@@ -31,6 +31,8 @@
 #define UBLOX_GPS_NODE_H
 
 // STL
+#include <deque>
+#include <fstream>
 #include <vector>
 #include <set>
 // Boost
@@ -39,6 +41,7 @@
 #include <boost/regex.hpp>
 // ROS includes
 #include <ros/ros.h>
+#include <ros/callback_queue.h>
 #include <ros/console.h>
 #include <ros/serialization.h>
 #include <tf/transform_datatypes.h>
@@ -47,6 +50,8 @@
 // ROS messages
 #include <geometry_msgs/TwistWithCovarianceStamped.h>
 #include <geometry_msgs/Vector3Stamped.h>
+#include <nav_msgs/Odometry.h>
+#include <rtcm_msgs/Message.h>
 #include <sensor_msgs/NavSatFix.h>
 #include <sensor_msgs/TimeReference.h>
 #include <sensor_msgs/Imu.h>
@@ -54,8 +59,27 @@
 #include <ublox_msgs/ublox_msgs.h>
 // Ublox GPS includes
 #include <ublox_gps/gps.h>
+#include <ublox_gps/callback_latency.h>
+#include <ublox_gps/chrony_refclock.h>
+#include <ublox_gps/config_monitor.h>
 #include <ublox_gps/utils.h>
 #include <ublox_gps/raw_data_pa.h>
+#include <ublox_gps/ephemeris.h>
+#include <ublox_gps/geotagger.h>
+#include <ublox_gps/history_store.h>
+#include <ublox_gps/local_frame.h>
+#include <ublox_gps/log_retriever.h>
+#include <ublox_gps/measurement_quality.h>
+#include <ublox_gps/metrics_exporter.h>
+#include <ublox_gps/moving_base.h>
+#include <ublox_gps/port_discovery.h>
+#include <ublox_gps/satellite_table.h>
+#include <ublox_gps/sfrbx_decoder.h>
+#include <ublox_gps/survey_in_store.h>
+#include <ublox_msgs/GetHistory.h>
+#include <ublox_msgs/GetSatelliteTable.h>
+#include <ublox_msgs/RetrieveLog.h>
+#include <ublox_msgs/SaveHistory.h>
 
 // This file declares the ComponentInterface which acts as a high level
 // interface for u-blox firmware, product categories, etc. It contains methods
@@ -111,6 +135,12 @@ std::set<std::string> supported;
 std::map<std::string, bool> enabled;
 //! The ROS frame ID of this device
 std::string frame_id;
+//! The local ENU frame of the odometry output, null if disabled
+boost::shared_ptr<LocalFrame> local_frame;
+//! The ROS frame ID of the local ENU frame
+std::string local_frame_id;
+//! Metrics of the metrics exporter, null if disabled
+boost::shared_ptr<NodeMetrics> metrics;
 //! The fix status service type, set in the Firmware Component
 //! based on the enabled GNSS
 int fix_status_service;
@@ -124,6 +154,8 @@ std::vector<uint8_t> rtcm_ids;
 std::vector<uint8_t> rtcm_rates;
 //! Flag for enabling configuration on startup
 bool config_on_startup_flag_;
+//! Whether to skip diagnostic updates while the node is overloaded
+bool shed_diagnostics = false;
 
 
 //! Topic diagnostics for u-blox messages
@@ -251,6 +283,12 @@ uint8_t modelFromString(const std::string& model);
  */
 uint8_t fixModeFromString(const std::string& mode);
 
+/**
+ * @brief Update the diagnostics, unless diagnostics are shed because the
+ * node is overloaded.
+ */
+void updateDiagnostics();
+
 /**
  * @brief Check that the parameter is above the minimum.
  * @param val the value to check
@@ -498,6 +536,12 @@ class UbloxNode : public virtual ComponentInterface {
   constexpr static double kFixFreqWindow = 10;
   //! Minimum Time Stamp Status for fix frequency diagnostic
   constexpr static double kTimeStampStatusMin = 0;
+  //! Window [s] over which the data integrity rates are computed
+  constexpr static double kDataIntegrityWindow = 60.0;
+  //! Time [s] without frames after which a redundant link is reported failed
+  constexpr static double kLinkFailedTimeout = 2.0;
+  //! Maximum position accuracy [cm] to check the ephemerides against RAWX
+  constexpr static uint32_t kEphemerisMaxPosAcc = 10000;
 
   /**
    * @brief Initialize and run the u-blox node.
@@ -537,6 +581,14 @@ class UbloxNode : public virtual ComponentInterface {
    */
   void initializeIo();
 
+  /**
+   * @brief Probe the discovery ports & bind the receivers of the devices set
+   * to "discover" to their ports by unique chip ID.
+   *
+   * @details Throws std::runtime_error if a receiver is not found.
+   */
+  void discoverDevices();
+
   /**
    * @brief Initialize the U-Blox node. Configure the U-Blox and subscribe to
    * messages.
@@ -548,6 +600,17 @@ class UbloxNode : public virtual ComponentInterface {
    */
   void shutdown();
 
+  /**
+   * @brief Configure the device, the message rates & INF messages while the
+   * node is publishing. Runs in the configuration thread.
+   */
+  void configureInBackground();
+
+  /**
+   * @brief Start polling messages and process ROS callbacks until shutdown.
+   */
+  void spin();
+
   /**
    * @brief Send a reset message the u-blox device & re-initialize the I/O.
    * @return true if reset was successful, false otherwise.
@@ -583,11 +646,282 @@ class UbloxNode : public virtual ComponentInterface {
    */
   void pollMessages(const ros::TimerEvent& event);
 
+  /**
+   * @brief Forward RTCM corrections to the device.
+   *
+   * @details Runs on the dedicated RTCM callback queue, so the corrections
+   * are not delayed by timers, services or diagnostics.
+   * @param event the RTCM message and its receipt time
+   */
+  void rtcmCallback(const ros::MessageEvent<rtcm_msgs::Message const>& event);
+
+  /**
+   * @brief Render the metrics in the Prometheus text exposition format.
+   *
+   * @details Only reads atomic counters & gauges, so it doesn't block the
+   * I/O thread.
+   */
+  std::string renderMetrics();
+
   /**
    * @brief Configure INF messages, call after subscribe.
    */
   void configureInf();
 
+  /**
+   * @brief Publish the changes of the satellite table.
+   * @param event a timer indicating how often to publish the changes
+   */
+  void publishSatelliteTable(const ros::TimerEvent& event);
+
+  /**
+   * @brief Handle a get_satellite_table service request.
+   * @param req the empty request
+   * @param res the response, the full satellite table
+   * @return true
+   */
+  bool getSatelliteTable(ublox_msgs::GetSatelliteTable::Request& req,
+                         ublox_msgs::GetSatelliteTable::Response& res);
+
+  /**
+   * @brief Check the satellite states against the RXM-RAWX pseudoranges, see
+   * EphemerisEngine::check.
+   * @param m the RXM-RAWX message
+   */
+  void evaluateEphemeris(const ublox_msgs::RxmRAWX& m);
+
+  /**
+   * @brief Update the receiver position the satellite states are checked
+   * against.
+   * @param m the NAV-POSECEF message
+   */
+  void updateEphemerisPosition(const ublox_msgs::NavPOSECEF& m);
+
+  /**
+   * @brief Detect cycle slips in the RXM-RAWX epoch and publish the quality
+   * summary.
+   * @param m the RXM-RAWX message
+   */
+  void processMeasurementQuality(const ublox_msgs::RxmRAWX& m);
+
+  /**
+   * @brief Update the ephemeris diagnostics.
+   *
+   * @details Reports the number of satellites with an ephemeris, the
+   * evaluation throughput in satellites per second and the pseudorange
+   * residuals of the last checked epoch. Warns if a residual exceeds the
+   * maximum.
+   */
+  void ephemerisDiagnostic(diagnostic_updater::DiagnosticStatusWrapper& stat);
+
+  /**
+   * @brief Update the navigation data diagnostics.
+   *
+   * @details Reports the RXM-SFRBX decoder counters, the number of GPS
+   * almanacs, whether ionosphere parameters were received and the leap
+   * seconds.
+   */
+  void navigationDataDiagnostic(
+      diagnostic_updater::DiagnosticStatusWrapper& stat);
+
+  /**
+   * @brief Create the message histories & subscribe to their frames.
+   */
+  void subscribeHistory();
+
+  /**
+   * @brief Handle a get_history service request.
+   * @param req the messages and the time or iTOW range
+   * @param res the stored frames in the range
+   * @return true
+   */
+  bool getHistory(ublox_msgs::GetHistory::Request& req,
+                  ublox_msgs::GetHistory::Response& res);
+
+  /**
+   * @brief Handle a save_history service request.
+   * @param req the path of the file
+   * @param res whether the history was saved, the path & number of frames
+   * @return true
+   */
+  bool saveHistory(ublox_msgs::SaveHistory::Request& req,
+                   ublox_msgs::SaveHistory::Response& res);
+
+  /**
+   * @brief Publish the combined pose of a moving base epoch.
+   * @param pose the moving base NAV-PVT combined with the rover NAV-RELPOSNED
+   */
+  void publishMovingBasePose(ublox_msgs::MovingBasePose pose);
+
+  /**
+   * @brief Update the moving base diagnostics.
+   *
+   * @details Reports the matched & dropped epochs and the latency between
+   * the moving base and the rover messages. The status is computed from the
+   * epochs since the last update.
+   */
+  void movingBaseDiagnostic(diagnostic_updater::DiagnosticStatusWrapper& stat);
+
+  /**
+   * @brief Publish the geotag of a time mark.
+   * @param geotag the position, velocity & attitude at the mark time
+   */
+  void publishGeotag(ublox_msgs::Geotag geotag);
+
+  /**
+   * @brief Update the geotagging diagnostics.
+   *
+   * @details Reports the tagged & dropped time marks.
+   */
+  void geotagDiagnostic(diagnostic_updater::DiagnosticStatusWrapper& stat);
+
+  /**
+   * @brief Write the time samples of a NAV-TIMEUTC epoch to chrony.
+   */
+  void chronyTimeUtc(const ublox_msgs::NavTIMEUTC& m);
+
+  /**
+   * @brief Pass the quantization error of the next time pulse to chrony.
+   */
+  void chronyTimePulse(const ublox_msgs::TimTP& m);
+
+  /**
+   * @brief Update the chrony refclock diagnostics.
+   *
+   * @details Reports the written & rejected samples, the serial offset and
+   * the NAV-CLOCK drift & accuracy.
+   */
+  void chronyDiagnostic(diagnostic_updater::DiagnosticStatusWrapper& stat);
+
+  /**
+   * @brief Subscribe to the retrieved log entries & batches.
+   */
+  void subscribeLog();
+
+  /**
+   * @brief Handle a retrieve_log service request.
+   *
+   * @details Polls LOG-INFO for the number of log entries and starts the
+   * retrieval, or sends LOG-RETRIEVEBATCH for the batched fixes.
+   * @param req the entries to retrieve and the path of the file
+   * @param res whether the retrieval started & the number of entries
+   * @return true
+   */
+  bool retrieveLog(ublox_msgs::RetrieveLog::Request& req,
+                   ublox_msgs::RetrieveLog::Response& res);
+
+  /**
+   * @brief Send a LOG-RETRIEVE request, does not wait for an acknowledgment.
+   */
+  bool requestLog(const ublox_msgs::LogRETRIEVE& m);
+
+  /**
+   * @brief Publish a retrieved log entry or batch & write it to the log file.
+   * @param m the LOG message
+   * @param topic the topic to publish the message on
+   */
+  template <typename T>
+  void writeLogRecord(const T& m, const std::string& topic);
+
+  //! Callbacks for the retrieved log entries & batches
+  void processLogRetrievePos(const ublox_msgs::LogRETRIEVEPOS& m);
+  void processLogRetrievePosExtra(const ublox_msgs::LogRETRIEVEPOSEXTRA& m);
+  void processLogRetrieveString(const ublox_msgs::LogRETRIEVESTRING& m);
+  void processLogBatch(const ublox_msgs::LogBATCH& m);
+
+  /**
+   * @brief Request missing log entries, report the progress & close the log
+   * file when the retrieval ended.
+   */
+  void checkLogRetrieval(const ros::TimerEvent& event);
+
+  /**
+   * @brief Update the log retrieval diagnostics.
+   *
+   * @details Reports the progress and the throughput of the current or last
+   * retrieval.
+   */
+  void logRetrievalDiagnostic(
+      diagnostic_updater::DiagnosticStatusWrapper& stat);
+
+  /**
+   * @brief Update the data integrity diagnostics.
+   *
+   * @details Reports the serial driver error counters, parser discards,
+   * decoder errors and missing navigation epochs as totals and as rates per
+   * minute over the last kDataIntegrityWindow seconds.
+   */
+  void dataIntegrityDiagnostic(
+      diagnostic_updater::DiagnosticStatusWrapper& stat);
+
+  /**
+   * @brief Update the overload diagnostics.
+   *
+   * @details Reports whether low-priority messages are shed, the dispatch lag
+   * and the shedding counters.
+   */
+  void overloadDiagnostic(diagnostic_updater::DiagnosticStatusWrapper& stat);
+
+  /**
+   * @brief Update the read diagnostics.
+   *
+   * @details Reports the wakeups & reads per second of the I/O thread since
+   * the last update and the read delays, see ublox_gps::ReadStatistics.
+   */
+  void readDiagnostic(diagnostic_updater::DiagnosticStatusWrapper& stat);
+
+  /**
+   * @brief Update the configuration diagnostics, which report whether the
+   * background configuration is pending, done or failed.
+   */
+  void configurationDiagnostic(
+      diagnostic_updater::DiagnosticStatusWrapper& stat);
+
+  /**
+   * @brief Recover the configuration if a reset or drift was detected & poll
+   * the monitored configuration blocks.
+   *
+   * @details The polls are sent without waiting for the responses, which are
+   * compared by the ConfigMonitor callbacks.
+   */
+  void checkConfiguration(const ros::TimerEvent& event);
+
+  /**
+   * @brief Apply the configuration again.
+   * @param reset whether the receiver was reset, then the device is
+   * configured as on startup
+   * @param blocks the drifted blocks, which are applied again
+   * @return true if the configuration was applied
+   */
+  bool recoverConfiguration(bool reset, uint32_t blocks);
+
+  /**
+   * @brief Update the configuration integrity diagnostics.
+   *
+   * @details Reports the detected resets & drifts and the detection &
+   * recovery times.
+   */
+  void configIntegrityDiagnostic(
+      diagnostic_updater::DiagnosticStatusWrapper& stat);
+
+  /**
+   * @brief Update the redundant link diagnostics.
+   *
+   * @details Reports for each link how many frames arrived on it first, how
+   * much earlier they arrived on average and how many frames it missed.
+   */
+  void redundantLinkDiagnostic(
+      diagnostic_updater::DiagnosticStatusWrapper& stat);
+
+  /**
+   * @brief Update the callback queue diagnostics.
+   *
+   * @details Reports the number of forwarded RTCM messages and the latency
+   * of the RTCM and poll timer callbacks since the last update.
+   */
+  void callbackQueueDiagnostic(
+      diagnostic_updater::DiagnosticStatusWrapper& stat);
+
   //! The u-blox node components
   /*!
    * The node will call the functions in these interfaces for each object
@@ -600,6 +934,18 @@ class UbloxNode : public virtual ComponentInterface {
   // Variables set from parameter server
   //! Device port
   std::string device_;
+  //! Port of a second link to the same device, empty if none
+  std::string redundant_device_;
+  //! Whether a device is discovered, see discoverDevices
+  bool discover_;
+  //! Unique chip ID of the receiver, empty to bind the only receiver found
+  std::string unique_id_;
+  //! Unique chip ID of the moving base receiver
+  std::string moving_base_unique_id_;
+  //! Glob patterns of the probed ports
+  std::vector<std::string> discovery_ports_;
+  //! Time to wait for the answer to each probe poll [s]
+  double discovery_timeout_;
   //! dynamic model type
   std::string dynamic_model_;
   //! Fix mode type
@@ -648,6 +994,151 @@ class UbloxNode : public virtual ComponentInterface {
 
   //! raw data stream logging
   RawDataStreamPa rawDataStreamPa_;
+
+  //! State of the background configuration
+  enum ConfigState {
+    CONFIG_PENDING, //!< Not configured yet
+    CONFIG_DONE, //!< Configured successfully
+    CONFIG_FAILED //!< Configuration failed
+  };
+  //! Whether to configure the device after subscribing, while publishing
+  bool config_in_background_;
+  //! Thread which configures the device in the background
+  boost::shared_ptr<boost::thread> config_thread_;
+  //! State of the background configuration
+  boost::atomic<ConfigState> config_state_;
+
+  //! Detects receiver resets & configuration drift, null if disabled
+  boost::shared_ptr<ublox_node::ConfigMonitor> config_monitor_;
+  //! Period of the configuration polls [s]
+  double config_monitor_period_;
+
+  //! Whether to dispatch time-critical messages ahead of bulk messages
+  bool prioritize_;
+  //! Whether to shed low-priority messages when the dispatch falls behind
+  bool overload_;
+  //! The maximum number of undecoded bytes before shedding
+  uint32_t overload_max_pending_;
+  //! The maximum age of the oldest undecoded frame before shedding [s]
+  double overload_max_lag_;
+  //! Time the lag must stay below half the limits to stop shedding [s]
+  double overload_restore_time_;
+  //! The work to shed while overloaded, see the overload/shed parameter
+  std::vector<std::string> overload_shed_;
+
+  //! How the reads are coalesced
+  ublox_gps::ReadCoalescing read_coalescing_;
+  //! Read statistics at the last diagnostic update
+  ublox_gps::ReadStatistics last_read_statistics_;
+  //! Time of the last read diagnostic update
+  ros::WallTime last_read_time_;
+
+  //! Whether to maintain & publish the satellite table
+  bool satellite_table_enabled_;
+  //! The rate at which the satellite table changes are published [Hz]
+  double satellite_table_rate_;
+  //! The satellite table, updated from NAV-SAT/SVINFO and RXM-RAWX
+  boost::shared_ptr<ublox_node::SatelliteTable> satellite_table_;
+  //! Timer which publishes the satellite table changes
+  ros::Timer satellite_table_timer_;
+  //! Service which returns the full satellite table
+  ros::ServiceServer satellite_table_service_;
+
+  //! Evaluates the satellite orbits & clocks, null if disabled
+  boost::shared_ptr<ublox_node::EphemerisEngine> ephemeris_;
+  //! The pseudorange residuals of the last RXM-RAWX epoch
+  std::vector<ublox_node::EphemerisEngine::Residual> ephemeris_residuals_;
+  //! The maximum pseudorange residual of a consistent satellite [m]
+  double ephemeris_max_residual_;
+  //! The elevation mask of the residual check [rad]
+  double ephemeris_min_elevation_;
+  //! The ECEF position of the receiver [m]
+  double ephemeris_position_[3];
+  //! Whether ephemeris_position_ is set
+  bool ephemeris_position_valid_;
+
+  //! Detects cycle slips in RXM-RAWX, null if disabled
+  boost::shared_ptr<ublox_node::MeasurementQuality> measurement_quality_;
+  //! Decodes the RXM-SFRBX navigation data, null if disabled
+  boost::shared_ptr<ublox_node::SfrbxDecoder> sfrbx_decoder_;
+
+  //! Whether to keep the history of recent messages
+  bool history_enabled_;
+  //! Byte budget of the history of each message
+  uint32_t history_budget_;
+  //! Maximum age of the stored messages [s]
+  double history_duration_;
+  //! The messages to keep, see the history/messages parameter
+  std::vector<std::string> history_messages_;
+  //! Directory of the saved histories
+  std::string history_directory_;
+  //! The histories of the recent messages
+  ublox_node::HistoryStore history_;
+  //! Services which return & save the history
+  ros::ServiceServer get_history_service_, save_history_service_;
+
+  //! Device of the moving base receiver, empty if not used
+  std::string moving_base_device_;
+  //! UART1 baudrate of the moving base receiver
+  uint32_t moving_base_baudrate_;
+  //! The moving base receiver, the rover is gps
+  boost::shared_ptr<ublox_gps::Gps> moving_base_gps_;
+  //! Pairs the moving base & rover messages, null if not used
+  boost::shared_ptr<ublox_node::MovingBaseSynchronizer> moving_base_;
+  //! The moving base statistics at the last diagnostic update
+  ublox_node::MovingBaseSynchronizer::Statistics last_moving_base_statistics_;
+
+  //! Tags the TIM-TM2 time marks, null if disabled
+  boost::shared_ptr<ublox_node::Geotagger> geotagger_;
+  //! Whether to tag the marks with the NAV-ATT attitude
+  bool geotag_attitude_;
+
+  //! Writes the time samples to the chrony SHM refclock, null if disabled
+  boost::shared_ptr<ublox_node::ChronyRefclock> chrony_;
+  //! Whether to correct the PPS samples by the TIM-TP quantization error
+  bool chrony_qerr_;
+
+  //! Retrieves the log & batches stored on the device, null if disabled
+  boost::shared_ptr<ublox_node::LogRetriever> log_retriever_;
+  //! Directory of the retrieved log files, the records are only published
+  //! if empty
+  std::string log_directory_;
+  //! The file of the current retrieval
+  std::ofstream log_file_;
+  //! Path of the file of the current retrieval
+  std::string log_path_;
+  //! Lock for the log file, written by the I/O thread
+  boost::mutex log_file_mutex_;
+  //! Timer which checks the progress of the retrieval
+  ros::Timer log_timer_;
+  //! Service which starts a retrieval
+  ros::ServiceServer retrieve_log_service_;
+
+  //! Data integrity samples of the last kDataIntegrityWindow seconds
+  std::deque<std::pair<ros::WallTime, ublox_gps::DataIntegrity> >
+      data_integrity_;
+
+  //! Topic of the RTCM corrections
+  std::string rtcm_topic_;
+  //! Queue size of the RTCM subscriber
+  int rtcm_queue_size_;
+  //! Callback queue of the RTCM subscriber, served by its own thread
+  ros::CallbackQueue rtcm_queue_;
+  //! Subscribes to the RTCM corrections
+  ros::Subscriber rtcm_sub_;
+  //! Number of threads serving the global callback queue
+  int spinner_threads_;
+  //! Latency of the RTCM callbacks
+  ublox_node::CallbackLatency rtcm_latency_;
+  //! Latency of the poll timer callbacks
+  ublox_node::CallbackLatency timer_latency_;
+  //! Number of RTCM messages which could not be sent to the device
+  boost::atomic<uint64_t> rtcm_failed_;
+
+  //! Serves the metrics over HTTP, null if disabled
+  boost::shared_ptr<MetricsExporter> metrics_exporter_;
+  //! Capacity of the serial link [bytes/s], 0 if not a serial link
+  double link_capacity_ = 0;
 };
 
 /**
@@ -758,9 +1249,9 @@ class UbloxFirmware7Plus : public UbloxFirmware {
   /**
    * @brief Publish a NavSatFix and TwistWithCovarianceStamped messages.
    *
-   * @details If a fixed carrier phase solution is available, the NavSatFix
-   * status is set to GBAS fixed. If NavPVT publishing is enabled, the message
-   * is published. This function also calls the ROS diagnostics updater.
+   * @details If NavPVT publishing is enabled, the message is published. If
+   * the high precision fix is enabled, the fix is published when the
+   * NavHPPOSLLH of the same epoch arrived.
    * @param m the message to publish
    */
   void callbackNavPvt(const NavPVT& m) {
@@ -771,6 +1262,56 @@ class UbloxFirmware7Plus : public UbloxFirmware {
       publisher.publish(m);
     }
 
+    if (!high_precision_fix_) {
+      publishFix(m, 0);
+      return;
+    }
+    // The NavHPPOSLLH of the previous epoch did not arrive
+    if (nav_pvt_pending_)
+      publishFix(pending_nav_pvt_, 0);
+    nav_pvt_pending_ = false;
+    if (nav_hpposllh_pending_ && pending_nav_hpposllh_.iTOW == m.iTOW) {
+      nav_hpposllh_pending_ = false;
+      publishFix(m, &pending_nav_hpposllh_);
+    } else {
+      pending_nav_pvt_ = m;
+      nav_pvt_pending_ = true;
+    }
+  }
+
+  /**
+   * @brief Publish the NavHPPOSLLH message and the fix of the same epoch.
+   *
+   * @param m the message to publish
+   */
+  void callbackNavHpPosLlh(const ublox_msgs::NavHPPOSLLH& m) {
+    if(enabled["nav_hpposllh"])
+      publish(m, "navhpposllh");
+
+    if (!high_precision_fix_)
+      return;
+    if (nav_pvt_pending_ && pending_nav_pvt_.iTOW == m.iTOW) {
+      nav_pvt_pending_ = false;
+      publishFix(pending_nav_pvt_, &m);
+    } else {
+      pending_nav_hpposllh_ = m;
+      nav_hpposllh_pending_ = true;
+    }
+  }
+
+ protected:
+  /**
+   * @brief Publish the NavSatFix, TwistWithCovarianceStamped and Odometry
+   * messages of an epoch.
+   *
+   * @details If a fixed carrier phase solution is available, the NavSatFix
+   * status is set to GBAS fixed. This function also calls the ROS diagnostics
+   * updater.
+   * @param m the NavPVT message of the epoch
+   * @param hp the NavHPPOSLLH message of the epoch, null if not available.
+   * If valid, the high precision position & accuracy are used.
+   */
+  void publishFix(const NavPVT& m, const ublox_msgs::NavHPPOSLLH* hp) {
     //
     // NavSatFix message
     //
@@ -799,12 +1340,27 @@ class UbloxFirmware7Plus : public UbloxFirmware {
       // Use ROS time since NavPVT timestamp is not valid
       fix.header.stamp = ros::Time::now();
     }
-    // Set the LLA
-    fix.latitude = m.lat * 1e-7; // to deg
-    fix.longitude = m.lon * 1e-7; // to deg
-    fix.altitude = m.height * 1e-3; // to [m]
+    // Set the LLA & accuracy
+    double hAcc, vAcc;
+    if (hp && !(hp->flags & hp->FLAGS_INVALID_LLH)) {
+      fix.latitude = hp->lat * 1e-7 + hp->latHp * 1e-9; // to deg
+      fix.longitude = hp->lon * 1e-7 + hp->lonHp * 1e-9; // to deg
+      fix.altitude = hp->height * 1e-3 + hp->heightHp * 1e-4; // to [m]
+      hAcc = hp->hAcc * 1e-4; // to [m]
+      vAcc = hp->vAcc * 1e-4; // to [m]
+    } else {
+      fix.latitude = m.lat * 1e-7; // to deg
+      fix.longitude = m.lon * 1e-7; // to deg
+      fix.altitude = m.height * 1e-3; // to [m]
+      hAcc = m.hAcc * 1e-3; // to [m]
+      vAcc = m.vAcc * 1e-3; // to [m]
+    }
     // Set the Fix status
     bool fixOk = m.flags & m.FLAGS_GNSS_FIX_OK;
+    if (metrics) {
+      metrics->setFix(m.fixType, fixOk, m.numSV);
+      metrics->setAccuracy(hAcc, vAcc);
+    }
     if (fixOk && m.fixType >= m.FIX_TYPE_2D) {
       fix.status.status = fix.status.STATUS_FIX;
       if(m.flags & m.CARRIER_PHASE_FIXED)
@@ -817,8 +1373,8 @@ class UbloxFirmware7Plus : public UbloxFirmware {
     fix.status.service = fix_status_service;
 
     // Set the position covariance
-    const double varH = pow(m.hAcc / 1000.0, 2); // to [m^2]
-    const double varV = pow(m.vAcc / 1000.0, 2); // to [m^2]
+    const double varH = pow(hAcc, 2); // to [m^2]
+    const double varV = pow(vAcc, 2); // to [m^2]
     fix.position_covariance[0] = varH;
     fix.position_covariance[4] = varH;
     fix.position_covariance[8] = varV;
@@ -851,15 +1407,82 @@ class UbloxFirmware7Plus : public UbloxFirmware {
 
     velocityPublisher.publish(velocity);
 
+    //
+    // Odometry message
+    //
+    if (local_frame)
+      publishOdometry(m, fix);
+
     //
     // Update diagnostics
     //
     last_nav_pvt_ = m;
     freq_diag->diagnostic->tick(fix.header.stamp);
-    updater->update();
+    updateDiagnostics();
   }
 
- protected:
+  /**
+   * @brief Publish the position & velocity in the local ENU frame.
+   *
+   * @details Sets the origin of the frame to the first 3D fix if configured.
+   * The position covariance and the velocity are rotated from the ENU frame
+   * at the position to the local frame.
+   * @param m the NavPVT message
+   * @param fix the fix of the NavPVT message
+   */
+  void publishOdometry(const NavPVT& m, const sensor_msgs::NavSatFix& fix) {
+    if (!(m.flags & m.FLAGS_GNSS_FIX_OK) || (m.fixType != m.FIX_TYPE_3D &&
+        m.fixType != m.FIX_TYPE_GNSS_DEAD_RECKONING_COMBINED))
+      return;
+    const double lat = fix.latitude;
+    const double lon = fix.longitude;
+    const double height = fix.altitude;
+    if (!local_frame->valid()) {
+      if (local_frame->source() != LocalFrame::ORIGIN_FIRST_FIX)
+        return;
+      local_frame->setOrigin(lat, lon, height);
+      ROS_INFO("Odometry origin set to the first fix: %.9f, %.9f, %.3f", lat,
+               lon, height);
+    }
+    double position[3], rotation[9];
+    if (!local_frame->toEnu(lat, lon, height, position, rotation))
+      return;
+
+    static ros::Publisher publisher =
+        nh->advertise<nav_msgs::Odometry>("odometry", kROSQueueSize);
+    nav_msgs::Odometry odometry;
+    odometry.header.stamp = fix.header.stamp;
+    odometry.header.frame_id = local_frame_id;
+    odometry.child_frame_id = frame_id;
+    odometry.pose.pose.position.x = position[0];
+    odometry.pose.pose.position.y = position[1];
+    odometry.pose.pose.position.z = position[2];
+    odometry.pose.pose.orientation.w = 1;
+    // Rotate the covariance from the ENU frame at the position
+    double local_covariance[9];
+    LocalFrame::rotateCovariance(rotation, fix.position_covariance.data(),
+                                 local_covariance);
+    const int cols = 6;
+    for (int i = 0; i < 3; ++i)
+      for (int j = 0; j < 3; ++j)
+        odometry.pose.covariance[cols * i + j] = local_covariance[3 * i + j];
+    odometry.pose.covariance[cols * 3 + 3] = -1;  // orientation unsupported
+
+    // The velocity in the local frame, not in the child frame
+    const double velocity[3] = {m.velE * 1e-3, m.velN * 1e-3, -m.velD * 1e-3};
+    double local_velocity[3];
+    LocalFrame::rotate(rotation, velocity, local_velocity);
+    odometry.twist.twist.linear.x = local_velocity[0];
+    odometry.twist.twist.linear.y = local_velocity[1];
+    odometry.twist.twist.linear.z = local_velocity[2];
+    const double covSpeed = pow(m.sAcc * 1e-3, 2);
+    odometry.twist.covariance[cols * 0 + 0] = covSpeed;
+    odometry.twist.covariance[cols * 1 + 1] = covSpeed;
+    odometry.twist.covariance[cols * 2 + 2] = covSpeed;
+    odometry.twist.covariance[cols * 3 + 3] = -1;  //  angular rate unsupported
+
+    publisher.publish(odometry);
+  }
 
   /**
    * @brief Update the fix diagnostics from Nav PVT message.
@@ -910,6 +1533,16 @@ class UbloxFirmware7Plus : public UbloxFirmware {
 
   //! The last received NavPVT message
   NavPVT last_nav_pvt_;
+  //! Whether to merge the NavHPPOSLLH position into the fix
+  bool high_precision_fix_ = false;
+  //! The NavPVT waiting for the NavHPPOSLLH of the same epoch
+  NavPVT pending_nav_pvt_;
+  //! Whether pending_nav_pvt_ waits for the NavHPPOSLLH
+  bool nav_pvt_pending_ = false;
+  //! The NavHPPOSLLH waiting for the NavPVT of the same epoch
+  ublox_msgs::NavHPPOSLLH pending_nav_hpposllh_;
+  //! Whether pending_nav_hpposllh_ waits for the NavPVT
+  bool nav_hpposllh_pending_ = false;
   // Whether or not to enable the given GNSS
   //! Whether or not to enable GPS
   bool enable_gps_;
@@ -991,7 +1624,36 @@ class UbloxFirmware8 : public UbloxFirmware7Plus<ublox_msgs::NavPVT> {
    */
   void subscribe();
 
+  /**
+   * @brief Add the fix diagnostic and, if enabled, the UPD-SOS backup
+   * diagnostic.
+   */
+  void initializeRosDiagnostics();
+
  private:
+  /**
+   * @brief Count the consecutive epochs with a valid fix.
+   *
+   * @details The backup is only created while the navigation is stable.
+   * @param m the message to process
+   */
+  void callbackSosNavPvt(const ublox_msgs::NavPVT& m);
+
+  /**
+   * @brief Create the periodic UPD-SOS backup and get the TTFF of the boot.
+   *
+   * @details The TTFF is polled from NavSTATUS once the first fix is
+   * available. The backup is created if the backup period elapsed and the
+   * navigation is stable.
+   */
+  void checkSosBackup(const ros::TimerEvent& event);
+
+  /**
+   * @brief Add the UPD-SOS restore status, TTFF & backup status to the
+   * diagnostics.
+   */
+  void sosBackupDiagnostics(diagnostic_updater::DiagnosticStatusWrapper& stat);
+
   // Set from ROS parameters
   //! Whether or not to enable the Galileo GNSS
   bool enable_galileo_;
@@ -1005,6 +1667,32 @@ class UbloxFirmware8 : public UbloxFirmware7Plus<ublox_msgs::NavPVT> {
   ublox_msgs::CfgNMEA cfg_nmea_;
   //! Whether to clear the flash memory during configuration
   bool clear_bbr_;
+  //! Whether to save the BBR to flash on shutdown
+  bool save_on_shutdown_;
+
+  // Periodic UPD-SOS backup
+  //! Period of the UPD-SOS backups [s], 0 if disabled
+  double sos_backup_period_;
+  //! Whether to stop the GNSS during the backup
+  bool sos_backup_stop_gnss_;
+  //! Number of consecutive valid fixes required before a backup
+  uint32_t sos_backup_stable_epochs_;
+  //! Creates the backups & gets the TTFF
+  ros::Timer sos_timer_;
+  //! Number of consecutive epochs with a valid fix, set by the I/O thread
+  boost::atomic<uint32_t> stable_epochs_;
+  //! Number of acknowledged backups
+  uint32_t sos_backups_ = 0;
+  //! Number of failed backups
+  uint32_t sos_backups_failed_ = 0;
+  //! The time of the last backup attempt
+  ros::WallTime last_sos_backup_;
+  //! The time of the last acknowledged backup
+  ros::WallTime last_sos_backup_ok_;
+  //! The UPD-SOS restore response of this boot, -1 if unknown
+  int sos_restore_response_ = -1;
+  //! The time to first fix of this boot [s], -1 if not known yet
+  double ttff_ = -1;
 };
 
 /**
@@ -1185,6 +1873,14 @@ class HpgRefProduct: public virtual ComponentInterface {
    */
   void callbackNavSvIn(ublox_msgs::NavSVIN m);
 
+  /**
+   * @brief Set the time mode after the survey-in finished.
+   *
+   * @details Runs on a timer, since the configuration waits for ACKs, which
+   * the I/O thread of callbackNavSvIn dispatches.
+   */
+  void configTimeMode(const ros::TimerEvent& event);
+
  protected:
   /**
    * @brief Update the TMODE3 diagnostics.
@@ -1201,6 +1897,40 @@ class HpgRefProduct: public virtual ComponentInterface {
    */
   bool setTimeMode();
 
+  /**
+   * @brief Set TMODE3 to fixed at the stored survey-in result of the site.
+   *
+   * @details The stored result is validated on startup, see
+   * validateStoredSurveyIn. Once a result was validated or surveyed in this
+   * run, e.g. when the configuration is recovered after a receiver reset, it
+   * is applied without validation.
+   * @param reset set to true if a stored result was rejected, so the
+   * survey-in must be reset
+   * @return true if TMODE3 was set to the stored result, false otherwise
+   */
+  bool configStoredSurveyIn(bool& reset);
+
+  /**
+   * @brief Validate the stored survey-in result of the site.
+   *
+   * @details The result is valid if it is not older than the maximum age, is
+   * accurate enough and is within the tolerance of a standalone 3D fix.
+   * TMODE3 is disabled while waiting for the fix.
+   * @return true if the result is valid, false otherwise
+   */
+  bool validateStoredSurveyIn(const SurveyInResult& result);
+
+  /**
+   * @brief Set the odometry origin to the survey-in position, if configured.
+   * @param ecef the survey-in position [m]
+   */
+  void setSurveyInOrigin(const double ecef[3]);
+
+  /**
+   * @brief Record the time from startup until RTCM corrections are enabled.
+   */
+  void recordTimeToCorrections();
+
   //! The last received Nav SVIN message
   ublox_msgs::NavSVIN last_nav_svin_;
 
@@ -1235,6 +1965,32 @@ class HpgRefProduct: public virtual ComponentInterface {
   //! Survey in accuracy limit [m]
   /*! This variable is used only if TMODE3 is set to survey-in. */
   float sv_in_acc_lim_;
+  //! Stores the survey-in results, null if disabled
+  /*! This variable is used only if TMODE3 is set to survey-in. */
+  boost::shared_ptr<SurveyInStore> sv_in_store_;
+  //! The antenna / site ID of the stored survey-in results
+  std::string sv_in_site_;
+  //! Maximum age of a stored survey-in result [s]
+  double sv_in_store_max_age_;
+  //! Maximum accuracy of a stored survey-in result [m]
+  double sv_in_store_max_acc_;
+  //! Maximum distance of the stored result to the standalone fix [m]
+  double sv_in_store_tolerance_;
+  //! Maximum time to wait for the standalone fix [s]
+  double sv_in_store_fix_timeout_;
+  //! The stored survey-in result TMODE3 is fixed at
+  SurveyInResult stored_sv_in_;
+  //! Whether TMODE3 is fixed at the stored survey-in result
+  bool stored_sv_in_used_ = false;
+  //! Whether stored_sv_in_ was validated or surveyed in this run
+  bool sv_in_validated_ = false;
+  //! Sets the time mode after the survey-in finished
+  ros::Timer time_mode_timer_;
+
+  //! The time the node started
+  ros::WallTime start_time_;
+  //! Time from startup until RTCM corrections are enabled [s], -1 if not yet
+  double time_to_corrections_ = -1;
 
   //! Status of device time mode
   enum {
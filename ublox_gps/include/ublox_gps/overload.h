@@ -0,0 +1,195 @@
+//==============================================================================
+// Copyright (c) 2012, Johannes Meyer, TU Darmstadt
+// All rights reserved.
+
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//     * Neither the name of the Flight Systems and Automatic Control group,
+//       TU Darmstadt, nor the names of its contributors may be used to
+//       endorse or promote products derived from this software without
+//       specific prior written permission.
+
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" 
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE 
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE 
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER BE LIABLE FOR ANY
+// DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+// (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+// LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+// ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+// SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//==============================================================================
+
+#ifndef UBLOX_GPS_OVERLOAD_H
+#define UBLOX_GPS_OVERLOAD_H
+
+#include <algorithm>
+#include <set>
+#include <stdint.h>
+#include <ros/console.h>
+#include <boost/date_time/posix_time/posix_time.hpp>
+#include <boost/thread.hpp>
+
+namespace ublox_gps {
+
+/**
+ * @brief Snapshot of the overload controller state.
+ */
+struct OverloadStatus {
+  OverloadStatus() : enabled(false), overloaded(false), pending_bytes(0),
+                     max_pending_bytes(0), lag(0), max_lag(0), events(0),
+                     shed_frames(0) {}
+
+  bool enabled; //!< Whether shedding is enabled
+  bool overloaded; //!< Whether low-priority messages are currently shed
+  uint32_t pending_bytes; //!< Last measured number of undecoded bytes
+  uint32_t max_pending_bytes; //!< Maximum number of undecoded bytes
+  double lag; //!< Last measured age of the oldest undecoded frame [s]
+  double max_lag; //!< Maximum age of the oldest undecoded frame [s]
+  uint64_t events; //!< Number of times shedding started
+  uint64_t shed_frames; //!< Number of frames dropped without decoding
+};
+
+/**
+ * @brief Sheds low-priority u-blox messages when the dispatch falls behind.
+ *
+ * @details The dispatch lag is measured for every frame as the number of
+ * bytes which are not yet decoded (in the kernel and the input buffer) and
+ * the age of the oldest undecoded frame. When either exceeds its limit, the
+ * controller is overloaded and frames of the sheddable message types are
+ * dropped without decoding. It is restored once both are below half of
+ * their limits for the restore time. Message types which are not
+ * sheddable, e.g. NAV-PVT, NAV-RELPOSNED and ESF, are always decoded.
+ */
+class OverloadController {
+ public:
+  OverloadController() : enabled_(false), max_pending_(0), max_lag_(0),
+                         restore_time_(0), overloaded_(false),
+                         episode_frames_(0) {}
+
+  /**
+   * @brief Enable shedding with the given limits.
+   * @param max_pending the maximum number of undecoded bytes
+   * @param max_lag the maximum age of the oldest undecoded frame [s]
+   * @param restore_time how long the lag must stay below half of the limits
+   * before shedding stops [s]
+   */
+  void setLimits(uint32_t max_pending, double max_lag, double restore_time) {
+    boost::mutex::scoped_lock lock(mutex_);
+    enabled_ = true;
+    max_pending_ = max_pending;
+    max_lag_ = max_lag;
+    restore_time_ = restore_time;
+  }
+
+  /**
+   * @brief Shed all messages of the given class while overloaded.
+   * @param class_id the u-blox message class
+   */
+  void addSheddable(uint8_t class_id) {
+    boost::mutex::scoped_lock lock(mutex_);
+    classes_.insert(class_id);
+  }
+
+  /**
+   * @brief Shed the given message type while overloaded.
+   * @param class_id the u-blox message class
+   * @param message_id the u-blox message ID
+   */
+  void addSheddable(uint8_t class_id, uint8_t message_id) {
+    boost::mutex::scoped_lock lock(mutex_);
+    messages_.insert(std::make_pair(class_id, message_id));
+  }
+
+  /**
+   * @brief Update the dispatch lag & decide whether to shed the next frame.
+   * @param class_id the class ID of the next frame
+   * @param message_id the message ID of the next frame
+   * @param pending the number of undecoded bytes, including the frame
+   * @param lag the age of the oldest undecoded frame [s]
+   * @return true if the frame should be dropped without decoding
+   */
+  bool shed(uint8_t class_id, uint8_t message_id, uint32_t pending,
+            double lag) {
+    boost::mutex::scoped_lock lock(mutex_);
+    status_.pending_bytes = pending;
+    status_.max_pending_bytes = std::max(status_.max_pending_bytes, pending);
+    status_.lag = lag;
+    status_.max_lag = std::max(status_.max_lag, lag);
+    if (!enabled_) return false;
+
+    boost::posix_time::ptime now =
+        boost::posix_time::microsec_clock::universal_time();
+    if (!overloaded_) {
+      if (pending > max_pending_ || lag > max_lag_) {
+        overloaded_ = true;
+        ++status_.events;
+        episode_frames_ = 0;
+        calm_since_ = boost::posix_time::not_a_date_time;
+        ROS_WARN("U-Blox: Dispatch overloaded (%u bytes pending, lag %.3f s), "
+                 "shedding low-priority messages", pending, lag);
+      }
+    } else if (pending > max_pending_ / 2 || lag > max_lag_ / 2) {
+      calm_since_ = boost::posix_time::not_a_date_time;
+    } else if (calm_since_.is_not_a_date_time()) {
+      calm_since_ = now;
+    } else if ((now - calm_since_).total_milliseconds()
+               >= restore_time_ * 1000) {
+      overloaded_ = false;
+      ROS_INFO("U-Blox: Dispatch recovered, %lu frames were shed",
+               static_cast<unsigned long>(episode_frames_));
+    }
+
+    if (!overloaded_ || (classes_.count(class_id) == 0 &&
+        messages_.count(std::make_pair(class_id, message_id)) == 0))
+      return false;
+    ++status_.shed_frames;
+    ++episode_frames_;
+    return true;
+  }
+
+  /**
+   * @brief Whether low-priority work is currently shed.
+   */
+  bool overloaded() const {
+    boost::mutex::scoped_lock lock(mutex_);
+    return overloaded_;
+  }
+
+  /**
+   * @brief Get the current state and the counters.
+   */
+  OverloadStatus status() const {
+    boost::mutex::scoped_lock lock(mutex_);
+    OverloadStatus status = status_;
+    status.enabled = enabled_;
+    status.overloaded = overloaded_;
+    return status;
+  }
+
+ private:
+  mutable boost::mutex mutex_; //!< Lock, accessed by the I/O & ROS threads
+  bool enabled_; //!< Whether shedding is enabled
+  uint32_t max_pending_; //!< The maximum number of undecoded bytes
+  double max_lag_; //!< The maximum age of the oldest undecoded frame [s]
+  double restore_time_; //!< Time below half the limits to restore [s]
+  std::set<uint8_t> classes_; //!< Sheddable message classes
+  //! Sheddable message types, (class ID, message ID)
+  std::set<std::pair<uint8_t, uint8_t> > messages_;
+
+  bool overloaded_; //!< Whether low-priority messages are currently shed
+  //! Since when the lag is below half the limits while overloaded
+  boost::posix_time::ptime calm_since_;
+  uint64_t episode_frames_; //!< Frames shed since shedding started
+  OverloadStatus status_; //!< Counters
+};
+
+}  // namespace ublox_gps
+
+#endif  // UBLOX_GPS_OVERLOAD_H
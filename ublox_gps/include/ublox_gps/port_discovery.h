@@ -0,0 +1,115 @@
+//==============================================================================
+// Copyright (c) 2012, Johannes Meyer, TU Darmstadt
+// All rights reserved.
+
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//     * Neither the name of the Flight Systems and Automatic Control group,
+//       TU Darmstadt, nor the names of its contributors may be used to
+//       endorse or promote products derived from this software without
+//       specific prior written permission.
+
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" 
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE 
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE 
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER BE LIABLE FOR ANY
+// DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+// (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+// LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+// ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+// SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//==============================================================================
+
+#ifndef UBLOX_GPS_PORT_DISCOVERY_H
+#define UBLOX_GPS_PORT_DISCOVERY_H
+
+#include <string>
+#include <vector>
+#include <boost/date_time/posix_time/posix_time.hpp>
+
+namespace ublox_gps {
+
+/**
+ * @brief The result of probing a serial port.
+ */
+struct ProbeResult {
+  std::string port; //!< The probed port
+  bool found; //!< Whether a u-blox receiver answered
+  unsigned int baudrate; //!< The baudrate at which it answered
+  std::string unique_id; //!< The unique chip ID in hex, empty if the
+                         //!< receiver does not support SEC-UNIQID
+  std::string sw_version; //!< The MON-VER software version
+  std::string hw_version; //!< The MON-VER hardware version
+  std::string error; //!< Why the port could not be probed, if not found
+};
+
+/**
+ * @brief Finds the u-blox receivers connected to a set of serial ports.
+ *
+ * @details Each port is probed by its own thread, so the discovery takes as
+ * long as the slowest port. A port is probed at each candidate baudrate
+ * until the receiver answers the MON-VER poll, then its unique chip ID is
+ * polled (SEC-UNIQID). The receivers are not configured. The ports are
+ * opened in exclusive mode while they are probed.
+ */
+class PortDiscovery {
+ public:
+  /**
+   * @param baudrates the candidate baudrates in the order they are tried
+   * @param timeout the time to wait for the answer to each poll
+   */
+  PortDiscovery(const std::vector<unsigned int>& baudrates,
+                const boost::posix_time::time_duration& timeout);
+
+  /**
+   * @brief Expand glob patterns of serial ports, e.g. /dev/ttyACM*.
+   *
+   * @details Symbolic links to the same device are only listed once.
+   * @param patterns the glob patterns
+   * @return the existing ports, sorted
+   */
+  static std::vector<std::string> expand(
+      const std::vector<std::string>& patterns);
+
+  /**
+   * @brief Probe the given ports concurrently.
+   * @return the result of each port, in the order of the ports
+   */
+  std::vector<ProbeResult> probe(const std::vector<std::string>& ports) const;
+
+  /**
+   * @brief Probe a single port.
+   * @param port the port
+   * @param result the result of the port
+   */
+  void probePort(const std::string& port, ProbeResult* result) const;
+
+ private:
+  //! The candidate baudrates in the order they are tried
+  std::vector<unsigned int> baudrates_;
+  //! The time to wait for the answer to each poll
+  boost::posix_time::time_duration timeout_;
+};
+
+/**
+ * @brief Find the receiver with the given unique chip ID.
+ *
+ * @details The IDs are compared case-insensitively.
+ * @param results the probe results
+ * @param unique_id the unique chip ID in hex
+ * @param exclude a port which must not be returned, e.g. already bound
+ * @return the index of the result, -1 if not found
+ */
+int findReceiver(const std::vector<ProbeResult>& results,
+                 const std::string& unique_id,
+                 const std::string& exclude = std::string());
+
+}  // namespace ublox_gps
+
+#endif  // UBLOX_GPS_PORT_DISCOVERY_H
@@ -47,6 +47,8 @@
 // ROS messages
 #include <std_msgs/UInt8MultiArray.h>
 
+#include <ublox_gps/capture.h>
+
 /**
  * @namespace ublox_node
  * This namespace is for the ROS u-blox node and handles anything regarding
@@ -77,6 +79,12 @@ class RawDataStreamPa {
      */
     bool isEnabled(void);
 
+    /**
+     * @brief Returns if the data is stored in the capture format, which
+     * includes the sent data and the timestamps.
+     */
+    bool isCapturing(void);
+
     /**
      * @brief Initializes raw data streams
      * If storing to file is enabled, the filename is created and the
@@ -94,6 +102,15 @@ class RawDataStreamPa {
     void ubloxCallback(const unsigned char* data,
      const std::size_t size);
 
+    /**
+     * @brief Callback function which handles the data sent to the device.
+     * Only stored in the capture format.
+     * @param data the sent bytes
+     * @param size the number of bytes
+     */
+    void sentCallback(const unsigned char* data,
+     const std::size_t size);
+
     /**
      * @brief Callback function which handles raw data.
      * @param msg ros message
@@ -125,6 +142,11 @@ class RawDataStreamPa {
     //! Handle for file access
     std::ofstream file_handle_;
 
+    //! Flag for storing in the capture format
+    bool flag_capture_;
+    //! Writer of the capture file
+    ublox_gps::CaptureWriter capture_;
+
     //! Flag for publishing raw data
     bool flag_publish_;
 
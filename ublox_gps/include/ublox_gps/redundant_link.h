@@ -0,0 +1,179 @@
+//==============================================================================
+// Copyright (c) 2012, Johannes Meyer, TU Darmstadt
+// All rights reserved.
+
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//     * Neither the name of the Flight Systems and Automatic Control group,
+//       TU Darmstadt, nor the names of its contributors may be used to
+//       endorse or promote products derived from this software without
+//       specific prior written permission.
+
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" 
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE 
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE 
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER BE LIABLE FOR ANY
+// DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+// (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+// LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+// ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+// SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//==============================================================================
+
+#ifndef UBLOX_GPS_REDUNDANT_LINK_H
+#define UBLOX_GPS_REDUNDANT_LINK_H
+
+#include <deque>
+#include <map>
+#include <stdint.h>
+#include <boost/date_time/posix_time/posix_time.hpp>
+#include <boost/thread.hpp>
+
+namespace ublox_gps {
+
+/**
+ * @brief Statistics of an input link of a receiver connected over several
+ * links.
+ */
+struct LinkStatistics {
+  LinkStatistics() : frames(0), first(0), matched(0), advantage(0),
+                     missed(0) {}
+
+  uint64_t frames; //!< Number of u-blox frames received on the link
+  uint64_t first; //!< Number of frames which arrived on this link first
+  //! Number of frames which arrived first and later on the other link
+  uint64_t matched;
+  //! Total time matched frames arrived earlier than on the other link [s]
+  double advantage;
+  //! Number of frames which only arrived on the other link
+  uint64_t missed;
+  //! When the last frame was received, not_a_date_time if none
+  boost::posix_time::ptime last_frame;
+};
+
+/**
+ * @brief Delivers the first copy of frames received over two links.
+ *
+ * @details Frames are identified by their class & message ID, iTOW (NAV
+ * messages only) and checksum. A frame is delivered if no copy of it arrived
+ * on the other link within the window. A copy which does not arrive on the
+ * other link within the window is counted as missed by that link.
+ */
+class FrameDeduplicator {
+ public:
+  //! The number of links
+  constexpr static std::size_t kLinks = 2;
+
+  /**
+   * @param window how long to wait for a copy from the other link [s]
+   */
+  explicit FrameDeduplicator(double window = 1.0)
+      : window_(boost::posix_time::microseconds(
+            static_cast<int64_t>(window * 1e6))) {}
+
+  /**
+   * @brief Decide whether to deliver the frame.
+   * @param link the link the frame was received on
+   * @param class_id the class ID of the frame
+   * @param message_id the message ID of the frame
+   * @param itow the iTOW of NAV messages, 0 otherwise
+   * @param checksum the checksum of the frame
+   * @return true if this is the first copy of the frame
+   */
+  bool accept(std::size_t link, uint8_t class_id, uint8_t message_id,
+              uint32_t itow, uint16_t checksum) {
+    boost::posix_time::ptime now =
+        boost::posix_time::microsec_clock::universal_time();
+    boost::mutex::scoped_lock lock(mutex_);
+    expire(now);
+    LinkStatistics& stats = stats_[link];
+    ++stats.frames;
+    stats.last_frame = now;
+
+    const uint64_t key = static_cast<uint64_t>(class_id) << 56
+                         | static_cast<uint64_t>(message_id) << 48
+                         | static_cast<uint64_t>(checksum) << 32 | itow;
+    Entries::iterator it = entries_.find(key);
+    if (it != entries_.end() && it->second.link != link) {
+      // Copy of a frame which was delivered from the other link
+      if (!it->second.matched) {
+        LinkStatistics& other = stats_[it->second.link];
+        ++other.matched;
+        other.advantage += (now - it->second.time).total_microseconds() * 1e-6;
+        it->second.matched = true;
+      }
+      return false;
+    }
+    // New frame, or a repeated message on the same link
+    Entry& entry = entries_[key];
+    entry.link = link;
+    entry.time = now;
+    entry.matched = false;
+    order_.push_back(std::make_pair(now, key));
+    ++stats.first;
+    return true;
+  }
+
+  /**
+   * @brief Get the statistics of the given link.
+   */
+  LinkStatistics statistics(std::size_t link) const {
+    boost::mutex::scoped_lock lock(mutex_);
+    return stats_[link];
+  }
+
+  /**
+   * @brief Whether a frame was received on the link within the given time.
+   * @param link the link
+   * @param timeout the maximum time since the last frame
+   */
+  bool isAlive(std::size_t link,
+               const boost::posix_time::time_duration& timeout) const {
+    boost::mutex::scoped_lock lock(mutex_);
+    return !stats_[link].last_frame.is_not_a_date_time()
+        && boost::posix_time::microsec_clock::universal_time()
+           - stats_[link].last_frame < timeout;
+  }
+
+ private:
+  //! A delivered frame
+  struct Entry {
+    std::size_t link; //!< The link it was received on first
+    boost::posix_time::ptime time; //!< When it was received
+    bool matched; //!< Whether it was also received on the other link
+  };
+  typedef std::map<uint64_t, Entry> Entries;
+
+  /**
+   * @brief Remove the frames older than the window & count missed frames.
+   */
+  void expire(const boost::posix_time::ptime& now) {
+    while (!order_.empty() && now - order_.front().first > window_) {
+      Entries::iterator it = entries_.find(order_.front().second);
+      // Skip entries which were replaced by a repeated message
+      if (it != entries_.end() && it->second.time == order_.front().first) {
+        if (!it->second.matched)
+          ++stats_[1 - it->second.link].missed;
+        entries_.erase(it);
+      }
+      order_.pop_front();
+    }
+  }
+
+  mutable boost::mutex mutex_; //!< Lock, accessed by the I/O & ROS threads
+  boost::posix_time::time_duration window_; //!< The deduplication window
+  Entries entries_; //!< Frames delivered within the window, by key
+  //! Frames in the order they were delivered, (time, key)
+  std::deque<std::pair<boost::posix_time::ptime, uint64_t> > order_;
+  LinkStatistics stats_[kLinks]; //!< Statistics of each link
+};
+
+}  // namespace ublox_gps
+
+#endif  // UBLOX_GPS_REDUNDANT_LINK_H
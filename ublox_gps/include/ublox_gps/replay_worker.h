@@ -0,0 +1,129 @@
+//==============================================================================
+// Copyright (c) 2012, Johannes Meyer, TU Darmstadt
+// All rights reserved.
+
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//     * Neither the name of the Flight Systems and Automatic Control group,
+//       TU Darmstadt, nor the names of its contributors may be used to
+//       endorse or promote products derived from this software without
+//       specific prior written permission.
+
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" 
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE 
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE 
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER BE LIABLE FOR ANY
+// DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+// (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+// LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+// ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+// SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//==============================================================================
+
+#ifndef UBLOX_GPS_REPLAY_WORKER_H
+#define UBLOX_GPS_REPLAY_WORKER_H
+
+#include <deque>
+#include <string>
+#include <vector>
+#include <boost/thread.hpp>
+#include <boost/thread/condition.hpp>
+
+#include "capture.h"
+#include "worker.h"
+
+namespace ublox_gps {
+
+/**
+ * @brief Replays a capture file as if the bytes were received from the
+ * device.
+ *
+ * @details The received chunks are delivered with the original timing,
+ * relative to the previous sent chunk. When the replay reaches a chunk the
+ * node sent during the capture, it waits until the node sends the same
+ * message, so that configuration handshakes are replayed in order, e.g. the
+ * ACKs are received after the node sent the configuration. The replay starts
+ * when the read callback is set.
+ */
+class ReplayWorker : public Worker {
+ public:
+  /**
+   * @brief Open the capture file.
+   * @param path the path of the capture file
+   * @param speed the replay speed factor, 0 to replay as fast as possible
+   * @param sync_timeout the maximum time to wait for a sent chunk
+   * @throws std::runtime_error if the file is not a capture file
+   */
+  ReplayWorker(const std::string& path, double speed,
+               const boost::posix_time::time_duration& sync_timeout);
+  virtual ~ReplayWorker();
+
+  /**
+   * @brief Set the callback function for received messages & start the
+   * replay.
+   */
+  void setCallback(const Callback& callback);
+
+  void setRawDataCallback(const Callback& callback) {
+    write_callback_ = callback;
+  }
+
+  /**
+   * @brief Compare the sent bytes with the bytes sent during the capture.
+   */
+  bool send(const unsigned char* data, const unsigned int size);
+
+  void wait(const boost::posix_time::time_duration& timeout);
+
+  /**
+   * @brief Whether the replay did not reach the end of the capture.
+   */
+  bool isOpen() const;
+
+ private:
+  /**
+   * @brief Replay the capture, runs in the replay thread.
+   */
+  void run();
+
+  /**
+   * @brief Wait until the node sent the next chunk.
+   * @param record the sent chunk of the capture
+   */
+  void synchronize(const CaptureRecord& record);
+
+  /**
+   * @brief Deliver a received chunk to the callbacks.
+   */
+  void deliver(const CaptureRecord& record);
+
+  CaptureReader reader_; //!< The capture file
+  double speed_; //!< Replay speed factor, 0 as fast as possible
+  boost::posix_time::time_duration sync_timeout_; //!< Sent chunk timeout
+
+  mutable boost::mutex mutex_; //!< Lock for the state below
+  boost::condition condition_; //!< Notified when the node sends or stops
+  std::deque<std::vector<unsigned char> > sent_; //!< Sent by the node
+  bool stopping_; //!< Whether the replay is stopped
+  bool open_; //!< Whether the replay did not reach the end
+  uint32_t mismatches_; //!< Sent chunks which differ from the capture
+
+  boost::mutex read_mutex_; //!< Lock for the input buffer
+  boost::condition read_condition_; //!< Notified when data is received
+  std::vector<unsigned char> in_; //!< The input buffer
+  std::size_t in_buffer_size_; //!< Number of bytes in the input buffer
+
+  Callback read_callback_; //!< Callback function to handle received messages
+  Callback write_callback_; //!< Callback function to handle raw data
+  boost::shared_ptr<boost::thread> thread_; //!< The replay thread
+};
+
+}  // namespace ublox_gps
+
+#endif  // UBLOX_GPS_REPLAY_WORKER_H
@@ -0,0 +1,168 @@
+//==============================================================================
+// Copyright (c) 2012, Johannes Meyer, TU Darmstadt
+// All rights reserved.
+
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//     * Neither the name of the Flight Systems and Automatic Control group,
+//       TU Darmstadt, nor the names of its contributors may be used to
+//       endorse or promote products derived from this software without
+//       specific prior written permission.
+
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" 
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE 
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE 
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER BE LIABLE FOR ANY
+// DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+// (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+// LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+// ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+// SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//==============================================================================
+
+#ifndef UBLOX_GPS_SATELLITE_TABLE_H
+#define UBLOX_GPS_SATELLITE_TABLE_H
+
+#include <vector>
+#include <boost/thread.hpp>
+#include <ros/time.h>
+// ROS messages
+#include <ublox_msgs/NavSAT.h>
+#include <ublox_msgs/NavSVINFO.h>
+#include <ublox_msgs/RxmRAWX.h>
+#include <ublox_msgs/SatelliteState.h>
+#include <ublox_msgs/SatelliteSummary.h>
+#include <ublox_msgs/SatelliteTableDelta.h>
+
+namespace ublox_node {
+
+/**
+ * @brief Table of the tracked satellites, indexed by (gnssId, svId).
+ *
+ * @details The table is stored as a structure of arrays, each column holds
+ * one field of all satellites. It is updated incrementally from NAV-SAT (or
+ * NAV-SVINFO for firmware < 8) and RXM-RAWX messages. Satellites which are
+ * not in a NAV-SAT/SVINFO message are removed. The changes since the last
+ * delta are collected, so that only the changed satellites are published.
+ */
+class SatelliteTable {
+ public:
+  //! Number of GNSS identifiers
+  constexpr static std::size_t kNumGnss = 8;
+  //! Number of satellite identifiers per GNSS
+  constexpr static std::size_t kNumSv = 256;
+
+  /**
+   * @param cno_threshold the minimum change of the C/N0 [dBHz] for which a
+   * satellite is published as changed
+   */
+  explicit SatelliteTable(uint8_t cno_threshold = 1);
+
+  /**
+   * @brief Update the table from a NAV-SAT message.
+   */
+  void update(const ublox_msgs::NavSAT& m);
+
+  /**
+   * @brief Update the table from a NAV-SVINFO message.
+   */
+  void update(const ublox_msgs::NavSVINFO& m);
+
+  /**
+   * @brief Update the carrier phase state from a RXM-RAWX message.
+   *
+   * @details Does not add or remove satellites.
+   */
+  void update(const ublox_msgs::RxmRAWX& m);
+
+  /**
+   * @brief Get the changes since the last delta and the summary.
+   * @param delta the delta output, the header is not set
+   * @return whether any satellite was added, changed or removed
+   */
+  bool takeDelta(ublox_msgs::SatelliteTableDelta& delta);
+
+  /**
+   * @brief Get all satellites and the summary.
+   * @param satellites the satellites output
+   * @param summary the summary output
+   */
+  void get(std::vector<ublox_msgs::SatelliteState>& satellites,
+           std::vector<ublox_msgs::SatelliteSummary>& summary) const;
+
+  /**
+   * @brief Convert a NAV-SVINFO satellite number to (gnssId, svId).
+   * @param svid the satellite number, see Satellite Numbering
+   * @param gnss_id the GNSS identifier output
+   * @param sv_id the satellite identifier output
+   * @return false if the satellite number is unknown
+   */
+  static bool fromSvInfoId(uint8_t svid, uint8_t& gnss_id, uint8_t& sv_id);
+
+ private:
+  //! Flags of the dirty column
+  enum Dirty {
+    ADDED = 1, //!< Added since the last delta
+    CHANGED = 2 //!< Changed since the last delta
+  };
+
+  /**
+   * @brief Get the row of the satellite, add it if it is not in the table.
+   */
+  std::size_t row(uint8_t gnss_id, uint8_t sv_id);
+
+  /**
+   * @brief Set the state of the satellite from NAV-SAT or NAV-SVINFO.
+   */
+  void set(std::size_t i, uint8_t cno, int8_t elev, int16_t azim,
+           float pr_res, uint8_t quality, bool used);
+
+  /**
+   * @brief Remove the satellites which were not in the current epoch.
+   */
+  void removeUnseen();
+
+  /**
+   * @brief Get the state of the satellite in the given row.
+   */
+  ublox_msgs::SatelliteState state(std::size_t i) const;
+
+  /**
+   * @brief Compute the statistics of each constellation.
+   */
+  void summarize(std::vector<ublox_msgs::SatelliteSummary>& summary) const;
+
+  mutable boost::mutex mutex_; //!< Lock, accessed by the I/O & ROS threads
+  uint8_t cno_threshold_; //!< Minimum C/N0 change to publish [dBHz]
+  //! Row of each (gnssId, svId), -1 if not tracked
+  std::vector<int16_t> index_;
+  uint32_t epoch_; //!< Number of NAV-SAT/SVINFO messages
+
+  // Columns
+  std::vector<uint8_t> gnss_id_; //!< GNSS identifier
+  std::vector<uint8_t> sv_id_; //!< Satellite identifier
+  std::vector<uint8_t> cno_; //!< C/N0 [dBHz]
+  std::vector<uint8_t> published_cno_; //!< C/N0 of the last delta [dBHz]
+  std::vector<int8_t> elev_; //!< Elevation [deg]
+  std::vector<int16_t> azim_; //!< Azimuth [deg]
+  std::vector<float> pr_res_; //!< Pseudo range residual [m]
+  std::vector<uint8_t> quality_; //!< Signal quality indicator
+  std::vector<uint8_t> used_; //!< Whether used for navigation
+  std::vector<uint8_t> carrier_valid_; //!< Whether RXM-RAWX CP was valid
+  std::vector<uint16_t> locktime_; //!< RXM-RAWX locktime [ms]
+  std::vector<uint32_t> epoch_seen_; //!< Last epoch with the satellite
+  std::vector<uint8_t> dirty_; //!< Dirty flags since the last delta
+
+  //! Satellites removed since the last delta
+  std::vector<ublox_msgs::SatelliteState> removed_;
+};
+
+}  // namespace ublox_node
+
+#endif  // UBLOX_GPS_SATELLITE_TABLE_H
@@ -0,0 +1,193 @@
+//==============================================================================
+// Copyright (c) 2012, Johannes Meyer, TU Darmstadt
+// All rights reserved.
+
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//     * Neither the name of the Flight Systems and Automatic Control group,
+//       TU Darmstadt, nor the names of its contributors may be used to
+//       endorse or promote products derived from this software without
+//       specific prior written permission.
+
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" 
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE 
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE 
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER BE LIABLE FOR ANY
+// DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+// (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+// LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+// ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+// SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//==============================================================================
+
+#ifndef UBLOX_GPS_SFRBX_DECODER_H
+#define UBLOX_GPS_SFRBX_DECODER_H
+
+#include <vector>
+#include <boost/function.hpp>
+#include <boost/thread.hpp>
+#include <ublox_gps/ephemeris.h>
+// ROS messages
+#include <ublox_msgs/RxmSFRBX.h>
+
+namespace ublox_node {
+
+/**
+ * @brief GPS almanac of one satellite, angles in radians.
+ */
+struct GpsAlmanac {
+  uint8_t sv_id; //!< GPS PRN
+  uint8_t health; //!< Satellite health
+  double toa; //!< Reference time of the almanac [s]
+  double e; //!< Eccentricity
+  double delta_i; //!< Inclination relative to 0.3 semi-circles
+  double omega_dot; //!< Rate of the right ascension [rad/s]
+  double sqrt_a; //!< Square root of the semi-major axis [m^0.5]
+  double omega0; //!< Longitude of the ascending node at the week epoch
+  double omega; //!< Argument of perigee
+  double m0; //!< Mean anomaly at the reference time
+  double af0; //!< Clock bias [s]
+  double af1; //!< Clock drift [s/s]
+};
+
+/**
+ * @brief Ionosphere model parameters.
+ */
+struct IonosphereParams {
+  bool klobuchar_valid; //!< Whether the GPS Klobuchar parameters are set
+  double alpha[4]; //!< Klobuchar alpha [s, s/sc, s/sc^2, s/sc^3]
+  double beta[4]; //!< Klobuchar beta [s, s/sc, s/sc^2, s/sc^3]
+  bool nequick_valid; //!< Whether the Galileo NeQuick parameters are set
+  double ai[3]; //!< NeQuick effective ionisation level coefficients
+};
+
+/**
+ * @brief GNSS time to UTC conversion parameters.
+ */
+struct UtcParams {
+  bool valid; //!< Whether the parameters are set
+  double a0; //!< Bias [s]
+  double a1; //!< Drift [s/s]
+  uint32_t tot; //!< Reference time of week [s]
+  uint8_t wnt; //!< Reference week number (modulo 256)
+  int8_t dt_ls; //!< Leap seconds [s]
+  uint8_t wn_lsf; //!< Week of the future leap second (modulo 256)
+  uint8_t dn; //!< Day of the week of the future leap second
+  int8_t dt_lsf; //!< Leap seconds after the future leap second [s]
+};
+
+/**
+ * @brief Decodes the navigation data in RXM-SFRBX messages.
+ *
+ * @details Decodes GPS (and QZSS) LNAV subframes and Galileo I/NAV pages.
+ * Subframes and pages are collected per satellite until an ephemeris is
+ * complete, i.e. all parts with the same issue of data have been received.
+ * Almanacs, ionosphere and UTC parameters are decoded from single subframes
+ * or pages. The GPS parity and the Galileo CRC are checked with lookup tables;
+ * subframes and pages which fail the check are discarded.
+ */
+class SfrbxDecoder {
+ public:
+  //! Callback for new ephemerides
+  typedef boost::function<void(const Ephemeris&)> EphemerisCallback;
+
+  /**
+   * @brief Decoder statistics.
+   */
+  struct Statistics {
+    uint32_t subframes; //!< Number of decoded subframes & pages
+    uint32_t parity_errors; //!< Number of parity or CRC failures
+    uint32_t unsupported; //!< Number of messages of unsupported signals
+    uint32_t ephemerides; //!< Number of new ephemerides
+    std::size_t almanacs; //!< Number of satellites with an almanac
+  };
+
+  SfrbxDecoder();
+
+  /**
+   * @brief Set the callback which is called for each new ephemeris.
+   */
+  void setEphemerisCallback(const EphemerisCallback& callback) {
+    ephemeris_callback_ = callback;
+  }
+
+  /**
+   * @brief Decode a subframe or page.
+   */
+  void decode(const ublox_msgs::RxmSFRBX& m);
+
+  /**
+   * @brief Get the GPS almanacs.
+   */
+  std::vector<GpsAlmanac> almanacs() const;
+
+  /**
+   * @brief Get the ionosphere model parameters.
+   */
+  IonosphereParams ionosphere() const;
+
+  /**
+   * @brief Get the UTC parameters of the given GNSS.
+   * @param gnss_id the GNSS identifier, GPS or Galileo
+   */
+  UtcParams utc(uint8_t gnss_id) const;
+
+  /**
+   * @brief Get the decoder statistics.
+   */
+  Statistics statistics() const;
+
+ private:
+  //! Number of GNSS identifiers
+  constexpr static std::size_t kNumGnss = 8;
+  //! Number of satellite identifiers per GNSS
+  constexpr static std::size_t kNumSv = 64;
+
+  /**
+   * @brief The parts of the ephemeris of a satellite received so far.
+   */
+  struct Parts {
+    //! GPS: data words 3-10 of subframes 1-3, Galileo: word types 1-5
+    std::vector<std::vector<uint32_t> > data;
+    uint8_t received; //!< Bit mask of the received parts
+    uint16_t iode; //!< Issue of data of the last ephemeris
+    double toe; //!< Reference time of the last ephemeris
+  };
+
+  /**
+   * @brief Decode a GPS or QZSS LNAV subframe.
+   */
+  void decodeLnav(const ublox_msgs::RxmSFRBX& m);
+
+  /**
+   * @brief Decode a Galileo I/NAV page.
+   */
+  void decodeInav(const ublox_msgs::RxmSFRBX& m);
+
+  /**
+   * @brief Queue the ephemeris for the callback if it is new.
+   */
+  void publish(Parts& parts, const Ephemeris& eph);
+
+  mutable boost::mutex mutex_; //!< Lock, accessed by the I/O & ROS threads
+  //! Ephemeris parts of each (gnssId, svId)
+  std::vector<Parts> parts_;
+  //! GPS almanac of each PRN, sv_id is 0 if none
+  std::vector<GpsAlmanac> almanacs_;
+  IonosphereParams ionosphere_; //!< Ionosphere parameters
+  std::vector<UtcParams> utc_; //!< UTC parameters of each GNSS
+  Statistics statistics_; //!< Decoder statistics
+  //! New ephemerides, passed to the callback after unlocking
+  std::vector<Ephemeris> pending_;
+  EphemerisCallback ephemeris_callback_; //!< Called for new ephemerides
+};
+
+}  // namespace ublox_node
+
+#endif  // UBLOX_GPS_SFRBX_DECODER_H
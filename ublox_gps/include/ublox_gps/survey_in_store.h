@@ -0,0 +1,99 @@
+//==============================================================================
+// Copyright (c) 2012, Johannes Meyer, TU Darmstadt
+// All rights reserved.
+
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//     * Neither the name of the Flight Systems and Automatic Control group,
+//       TU Darmstadt, nor the names of its contributors may be used to
+//       endorse or promote products derived from this software without
+//       specific prior written permission.
+
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" 
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE 
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE 
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER BE LIABLE FOR ANY
+// DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+// (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+// LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+// ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+// SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//==============================================================================
+
+#ifndef UBLOX_GPS_SURVEY_IN_STORE_H
+#define UBLOX_GPS_SURVEY_IN_STORE_H
+
+#include <string>
+// ROS messages
+#include <ublox_msgs/NavSVIN.h>
+
+namespace ublox_node {
+
+/**
+ * @brief A converged survey-in result of an antenna site.
+ */
+struct SurveyInResult {
+  std::string site; //!< The antenna / site ID
+  double stamp; //!< The time the survey-in converged [s since epoch]
+  double ecef[3]; //!< The mean ECEF position [m]
+  double accuracy; //!< The mean position accuracy [m]
+  uint32_t duration; //!< The survey-in duration [s]
+  uint32_t observations; //!< The number of position observations
+};
+
+/**
+ * @brief Persists survey-in results per antenna site.
+ *
+ * @details Each site is stored in a separate text file in the given
+ * directory, so that a reference station restarted at the same site can be
+ * set to fixed mode without a new survey-in.
+ */
+class SurveyInStore {
+ public:
+  /**
+   * @param directory the directory of the stored results
+   */
+  explicit SurveyInStore(const std::string& directory);
+
+  /**
+   * @brief Load the stored result of a site.
+   * @param site the antenna / site ID
+   * @param result the stored result
+   * @return true if a result was loaded, false otherwise
+   */
+  bool load(const std::string& site, SurveyInResult& result) const;
+
+  /**
+   * @brief Store the result of a site, replacing the previous result.
+   * @return true if the result was written, false otherwise
+   */
+  bool save(const SurveyInResult& result) const;
+
+  /**
+   * @brief Create a result from a converged NavSVIN message.
+   * @param site the antenna / site ID
+   * @param m the NavSVIN message
+   * @param stamp the time the survey-in converged [s since epoch]
+   */
+  static SurveyInResult fromNavSvIn(const std::string& site,
+                                    const ublox_msgs::NavSVIN& m,
+                                    double stamp);
+
+  /**
+   * @brief Get the path of the stored result of a site.
+   */
+  std::string path(const std::string& site) const;
+
+ private:
+  std::string directory_; //!< The directory of the stored results
+};
+
+}  // namespace ublox_node
+
+#endif  // UBLOX_GPS_SURVEY_IN_STORE_H
@@ -31,9 +31,48 @@
 
 #include <boost/date_time/posix_time/posix_time.hpp>
 #include <boost/function.hpp>
+#include <string>
+#include <ublox_gps/metrics.h>
 
 namespace ublox_gps {
 
+/**
+ * @brief Settings of the coalesced reads, see AsyncWorker.
+ */
+struct ReadCoalescing {
+  ReadCoalescing() : enabled(false), min_bytes(0), max_latency(0) {}
+
+  bool enabled; //!< Whether to coalesce the reads
+  uint32_t min_bytes; //!< The bytes to wait for until the latency budget
+  double max_latency; //!< The latency budget of the received bytes [s]
+};
+
+/**
+ * @brief Read statistics of a worker.
+ */
+struct ReadStatistics {
+  ReadStatistics() : wakeups(0), reads(0), bytes(0), max_delay(0) {}
+
+  uint64_t wakeups; //!< Wakeups of the I/O thread for reading
+  uint64_t reads; //!< Reads which returned data
+  uint64_t bytes; //!< Bytes read
+  double max_delay; //!< The longest read delay, see delay [s]
+  //! The longest time the bytes of each read may have waited in the kernel
+  //! [s]
+  Histogram::Snapshot delay;
+};
+
+/**
+ * @brief Read errors of a worker.
+ */
+struct ReadErrors {
+  ReadErrors() : failing(false), count(0) {}
+
+  bool failing; //!< Whether the reads currently fail
+  uint64_t count; //!< Failed reads since startup
+  std::string message; //!< The last read error
+};
+
 /**
  * @brief Handles I/O reading and writing.
  */
@@ -71,6 +110,32 @@ class Worker {
    * @brief Whether or not the I/O stream is open.
    */
   virtual bool isOpen() const = 0;
+
+  /**
+   * @brief Set how the reads are coalesced, ignored by workers which do not
+   * support it.
+   */
+  virtual void setReadCoalescing(const ReadCoalescing& coalescing) {}
+
+  /**
+   * @brief Get the read statistics.
+   * @return false if the worker does not keep them
+   */
+  virtual bool getReadStatistics(ReadStatistics& statistics) const {
+    return false;
+  }
+
+  /**
+   * @brief Whether the reads currently fail, e.g. because the device was
+   * unplugged.
+   */
+  virtual bool isReadFailing() const { return false; }
+
+  /**
+   * @brief Get the read errors, left unchanged by workers which do not keep
+   * them.
+   */
+  virtual void getReadErrors(ReadErrors& errors) const {}
 };
 
 }  // namespace ublox_gps
@@ -0,0 +1,304 @@
+//==============================================================================
+// Copyright (c) 2012, Johannes Meyer, TU Darmstadt
+// All rights reserved.
+
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//     * Neither the name of the Flight Systems and Automatic Control group,
+//       TU Darmstadt, nor the names of its contributors may be used to
+//       endorse or promote products derived from this software without
+//       specific prior written permission.
+
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" 
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE 
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE 
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER BE LIABLE FOR ANY
+// DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+// (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+// LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+// ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+// SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//==============================================================================
+
+// Re-encodes the ublox_msgs messages of ROS bags to a UBX byte stream, e.g. to
+// process old recordings with rtklib or u-center.
+//
+// Usage: ublox_bag_to_ubx <output.ubx> <input.bag>... [-- <topic>...]
+
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+#include <boost/unordered_map.hpp>
+#include <ros/ros.h>
+#include <ros/serialization.h>
+#include <rosbag/bag.h>
+#include <rosbag/view.h>
+#include <ublox/serialization/ublox_msgs.h>
+
+namespace {
+
+//! Size of the output buffer, flushed when it is full
+const uint32_t kBufferSize = 4 * 1024 * 1024;
+
+/**
+ * @brief Encodes UBX frames into a large buffer which is written to a file
+ * when it is full.
+ */
+class UbxEncoder {
+ public:
+  explicit UbxEncoder(std::ostream& out)
+      : out_(out), buffer_(kBufferSize), used_(0), frames_(0), bytes_(0) {}
+
+  ~UbxEncoder() { flush(); }
+
+  /**
+   * @brief Copy the bag message as payload.
+   *
+   * @details The ROS serialization of the messages without a custom
+   * serializer is identical to the UBX payload, so the payload is copied from
+   * the bag without decoding the message.
+   */
+  bool copy(const rosbag::MessageInstance& m, uint8_t class_id,
+            uint8_t message_id) {
+    const uint32_t length = m.size();
+    if (!reserve(length))
+      return false;
+    ros::serialization::OStream stream(
+        buffer_.data() + used_ + ublox::kHeaderLength, length);
+    m.write(stream);
+    return frame(length, class_id, message_id);
+  }
+
+  /**
+   * @brief Encode the message with its UBX serializer.
+   */
+  template <typename T>
+  bool encode(const T& m) {
+    const uint32_t length = ublox::Serializer<T>::serializedLength(m);
+    if (!reserve(length))
+      return false;
+    ublox::Serializer<T>::write(buffer_.data() + used_ + ublox::kHeaderLength,
+                                length, m);
+    return frame(length, T::CLASS_ID, T::MESSAGE_ID);
+  }
+
+  /**
+   * @brief Write the buffered frames to the file.
+   */
+  void flush() {
+    out_.write(reinterpret_cast<const char*>(buffer_.data()), used_);
+    bytes_ += used_;
+    used_ = 0;
+  }
+
+  uint64_t frames() const { return frames_; }
+  uint64_t bytes() const { return bytes_ + used_; }
+
+ private:
+  /**
+   * @brief Make room for a frame with the given payload length.
+   * @return false if the payload does not fit in a UBX frame
+   */
+  bool reserve(uint32_t length) {
+    if (length > 0xFFFF)
+      return false;
+    if (used_ + length + ublox::kHeaderLength + ublox::kChecksumLength
+        > buffer_.size())
+      flush();
+    return true;
+  }
+
+  /**
+   * @brief Add the header & checksum to the payload at the end of the buffer.
+   */
+  bool frame(uint32_t length, uint8_t class_id, uint8_t message_id) {
+    uint8_t* data = buffer_.data() + used_;
+    const uint32_t size = buffer_.size() - used_;
+    ublox::Writer writer(data, size);
+    // The payload is already in place, only the header & checksum are written
+    if (!writer.write(0, length, class_id, message_id))
+      return false;
+    used_ += writer.end() - data;
+    ++frames_;
+    return true;
+  }
+
+  std::ostream& out_; //!< The output file
+  std::vector<uint8_t> buffer_; //!< The encoded frames
+  uint32_t used_; //!< The number of used bytes of the buffer
+  uint64_t frames_; //!< The number of encoded frames
+  uint64_t bytes_; //!< The number of written bytes
+};
+
+//! Encodes a bag message, returns false if it could not be encoded
+typedef bool (*Encode)(const rosbag::MessageInstance&, UbxEncoder&);
+
+template <typename T>
+bool copyMessage(const rosbag::MessageInstance& m, UbxEncoder& encoder) {
+  return encoder.copy(m, T::CLASS_ID, T::MESSAGE_ID);
+}
+
+template <typename T>
+bool decodeMessage(const rosbag::MessageInstance& m, UbxEncoder& encoder) {
+  typename T::ConstPtr message = m.instantiate<T>();
+  return message && encoder.encode(*message);
+}
+
+//! The encoders by ROS data type
+typedef boost::unordered_map<std::string, Encode> Encoders;
+
+template <typename T>
+void addCopy(Encoders& encoders) {
+  encoders[ros::message_traits::DataType<T>::value()] = &copyMessage<T>;
+}
+
+template <typename T>
+void addDecode(Encoders& encoders) {
+  encoders[ros::message_traits::DataType<T>::value()] = &decodeMessage<T>;
+}
+
+/**
+ * @brief Get the encoders of the messages sent by the devices.
+ *
+ * @details Messages with a custom serializer (repeated blocks) must be
+ * decoded, all others are copied.
+ */
+Encoders createEncoders() {
+  Encoders e;
+  addDecode<ublox_msgs::AidALM>(e);
+  addDecode<ublox_msgs::AidEPH>(e);
+  addCopy<ublox_msgs::AidHUI>(e);
+  addCopy<ublox_msgs::EsfINS>(e);
+  addDecode<ublox_msgs::EsfMEAS>(e);
+  addDecode<ublox_msgs::EsfRAW>(e);
+  addDecode<ublox_msgs::EsfSTATUS>(e);
+  addCopy<ublox_msgs::HnrPVT>(e);
+  addCopy<ublox_msgs::LogBATCH>(e);
+  addCopy<ublox_msgs::LogINFO>(e);
+  addCopy<ublox_msgs::LogRETRIEVEPOS>(e);
+  addCopy<ublox_msgs::LogRETRIEVEPOSEXTRA>(e);
+  addDecode<ublox_msgs::LogRETRIEVESTRING>(e);
+  addCopy<ublox_msgs::MonGNSS>(e);
+  addCopy<ublox_msgs::MonHW>(e);
+  addCopy<ublox_msgs::MonHW6>(e);
+  addDecode<ublox_msgs::MonVER>(e);
+  addCopy<ublox_msgs::NavATT>(e);
+  addCopy<ublox_msgs::NavCLOCK>(e);
+  addDecode<ublox_msgs::NavDGPS>(e);
+  addCopy<ublox_msgs::NavDOP>(e);
+  addCopy<ublox_msgs::NavHPPOSECEF>(e);
+  addCopy<ublox_msgs::NavHPPOSLLH>(e);
+  addCopy<ublox_msgs::NavPOSECEF>(e);
+  addCopy<ublox_msgs::NavPOSLLH>(e);
+  addCopy<ublox_msgs::NavPVT>(e);
+  addCopy<ublox_msgs::NavPVT7>(e);
+  addCopy<ublox_msgs::NavRELPOSNED>(e);
+  addCopy<ublox_msgs::NavRELPOSNED9>(e);
+  addDecode<ublox_msgs::NavSAT>(e);
+  addDecode<ublox_msgs::NavSBAS>(e);
+  addCopy<ublox_msgs::NavSOL>(e);
+  addCopy<ublox_msgs::NavSTATUS>(e);
+  addCopy<ublox_msgs::NavSVIN>(e);
+  addDecode<ublox_msgs::NavSVINFO>(e);
+  addCopy<ublox_msgs::NavTIMEGPS>(e);
+  addCopy<ublox_msgs::NavTIMEUTC>(e);
+  addCopy<ublox_msgs::NavVELECEF>(e);
+  addCopy<ublox_msgs::NavVELNED>(e);
+  addDecode<ublox_msgs::RxmALM>(e);
+  addDecode<ublox_msgs::RxmEPH>(e);
+  addDecode<ublox_msgs::RxmRAW>(e);
+  addDecode<ublox_msgs::RxmRAWX>(e);
+  addCopy<ublox_msgs::RxmRTCM>(e);
+  addCopy<ublox_msgs::RxmSFRB>(e);
+  addDecode<ublox_msgs::RxmSFRBX>(e);
+  addDecode<ublox_msgs::RxmSVSI>(e);
+  addCopy<ublox_msgs::TimTM2>(e);
+  addCopy<ublox_msgs::UpdSOS_Ack>(e);
+  return e;
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+  std::vector<std::string> bags, topics;
+  bool parse_topics = false;
+  for (int i = 2; i < argc; ++i) {
+    if (std::string(argv[i]) == "--")
+      parse_topics = true;
+    else if (parse_topics)
+      topics.push_back(argv[i]);
+    else
+      bags.push_back(argv[i]);
+  }
+  if (bags.empty()) {
+    std::cerr << "Usage: " << argv[0]
+              << " <output.ubx> <input.bag>... [-- <topic>...]" << std::endl;
+    return 1;
+  }
+  std::ofstream out(argv[1], std::ios::binary | std::ios::trunc);
+  if (!out.is_open()) {
+    std::cerr << "Failed to open " << argv[1] << std::endl;
+    return 1;
+  }
+
+  const Encoders encoders = createEncoders();
+  const ros::WallTime start = ros::WallTime::now();
+  uint64_t skipped = 0, failed = 0;
+  try {
+    std::vector<boost::shared_ptr<rosbag::Bag> > files;
+    // The view merges the bags in the order of the receive time
+    rosbag::View view;
+    for (size_t i = 0; i < bags.size(); ++i) {
+      files.push_back(boost::shared_ptr<rosbag::Bag>(
+          new rosbag::Bag(bags[i], rosbag::bagmode::Read)));
+      if (topics.empty())
+        view.addQuery(*files.back());
+      else
+        view.addQuery(*files.back(), rosbag::TopicQuery(topics));
+    }
+
+    UbxEncoder encoder(out);
+    // Look up the encoder once per connection instead of once per message,
+    // the connection header is shared by the messages of a connection
+    typedef boost::unordered_map<const ros::M_string*, Encode> Connections;
+    Connections connections;
+    for (rosbag::View::iterator it = view.begin(); it != view.end(); ++it) {
+      const ros::M_string* connection = it->getConnectionHeader().get();
+      Connections::iterator c = connections.find(connection);
+      if (c == connections.end()) {
+        Encoders::const_iterator e = encoders.find(it->getDataType());
+        c = connections.insert(std::make_pair(
+            connection, e == encoders.end() ? Encode(0) : e->second)).first;
+      }
+      if (!c->second)
+        ++skipped;
+      else if (!c->second(*it, encoder))
+        ++failed;
+    }
+    encoder.flush();
+
+    const double elapsed = (ros::WallTime::now() - start).toSec();
+    std::cout << "Wrote " << encoder.frames() << " frames ("
+              << encoder.bytes() << " bytes) to " << argv[1] << " in "
+              << elapsed << " s";
+    if (elapsed > 0)
+      std::cout << ", " << encoder.frames() / elapsed * 60 << " frames/min";
+    std::cout << std::endl;
+  } catch (rosbag::BagException& e) {
+    std::cerr << e.what() << std::endl;
+    return 1;
+  }
+  if (skipped > 0)
+    std::cout << "Skipped " << skipped << " messages of other types"
+              << std::endl;
+  if (failed > 0)
+    std::cerr << "Failed to encode " << failed << " messages" << std::endl;
+  return failed > 0 ? 1 : 0;
+}
@@ -0,0 +1,133 @@
+//==============================================================================
+// Copyright (c) 2012, Johannes Meyer, TU Darmstadt
+// All rights reserved.
+
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//     * Neither the name of the Flight Systems and Automatic Control group,
+//       TU Darmstadt, nor the names of its contributors may be used to
+//       endorse or promote products derived from this software without
+//       specific prior written permission.
+
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" 
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE 
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE 
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER BE LIABLE FOR ANY
+// DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+// (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+// LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+// ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+// SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//==============================================================================
+
+#include "ublox_gps/capture.h"
+#include <cstring>
+#include <time.h>
+
+using namespace ublox_gps;
+
+namespace {
+
+/**
+ * @brief Get the time of the given clock [ns].
+ */
+uint64_t clockTime(clockid_t clock) {
+  timespec ts;
+  clock_gettime(clock, &ts);
+  return static_cast<uint64_t>(ts.tv_sec) * 1000000000ULL + ts.tv_nsec;
+}
+
+/**
+ * @brief Encode a little endian number.
+ */
+void encode(unsigned char* data, uint64_t value, std::size_t size) {
+  for (std::size_t i = 0; i < size; ++i)
+    data[i] = (value >> (8 * i)) & 0xff;
+}
+
+/**
+ * @brief Decode a little endian number.
+ */
+uint64_t decode(const unsigned char* data, std::size_t size) {
+  uint64_t value = 0;
+  for (std::size_t i = 0; i < size; ++i)
+    value |= static_cast<uint64_t>(data[i]) << (8 * i);
+  return value;
+}
+
+}  // namespace
+
+bool CaptureWriter::open(const std::string& path) {
+  boost::mutex::scoped_lock lock(mutex_);
+  file_.open(path.c_str(), std::ios::binary | std::ios::trunc);
+  if (!file_.is_open())
+    return false;
+  unsigned char header[kCaptureHeaderSize];
+  std::memcpy(header, kCaptureMagic, 6);
+  encode(header + 6, kCaptureVersion, 2);
+  file_.write(reinterpret_cast<const char*>(header), sizeof(header));
+  records_ = 0;
+  return file_.good();
+}
+
+void CaptureWriter::close() {
+  boost::mutex::scoped_lock lock(mutex_);
+  if (file_.is_open())
+    file_.close();
+}
+
+void CaptureWriter::write(uint8_t direction, const unsigned char* data,
+                          std::size_t size) {
+  // Take the time before waiting for the lock
+  const uint64_t monotonic = clockTime(CLOCK_MONOTONIC);
+  const uint64_t realtime = clockTime(CLOCK_REALTIME);
+  unsigned char header[kCaptureRecordHeaderSize] = {0};
+  encode(header, size, 4);
+  header[4] = direction;
+  encode(header + 8, monotonic, 8);
+  encode(header + 16, realtime, 8);
+
+  boost::mutex::scoped_lock lock(mutex_);
+  if (!file_.is_open())
+    return;
+  file_.write(reinterpret_cast<const char*>(header), sizeof(header));
+  file_.write(reinterpret_cast<const char*>(data), size);
+  ++records_;
+}
+
+uint64_t CaptureWriter::records() const {
+  boost::mutex::scoped_lock lock(mutex_);
+  return records_;
+}
+
+bool CaptureReader::open(const std::string& path) {
+  file_.open(path.c_str(), std::ios::binary);
+  unsigned char header[kCaptureHeaderSize];
+  if (!file_.read(reinterpret_cast<char*>(header), sizeof(header)))
+    return false;
+  return std::memcmp(header, kCaptureMagic, 6) == 0
+      && decode(header + 6, 2) == kCaptureVersion;
+}
+
+bool CaptureReader::read(CaptureRecord& record) {
+  unsigned char header[kCaptureRecordHeaderSize];
+  if (!file_.read(reinterpret_cast<char*>(header), sizeof(header)))
+    return false;
+  record.direction = header[4];
+  record.monotonic = decode(header + 8, 8);
+  record.realtime = decode(header + 16, 8);
+  // Never trust a corrupted size with a huge allocation
+  const uint64_t size = decode(header, 4);
+  if (size > kCaptureMaxRecordSize)
+    return false;
+  record.data.resize(size);
+  return record.data.empty()
+      || file_.read(reinterpret_cast<char*>(record.data.data()),
+                    record.data.size());
+}
@@ -0,0 +1,301 @@
+//==============================================================================
+// Copyright (c) 2012, Johannes Meyer, TU Darmstadt
+// All rights reserved.
+
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//     * Neither the name of the Flight Systems and Automatic Control group,
+//       TU Darmstadt, nor the names of its contributors may be used to
+//       endorse or promote products derived from this software without
+//       specific prior written permission.
+
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" 
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE 
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE 
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER BE LIABLE FOR ANY
+// DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+// (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+// LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+// ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+// SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//==============================================================================
+
+#include "ublox_gps/chrony_refclock.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <sys/ioctl.h>
+#include <sys/ipc.h>
+#include <sys/shm.h>
+#include <unistd.h>
+#include <linux/pps.h>
+#include <algorithm>
+#include <cmath>
+#include <boost/atomic.hpp>
+#include <ros/console.h>
+#include "ublox_gps/utils.h"
+
+using namespace ublox_node;
+
+//! The SHM segment layout shared by ntpd, chrony & gpsd
+struct ChronyRefclock::ShmTime {
+  int mode;
+  volatile int count;
+  time_t clockTimeStampSec;
+  int clockTimeStampUSec;
+  time_t receiveTimeStampSec;
+  int receiveTimeStampUSec;
+  int leap;
+  int precision;
+  int nsamples;
+  volatile int valid;
+  unsigned clockTimeStampNSec;
+  unsigned receiveTimeStampNSec;
+  int dummy[8];
+};
+
+namespace {
+
+//! The SHM key of unit 0, "NTP0"
+const key_t kShmKeyBase = 0x4e545030;
+//! The maximum distance of an epoch from the whole second to be paired
+//! with a pulse [ns]
+const int32_t kMaxEpochFraction = 1000000;
+
+/**
+ * @brief Get the precision of a sample [log2 s].
+ */
+int precision(double seconds) {
+  return static_cast<int>(std::ceil(std::log2(std::max(seconds, 1e-9))));
+}
+
+/**
+ * @brief Get a - b [s].
+ */
+double difference(const struct timespec& a, const struct timespec& b) {
+  return (a.tv_sec - b.tv_sec) + (a.tv_nsec - b.tv_nsec) * 1e-9;
+}
+
+/**
+ * @brief Add nanoseconds to a time.
+ */
+struct timespec add(struct timespec t, int64_t nsec) {
+  nsec += t.tv_nsec;
+  t.tv_sec += nsec / 1000000000;
+  t.tv_nsec = nsec % 1000000000;
+  if (t.tv_nsec < 0) {
+    t.tv_sec -= 1;
+    t.tv_nsec += 1000000000;
+  }
+  return t;
+}
+
+/**
+ * @brief Convert a UTC boost time to a timespec.
+ */
+struct timespec toTimespec(const boost::posix_time::ptime& time) {
+  static const boost::posix_time::ptime epoch(
+      boost::gregorian::date(1970, 1, 1));
+  struct timespec t = {0, 0};
+  return add(t, (time - epoch).total_microseconds() * 1000);
+}
+
+}  // namespace
+
+ChronyRefclock::ChronyRefclock(int unit, const std::string& pps_device,
+                               uint32_t max_time_acc, uint32_t max_freq_acc)
+    : unit_(unit), pps_device_(pps_device), max_time_acc_(max_time_acc),
+      max_freq_acc_(max_freq_acc), shm_(NULL), pps_shm_(NULL), pps_fd_(-1),
+      pps_sequence_(0), clock_valid_(false) {
+  for (int i = 0; i < 2; ++i) {
+    time_pulses_[i].valid = false;
+    time_pulses_[i].qerr = 0;
+    time_pulses_[i].arrival.tv_sec = 0;
+    time_pulses_[i].arrival.tv_nsec = 0;
+  }
+  statistics_.samples = 0;
+  statistics_.pps_samples = 0;
+  statistics_.rejected = 0;
+  statistics_.last_offset = 0;
+  statistics_.clock_drift = 0;
+  statistics_.time_acc = 0;
+  statistics_.freq_acc = 0;
+  statistics_.last_qerr = 0;
+}
+
+ChronyRefclock::~ChronyRefclock() {
+  if (shm_)
+    shmdt(const_cast<ShmTime*>(shm_));
+  if (pps_shm_)
+    shmdt(const_cast<ShmTime*>(pps_shm_));
+  if (pps_fd_ >= 0)
+    close(pps_fd_);
+}
+
+bool ChronyRefclock::open() {
+  shm_ = attach(unit_);
+  if (!shm_)
+    return false;
+  if (pps_device_.empty())
+    return true;
+
+  pps_fd_ = ::open(pps_device_.c_str(), O_RDWR);
+  if (pps_fd_ < 0) {
+    ROS_ERROR("Chrony refclock: could not open %s: %s", pps_device_.c_str(),
+              strerror(errno));
+    return false;
+  }
+  // Capture the assert events, the driver may not do it by default
+  struct pps_kparams params;
+  memset(&params, 0, sizeof(params));
+  if (ioctl(pps_fd_, PPS_GETPARAMS, &params) == 0
+      && !(params.mode & PPS_CAPTUREASSERT)) {
+    params.mode |= PPS_CAPTUREASSERT;
+    if (ioctl(pps_fd_, PPS_SETPARAMS, &params) < 0)
+      ROS_WARN("Chrony refclock: could not capture the assert events of %s",
+               pps_device_.c_str());
+  }
+  pps_shm_ = attach(unit_ + 1);
+  return pps_shm_ != NULL;
+}
+
+volatile ChronyRefclock::ShmTime* ChronyRefclock::attach(int unit) {
+  // chrony only allows root to write the segments of the units 0 & 1
+  const int perms = unit < 2 ? 0600 : 0666;
+  const int id = shmget(kShmKeyBase + unit, sizeof(ShmTime),
+                        IPC_CREAT | perms);
+  if (id < 0) {
+    ROS_ERROR("Chrony refclock: could not get the SHM segment of unit %d: %s",
+              unit, strerror(errno));
+    return NULL;
+  }
+  void* segment = shmat(id, NULL, 0);
+  if (segment == reinterpret_cast<void*>(-1)) {
+    ROS_ERROR("Chrony refclock: could not attach the SHM segment of unit %d: "
+              "%s", unit, strerror(errno));
+    return NULL;
+  }
+  return static_cast<volatile ShmTime*>(segment);
+}
+
+void ChronyRefclock::write(volatile ShmTime* shm,
+                           const struct timespec& clock,
+                           const struct timespec& receive, int precision) {
+  // The reader discards the sample if the count changes while it reads
+  shm->mode = 1;
+  shm->valid = 0;
+  shm->count = shm->count + 1;
+  boost::atomic_thread_fence(boost::memory_order_seq_cst);
+  shm->clockTimeStampSec = clock.tv_sec;
+  shm->clockTimeStampUSec = clock.tv_nsec / 1000;
+  shm->clockTimeStampNSec = clock.tv_nsec;
+  shm->receiveTimeStampSec = receive.tv_sec;
+  shm->receiveTimeStampUSec = receive.tv_nsec / 1000;
+  shm->receiveTimeStampNSec = receive.tv_nsec;
+  shm->leap = 0;
+  shm->precision = precision;
+  shm->nsamples = 3;
+  boost::atomic_thread_fence(boost::memory_order_seq_cst);
+  shm->count = shm->count + 1;
+  shm->valid = 1;
+}
+
+void ChronyRefclock::addTimeUtc(const ublox_msgs::NavTIMEUTC& m,
+                                const boost::posix_time::ptime& arrival) {
+  static const uint8_t kValid = ublox_msgs::NavTIMEUTC::VALID_TOW
+      | ublox_msgs::NavTIMEUTC::VALID_WKN | ublox_msgs::NavTIMEUTC::VALID_UTC;
+
+  boost::mutex::scoped_lock lock(mutex_);
+  const uint32_t time_acc = std::max(m.tAcc, clock_valid_ ?
+                                     statistics_.time_acc : 0);
+  const bool accurate = time_acc <= max_time_acc_
+      && (max_freq_acc_ == 0 || !clock_valid_
+          || statistics_.freq_acc <= max_freq_acc_);
+  // Leap seconds are not representable as time_t, skip them
+  if ((m.valid & kValid) != kValid || !accurate || m.sec > 59 || !shm_
+      || arrival.is_not_a_date_time()) {
+    statistics_.rejected++;
+    return;
+  }
+
+  struct timespec clock = {static_cast<time_t>(toUtcSeconds(m)), 0};
+  clock = add(clock, m.nano);
+  const struct timespec receive = toTimespec(arrival);
+  // The arrival is timestamped in microseconds
+  write(shm_, clock, receive, precision(std::max(time_acc * 1e-9, 1e-6)));
+  statistics_.samples++;
+  statistics_.last_offset = difference(receive, clock);
+
+  // Pair the pulse of the whole second with the epoch of the second
+  if (!pps_shm_ || (clock.tv_nsec > kMaxEpochFraction
+                    && clock.tv_nsec < 1000000000 - kMaxEpochFraction))
+    return;
+  const time_t second = clock.tv_sec + (clock.tv_nsec > 500000000 ? 1 : 0);
+  writePps(second, receive, precision(time_acc * 1e-9));
+}
+
+void ChronyRefclock::writePps(time_t second, const struct timespec& arrival,
+                              int precision) {
+  struct pps_fdata fdata;
+  memset(&fdata, 0, sizeof(fdata));
+  // A zero timeout returns the last event without waiting
+  if (ioctl(pps_fd_, PPS_FETCH, &fdata) < 0
+      || fdata.info.assert_sequence == pps_sequence_)
+    return;
+  pps_sequence_ = fdata.info.assert_sequence;
+
+  struct timespec assert = {
+      static_cast<time_t>(fdata.info.assert_tu.sec),
+      static_cast<long>(fdata.info.assert_tu.nsec)};
+  // The pulse of the second precedes the message of its epoch
+  const double age = difference(arrival, assert);
+  if (age < 0 || age >= 1.0)
+    return;
+
+  // The TIM-TP message precedes the pulse it describes. The pulse is output
+  // qErr after the whole second.
+  int32_t qerr = 0;
+  for (int i = 0; i < 2; ++i) {
+    const double tp_age = difference(assert, time_pulses_[i].arrival);
+    if (tp_age > 0) {
+      if (time_pulses_[i].valid && tp_age < 1.0)
+        qerr = time_pulses_[i].qerr;
+      break;
+    }
+  }
+  struct timespec clock = {second, 0};
+  write(pps_shm_, clock, add(assert, -static_cast<int64_t>(qerr) / 1000),
+        precision);
+  statistics_.pps_samples++;
+  statistics_.last_qerr = qerr;
+}
+
+void ChronyRefclock::addClock(const ublox_msgs::NavCLOCK& m) {
+  boost::mutex::scoped_lock lock(mutex_);
+  clock_valid_ = true;
+  statistics_.clock_drift = m.clkD;
+  statistics_.time_acc = m.tAcc;
+  statistics_.freq_acc = m.fAcc;
+}
+
+void ChronyRefclock::addTimePulse(const ublox_msgs::TimTP& m,
+                                  const boost::posix_time::ptime& arrival) {
+  boost::mutex::scoped_lock lock(mutex_);
+  if (arrival.is_not_a_date_time())
+    return;
+  time_pulses_[1] = time_pulses_[0];
+  time_pulses_[0].valid = !(m.flags & ublox_msgs::TimTP::FLAGS_QERR_INVALID);
+  time_pulses_[0].qerr = m.qErr;
+  time_pulses_[0].arrival = toTimespec(arrival);
+}
+
+ChronyRefclock::Statistics ChronyRefclock::statistics() const {
+  boost::mutex::scoped_lock lock(mutex_);
+  return statistics_;
+}
@@ -0,0 +1,112 @@
+//==============================================================================
+// Copyright (c) 2012, Johannes Meyer, TU Darmstadt
+// All rights reserved.
+
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//     * Neither the name of the Flight Systems and Automatic Control group,
+//       TU Darmstadt, nor the names of its contributors may be used to
+//       endorse or promote products derived from this software without
+//       specific prior written permission.
+
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" 
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE 
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE 
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER BE LIABLE FOR ANY
+// DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+// (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+// LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+// ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+// SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//==============================================================================
+
+#include "ublox_gps/config_monitor.h"
+
+using namespace ublox_node;
+
+ConfigMonitor::ConfigMonitor(const ublox_gps::ConfigShadow& shadow)
+    : shadow_(shadow), answered_(true), uptime_valid_(false), uptime_(0),
+      reset_(false), blocks_(0), last_match_(ros::Time::now()) {
+  statistics_.checks = 0;
+  statistics_.unanswered = 0;
+  statistics_.resets = 0;
+  statistics_.drifts = 0;
+  statistics_.recoveries = 0;
+  statistics_.failed_recoveries = 0;
+  statistics_.last_detection = 0;
+  statistics_.last_recovery = 0;
+}
+
+uint32_t ConfigMonitor::startRound() {
+  const ros::Time now = ros::Time::now();
+  boost::mutex::scoped_lock lock(mutex_);
+  if (!answered_)
+    ++statistics_.unanswered;
+  answered_ = false;
+  if (!reset_ && blocks_ == 0)
+    last_match_ = now;
+  ++statistics_.checks;
+  return shadow_.blocks();
+}
+
+void ConfigMonitor::checkStatus(const ublox_msgs::NavSTATUS& m) {
+  const ros::Time now = ros::Time::now();
+  boost::mutex::scoped_lock lock(mutex_);
+  answered_ = true;
+  // The uptime wraps after 49.7 days, ignore the wrap
+  const bool wrapped = uptime_ > 0xf0000000 && m.msss < 0x10000000;
+  if (uptime_valid_ && m.msss < uptime_ && !wrapped && !reset_) {
+    reset_ = true;
+    ++statistics_.resets;
+    // The uptime is the time since the reset
+    statistics_.last_detection = m.msss * 1e-3;
+    if (blocks_ == 0)
+      detected_ = now;
+  }
+  uptime_ = m.msss;
+  uptime_valid_ = true;
+}
+
+void ConfigMonitor::detect(uint32_t block) {
+  const ros::Time now = ros::Time::now();
+  boost::mutex::scoped_lock lock(mutex_);
+  if (blocks_ & block)
+    return;
+  if (!reset_ && blocks_ == 0) {
+    detected_ = now;
+    statistics_.last_detection = (now - last_match_).toSec();
+  }
+  blocks_ |= block;
+  ++statistics_.drifts;
+}
+
+bool ConfigMonitor::pending(bool& reset, uint32_t& blocks) const {
+  boost::mutex::scoped_lock lock(mutex_);
+  reset = reset_;
+  blocks = blocks_;
+  return reset_ || blocks_ != 0;
+}
+
+void ConfigMonitor::recovered(bool success) {
+  const ros::Time now = ros::Time::now();
+  boost::mutex::scoped_lock lock(mutex_);
+  if (!success) {
+    ++statistics_.failed_recoveries;
+    return;
+  }
+  ++statistics_.recoveries;
+  statistics_.last_recovery = (now - detected_).toSec();
+  reset_ = false;
+  blocks_ = 0;
+}
+
+ConfigMonitor::Statistics ConfigMonitor::statistics() const {
+  boost::mutex::scoped_lock lock(mutex_);
+  return statistics_;
+}
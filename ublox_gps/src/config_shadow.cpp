@@ -0,0 +1,139 @@
+//==============================================================================
+// Copyright (c) 2012, Johannes Meyer, TU Darmstadt
+// All rights reserved.
+
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//     * Neither the name of the Flight Systems and Automatic Control group,
+//       TU Darmstadt, nor the names of its contributors may be used to
+//       endorse or promote products derived from this software without
+//       specific prior written permission.
+
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" 
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE 
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE 
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER BE LIABLE FOR ANY
+// DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+// (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+// LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+// ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+// SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//==============================================================================
+
+#include "ublox_gps/config_shadow.h"
+
+using namespace ublox_gps;
+
+void ConfigShadow::applied(const ublox_msgs::CfgRATE& message) {
+  boost::mutex::scoped_lock lock(mutex_);
+  rate_ = message;
+  blocks_ |= BLOCK_RATE;
+}
+
+void ConfigShadow::applied(const ublox_msgs::CfgNAV5& message) {
+  typedef ublox_msgs::CfgNAV5 CfgNAV5;
+  boost::mutex::scoped_lock lock(mutex_);
+  // Only the masked settings are applied by the device
+  if (message.mask & CfgNAV5::MASK_DYN)
+    nav5_.dynModel = message.dynModel;
+  if (message.mask & CfgNAV5::MASK_MIN_EL)
+    nav5_.minElev = message.minElev;
+  if (message.mask & CfgNAV5::MASK_FIX_MODE)
+    nav5_.fixMode = message.fixMode;
+  if (message.mask & CfgNAV5::MASK_DR_LIM)
+    nav5_.drLimit = message.drLimit;
+  if (message.mask & CfgNAV5::MASK_DGPS_MASK)
+    nav5_.dgnssTimeOut = message.dgnssTimeOut;
+  nav5_.mask |= message.mask & (CfgNAV5::MASK_DYN | CfgNAV5::MASK_MIN_EL
+                                | CfgNAV5::MASK_FIX_MODE | CfgNAV5::MASK_DR_LIM
+                                | CfgNAV5::MASK_DGPS_MASK);
+  if (nav5_.mask != 0)
+    blocks_ |= BLOCK_NAV5;
+}
+
+void ConfigShadow::applied(const ublox_msgs::CfgTMODE3& message) {
+  boost::mutex::scoped_lock lock(mutex_);
+  tmode3_ = message;
+  blocks_ |= BLOCK_TMODE3;
+}
+
+void ConfigShadow::applied(const ublox_msgs::CfgMSG& message) {
+  boost::mutex::scoped_lock lock(mutex_);
+  message_rates_[message.msgClass << 8 | message.msgID] = message.rate;
+}
+
+uint32_t ConfigShadow::blocks() const {
+  boost::mutex::scoped_lock lock(mutex_);
+  return blocks_;
+}
+
+bool ConfigShadow::matches(const ublox_msgs::CfgRATE& message) const {
+  boost::mutex::scoped_lock lock(mutex_);
+  return !(blocks_ & BLOCK_RATE)
+      || (message.measRate == rate_.measRate
+          && message.navRate == rate_.navRate
+          && message.timeRef == rate_.timeRef);
+}
+
+bool ConfigShadow::matches(const ublox_msgs::CfgNAV5& message) const {
+  typedef ublox_msgs::CfgNAV5 CfgNAV5;
+  boost::mutex::scoped_lock lock(mutex_);
+  const uint16_t mask = nav5_.mask;
+  return (!(mask & CfgNAV5::MASK_DYN) || message.dynModel == nav5_.dynModel)
+      && (!(mask & CfgNAV5::MASK_MIN_EL) || message.minElev == nav5_.minElev)
+      && (!(mask & CfgNAV5::MASK_FIX_MODE)
+          || message.fixMode == nav5_.fixMode)
+      && (!(mask & CfgNAV5::MASK_DR_LIM) || message.drLimit == nav5_.drLimit)
+      && (!(mask & CfgNAV5::MASK_DGPS_MASK)
+          || message.dgnssTimeOut == nav5_.dgnssTimeOut);
+}
+
+bool ConfigShadow::matches(const ublox_msgs::CfgTMODE3& message) const {
+  typedef ublox_msgs::CfgTMODE3 CfgTMODE3;
+  boost::mutex::scoped_lock lock(mutex_);
+  if (!(blocks_ & BLOCK_TMODE3))
+    return true;
+  if (message.flags != tmode3_.flags)
+    return false;
+  switch (tmode3_.flags & CfgTMODE3::FLAGS_MODE_MASK) {
+    case CfgTMODE3::FLAGS_MODE_FIXED:
+      return message.ecefXOrLat == tmode3_.ecefXOrLat
+          && message.ecefYOrLon == tmode3_.ecefYOrLon
+          && message.ecefZOrAlt == tmode3_.ecefZOrAlt
+          && message.ecefXOrLatHP == tmode3_.ecefXOrLatHP
+          && message.ecefYOrLonHP == tmode3_.ecefYOrLonHP
+          && message.ecefZOrAltHP == tmode3_.ecefZOrAltHP
+          && message.fixedPosAcc == tmode3_.fixedPosAcc;
+    case CfgTMODE3::FLAGS_MODE_SURVEY_IN:
+      return message.svinMinDur == tmode3_.svinMinDur
+          && message.svinAccLimit == tmode3_.svinAccLimit;
+    default:
+      return true;
+  }
+}
+
+ublox_msgs::CfgRATE ConfigShadow::rate() const {
+  boost::mutex::scoped_lock lock(mutex_);
+  return rate_;
+}
+
+ublox_msgs::CfgNAV5 ConfigShadow::nav5() const {
+  boost::mutex::scoped_lock lock(mutex_);
+  return nav5_;
+}
+
+ublox_msgs::CfgTMODE3 ConfigShadow::tmode3() const {
+  boost::mutex::scoped_lock lock(mutex_);
+  return tmode3_;
+}
+
+std::map<uint16_t, uint8_t> ConfigShadow::messageRates() const {
+  boost::mutex::scoped_lock lock(mutex_);
+  return message_rates_;
+}
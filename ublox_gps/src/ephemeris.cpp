@@ -0,0 +1,487 @@
+//==============================================================================
+// Copyright (c) 2012, Johannes Meyer, TU Darmstadt
+// All rights reserved.
+
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//     * Neither the name of the Flight Systems and Automatic Control group,
+//       TU Darmstadt, nor the names of its contributors may be used to
+//       endorse or promote products derived from this software without
+//       specific prior written permission.
+
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" 
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE 
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE 
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER BE LIABLE FOR ANY
+// DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+// (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+// LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+// ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+// SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//==============================================================================
+
+#include "ublox_gps/ephemeris.h"
+#include <algorithm>
+#include <cmath>
+#include <boost/date_time/posix_time/posix_time.hpp>
+
+using namespace ublox_node;
+
+namespace {
+
+//! Number of GNSS identifiers
+const std::size_t kNumGnss = 8;
+//! Number of satellite identifiers per GNSS
+const std::size_t kNumSv = 256;
+//! Half a week [s]
+const double kHalfWeek = 302400;
+//! Pi as defined in the GPS ICD
+const double kGpsPi = 3.1415926535898;
+//! Speed of light [m/s]
+const double kSpeedOfLight = 299792458.0;
+//! Number of Kepler equation iterations, enough for e < 0.1
+const int kKeplerIterations = 8;
+//! Inclination of the BeiDou GEO reference frame [rad]
+const double kBeidouGeoInclination = -5.0 * M_PI / 180;
+//! Typical signal travel time of the MEO satellites [s]
+const double kNominalTravelTime = 0.075;
+//! Earth rotation rate of WGS 84 [rad/s]
+const double kEarthRotation = 7.2921151467e-5;
+//! Maximum time from the ephemeris reference time to use it [s]
+const double kMaxEphemerisAge = 4 * 3600;
+//! Minimum number of satellites to estimate the receiver clock bias
+const std::size_t kMinCheckSatellites = 4;
+
+/**
+ * @brief Get the bits of a subframe data word.
+ * @param sf the data words 3 to 10 of the subframe
+ * @param word the word number as in the ICD, 3 to 10
+ * @param first the first bit, 1 is the MSB as in the ICD
+ * @param length the number of bits
+ */
+uint32_t bits(const std::vector<uint32_t>& sf, int word, int first,
+              int length) {
+  return (sf[word - 3] >> (25 - first - length)) & ((1u << length) - 1);
+}
+
+/**
+ * @brief Get a 32-bit field which starts with the last 8 bits of a word.
+ */
+uint32_t bits32(const std::vector<uint32_t>& sf, int word) {
+  return bits(sf, word, 17, 8) << 24 | bits(sf, word + 1, 1, 24);
+}
+
+/**
+ * @brief Sign extend a two's complement value.
+ */
+int32_t signed_(uint32_t value, int length) {
+  if (length < 32 && (value & (1u << (length - 1))))
+    value |= ~((1u << length) - 1);
+  return static_cast<int32_t>(value);
+}
+
+/**
+ * @brief Wrap a time difference to +/- half a week.
+ */
+double wrapWeek(double t) {
+  if (t > kHalfWeek)
+    return t - 2 * kHalfWeek;
+  if (t < -kHalfWeek)
+    return t + 2 * kHalfWeek;
+  return t;
+}
+
+}  // namespace
+
+bool ublox_node::decodeGpsEphemeris(uint8_t sv_id,
+                                    const std::vector<uint32_t>& sf1d,
+                                    const std::vector<uint32_t>& sf2d,
+                                    const std::vector<uint32_t>& sf3d,
+                                    Ephemeris& eph) {
+  if (sf1d.size() < 8 || sf2d.size() < 8 || sf3d.size() < 8)
+    return false;
+  // The IODE of subframes 2 & 3 and the 8 LSBs of the IODC must match
+  const uint32_t iode = bits(sf2d, 3, 1, 8);
+  if (bits(sf3d, 10, 1, 8) != iode || bits(sf1d, 8, 1, 8) != iode)
+    return false;
+
+  eph.gnss_id = 0;
+  eph.sv_id = sv_id;
+  eph.iode = iode;
+  // Subframe 1
+  eph.week = bits(sf1d, 3, 1, 10);
+  eph.tgd = signed_(bits(sf1d, 7, 17, 8), 8) * std::pow(2.0, -31);
+  eph.toc = bits(sf1d, 8, 9, 16) * 16.0;
+  eph.af2 = signed_(bits(sf1d, 9, 1, 8), 8) * std::pow(2.0, -55);
+  eph.af1 = signed_(bits(sf1d, 9, 9, 16), 16) * std::pow(2.0, -43);
+  eph.af0 = signed_(bits(sf1d, 10, 1, 22), 22) * std::pow(2.0, -31);
+  // Subframe 2
+  eph.crs = signed_(bits(sf2d, 3, 9, 16), 16) * std::pow(2.0, -5);
+  eph.delta_n = signed_(bits(sf2d, 4, 1, 16), 16) * std::pow(2.0, -43)
+      * kGpsPi;
+  eph.m0 = signed_(bits32(sf2d, 4), 32) * std::pow(2.0, -31) * kGpsPi;
+  eph.cuc = signed_(bits(sf2d, 6, 1, 16), 16) * std::pow(2.0, -29);
+  eph.e = bits32(sf2d, 6) * std::pow(2.0, -33);
+  eph.cus = signed_(bits(sf2d, 8, 1, 16), 16) * std::pow(2.0, -29);
+  eph.sqrt_a = bits32(sf2d, 8) * std::pow(2.0, -19);
+  eph.toe = bits(sf2d, 10, 1, 16) * 16.0;
+  // Subframe 3
+  eph.cic = signed_(bits(sf3d, 3, 1, 16), 16) * std::pow(2.0, -29);
+  eph.omega0 = signed_(bits32(sf3d, 3), 32) * std::pow(2.0, -31) * kGpsPi;
+  eph.cis = signed_(bits(sf3d, 5, 1, 16), 16) * std::pow(2.0, -29);
+  eph.i0 = signed_(bits32(sf3d, 5), 32) * std::pow(2.0, -31) * kGpsPi;
+  eph.crc = signed_(bits(sf3d, 7, 1, 16), 16) * std::pow(2.0, -5);
+  eph.omega = signed_(bits32(sf3d, 7), 32) * std::pow(2.0, -31) * kGpsPi;
+  eph.omega_dot = signed_(bits(sf3d, 9, 1, 24), 24) * std::pow(2.0, -43)
+      * kGpsPi;
+  eph.idot = signed_(bits(sf3d, 10, 9, 14), 14) * std::pow(2.0, -43)
+      * kGpsPi;
+  return true;
+}
+
+void EphemerisEngine::States::resize(std::size_t size) {
+  gnss_id.resize(size);
+  sv_id.resize(size);
+  x.resize(size);
+  y.resize(size);
+  z.resize(size);
+  vx.resize(size);
+  vy.resize(size);
+  vz.resize(size);
+  clock_bias.resize(size);
+  clock_drift.resize(size);
+  age.resize(size);
+}
+
+EphemerisEngine::EphemerisEngine() : index_(kNumGnss * kNumSv, -1) {
+  statistics_.satellites = 0;
+  statistics_.updates = 0;
+  statistics_.epochs = 0;
+  statistics_.evaluated = 0;
+  statistics_.time = 0;
+  statistics_.checks = 0;
+}
+
+bool EphemerisEngine::update(const Ephemeris& eph) {
+  double gm, omega_e, time_offset;
+  switch (eph.gnss_id) {
+    case 0:  // GPS
+    case 5:  // QZSS
+      gm = 3.986005e14;
+      omega_e = 7.2921151467e-5;
+      time_offset = 0;
+      break;
+    case 2:  // Galileo
+      gm = 3.986004418e14;
+      omega_e = 7.2921151467e-5;
+      time_offset = 0;
+      break;
+    case 3:  // BeiDou
+      gm = 3.986004418e14;
+      omega_e = 7.292115e-5;
+      time_offset = -14;
+      break;
+    default:
+      return false;
+  }
+
+  boost::mutex::scoped_lock lock(mutex_);
+  int16_t& i = index_[eph.gnss_id * kNumSv + eph.sv_id];
+  if (i >= 0 && iode_[i] == eph.iode && toe_[i] == eph.toe)
+    return false;
+  if (i < 0) {
+    i = gnss_id_.size();
+    const std::size_t size = i + 1;
+    gnss_id_.resize(size);
+    sv_id_.resize(size);
+    iode_.resize(size);
+    gm_.resize(size);
+    omega_e_.resize(size);
+    time_offset_.resize(size);
+    geo_.resize(size);
+    toe_.resize(size);
+    toc_.resize(size);
+    sqrt_a_.resize(size);
+    e_.resize(size);
+    i0_.resize(size);
+    omega0_.resize(size);
+    omega_.resize(size);
+    m0_.resize(size);
+    delta_n_.resize(size);
+    idot_.resize(size);
+    omega_dot_.resize(size);
+    cuc_.resize(size);
+    cus_.resize(size);
+    crc_.resize(size);
+    crs_.resize(size);
+    cic_.resize(size);
+    cis_.resize(size);
+    af0_.resize(size);
+    af1_.resize(size);
+    af2_.resize(size);
+    tgd_.resize(size);
+    statistics_.satellites = size;
+  }
+  gnss_id_[i] = eph.gnss_id;
+  sv_id_[i] = eph.sv_id;
+  iode_[i] = eph.iode;
+  gm_[i] = gm;
+  omega_e_[i] = omega_e;
+  time_offset_[i] = time_offset;
+  // BeiDou GEO satellites: C01-C05 & C59-C63
+  geo_[i] = eph.gnss_id == 3 && (eph.sv_id <= 5 || eph.sv_id >= 59);
+  toe_[i] = eph.toe;
+  toc_[i] = eph.toc;
+  sqrt_a_[i] = eph.sqrt_a;
+  e_[i] = eph.e;
+  i0_[i] = eph.i0;
+  omega0_[i] = eph.omega0;
+  omega_[i] = eph.omega;
+  m0_[i] = eph.m0;
+  delta_n_[i] = eph.delta_n;
+  idot_[i] = eph.idot;
+  omega_dot_[i] = eph.omega_dot;
+  cuc_[i] = eph.cuc;
+  cus_[i] = eph.cus;
+  crc_[i] = eph.crc;
+  crs_[i] = eph.crs;
+  cic_[i] = eph.cic;
+  cis_[i] = eph.cis;
+  af0_[i] = eph.af0;
+  af1_[i] = eph.af1;
+  af2_[i] = eph.af2;
+  tgd_[i] = eph.tgd;
+  ++statistics_.updates;
+  return true;
+}
+
+template <typename EphT>
+void EphemerisEngine::updateGps(const EphT& m) {
+  // how is 0 if there is no ephemeris
+  if (m.how == 0 || m.svid < 1 || m.svid > 32)
+    return;
+  Ephemeris eph;
+  if (decodeGpsEphemeris(m.svid, m.sf1d, m.sf2d, m.sf3d, eph))
+    update(eph);
+}
+
+void EphemerisEngine::update(const ublox_msgs::RxmEPH& m) {
+  updateGps(m);
+}
+
+void EphemerisEngine::update(const ublox_msgs::AidEPH& m) {
+  updateGps(m);
+}
+
+void EphemerisEngine::evaluate(double tow, States& states) {
+  boost::mutex::scoped_lock lock(mutex_);
+  const boost::posix_time::ptime start =
+      boost::posix_time::microsec_clock::universal_time();
+  const std::size_t n = gnss_id_.size();
+  states.resize(n);
+  states.gnss_id = gnss_id_;
+  states.sv_id = sv_id_;
+  const double cos_geo = std::cos(kBeidouGeoInclination);
+  const double sin_geo = std::sin(kBeidouGeoInclination);
+  for (std::size_t i = 0; i < n; ++i) {
+    const double t = tow + time_offset_[i];
+    const double tk = wrapWeek(t - toe_[i]);
+    const double a = sqrt_a_[i] * sqrt_a_[i];
+    const double e = e_[i];
+    const double mean_motion = std::sqrt(gm_[i] / (a * a * a)) + delta_n_[i];
+
+    // Eccentric anomaly, fixed number of iterations
+    const double m = m0_[i] + mean_motion * tk;
+    double ek = m;
+    for (int k = 0; k < kKeplerIterations; ++k)
+      ek = m + e * std::sin(ek);
+    const double sin_e = std::sin(ek);
+    const double cos_e = std::cos(ek);
+    const double one_e_cos = 1 - e * cos_e;
+    const double ek_dot = mean_motion / one_e_cos;
+    const double sqrt_1_e2 = std::sqrt(1 - e * e);
+
+    // True anomaly & argument of latitude
+    const double v = std::atan2(sqrt_1_e2 * sin_e, cos_e - e);
+    const double v_dot = ek_dot * sqrt_1_e2 / one_e_cos;
+    const double phi = v + omega_[i];
+    const double sin_2phi = std::sin(2 * phi);
+    const double cos_2phi = std::cos(2 * phi);
+
+    // Corrected argument of latitude, radius & inclination
+    const double u = phi + cus_[i] * sin_2phi + cuc_[i] * cos_2phi;
+    const double r = a * one_e_cos + crs_[i] * sin_2phi + crc_[i] * cos_2phi;
+    const double inc = i0_[i] + idot_[i] * tk + cis_[i] * sin_2phi
+        + cic_[i] * cos_2phi;
+    const double u_dot = v_dot * (1 + 2 * (cus_[i] * cos_2phi
+                                           - cuc_[i] * sin_2phi));
+    const double r_dot = a * e * sin_e * ek_dot
+        + 2 * v_dot * (crs_[i] * cos_2phi - crc_[i] * sin_2phi);
+    const double inc_dot = idot_[i]
+        + 2 * v_dot * (cis_[i] * cos_2phi - cic_[i] * sin_2phi);
+
+    // Position & velocity in the orbital plane
+    const double sin_u = std::sin(u);
+    const double cos_u = std::cos(u);
+    const double xp = r * cos_u;
+    const double yp = r * sin_u;
+    const double xp_dot = r_dot * cos_u - r * u_dot * sin_u;
+    const double yp_dot = r_dot * sin_u + r * u_dot * cos_u;
+
+    // Longitude of the ascending node, GEO satellites are computed in an
+    // inertial frame and rotated to ECEF below
+    const double we = omega_e_[i];
+    const double geo = geo_[i];
+    const double node_dot = omega_dot_[i] - (1 - geo) * we;
+    const double node = omega0_[i] + node_dot * tk - we * toe_[i];
+    const double sin_node = std::sin(node);
+    const double cos_node = std::cos(node);
+    const double sin_inc = std::sin(inc);
+    const double cos_inc = std::cos(inc);
+
+    double x = xp * cos_node - yp * cos_inc * sin_node;
+    double y = xp * sin_node + yp * cos_inc * cos_node;
+    double z = yp * sin_inc;
+    double vx = xp_dot * cos_node - yp_dot * cos_inc * sin_node
+        + yp * sin_inc * sin_node * inc_dot - y * node_dot;
+    double vy = xp_dot * sin_node + yp_dot * cos_inc * cos_node
+        - yp * sin_inc * cos_node * inc_dot + x * node_dot;
+    double vz = yp_dot * sin_inc + yp * cos_inc * inc_dot;
+
+    // BeiDou GEO: rotate by -5 deg around X and by we * tk around Z; for
+    // other satellites the rotation is the identity
+    const double cos_x = geo * cos_geo + (1 - geo);
+    const double sin_x = geo * sin_geo;
+    const double y1 = cos_x * y + sin_x * z;
+    const double z1 = -sin_x * y + cos_x * z;
+    const double vy1 = cos_x * vy + sin_x * vz;
+    const double vz1 = -sin_x * vy + cos_x * vz;
+    const double cos_z = std::cos(geo * we * tk);
+    const double sin_z = std::sin(geo * we * tk);
+    states.x[i] = cos_z * x + sin_z * y1;
+    states.y[i] = -sin_z * x + cos_z * y1;
+    states.z[i] = z1;
+    states.vx[i] = cos_z * vx + sin_z * vy1 + geo * we * states.y[i];
+    states.vy[i] = -sin_z * vx + cos_z * vy1 - geo * we * states.x[i];
+    states.vz[i] = vz1;
+
+    // Clock correction incl. relativistic correction
+    const double tc = wrapWeek(t - toc_[i]);
+    const double f = -2 * std::sqrt(gm_[i]) / (kSpeedOfLight * kSpeedOfLight);
+    states.clock_bias[i] = af0_[i] + af1_[i] * tc + af2_[i] * tc * tc
+        + f * e * sqrt_a_[i] * sin_e - tgd_[i];
+    states.clock_drift[i] = af1_[i] + 2 * af2_[i] * tc
+        + f * e * sqrt_a_[i] * cos_e * ek_dot;
+    states.age[i] = tk;
+  }
+  ++statistics_.epochs;
+  statistics_.evaluated += n;
+  statistics_.time += (boost::posix_time::microsec_clock::universal_time()
+                       - start).total_microseconds() * 1e-6;
+}
+
+void EphemerisEngine::check(const ublox_msgs::RxmRAWX& m,
+                            const double receiver[3], double min_elevation,
+                            std::vector<Residual>& residuals) {
+  // Evaluate all satellites together, then move each satellite to its own
+  // transmission time, within milliseconds of the evaluation time
+  const double t0 = m.rcvTOW - kNominalTravelTime;
+  evaluate(t0, states_);
+  residuals.clear();
+  {
+    boost::mutex::scoped_lock lock(mutex_);
+    for (std::size_t k = 0; k < m.meas.size(); ++k) {
+      const ublox_msgs::RxmRAWX_Meas& meas = m.meas[k];
+      if (!(meas.trkStat & meas.TRK_STAT_PR_VALID) || meas.gnssId >= kNumGnss)
+        continue;
+      const int16_t i = index_[meas.gnssId * kNumSv + meas.svId];
+      if (i < 0 || static_cast<std::size_t>(i) >= states_.x.size()
+          || std::fabs(states_.age[i]) > kMaxEphemerisAge)
+        continue;
+      const double travel = meas.prMes / kSpeedOfLight;
+      const double dt = m.rcvTOW - travel - t0;
+      const double x = states_.x[i] + states_.vx[i] * dt;
+      const double y = states_.y[i] + states_.vy[i] * dt;
+      const double z = states_.z[i] + states_.vz[i] * dt;
+      const double clock = states_.clock_bias[i] + states_.clock_drift[i] * dt;
+      // The ECEF frame rotates while the signal travels
+      const double theta = kEarthRotation * travel;
+      const double xr = x * std::cos(theta) + y * std::sin(theta);
+      const double yr = -x * std::sin(theta) + y * std::cos(theta);
+
+      Residual residual;
+      residual.gnss_id = meas.gnssId;
+      residual.sv_id = meas.svId;
+      elevationAzimuth(receiver, xr, yr, z, residual.elevation,
+                       residual.azimuth);
+      if (residual.elevation < min_elevation)
+        continue;
+      const double dx = xr - receiver[0];
+      const double dy = yr - receiver[1];
+      const double dz = z - receiver[2];
+      residual.residual = meas.prMes - std::sqrt(dx * dx + dy * dy + dz * dz)
+          + kSpeedOfLight * clock;
+      residuals.push_back(residual);
+    }
+  }
+  // The receiver clock bias is common to all satellites
+  if (residuals.size() < kMinCheckSatellites) {
+    residuals.clear();
+  } else {
+    std::vector<double> values(residuals.size());
+    for (std::size_t k = 0; k < residuals.size(); ++k)
+      values[k] = residuals[k].residual;
+    std::nth_element(values.begin(), values.begin() + values.size() / 2,
+                     values.end());
+    const double median = values[values.size() / 2];
+    for (std::size_t k = 0; k < residuals.size(); ++k)
+      residuals[k].residual -= median;
+  }
+  boost::mutex::scoped_lock lock(mutex_);
+  ++statistics_.checks;
+  statistics_.residuals = residuals;
+}
+
+EphemerisEngine::Statistics EphemerisEngine::statistics() const {
+  boost::mutex::scoped_lock lock(mutex_);
+  return statistics_;
+}
+
+void EphemerisEngine::elevationAzimuth(const double receiver[3], double x,
+                                       double y, double z, double& elev,
+                                       double& azim) {
+  // Geodetic latitude (WGS 84) & longitude of the receiver
+  const double a = 6378137.0;
+  const double e2 = 6.69437999014e-3;
+  const double lon = std::atan2(receiver[1], receiver[0]);
+  const double p = std::sqrt(receiver[0] * receiver[0]
+                             + receiver[1] * receiver[1]);
+  double lat = std::atan2(receiver[2], p * (1 - e2));
+  for (int k = 0; k < 4; ++k) {
+    const double sin_lat = std::sin(lat);
+    const double n = a / std::sqrt(1 - e2 * sin_lat * sin_lat);
+    lat = std::atan2(receiver[2] + e2 * n * sin_lat, p);
+  }
+  const double dx = x - receiver[0];
+  const double dy = y - receiver[1];
+  const double dz = z - receiver[2];
+  const double sin_lat = std::sin(lat);
+  const double cos_lat = std::cos(lat);
+  const double sin_lon = std::sin(lon);
+  const double cos_lon = std::cos(lon);
+  const double east = -sin_lon * dx + cos_lon * dy;
+  const double north = -sin_lat * cos_lon * dx - sin_lat * sin_lon * dy
+      + cos_lat * dz;
+  const double up = cos_lat * cos_lon * dx + cos_lat * sin_lon * dy
+      + sin_lat * dz;
+  elev = std::atan2(up, std::sqrt(east * east + north * north));
+  azim = std::atan2(east, north);
+  if (azim < 0)
+    azim += 2 * M_PI;
+}
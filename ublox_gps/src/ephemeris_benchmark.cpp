@@ -0,0 +1,116 @@
+//==============================================================================
+// Copyright (c) 2012, Johannes Meyer, TU Darmstadt
+// All rights reserved.
+
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//     * Neither the name of the Flight Systems and Automatic Control group,
+//       TU Darmstadt, nor the names of its contributors may be used to
+//       endorse or promote products derived from this software without
+//       specific prior written permission.
+
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" 
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE 
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE 
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER BE LIABLE FOR ANY
+// DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+// (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+// LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+// ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+// SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//==============================================================================
+
+// Measures the throughput of the ephemeris engine in satellites per second,
+// with a full constellation of synthetic GPS, Galileo, BeiDou & QZSS
+// ephemerides.
+//
+// Usage: ublox_ephemeris_benchmark [epochs]
+
+#include <cmath>
+#include <cstdlib>
+#include <iostream>
+#include <ublox_gps/ephemeris.h>
+
+using ublox_node::Ephemeris;
+using ublox_node::EphemerisEngine;
+
+namespace {
+
+//! Default number of evaluated epochs
+const int kDefaultEpochs = 100000;
+
+/**
+ * @brief Add the satellites of a constellation on evenly spaced orbits.
+ * @param engine the engine
+ * @param gnss_id the GNSS identifier
+ * @param first_sv the first satellite identifier
+ * @param count the number of satellites
+ * @param sqrt_a the square root of the semi-major axis [m^0.5]
+ */
+void addConstellation(EphemerisEngine& engine, uint8_t gnss_id,
+                      uint8_t first_sv, int count, double sqrt_a) {
+  for (int i = 0; i < count; ++i) {
+    Ephemeris eph = Ephemeris();
+    eph.gnss_id = gnss_id;
+    eph.sv_id = first_sv + i;
+    eph.iode = 1;
+    eph.toe = 7200;
+    eph.toc = 7200;
+    eph.sqrt_a = sqrt_a;
+    eph.e = 0.01;
+    eph.i0 = 55.0 * M_PI / 180;
+    eph.omega0 = 2 * M_PI * (i % 6) / 6;
+    eph.omega = 0.5;
+    eph.m0 = 2 * M_PI * i / count;
+    eph.delta_n = 4.5e-9;
+    eph.omega_dot = -8e-9;
+    eph.crs = 20;
+    eph.crc = 200;
+    eph.cuc = 1e-6;
+    eph.cus = 1e-6;
+    eph.cic = 1e-7;
+    eph.cis = 1e-7;
+    eph.af0 = 1e-4;
+    eph.af1 = 1e-11;
+    engine.update(eph);
+  }
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+  const int epochs = argc > 1 ? std::atoi(argv[1]) : kDefaultEpochs;
+  if (epochs <= 0) {
+    std::cerr << "Usage: " << argv[0] << " [epochs]" << std::endl;
+    return 1;
+  }
+
+  EphemerisEngine engine;
+  addConstellation(engine, 0, 1, 32, 5153.6);  // GPS
+  addConstellation(engine, 2, 1, 36, 5440.6);  // Galileo
+  addConstellation(engine, 3, 1, 5, 6493.4);   // BeiDou GEO
+  addConstellation(engine, 3, 6, 41, 5282.6);  // BeiDou IGSO & MEO
+  addConstellation(engine, 5, 1, 7, 6493.4);   // QZSS
+
+  // 10 Hz epochs, the checksum keeps the evaluation from being optimized out
+  EphemerisEngine::States states;
+  double checksum = 0;
+  for (int i = 0; i < epochs; ++i) {
+    engine.evaluate(7200 + i * 0.1, states);
+    checksum += states.x[i % states.x.size()];
+  }
+
+  const EphemerisEngine::Statistics statistics = engine.statistics();
+  std::cout << statistics.satellites << " satellites, " << statistics.epochs
+            << " epochs in " << statistics.time << " s: "
+            << statistics.evaluated / statistics.time << " SVs/s, "
+            << statistics.time / statistics.epochs * 1e6 << " us/epoch"
+            << " (checksum " << checksum << ")" << std::endl;
+  return 0;
+}
@@ -0,0 +1,281 @@
+//==============================================================================
+// Copyright (c) 2012, Johannes Meyer, TU Darmstadt
+// All rights reserved.
+
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//     * Neither the name of the Flight Systems and Automatic Control group,
+//       TU Darmstadt, nor the names of its contributors may be used to
+//       endorse or promote products derived from this software without
+//       specific prior written permission.
+
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" 
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE 
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE 
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER BE LIABLE FOR ANY
+// DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+// (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+// LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+// ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+// SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//==============================================================================
+
+#include "ublox_gps/geotagger.h"
+#include <cmath>
+
+using namespace ublox_node;
+
+namespace {
+
+//! Milliseconds per GPS week
+const double kWeekMs = 604800e3;
+//! WGS-84 semi-major axis [m]
+const double kSemiMajorAxis = 6378137.0;
+//! WGS-84 first eccentricity squared
+const double kEccentricity2 = 6.69437999014e-3;
+const double kDegToRad = M_PI / 180.0;
+
+/**
+ * @brief Wrap an angle difference to [-180, 180) degrees.
+ */
+double wrapAngle(double angle) {
+  return angle - 360.0 * std::floor((angle + 180.0) / 360.0);
+}
+
+/**
+ * @brief Interpolate linearly between a & b.
+ */
+double lerp(double a, double b, double s) {
+  return a + s * (b - a);
+}
+
+}  // namespace
+
+Geotagger::Geotagger(std::size_t capacity, std::size_t max_pending,
+                     double max_gap, bool falling_edge)
+    : max_gap_(max_gap * 1e3), falling_edge_(falling_edge),
+      max_pending_(max_pending), epochs_(capacity), attitudes_(capacity) {
+  statistics_.marks = 0;
+  statistics_.tagged = 0;
+  statistics_.rejected = 0;
+  statistics_.dropped_old = 0;
+  statistics_.dropped_gap = 0;
+  statistics_.dropped_overflow = 0;
+  statistics_.last_interval = 0;
+}
+
+double Geotagger::towDiff(double a, double b) {
+  double diff = a - b;
+  if (diff > kWeekMs / 2)
+    diff -= kWeekMs;
+  else if (diff < -kWeekMs / 2)
+    diff += kWeekMs;
+  return diff;
+}
+
+template <typename T>
+bool Geotagger::bracket(const Ring<T>& ring, double tow, std::size_t& index) {
+  // Marks are usually close to the latest epoch, search from the back
+  for (std::size_t i = ring.size(); i-- > 1; ) {
+    if (towDiff(tow, ring[i - 1].tow) >= 0 && towDiff(ring[i].tow, tow) >= 0) {
+      index = i - 1;
+      return true;
+    }
+  }
+  return false;
+}
+
+void Geotagger::addPvt(const ublox_msgs::NavPVT& m) {
+  if (!(m.flags & ublox_msgs::NavPVT::FLAGS_GNSS_FIX_OK))
+    return;
+  Epoch epoch;
+  epoch.tow = m.iTOW;
+  epoch.lat = m.lat * 1e-7;
+  epoch.lon = m.lon * 1e-7;
+  epoch.height = m.height * 1e-3;
+  epoch.vel[0] = m.velN * 1e-3;
+  epoch.vel[1] = m.velE * 1e-3;
+  epoch.vel[2] = m.velD * 1e-3;
+  epoch.h_acc = m.hAcc * 1e-3;
+  epoch.v_acc = m.vAcc * 1e-3;
+  epoch.s_acc = m.sAcc * 1e-3;
+
+  std::vector<ublox_msgs::Geotag> tagged;
+  boost::mutex::scoped_lock lock(mutex_);
+  // Ignore repeated or out of order epochs
+  if (!epochs_.empty() && towDiff(epoch.tow, epochs_.back().tow) <= 0)
+    return;
+  epochs_.push(epoch);
+  while (!pending_.empty() && tag(pending_.front(), tagged))
+    pending_.pop_front();
+  publish(tagged, lock);
+}
+
+void Geotagger::addAttitude(const ublox_msgs::NavATT& m) {
+  Attitude attitude;
+  attitude.tow = m.iTOW;
+  attitude.angles[0] = m.roll * 1e-5;
+  attitude.angles[1] = m.pitch * 1e-5;
+  attitude.angles[2] = m.heading * 1e-5;
+  attitude.acc[0] = m.accRoll * 1e-5;
+  attitude.acc[1] = m.accPitch * 1e-5;
+  attitude.acc[2] = m.accHeading * 1e-5;
+
+  boost::mutex::scoped_lock lock(mutex_);
+  if (!attitudes_.empty() && towDiff(attitude.tow, attitudes_.back().tow) <= 0)
+    return;
+  attitudes_.push(attitude);
+}
+
+void Geotagger::addMark(const ublox_msgs::TimTM2& m) {
+  const ros::Time now = ros::Time::now();
+  const uint8_t edge = falling_edge_ ? ublox_msgs::TimTM2::FLAGS_NEWFALLINGEDGE
+                                     : ublox_msgs::TimTM2::FLAGS_NEWRISINGEDGE;
+  if (!(m.flags & edge))
+    return;
+
+  std::vector<ublox_msgs::Geotag> tagged;
+  boost::mutex::scoped_lock lock(mutex_);
+  ++statistics_.marks;
+  // The epochs are in GPS time, the mark must be too
+  if (!(m.flags & ublox_msgs::TimTM2::FLAGS_TIME_VALID)
+      || (m.flags & ublox_msgs::TimTM2::FLAGS_TIMEBASE_UTC)) {
+    ++statistics_.rejected;
+    return;
+  }
+
+  Mark mark;
+  // The sub-millisecond fraction is in ns
+  mark.tow = falling_edge_ ? m.towMsF + m.towSubMsF * 1e-6
+                           : m.towMsR + m.towSubMsR * 1e-6;
+  mark.tag.header.stamp = now;
+  mark.tag.ch = m.ch;
+  mark.tag.count = m.risingEdgeCount;
+  // TIM-TM2 only counts the rising edges. A falling edge before the last
+  // rising edge belongs to the previous pulse.
+  if (falling_edge_ && (m.wnF < m.wnR || (m.wnF == m.wnR
+      && (m.towMsF < m.towMsR || (m.towMsF == m.towMsR
+                                  && m.towSubMsF < m.towSubMsR)))))
+    --mark.tag.count;
+  mark.tag.week = falling_edge_ ? m.wnF : m.wnR;
+  mark.tag.tow = mark.tow * 1e-3;
+  mark.tag.timeAcc = m.accEst * 1e-9;
+
+  if (pending_.empty() && tag(mark, tagged)) {
+    publish(tagged, lock);
+    return;
+  }
+  if (pending_.size() >= max_pending_) {
+    pending_.pop_front();
+    ++statistics_.dropped_overflow;
+  }
+  pending_.push_back(mark);
+}
+
+bool Geotagger::tag(Mark& mark, std::vector<ublox_msgs::Geotag>& tagged) {
+  if (epochs_.empty() || towDiff(mark.tow, epochs_.back().tow) > 0)
+    return false;
+  std::size_t i;
+  if (!bracket(epochs_, mark.tow, i)) {
+    ++statistics_.dropped_old;
+    return true;
+  }
+  const Epoch& a = epochs_[i];
+  const Epoch& b = epochs_[i + 1];
+  const double interval = towDiff(b.tow, a.tow);
+  if (interval > max_gap_) {
+    ++statistics_.dropped_gap;
+    return true;
+  }
+  const double s = interval > 0 ? towDiff(mark.tow, a.tow) / interval : 0;
+  const double dt = interval * 1e-3;
+
+  // Displacement from a to b in the local NED frame of a
+  const double lat = a.lat * kDegToRad;
+  const double sin_lat = std::sin(lat);
+  const double w = 1 - kEccentricity2 * sin_lat * sin_lat;
+  const double radius_n = kSemiMajorAxis * (1 - kEccentricity2)
+      / (w * std::sqrt(w)) + a.height;
+  const double radius_e = (kSemiMajorAxis / std::sqrt(w) + a.height)
+      * std::cos(lat);
+  const double delta[3] = {(b.lat - a.lat) * kDegToRad * radius_n,
+                           wrapAngle(b.lon - a.lon) * kDegToRad * radius_e,
+                           a.height - b.height};
+
+  // Cubic Hermite basis, a is the origin
+  const double s2 = s * s, s3 = s2 * s;
+  const double h10 = s3 - 2 * s2 + s;
+  const double h01 = -2 * s3 + 3 * s2;
+  const double h11 = s3 - s2;
+  double position[3];
+  for (int k = 0; k < 3; ++k)
+    position[k] = h10 * dt * a.vel[k] + h01 * delta[k] + h11 * dt * b.vel[k];
+
+  ublox_msgs::Geotag& geotag = mark.tag;
+  geotag.lat = a.lat + position[0] / radius_n / kDegToRad;
+  geotag.lon = a.lon;
+  if (radius_e > 0)
+    geotag.lon = wrapAngle(a.lon + position[1] / radius_e / kDegToRad);
+  geotag.height = a.height - position[2];
+  geotag.velN = lerp(a.vel[0], b.vel[0], s);
+  geotag.velE = lerp(a.vel[1], b.vel[1], s);
+  geotag.velD = lerp(a.vel[2], b.vel[2], s);
+  geotag.sAcc = lerp(a.s_acc, b.s_acc, s);
+
+  // Blend the epoch variances & add the motion during the mark time error
+  const double speed_h = std::sqrt(geotag.velN * geotag.velN
+                                   + geotag.velE * geotag.velE);
+  const double h_time = speed_h * geotag.timeAcc;
+  const double v_time = geotag.velD * geotag.timeAcc;
+  geotag.hAcc = std::sqrt(lerp(a.h_acc * a.h_acc, b.h_acc * b.h_acc, s)
+                          + h_time * h_time);
+  geotag.vAcc = std::sqrt(lerp(a.v_acc * a.v_acc, b.v_acc * b.v_acc, s)
+                          + v_time * v_time);
+  geotag.interval = dt;
+
+  std::size_t j;
+  geotag.attitudeValid = bracket(attitudes_, mark.tow, j)
+      && towDiff(attitudes_[j + 1].tow, attitudes_[j].tow) <= max_gap_;
+  if (geotag.attitudeValid) {
+    const Attitude& c = attitudes_[j];
+    const Attitude& d = attitudes_[j + 1];
+    const double att_interval = towDiff(d.tow, c.tow);
+    const double t = att_interval > 0
+        ? towDiff(mark.tow, c.tow) / att_interval : 0;
+    float angles[3];
+    for (int k = 0; k < 3; ++k)
+      angles[k] = wrapAngle(c.angles[k]
+                            + t * wrapAngle(d.angles[k] - c.angles[k]));
+    geotag.roll = angles[0];
+    geotag.pitch = angles[1];
+    geotag.heading = angles[2] < 0 ? angles[2] + 360 : angles[2];
+    geotag.accRoll = lerp(c.acc[0], d.acc[0], t);
+    geotag.accPitch = lerp(c.acc[1], d.acc[1], t);
+    geotag.accHeading = lerp(c.acc[2], d.acc[2], t);
+  }
+
+  ++statistics_.tagged;
+  statistics_.last_interval = dt;
+  tagged.push_back(geotag);
+  return true;
+}
+
+void Geotagger::publish(const std::vector<ublox_msgs::Geotag>& tagged,
+                        boost::mutex::scoped_lock& lock) {
+  lock.unlock();
+  if (!callback_)
+    return;
+  for (std::size_t i = 0; i < tagged.size(); ++i)
+    callback_(tagged[i]);
+}
+
+Geotagger::Statistics Geotagger::statistics() const {
+  boost::mutex::scoped_lock lock(mutex_);
+  return statistics_;
+}
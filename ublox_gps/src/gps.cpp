@@ -29,6 +29,7 @@
 
 #include <ublox_gps/gps.h>
 #include <boost/version.hpp>
+#include <sys/ioctl.h>
 
 namespace ublox_gps {
 
@@ -41,17 +42,40 @@ const boost::posix_time::time_duration Gps::default_timeout_ =
     boost::posix_time::milliseconds(
         static_cast<int>(Gps::kDefaultAckTimeout * 1000));
 
-Gps::Gps() : configured_(false), config_on_startup_flag_(true) {
+//! Time without data after which a link is considered failed
+static const boost::posix_time::time_duration kLinkTimeout =
+    boost::posix_time::seconds(2);
+
+//! Upper bounds of the ACK latency histogram buckets [s]
+static const double kAckLatencyBounds[] = {0.005, 0.01, 0.025, 0.05, 0.1,
+                                           0.25, 0.5, 1.0};
+
+Gps::Gps() : configured_(false), save_on_shutdown_(false),
+             config_on_startup_flag_(true), exclusive_(false),
+             defer_rates_(false), stream_handle_(-1), kernel_pending_(0),
+             redundant_handle_(-1), link_(0),
+             ack_latency_(std::vector<double>(kAckLatencyBounds,
+                 kAckLatencyBounds + sizeof(kAckLatencyBounds) /
+                                     sizeof(kAckLatencyBounds[0]))),
+             pending_bytes_(0), dispatch_lag_(0) {
+ for (std::size_t i = 0; i < FrameDeduplicator::kLinks; ++i)
+   buffered_[i] = false;
  subscribeAcks();
+ callbacks_.setFrameCallback(boost::bind(&Gps::processFrame, this, _1));
+ callbacks_.setDispatchCallback(boost::bind(&Gps::dispatchFrame, this, _1,
+                                            _2));
 }
 
 Gps::~Gps() { close(); }
 
 void Gps::setWorker(const boost::shared_ptr<Worker>& worker) {
+  boost::mutex::scoped_lock lock(worker_mutex_);
   if (worker_) return;
+  worker->setReadCoalescing(coalescing_);
+  if (raw_data_callback_)
+    worker->setRawDataCallback(raw_data_callback_);
+  worker->setCallback(boost::bind(&Gps::readCallback, this, 0, _1, _2));
   worker_ = worker;
-  worker_->setCallback(boost::bind(&CallbackHandlers::readCallback,
-                                   &callbacks_, _1, _2));
   configured_ = static_cast<bool>(worker);
 }
 
@@ -67,6 +91,75 @@ void Gps::subscribeAcks() {
       boost::bind(&Gps::processUpdSosAck, this, _1));
 }
 
+void Gps::readCallback(std::size_t link, unsigned char* data,
+                       std::size_t& size) {
+  boost::mutex::scoped_lock lock(dispatch_mutex_);
+  // Bytes left from the previous read are older than the newly read bytes
+  if (!buffered_[link])
+    buffer_time_[link] = boost::posix_time::microsec_clock::universal_time();
+  int handle = link == 0 ? stream_handle_ : redundant_handle_;
+  int pending = 0;
+  if (handle < 0 || ioctl(handle, FIONREAD, &pending) < 0)
+    pending = 0;
+  kernel_pending_ = pending;
+  link_ = link;
+
+  callbacks_.readCallback(data, size, link);
+  buffered_[link] = size > 0;
+}
+
+bool Gps::processFrame(ublox::Reader& reader) {
+  // A corrupted copy must neither mark the frame as received, which would
+  // drop the good copy of the other link, nor update the iTOW continuity. Its
+  // class & ID can't be trusted, so it is only counted as a decode error.
+  uint16_t checksum;
+  if (ublox::calculateChecksum(reader.pos() + 2, reader.length() + 4,
+                               checksum) != reader.checksum()) {
+    callbacks_.addDecodeError();
+    return false;
+  }
+  frame_counters_.add(reader.classId(), reader.messageId(),
+                     reader.length() + ublox::kHeaderLength +
+                     ublox::kChecksumLength);
+  if (redundant_worker_) {
+    int offset = ItowContinuity::itowOffset(reader.classId(),
+                                            reader.messageId());
+    uint32_t itow = 0;
+    if (offset >= 0 && reader.length() >= static_cast<uint32_t>(offset) + 4)
+      itow = reader.data()[offset] | reader.data()[offset + 1] << 8
+             | reader.data()[offset + 2] << 16
+             | reader.data()[offset + 3] << 24;
+    if (!deduplicator_.accept(link_, reader.classId(), reader.messageId(),
+                              itow, reader.checksum()))
+      return false;
+  }
+
+  itow_continuity_.update(reader.classId(), reader.messageId(), reader.data(),
+                          reader.length());
+  return true;
+}
+
+bool Gps::dispatchFrame(ublox::Reader& reader, uint32_t remaining) {
+  const boost::posix_time::time_duration lag =
+      boost::posix_time::microsec_clock::universal_time() - buffer_time_[link_];
+  const uint32_t pending = kernel_pending_ + remaining;
+  pending_bytes_.store(pending, boost::memory_order_relaxed);
+  dispatch_lag_.store(lag.total_microseconds() * 1e-6,
+                      boost::memory_order_relaxed);
+  return !overload_.shed(reader.classId(), reader.messageId(), pending,
+                         lag.total_microseconds() * 1e-6);
+}
+
+boost::shared_ptr<Worker> Gps::sendWorker() const {
+  boost::shared_ptr<Worker> worker = primaryWorker();
+  if (redundant_worker_ && (!worker || worker->isReadFailing()
+                            || !deduplicator_.isAlive(0, kLinkTimeout))
+      && !redundant_worker_->isReadFailing()
+      && deduplicator_.isAlive(1, kLinkTimeout))
+    return redundant_worker_;
+  return worker;
+}
+
 void Gps::processAck(const ublox_msgs::Ack &m) {
   // Process ACK/NACK messages
   Ack ack;
@@ -135,10 +228,15 @@ void Gps::initializeSerial(std::string port, unsigned int baudrate,
     tcsetattr(fd, TCSANOW, &tio);
   }
 
+  if (exclusive_ && ioctl(serial->native_handle(), TIOCEXCL) < 0)
+    ROS_WARN("U-Blox: Could not open serial port %s in exclusive mode",
+             port.c_str());
+
   // Set the I/O worker
   if (worker_) return;
   setWorker(boost::shared_ptr<Worker>(
       new AsyncWorker<boost::asio::serial_port>(serial, io_service)));
+  stream_handle_ = serial->native_handle();
 
   configured_ = false;
 
@@ -189,6 +287,7 @@ void Gps::resetSerial(std::string port) {
   if (worker_) return;
   setWorker(boost::shared_ptr<Worker>(
       new AsyncWorker<boost::asio::serial_port>(serial, io_service)));
+  stream_handle_ = serial->native_handle();
   configured_ = false;
 
   // Poll UART PRT Config
@@ -244,6 +343,89 @@ void Gps::initializeTcp(std::string host, std::string port) {
   setWorker(boost::shared_ptr<Worker>(
       new AsyncWorker<boost::asio::ip::tcp::socket>(socket,
                                                     io_service)));
+  stream_handle_ = socket->native_handle();
+}
+
+void Gps::initializeReplay(std::string path, double speed) {
+  if (worker_) return;
+  setWorker(boost::shared_ptr<Worker>(
+      new ReplayWorker(path, speed, default_timeout_)));
+  ROS_INFO("U-Blox: Replaying capture %s.", path.c_str());
+}
+
+void Gps::initializeProbe(std::string port, unsigned int baudrate) {
+  port_ = port;
+  boost::shared_ptr<boost::asio::io_service> io_service(
+      new boost::asio::io_service);
+  boost::shared_ptr<boost::asio::serial_port> serial(
+      new boost::asio::serial_port(*io_service));
+
+  // open serial port, fails if another process opened it exclusively
+  try {
+    serial->open(port);
+  } catch (std::runtime_error& e) {
+    throw std::runtime_error("U-Blox: Could not open serial port :"
+                             + port + " " + e.what());
+  }
+  if (ioctl(serial->native_handle(), TIOCEXCL) < 0)
+    ROS_DEBUG("U-Blox: Could not open serial port %s in exclusive mode",
+              port.c_str());
+
+  if(BOOST_VERSION < 106600)
+  {
+    // Set serial port to "raw" mode, see initializeSerial
+    int fd = serial->native_handle();
+    termios tio;
+    tcgetattr(fd, &tio);
+    cfmakeraw(&tio);
+    tcsetattr(fd, TCSANOW, &tio);
+  }
+  serial->set_option(boost::asio::serial_port_base::baud_rate(baudrate));
+
+  if (worker_) return;
+  setWorker(boost::shared_ptr<Worker>(
+      new AsyncWorker<boost::asio::serial_port>(serial, io_service)));
+  stream_handle_ = serial->native_handle();
+}
+
+void Gps::initializeRedundantSerial(std::string port,
+                                    unsigned int baudrate) {
+  boost::shared_ptr<boost::asio::io_service> io_service(
+      new boost::asio::io_service);
+  boost::shared_ptr<boost::asio::serial_port> serial(
+      new boost::asio::serial_port(*io_service));
+
+  // open serial port
+  try {
+    serial->open(port);
+  } catch (std::runtime_error& e) {
+    throw std::runtime_error("U-Blox: Could not open redundant serial port :"
+                             + port + " " + e.what());
+  }
+
+  ROS_INFO("U-Blox: Opened redundant serial port %s", port.c_str());
+
+  if(BOOST_VERSION < 106600)
+  {
+    // Set serial port to "raw" mode, see initializeSerial
+    int fd = serial->native_handle();
+    termios tio;
+    tcgetattr(fd, &tio);
+    cfmakeraw(&tio);
+    tcsetattr(fd, TCSANOW, &tio);
+  }
+  serial->set_option(boost::asio::serial_port_base::baud_rate(baudrate));
+  if (exclusive_ && ioctl(serial->native_handle(), TIOCEXCL) < 0)
+    ROS_WARN("U-Blox: Could not open serial port %s in exclusive mode",
+             port.c_str());
+
+  if (redundant_worker_) return;
+  redundant_worker_.reset(
+      new AsyncWorker<boost::asio::serial_port>(serial, io_service));
+  redundant_worker_->setReadCoalescing(coalescing_);
+  redundant_worker_->setCallback(
+      boost::bind(&Gps::readCallback, this, 1, _1, _2));
+  redundant_handle_ = serial->native_handle();
 }
 
 void Gps::close() {
@@ -253,12 +435,30 @@ void Gps::close() {
     else
       ROS_INFO("U-Blox Flash BBR failed to save");
   }
-  worker_.reset();
+  boost::shared_ptr<Worker> worker;
+  {
+    // Stop the worker outside the lock, it waits for its I/O thread
+    boost::mutex::scoped_lock lock(worker_mutex_);
+    worker.swap(worker_);
+    stream_handle_ = -1;
+  }
+  worker.reset();
+  redundant_worker_.reset();
+  redundant_handle_ = -1;
   configured_ = false;
 }
 
 void Gps::reset(const boost::posix_time::time_duration& wait) {
-  worker_.reset();
+  // The capture continues with the bytes received after the reset
+  boost::shared_ptr<Worker> worker;
+  {
+    boost::mutex::scoped_lock lock(worker_mutex_);
+    if (boost::dynamic_pointer_cast<ReplayWorker>(worker_))
+      return;
+    worker.swap(worker_);
+    stream_handle_ = -1;
+  }
+  worker.reset();
   configured_ = false;
   // sleep because of undefined behavior after I/O reset
   boost::this_thread::sleep(wait);
@@ -319,6 +519,31 @@ bool Gps::clearBbr() {
   return configure(sos);
 }
 
+bool Gps::createBackup(bool stop_gnss) {
+  boost::recursive_mutex::scoped_lock lock(transaction_mutex_);
+  CfgRST rst;
+  rst.navBbrMask = rst.NAV_BBR_HOT_START;
+  if (stop_gnss) {
+    // CFG-RST is not acknowledged
+    rst.resetMode = rst.RESET_MODE_GNSS_STOP;
+    if (!configure(rst, false))
+      return false;
+  }
+  // Command saving the contents of BBR to flash memory
+  // And wait for UBX-UPD-SOS-ACK
+  UpdSOS backup;
+  backup.cmd = backup.CMD_FLASH_BACKUP_CREATE;
+  bool result = configure(backup);
+  if (stop_gnss) {
+    rst.resetMode = rst.RESET_MODE_GNSS_START;
+    if (!configure(rst, false)) {
+      ROS_ERROR("U-blox failed to restart the GNSS after the backup");
+      return false;
+    }
+  }
+  return result;
+}
+
 bool Gps::configUart1(unsigned int baudrate, uint16_t in_proto_mask,
                       uint16_t out_proto_mask) {
   if (!worker_) return true;
@@ -338,6 +563,7 @@ bool Gps::configUart1(unsigned int baudrate, uint16_t in_proto_mask,
 
 bool Gps::disableUart1(CfgPRT& prev_config) {
   ROS_DEBUG("Disabling UART1");
+  boost::recursive_mutex::scoped_lock lock(transaction_mutex_);
 
   // Poll UART PRT Config
   std::vector<uint8_t> payload;
@@ -386,7 +612,10 @@ bool Gps::configRate(uint16_t meas_rate, uint16_t nav_rate) {
   rate.measRate = meas_rate;
   rate.navRate = nav_rate;  //  must be fixed at 1 for ublox 5 and 6
   rate.timeRef = CfgRATE::TIME_REF_GPS;
-  return configure(rate);
+  if (!configure(rate))
+    return false;
+  setNavPeriod(meas_rate, nav_rate);
+  return true;
 }
 
 bool Gps::configRtcm(std::vector<uint8_t> ids, std::vector<uint8_t> rates) {
@@ -446,6 +675,27 @@ bool Gps::configTmode3Fixed(bool lla_flag,
   return configure(tmode3);
 }
 
+bool Gps::configTmode3FixedEcef(const double ecef[3], double fixed_pos_acc) {
+  ROS_DEBUG("Configuring TMODE3 to Fixed ECEF");
+
+  CfgTMODE3 tmode3;
+  tmode3.flags = tmode3.FLAGS_MODE_FIXED & tmode3.FLAGS_MODE_MASK;
+  // Split each coordinate [0.1 mm] into [cm] and the remainder [0.1 mm],
+  // both with the same sign
+  const int64_t x = llround(ecef[0] * 1e4);
+  const int64_t y = llround(ecef[1] * 1e4);
+  const int64_t z = llround(ecef[2] * 1e4);
+  tmode3.ecefXOrLat = x / 100;
+  tmode3.ecefYOrLon = y / 100;
+  tmode3.ecefZOrAlt = z / 100;
+  tmode3.ecefXOrLatHP = x % 100;
+  tmode3.ecefYOrLonHP = y % 100;
+  tmode3.ecefZOrAltHP = z % 100;
+  // Convert from m to [0.1 mm]
+  tmode3.fixedPosAcc = (uint32_t)round(fixed_pos_acc * 1e4);
+  return configure(tmode3);
+}
+
 bool Gps::configTmode3SurveyIn(unsigned int svin_min_dur,
                                float svin_acc_limit) {
   CfgTMODE3 tmode3;
@@ -472,7 +722,50 @@ bool Gps::setRate(uint8_t class_id, uint8_t message_id, uint8_t rate) {
   msg.msgClass = class_id;
   msg.msgID = message_id;
   msg.rate = rate;
-  return configure(msg);
+  // The rate applies to the port the message is received on, so it is also
+  // sent over the redundant link, without waiting for its ACK
+  if (redundant_worker_) {
+    std::vector<unsigned char> out(kWriterSize);
+    ublox::Writer writer(out.data(), out.size());
+    boost::shared_ptr<Worker> worker = primaryWorker();
+    boost::shared_ptr<Worker> other =
+        sendWorker() == worker ? redundant_worker_ : worker;
+    if (other && writer.write(msg))
+      other->send(out.data(), writer.end() - out.data());
+  }
+  if (!configure(msg))
+    return false;
+  itow_continuity_.setRate(class_id, message_id, rate);
+  return true;
+}
+
+bool Gps::setDeferredRates() {
+  defer_rates_ = false;
+  bool result = true;
+  for (std::size_t i = 0; i < deferred_rates_.size(); ++i) {
+    const DeferredRate& deferred = deferred_rates_[i];
+    if (!setRate(deferred.class_id, deferred.message_id, deferred.rate)) {
+      ROS_WARN("Failed to set the rate of 0x%02x / 0x%02x to %u",
+               deferred.class_id, deferred.message_id, deferred.rate);
+      result = false;
+    }
+  }
+  deferred_rates_.clear();
+  return result;
+}
+
+bool Gps::reapplyRates() {
+  const std::map<uint16_t, uint8_t> rates = config_shadow_.messageRates();
+  bool result = true;
+  for (std::map<uint16_t, uint8_t>::const_iterator it = rates.begin();
+       it != rates.end(); ++it) {
+    if (!setRate(it->first >> 8, it->first & 0xff, it->second)) {
+      ROS_WARN("Failed to set the rate of 0x%02x / 0x%02x to %u",
+               it->first >> 8, it->first & 0xff, it->second);
+      result = false;
+    }
+  }
+  return result;
 }
 
 bool Gps::setDynamicModel(uint8_t model) {
@@ -533,19 +826,18 @@ bool Gps::setUseAdr(bool enable, float protocol_version) {
 }
 
 bool Gps::sendRtcm(const std::vector<uint8_t>& rtcm) {
-  worker_->send(rtcm.data(), rtcm.size());
-  return true;
+  return send(rtcm.data(), rtcm.size());
 }
 
 bool Gps::poll(uint8_t class_id, uint8_t message_id,
                const std::vector<uint8_t>& payload) {
-  if (!worker_) return false;
+  if (!primaryWorker()) return false;
 
   std::vector<unsigned char> out(kWriterSize);
   ublox::Writer writer(out.data(), out.size());
   if (!writer.write(payload.data(), payload.size(), class_id, message_id))
     return false;
-  worker_->send(out.data(), writer.end() - out.data());
+  send(out.data(), writer.end() - out.data());
 
   return true;
 }
@@ -554,6 +846,8 @@ bool Gps::waitForAcknowledge(const boost::posix_time::time_duration& timeout,
                              uint8_t class_id, uint8_t msg_id) {
   ROS_DEBUG_COND(debug >= 2, "Waiting for ACK 0x%02x / 0x%02x",
                  class_id, msg_id);
+  const boost::posix_time::ptime start =
+      boost::posix_time::microsec_clock::universal_time();
   boost::posix_time::ptime wait_until(
       boost::posix_time::second_clock::local_time() + timeout);
 
@@ -562,20 +856,42 @@ bool Gps::waitForAcknowledge(const boost::posix_time::time_duration& timeout,
          && (ack.class_id != class_id
              || ack.msg_id != msg_id
              || ack.type == WAIT)) {
-    worker_->wait(timeout);
+    boost::shared_ptr<Worker> worker = sendWorker();
+    if (!worker)
+      break;
+    worker->wait(timeout);
     ack = ack_.load(boost::memory_order_seq_cst);
   }
   bool result = ack.type == ACK
                 && ack.class_id == class_id
                 && ack.msg_id == msg_id;
+  if (result)
+    ack_latency_.observe((boost::posix_time::microsec_clock::universal_time()
+                          - start).total_microseconds() * 1e-6);
   return result;
 }
 
 void Gps::setRawDataCallback(const Worker::Callback& callback) {
+  // Kept for workers which are initialized later
+  boost::mutex::scoped_lock lock(worker_mutex_);
+  raw_data_callback_ = callback;
   if (! worker_) return;
   worker_->setRawDataCallback(callback);
 }
 
+DataIntegrity Gps::getDataIntegrity(bool serial_counters) const {
+  DataIntegrity integrity;
+  if (serial_counters)
+    integrity.serial_counters_valid =
+        readSerialErrorCounters(stream_handle_, integrity.serial);
+  integrity.frames = callbacks_.frames();
+  integrity.discarded_bytes = callbacks_.discardedBytes();
+  integrity.foreign_bytes = callbacks_.foreignBytes();
+  integrity.decode_errors = callbacks_.decodeErrors();
+  integrity.missing_epochs = itow_continuity_.missing();
+  return integrity;
+}
+
 bool Gps::setUTCtime() {
   ROS_DEBUG("Setting time to UTC time");
 
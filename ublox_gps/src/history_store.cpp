@@ -0,0 +1,188 @@
+//==============================================================================
+// Copyright (c) 2012, Johannes Meyer, TU Darmstadt
+// All rights reserved.
+
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//     * Neither the name of the Flight Systems and Automatic Control group,
+//       TU Darmstadt, nor the names of its contributors may be used to
+//       endorse or promote products derived from this software without
+//       specific prior written permission.
+
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" 
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE 
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE 
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER BE LIABLE FOR ANY
+// DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+// (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+// LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+// ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+// SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//==============================================================================
+
+#include "ublox_gps/history_store.h"
+#include <algorithm>
+#include <fstream>
+#include <ros/console.h>
+
+using namespace ublox_node;
+
+namespace {
+
+//! Size of the frame header [bytes]
+const uint32_t kHeaderLength = 6;
+//! Size of the smallest frame, used to size the columns [bytes]
+const std::size_t kMinFrameSize = 16;
+
+/**
+ * @brief Compare records by receive time.
+ */
+bool earlier(const ublox_msgs::HistoryRecord& a,
+             const ublox_msgs::HistoryRecord& b) {
+  return a.stamp < b.stamp;
+}
+
+}  // namespace
+
+HistoryRing::HistoryRing(const std::string& name, std::size_t budget,
+                         double max_age, int itow_offset)
+    : name_(name), max_age_(max_age), itow_offset_(itow_offset),
+      data_(budget), write_(0),
+      stamp_(std::max<std::size_t>(budget / kMinFrameSize, 1)),
+      itow_(stamp_.size()), offset_(stamp_.size()), size_(stamp_.size()),
+      head_(0), count_(0) {}
+
+void HistoryRing::pop() {
+  head_ = (head_ + 1) % stamp_.size();
+  --count_;
+}
+
+void HistoryRing::add(const uint8_t* frame, uint32_t size) {
+  if (size > data_.size())
+    return;
+  const ros::Time now = ros::Time::now();
+  boost::mutex::scoped_lock lock(mutex_);
+
+  // Drop frames which are too old
+  while (count_ > 0 && (now - stamp_[head_]).toSec() > max_age_)
+    pop();
+
+  // Wrap if the frame does not fit at the end, the frames at the end are the
+  // oldest
+  if (write_ + size > data_.size()) {
+    while (count_ > 0 && offset_[head_] >= write_)
+      pop();
+    write_ = 0;
+  }
+  // Drop the frames in the space of the new frame
+  while (count_ > 0 && offset_[head_] >= write_
+         && offset_[head_] < write_ + size)
+    pop();
+  if (count_ == stamp_.size())
+    pop();
+
+  std::copy(frame, frame + size, data_.begin() + write_);
+  const std::size_t i = (head_ + count_) % stamp_.size();
+  stamp_[i] = now;
+  itow_[i] = 0;
+  if (itow_offset_ >= 0 && size >= kHeaderLength + itow_offset_ + 4) {
+    const uint8_t* itow = frame + kHeaderLength + itow_offset_;
+    itow_[i] = itow[0] | itow[1] << 8 | itow[2] << 16 | itow[3] << 24;
+  }
+  offset_[i] = write_;
+  size_[i] = size;
+  ++count_;
+  write_ += size;
+}
+
+void HistoryRing::append(
+    std::size_t i, std::vector<ublox_msgs::HistoryRecord>& records) const {
+  ublox_msgs::HistoryRecord record;
+  record.stamp = stamp_[i];
+  record.message = name_;
+  record.iTOW = itow_[i];
+  record.frame.assign(data_.begin() + offset_[i],
+                      data_.begin() + offset_[i] + size_[i]);
+  records.push_back(record);
+}
+
+void HistoryRing::query(
+    const ros::Time& start, const ros::Time& end,
+    std::vector<ublox_msgs::HistoryRecord>& records) const {
+  boost::mutex::scoped_lock lock(mutex_);
+  for (std::size_t k = 0; k < count_; ++k) {
+    const std::size_t i = (head_ + k) % stamp_.size();
+    if (stamp_[i] >= start && stamp_[i] <= end)
+      append(i, records);
+  }
+}
+
+void HistoryRing::queryItow(
+    uint32_t start, uint32_t end,
+    std::vector<ublox_msgs::HistoryRecord>& records) const {
+  if (itow_offset_ < 0)
+    return;
+  boost::mutex::scoped_lock lock(mutex_);
+  for (std::size_t k = 0; k < count_; ++k) {
+    const std::size_t i = (head_ + k) % stamp_.size();
+    const bool in_range = start <= end
+        ? itow_[i] >= start && itow_[i] <= end
+        : itow_[i] >= start || itow_[i] <= end;
+    if (in_range)
+      append(i, records);
+  }
+}
+
+boost::shared_ptr<HistoryRing> HistoryStore::add(const std::string& name,
+                                                 std::size_t budget,
+                                                 double max_age,
+                                                 int itow_offset) {
+  rings_.push_back(boost::shared_ptr<HistoryRing>(
+      new HistoryRing(name, budget, max_age, itow_offset)));
+  return rings_.back();
+}
+
+void HistoryStore::query(
+    const std::vector<std::string>& names, bool use_itow,
+    const ros::Time& start, const ros::Time& end, uint32_t start_itow,
+    uint32_t end_itow, std::vector<ublox_msgs::HistoryRecord>& records) const {
+  records.clear();
+  for (std::size_t i = 0; i < rings_.size(); ++i) {
+    if (!names.empty() && std::find(names.begin(), names.end(),
+                                    rings_[i]->name()) == names.end())
+      continue;
+    if (use_itow)
+      rings_[i]->queryItow(start_itow, end_itow, records);
+    else
+      rings_[i]->query(start, end, records);
+  }
+  std::stable_sort(records.begin(), records.end(), earlier);
+}
+
+bool HistoryStore::save(const std::string& path,
+                        uint32_t& num_records) const {
+  std::vector<ublox_msgs::HistoryRecord> records;
+  query(std::vector<std::string>(), false, ros::Time(0),
+        ros::TIME_MAX, 0, 0, records);
+  std::ofstream file(path.c_str(), std::ios::binary);
+  if (!file) {
+    ROS_ERROR("Could not open %s to save the message history",
+              path.c_str());
+    return false;
+  }
+  for (std::size_t i = 0; i < records.size(); ++i)
+    file.write(reinterpret_cast<const char*>(records[i].frame.data()),
+               records[i].frame.size());
+  num_records = records.size();
+  if (!file) {
+    ROS_ERROR("Could not write the message history to %s", path.c_str());
+    return false;
+  }
+  return true;
+}
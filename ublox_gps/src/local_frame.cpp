@@ -0,0 +1,191 @@
+//==============================================================================
+// Copyright (c) 2012, Johannes Meyer, TU Darmstadt
+// All rights reserved.
+
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//     * Neither the name of the Flight Systems and Automatic Control group,
+//       TU Darmstadt, nor the names of its contributors may be used to
+//       endorse or promote products derived from this software without
+//       specific prior written permission.
+
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" 
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE 
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE 
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER BE LIABLE FOR ANY
+// DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+// (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+// LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+// ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+// SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//==============================================================================
+
+#include "ublox_gps/local_frame.h"
+#include <cmath>
+
+using namespace ublox_node;
+
+namespace {
+//! WGS 84 semi-major axis [m]
+const double kA = 6378137.0;
+//! WGS 84 first eccentricity squared
+const double kE2 = 6.69437999014e-3;
+const double kDegToRad = M_PI / 180.0;
+
+/**
+ * @brief Get the row-major rotation from ECEF to the ENU frame at a position.
+ */
+void enuRotation(double sin_lat, double cos_lat, double sin_lon,
+                 double cos_lon, double r[9]) {
+  r[0] = -sin_lon;
+  r[1] = cos_lon;
+  r[2] = 0;
+  r[3] = -sin_lat * cos_lon;
+  r[4] = -sin_lat * sin_lon;
+  r[5] = cos_lat;
+  r[6] = cos_lat * cos_lon;
+  r[7] = cos_lat * sin_lon;
+  r[8] = sin_lat;
+}
+}  // namespace
+
+LocalFrame::LocalFrame(OriginSource source) : source_(source), valid_(false) {
+  for (int i = 0; i < 3; ++i)
+    origin_lla_[i] = origin_ecef_[i] = 0;
+  for (int i = 0; i < 9; ++i)
+    rotation_[i] = 0;
+}
+
+bool LocalFrame::valid() const {
+  boost::mutex::scoped_lock lock(mutex_);
+  return valid_;
+}
+
+void LocalFrame::setOrigin(double lat, double lon, double height) {
+  boost::mutex::scoped_lock lock(mutex_);
+  origin_lla_[0] = lat;
+  origin_lla_[1] = lon;
+  origin_lla_[2] = height;
+  toEcef(lat, lon, height, origin_ecef_);
+  enuRotation(std::sin(lat * kDegToRad), std::cos(lat * kDegToRad),
+              std::sin(lon * kDegToRad), std::cos(lon * kDegToRad), rotation_);
+  valid_ = true;
+}
+
+void LocalFrame::setOriginEcef(const double ecef[3]) {
+  double lla[3];
+  toLla(ecef, lla);
+  setOrigin(lla[0], lla[1], lla[2]);
+}
+
+bool LocalFrame::origin(double lla[3]) const {
+  boost::mutex::scoped_lock lock(mutex_);
+  for (int i = 0; i < 3; ++i)
+    lla[i] = origin_lla_[i];
+  return valid_;
+}
+
+bool LocalFrame::toEnu(double lat, double lon, double height, double enu[3],
+                       double rotation[9]) const {
+  if (!toEnu(&lat, &lon, &height, 1, &enu[0], &enu[1], &enu[2]))
+    return false;
+  if (rotation) {
+    // The origin rotation times the transposed rotation at the position
+    double r[9];
+    enuRotation(std::sin(lat * kDegToRad), std::cos(lat * kDegToRad),
+                std::sin(lon * kDegToRad), std::cos(lon * kDegToRad), r);
+    boost::mutex::scoped_lock lock(mutex_);
+    for (int i = 0; i < 3; ++i)
+      for (int j = 0; j < 3; ++j)
+        rotation[3 * i + j] = rotation_[3 * i] * r[3 * j]
+                              + rotation_[3 * i + 1] * r[3 * j + 1]
+                              + rotation_[3 * i + 2] * r[3 * j + 2];
+  }
+  return true;
+}
+
+bool LocalFrame::toEnu(const double* lat, const double* lon,
+                       const double* height, std::size_t n, double* east,
+                       double* north, double* up) const {
+  double o[3], r[9];
+  {
+    boost::mutex::scoped_lock lock(mutex_);
+    if (!valid_)
+      return false;
+    for (int i = 0; i < 3; ++i)
+      o[i] = origin_ecef_[i];
+    for (int i = 0; i < 9; ++i)
+      r[i] = rotation_[i];
+  }
+  for (std::size_t i = 0; i < n; ++i) {
+    const double sin_lat = std::sin(lat[i] * kDegToRad);
+    const double cos_lat = std::cos(lat[i] * kDegToRad);
+    const double sin_lon = std::sin(lon[i] * kDegToRad);
+    const double cos_lon = std::cos(lon[i] * kDegToRad);
+    const double nr = kA / std::sqrt(1 - kE2 * sin_lat * sin_lat);
+    const double dx = (nr + height[i]) * cos_lat * cos_lon - o[0];
+    const double dy = (nr + height[i]) * cos_lat * sin_lon - o[1];
+    const double dz = (nr * (1 - kE2) + height[i]) * sin_lat - o[2];
+    east[i] = r[0] * dx + r[1] * dy;
+    north[i] = r[3] * dx + r[4] * dy + r[5] * dz;
+    up[i] = r[6] * dx + r[7] * dy + r[8] * dz;
+  }
+  return true;
+}
+
+void LocalFrame::rotate(const double rotation[9], const double v[3],
+                        double out[3]) {
+  for (int i = 0; i < 3; ++i)
+    out[i] = rotation[3 * i] * v[0] + rotation[3 * i + 1] * v[1]
+             + rotation[3 * i + 2] * v[2];
+}
+
+void LocalFrame::rotateCovariance(const double rotation[9],
+                                  const double covariance[9], double out[9]) {
+  double rc[9];
+  for (int i = 0; i < 3; ++i)
+    for (int j = 0; j < 3; ++j)
+      rc[3 * i + j] = rotation[3 * i] * covariance[j]
+                      + rotation[3 * i + 1] * covariance[3 + j]
+                      + rotation[3 * i + 2] * covariance[6 + j];
+  for (int i = 0; i < 3; ++i)
+    for (int j = 0; j < 3; ++j)
+      out[3 * i + j] = rc[3 * i] * rotation[3 * j]
+                       + rc[3 * i + 1] * rotation[3 * j + 1]
+                       + rc[3 * i + 2] * rotation[3 * j + 2];
+}
+
+void LocalFrame::toEcef(double lat, double lon, double height,
+                        double ecef[3]) {
+  const double sin_lat = std::sin(lat * kDegToRad);
+  const double cos_lat = std::cos(lat * kDegToRad);
+  const double nr = kA / std::sqrt(1 - kE2 * sin_lat * sin_lat);
+  ecef[0] = (nr + height) * cos_lat * std::cos(lon * kDegToRad);
+  ecef[1] = (nr + height) * cos_lat * std::sin(lon * kDegToRad);
+  ecef[2] = (nr * (1 - kE2) + height) * sin_lat;
+}
+
+void LocalFrame::toLla(const double ecef[3], double lla[3]) {
+  const double p = std::sqrt(ecef[0] * ecef[0] + ecef[1] * ecef[1]);
+  double lat = std::atan2(ecef[2], p * (1 - kE2));
+  double nr = kA;
+  // Converges to below 1e-12 rad within a few iterations
+  for (int i = 0; i < 5; ++i) {
+    const double sin_lat = std::sin(lat);
+    nr = kA / std::sqrt(1 - kE2 * sin_lat * sin_lat);
+    lat = std::atan2(ecef[2] + kE2 * nr * sin_lat, p);
+  }
+  const double sin_lat = std::sin(lat);
+  nr = kA / std::sqrt(1 - kE2 * sin_lat * sin_lat);
+  lla[0] = lat / kDegToRad;
+  lla[1] = std::atan2(ecef[1], ecef[0]) / kDegToRad;
+  // Height from the distance to the ellipsoid surface along the normal
+  lla[2] = p * std::cos(lat) + ecef[2] * sin_lat
+           - kA * std::sqrt(1 - kE2 * sin_lat * sin_lat);
+}
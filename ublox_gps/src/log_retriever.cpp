@@ -0,0 +1,197 @@
+//==============================================================================
+// Copyright (c) 2012, Johannes Meyer, TU Darmstadt
+// All rights reserved.
+
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//     * Neither the name of the Flight Systems and Automatic Control group,
+//       TU Darmstadt, nor the names of its contributors may be used to
+//       endorse or promote products derived from this software without
+//       specific prior written permission.
+
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" 
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE 
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE 
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER BE LIABLE FOR ANY
+// DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+// (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+// LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+// ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+// SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//==============================================================================
+
+#include "ublox_gps/log_retriever.h"
+#include <algorithm>
+
+using namespace ublox_node;
+
+LogRetriever::LogRetriever(const Request& request, uint32_t window,
+                           double timeout, uint32_t max_retries)
+    : request_(request), window_(window), timeout_(timeout),
+      max_retries_(max_retries), start_(0), next_(0), window_start_(0),
+      window_end_(0), attempts_(0), msg_cnt_(0) {
+  progress_ = Progress();
+}
+
+bool LogRetriever::start(uint32_t start, uint32_t count) {
+  ublox_msgs::LogRETRIEVE m;
+  {
+    boost::mutex::scoped_lock lock(mutex_);
+    if (progress_.active)
+      return false;
+    progress_ = Progress();
+    progress_.active = true;
+    progress_.total = count;
+    start_ = start;
+    received_.assign(count, false);
+    next_ = start;
+    window_end_ = start;
+    attempts_ = 0;
+    start_time_ = last_time_ = ros::Time::now();
+    if (count == 0) {
+      finish(true);
+      return true;
+    }
+    nextRequest(m);
+  }
+  if (!request_(m)) {
+    boost::mutex::scoped_lock lock(mutex_);
+    finish(false);
+    return false;
+  }
+  return true;
+}
+
+bool LogRetriever::startBatch() {
+  boost::mutex::scoped_lock lock(mutex_);
+  if (progress_.active)
+    return false;
+  progress_ = Progress();
+  progress_.active = true;
+  progress_.batch = true;
+  progress_.requests = 1;
+  start_time_ = last_time_ = ros::Time::now();
+  return true;
+}
+
+bool LogRetriever::nextRequest(ublox_msgs::LogRETRIEVE& m) {
+  const uint32_t end = start_ + received_.size();
+  while (next_ < end && received_[next_ - start_])
+    ++next_;
+  // Requests of a window which starts before the end of the previous window
+  // are retries
+  if (next_ < window_end_)
+    ++progress_.retries;
+  if (next_ != window_start_ || progress_.requests == 0)
+    attempts_ = 0;
+  if (++attempts_ > max_retries_ + 1)
+    return false;
+  window_start_ = next_;
+  // Stop before the next received entry, so that a retry resumes after the
+  // received entries instead of retrieving them again
+  uint32_t missing = next_ + 1;
+  while (missing < end && missing - next_ < window_
+         && !received_[missing - start_])
+    ++missing;
+  m.startNumber = next_;
+  m.entryCount = missing - next_;
+  m.version = 0;
+  window_end_ = next_ + m.entryCount;
+  ++progress_.requests;
+  last_time_ = ros::Time::now();
+  return true;
+}
+
+void LogRetriever::send(const ublox_msgs::LogRETRIEVE& m) {
+  if (request_(m))
+    return;
+  boost::mutex::scoped_lock lock(mutex_);
+  finish(false);
+}
+
+bool LogRetriever::addEntry(uint32_t index) {
+  ublox_msgs::LogRETRIEVE m;
+  {
+    boost::mutex::scoped_lock lock(mutex_);
+    if (!progress_.active || progress_.batch || index < start_
+        || index - start_ >= received_.size() || received_[index - start_])
+      return false;
+    received_[index - start_] = true;
+    ++progress_.received;
+    last_time_ = ros::Time::now();
+    if (progress_.received == progress_.total) {
+      finish(true);
+      return true;
+    }
+    // Request the next window as soon as the current window is done
+    if (index + 1 != window_end_)
+      return true;
+    if (!nextRequest(m)) {
+      finish(false);
+      return true;
+    }
+  }
+  send(m);
+  return true;
+}
+
+bool LogRetriever::addBatch(uint16_t msg_cnt) {
+  boost::mutex::scoped_lock lock(mutex_);
+  if (!progress_.active || !progress_.batch)
+    return false;
+  if (progress_.received > 0)
+    progress_.missing += static_cast<uint16_t>(msg_cnt - msg_cnt_ - 1);
+  msg_cnt_ = msg_cnt;
+  ++progress_.received;
+  last_time_ = ros::Time::now();
+  return true;
+}
+
+void LogRetriever::addBytes(uint32_t size) {
+  boost::mutex::scoped_lock lock(mutex_);
+  progress_.bytes += size;
+}
+
+void LogRetriever::checkTimeout() {
+  ublox_msgs::LogRETRIEVE m;
+  {
+    boost::mutex::scoped_lock lock(mutex_);
+    if (!progress_.active
+        || (ros::Time::now() - last_time_).toSec() < timeout_)
+      return;
+    if (progress_.batch) {
+      finish(progress_.missing == 0);
+      return;
+    }
+    if (!nextRequest(m)) {
+      finish(false);
+      return;
+    }
+  }
+  send(m);
+}
+
+void LogRetriever::finish(bool complete) {
+  progress_.active = false;
+  progress_.complete = complete;
+  progress_.elapsed = (last_time_ - start_time_).toSec();
+  if (progress_.elapsed > 0)
+    progress_.throughput = progress_.bytes / progress_.elapsed;
+}
+
+LogRetriever::Progress LogRetriever::progress() const {
+  boost::mutex::scoped_lock lock(mutex_);
+  Progress progress = progress_;
+  if (progress.active) {
+    progress.elapsed = (ros::Time::now() - start_time_).toSec();
+    if (progress.elapsed > 0)
+      progress.throughput = progress.bytes / progress.elapsed;
+  }
+  return progress;
+}
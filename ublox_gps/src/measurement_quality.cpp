@@ -0,0 +1,269 @@
+//==============================================================================
+// Copyright (c) 2012, Johannes Meyer, TU Darmstadt
+// All rights reserved.
+
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//     * Neither the name of the Flight Systems and Automatic Control group,
+//       TU Darmstadt, nor the names of its contributors may be used to
+//       endorse or promote products derived from this software without
+//       specific prior written permission.
+
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" 
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE 
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE 
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER BE LIABLE FOR ANY
+// DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+// (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+// LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+// ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+// SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//==============================================================================
+
+#include "ublox_gps/measurement_quality.h"
+#include <cmath>
+
+using namespace ublox_node;
+
+constexpr std::size_t MeasurementQuality::kNumSig;
+constexpr double MeasurementQuality::kMaxGap;
+constexpr double MeasurementQuality::kLocktimeTolerance;
+constexpr double MeasurementQuality::kMaxLocktime;
+constexpr double MeasurementQuality::kCodePhaseWindow;
+constexpr double MeasurementQuality::kCodePhaseMinEpochs;
+constexpr double MeasurementQuality::kCnoWindow;
+constexpr double MeasurementQuality::kCnoDrop;
+
+namespace {
+
+//! Number of GNSS identifiers
+const std::size_t kNumGnss = 8;
+//! Number of satellite identifiers per GNSS
+const std::size_t kNumSv = 256;
+//! Speed of light [m/s]
+const double kSpeedOfLight = 299792458.0;
+
+}  // namespace
+
+MeasurementQuality::MeasurementQuality(double doppler_threshold,
+                                       double code_phase_threshold)
+    : doppler_threshold_(doppler_threshold),
+      code_phase_threshold_(code_phase_threshold),
+      index_(kNumGnss * kNumSv * kNumSig, -1) {}
+
+double MeasurementQuality::wavelength(uint8_t gnss_id, uint8_t sig_id,
+                                      uint8_t freq_id) {
+  double frequency = 0;  // [MHz]
+  switch (gnss_id) {
+    case 0:  // GPS: L1C/A, L2 CL & CM
+    case 5:  // QZSS: L1C/A, L2 CM & CL
+      frequency = sig_id < 3 ? 1575.42 : 1227.60;
+      break;
+    case 1:  // SBAS: L1C/A
+      frequency = 1575.42;
+      break;
+    case 2:  // Galileo: E1 C & B, E5b I & Q
+      frequency = sig_id < 2 ? 1575.42 : 1207.14;
+      break;
+    case 3:  // BeiDou: B1I D1 & D2, B2I D1 & D2
+      frequency = sig_id < 2 ? 1561.098 : 1207.14;
+      break;
+    case 6:  // GLONASS: L1OF, L2OF
+      frequency = sig_id < 2 ? 1602.0 + (freq_id - 7) * 0.5625
+          : 1246.0 + (freq_id - 7) * 0.4375;
+      break;
+    default:
+      return 0;
+  }
+  return kSpeedOfLight / (frequency * 1e6);
+}
+
+std::size_t MeasurementQuality::row(uint8_t gnss_id, uint8_t sv_id,
+                                    uint8_t sig_id) {
+  int16_t& i = index_[(gnss_id * kNumSv + sv_id) * kNumSig + sig_id];
+  if (i >= 0)
+    return i;
+  i = tow_.size();
+  tow_.push_back(0);
+  cp_.push_back(0);
+  doppler_.push_back(0);
+  locktime_.push_back(0);
+  cp_valid_.push_back(0);
+  sub_half_.push_back(0);
+  code_phase_.push_back(0);
+  code_phase_n_.push_back(0);
+  cno_.push_back(-1);
+  return i;
+}
+
+void MeasurementQuality::process(const ublox_msgs::RxmRAWX& m,
+                                 ublox_msgs::RxmQuality& quality) {
+  typedef ublox_msgs::RxmRAWX_Meas Meas;
+  quality.rcvTOW = m.rcvTOW;
+  quality.week = m.week;
+  quality.numMeas = 0;
+  quality.numPrValid = 0;
+  quality.numCpValid = 0;
+  quality.numHalfCycUnresolved = 0;
+  quality.numSlips = 0;
+  quality.numCnoDrops = 0;
+  quality.meanCno = 0;
+  quality.minCno = 0;
+  quality.maxCno = 0;
+  quality.rmsDopplerResidual = 0;
+  quality.slips.clear();
+
+  // Gather the measurements of the epoch
+  rows_.clear();
+  e_gnss_id_.clear();
+  e_sv_id_.clear();
+  e_sig_id_.clear();
+  e_cp_.clear();
+  e_pr_.clear();
+  e_doppler_.clear();
+  e_locktime_.clear();
+  e_cp_valid_.clear();
+  e_pr_valid_.clear();
+  e_half_valid_.clear();
+  e_sub_half_.clear();
+  e_cno_.clear();
+  e_wavelength_.clear();
+  for (std::size_t j = 0; j < m.meas.size(); ++j) {
+    const Meas& meas = m.meas[j];
+    // The signal identifier is reserved in version 0
+    const uint8_t sig_id = m.version >= 1 ? meas.reserved0 : 0;
+    if (meas.gnssId >= kNumGnss || sig_id >= kNumSig)
+      continue;
+    rows_.push_back(row(meas.gnssId, meas.svId, sig_id));
+    e_gnss_id_.push_back(meas.gnssId);
+    e_sv_id_.push_back(meas.svId);
+    e_sig_id_.push_back(sig_id);
+    e_cp_.push_back(meas.cpMes);
+    e_pr_.push_back(meas.prMes);
+    e_doppler_.push_back(meas.doMes);
+    e_locktime_.push_back(meas.locktime);
+    e_cp_valid_.push_back((meas.trkStat & Meas::TRK_STAT_CP_VALID) != 0);
+    e_pr_valid_.push_back((meas.trkStat & Meas::TRK_STAT_PR_VALID) != 0);
+    e_half_valid_.push_back((meas.trkStat & Meas::TRK_STAT_HALF_CYC) != 0);
+    e_sub_half_.push_back((meas.trkStat & Meas::TRK_STAT_SUB_HALF_CYC) != 0);
+    e_cno_.push_back(meas.cno > 0 ? meas.cno : 0);
+    e_wavelength_.push_back(wavelength(meas.gnssId, sig_id, meas.freqId));
+  }
+  const std::size_t n = rows_.size();
+  e_flags_.resize(n);
+  e_doppler_residual_.resize(n);
+  e_code_phase_jump_.resize(n);
+  if (n == 0)
+    return;
+
+  // The phase jumps with the receiver clock, skip the Doppler test
+  const double doppler_test =
+      (m.recStat & m.REC_STAT_CLK_RESET) ? 0 : 1;
+
+  // Slip tests
+  double residual_sum = 0;
+  double residual_n = 0;
+  for (std::size_t i = 0; i < n; ++i) {
+    const std::size_t r = rows_[i];
+    const double dt = m.rcvTOW - tow_[r];
+    const bool continuous = cp_valid_[r] * e_cp_valid_[i] > 0 && dt > 0
+        && dt <= kMaxGap;
+
+    const double expected_locktime =
+        std::fmin(locktime_[r] + dt * 1000, kMaxLocktime);
+    const bool lock_reset =
+        e_locktime_[i] + kLocktimeTolerance < expected_locktime;
+    const bool half_cycle =
+        e_half_valid_[i] > 0 && e_sub_half_[i] != sub_half_[r];
+
+    const double predicted = cp_[r] - 0.5 * (doppler_[r] + e_doppler_[i]) * dt;
+    const double residual = e_cp_[i] - predicted;
+    const bool doppler =
+        doppler_test * std::fabs(residual) > doppler_threshold_;
+
+    const double jump = e_cp_[i] * e_wavelength_[i] - e_pr_[i]
+        - code_phase_[r];
+    const bool code_phase = e_pr_valid_[i] > 0 && e_wavelength_[i] > 0
+        && code_phase_n_[r] >= kCodePhaseMinEpochs
+        && std::fabs(jump) > code_phase_threshold_;
+
+    const uint8_t flags = continuous
+        * (lock_reset * ublox_msgs::SignalSlip::FLAGS_LOCK_RESET
+           | half_cycle * ublox_msgs::SignalSlip::FLAGS_HALF_CYCLE
+           | doppler * ublox_msgs::SignalSlip::FLAGS_DOPPLER
+           | code_phase * ublox_msgs::SignalSlip::FLAGS_CODE_PHASE);
+    e_flags_[i] = flags;
+    e_doppler_residual_[i] = residual;
+    e_code_phase_jump_[i] = jump;
+    const double clean = continuous && flags == 0 ? doppler_test : 0;
+    residual_sum += clean * residual * residual;
+    residual_n += clean;
+  }
+
+  // Update the signal states & the cno statistics
+  double cno_sum = 0;
+  double cno_min = e_cno_[0];
+  double cno_max = e_cno_[0];
+  uint32_t cno_drops = 0;
+  for (std::size_t i = 0; i < n; ++i) {
+    const std::size_t r = rows_[i];
+    const bool continuous = e_flags_[i] == 0 && cp_valid_[r] > 0
+        && e_cp_valid_[i] > 0 && m.rcvTOW - tow_[r] <= kMaxGap;
+    tow_[r] = m.rcvTOW;
+    cp_[r] = e_cp_[i];
+    doppler_[r] = e_doppler_[i];
+    locktime_[r] = e_locktime_[i];
+    cp_valid_[r] = e_cp_valid_[i];
+    sub_half_[r] = e_sub_half_[i];
+
+    // Restart the phase minus code average after a slip
+    const double valid =
+        e_cp_valid_[i] * e_pr_valid_[i] * (e_wavelength_[i] > 0);
+    const double pmc = e_cp_[i] * e_wavelength_[i] - e_pr_[i];
+    const double average = continuous ? code_phase_[r] : 0;
+    const double count = std::fmin(
+        (continuous ? code_phase_n_[r] : 0) + valid, kCodePhaseWindow);
+    code_phase_[r] = count > 0 ? average + (pmc - average) * valid / count
+        : 0;
+    code_phase_n_[r] = count;
+
+    const double cno = e_cno_[i];
+    cno_drops += cno_[r] >= 0 && cno + kCnoDrop <= cno_[r];
+    cno_[r] = cno_[r] >= 0 ? cno_[r] + (cno - cno_[r]) / kCnoWindow : cno;
+    cno_sum += cno;
+    cno_min = std::fmin(cno_min, cno);
+    cno_max = std::fmax(cno_max, cno);
+  }
+
+  // Summary
+  quality.numMeas = n;
+  for (std::size_t i = 0; i < n; ++i) {
+    quality.numPrValid += e_pr_valid_[i] > 0;
+    quality.numCpValid += e_cp_valid_[i] > 0;
+    quality.numHalfCycUnresolved += e_cp_valid_[i] > 0
+        && e_half_valid_[i] == 0;
+    if (e_flags_[i] == 0)
+      continue;
+    ublox_msgs::SignalSlip slip;
+    slip.gnssId = e_gnss_id_[i];
+    slip.svId = e_sv_id_[i];
+    slip.sigId = e_sig_id_[i];
+    slip.flags = e_flags_[i];
+    slip.dopplerResidual = e_doppler_residual_[i];
+    slip.codePhaseJump = e_code_phase_jump_[i];
+    quality.slips.push_back(slip);
+  }
+  quality.numSlips = quality.slips.size();
+  quality.numCnoDrops = cno_drops;
+  quality.meanCno = cno_sum / n;
+  quality.minCno = cno_min;
+  quality.maxCno = cno_max;
+  if (residual_n > 0)
+    quality.rmsDopplerResidual = std::sqrt(residual_sum / residual_n);
+}
@@ -0,0 +1,224 @@
+//==============================================================================
+// Copyright (c) 2012, Johannes Meyer, TU Darmstadt
+// All rights reserved.
+
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//     * Neither the name of the Flight Systems and Automatic Control group,
+//       TU Darmstadt, nor the names of its contributors may be used to
+//       endorse or promote products derived from this software without
+//       specific prior written permission.
+
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" 
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE 
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE 
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER BE LIABLE FOR ANY
+// DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+// (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+// LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+// ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+// SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//==============================================================================
+
+#include "ublox_gps/metrics_exporter.h"
+#include <limits>
+#include <boost/asio/placeholders.hpp>
+#include <boost/asio/read_until.hpp>
+#include <boost/asio/streambuf.hpp>
+#include <boost/asio/write.hpp>
+#include <boost/bind.hpp>
+#include <boost/enable_shared_from_this.hpp>
+#include <ros/console.h>
+
+using namespace ublox_node;
+
+constexpr int MetricsExporter::kSessionTimeout;
+constexpr int MetricsExporter::kAcceptRetryDelay;
+
+//! Upper bounds of the RTCM latency histogram buckets [s]
+static const double kRtcmLatencyBounds[] = {0.0005, 0.001, 0.0025, 0.005,
+                                            0.01, 0.025, 0.05, 0.1};
+
+NodeMetrics::NodeMetrics() :
+    fix_type(-1), fix_ok(false), num_sv(0), h_acc(0), v_acc(0),
+    last_rtcm(0), rtcm_messages(0), rtcm_bytes(0),
+    rtcm_latency(std::vector<double>(kRtcmLatencyBounds, kRtcmLatencyBounds +
+        sizeof(kRtcmLatencyBounds) / sizeof(kRtcmLatencyBounds[0]))) {}
+
+void MetricsWriter::family(const std::string& name, const std::string& type,
+                           const std::string& help) {
+  out_ << "# HELP " << name << " " << help << "\n"
+       << "# TYPE " << name << " " << type << "\n";
+}
+
+void MetricsWriter::sample(const std::string& name, double value,
+                           const std::string& labels) {
+  out_ << name;
+  if (!labels.empty())
+    out_ << "{" << labels << "}";
+  out_.precision(std::numeric_limits<double>::digits10);
+  out_ << " " << value << "\n";
+}
+
+void MetricsWriter::histogram(const std::string& name,
+                              const std::string& help,
+                              const ublox_gps::Histogram::Snapshot& snapshot) {
+  family(name, "histogram", help);
+  for (std::size_t i = 0; i < snapshot.bounds.size(); ++i) {
+    std::ostringstream le;
+    le << "le=\"" << snapshot.bounds[i] << "\"";
+    sample(name + "_bucket", snapshot.counts[i], le.str());
+  }
+  sample(name + "_bucket", snapshot.count, "le=\"+Inf\"");
+  sample(name + "_sum", snapshot.sum);
+  sample(name + "_count", snapshot.count);
+}
+
+//! An accepted connection
+struct MetricsExporter::Session {
+  explicit Session(boost::asio::io_service& io_service) :
+      socket(io_service), timer(io_service), request(4096) {}
+
+  boost::asio::ip::tcp::socket socket; //!< The connection
+  boost::asio::deadline_timer timer; //!< Closes the connection on timeout
+  boost::asio::streambuf request; //!< The request, limited to 4 KiB
+  std::string response; //!< The response
+};
+
+MetricsExporter::MetricsExporter(const std::string& address, uint16_t port,
+                                 const Render& render) :
+    address_(address), port_(port), render_(render), acceptor_(io_service_),
+    accept_timer_(io_service_), scrapes_(0) {}
+
+MetricsExporter::~MetricsExporter() { stop(); }
+
+bool MetricsExporter::start() {
+  try {
+    boost::asio::ip::tcp::endpoint endpoint(
+        boost::asio::ip::address::from_string(address_), port_);
+    acceptor_.open(endpoint.protocol());
+    acceptor_.set_option(boost::asio::ip::tcp::acceptor::reuse_address(true));
+    acceptor_.bind(endpoint);
+    acceptor_.listen();
+  } catch (std::exception& e) {
+    ROS_ERROR("Failed to serve the metrics on %s:%u: %s", address_.c_str(),
+              port_, e.what());
+    return false;
+  }
+  accept();
+  thread_ = boost::thread(
+      boost::bind(&boost::asio::io_service::run, &io_service_));
+  ROS_INFO("Serving the metrics on http://%s:%u/metrics", address_.c_str(),
+           port_);
+  return true;
+}
+
+void MetricsExporter::stop() {
+  io_service_.stop();
+  if (thread_.joinable())
+    thread_.join();
+}
+
+void MetricsExporter::accept() {
+  boost::shared_ptr<Session> session(new Session(io_service_));
+  acceptor_.async_accept(session->socket,
+                         boost::bind(&MetricsExporter::handleAccept, this,
+                                     session,
+                                     boost::asio::placeholders::error));
+}
+
+void MetricsExporter::handleAccept(boost::shared_ptr<Session> session,
+                                   const boost::system::error_code& error) {
+  if (!acceptor_.is_open())
+    return;
+  if (error) {
+    // Errors such as EMFILE persist, so don't retry immediately
+    ROS_WARN_THROTTLE(60, "Failed to accept a metrics connection: %s",
+                      error.message().c_str());
+    accept_timer_.expires_from_now(
+        boost::posix_time::milliseconds(kAcceptRetryDelay));
+    accept_timer_.async_wait(
+        boost::bind(&MetricsExporter::handleAcceptRetry, this,
+                    boost::asio::placeholders::error));
+    return;
+  }
+  session->timer.expires_from_now(boost::posix_time::seconds(kSessionTimeout));
+  session->timer.async_wait(boost::bind(&MetricsExporter::handleTimeout, this,
+                                        session,
+                                        boost::asio::placeholders::error));
+  boost::asio::async_read_until(session->socket, session->request,
+                                "\r\n\r\n",
+                                boost::bind(&MetricsExporter::handleRequest,
+                                            this, session,
+                                            boost::asio::placeholders::error));
+  accept();
+}
+
+void MetricsExporter::handleAcceptRetry(
+    const boost::system::error_code& error) {
+  if (!error && acceptor_.is_open())
+    accept();
+}
+
+void MetricsExporter::handleTimeout(boost::shared_ptr<Session> session,
+                                    const boost::system::error_code& error) {
+  if (error == boost::asio::error::operation_aborted)
+    return;
+  // Cancels the pending read or write of the session
+  boost::system::error_code ignored;
+  session->socket.close(ignored);
+}
+
+void MetricsExporter::handleRequest(boost::shared_ptr<Session> session,
+                                    const boost::system::error_code& error) {
+  if (error) {
+    boost::system::error_code ignored;
+    session->timer.cancel(ignored);
+    return;
+  }
+  std::istream request(&session->request);
+  std::string method, target;
+  request >> method >> target;
+  std::string status, content_type, body;
+  if (method != "GET") {
+    status = "405 Method Not Allowed";
+    content_type = "text/plain";
+    body = "Method not allowed\n";
+  } else if (target == "/metrics") {
+    status = "200 OK";
+    content_type = "text/plain; version=0.0.4; charset=utf-8";
+    body = render_();
+    ++scrapes_;
+  } else {
+    status = "404 Not Found";
+    content_type = "text/plain";
+    body = "Not found, the metrics are served on /metrics\n";
+  }
+  std::ostringstream response;
+  response << "HTTP/1.1 " << status << "\r\n"
+           << "Content-Type: " << content_type << "\r\n"
+           << "Content-Length: " << body.size() << "\r\n"
+           << "Connection: close\r\n\r\n" << body;
+  session->response = response.str();
+  // The session is kept alive by the handler until the response is sent
+  boost::asio::async_write(session->socket,
+                           boost::asio::buffer(session->response),
+                           boost::bind(&MetricsExporter::handleResponse,
+                                       this, session,
+                                       boost::asio::placeholders::error));
+}
+
+void MetricsExporter::handleResponse(boost::shared_ptr<Session> session,
+                                     const boost::system::error_code& error) {
+  boost::system::error_code ignored;
+  session->timer.cancel(ignored);
+  session->socket.shutdown(boost::asio::ip::tcp::socket::shutdown_both,
+                           ignored);
+  session->socket.close(ignored);
+}
@@ -0,0 +1,160 @@
+//==============================================================================
+// Copyright (c) 2012, Johannes Meyer, TU Darmstadt
+// All rights reserved.
+
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//     * Neither the name of the Flight Systems and Automatic Control group,
+//       TU Darmstadt, nor the names of its contributors may be used to
+//       endorse or promote products derived from this software without
+//       specific prior written permission.
+
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" 
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE 
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE 
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER BE LIABLE FOR ANY
+// DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+// (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+// LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+// ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+// SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//==============================================================================
+
+#include "ublox_gps/moving_base.h"
+#include <algorithm>
+#include <cmath>
+
+using namespace ublox_node;
+
+MovingBaseSynchronizer::MovingBaseSynchronizer(double max_delay)
+    : max_delay_(max_delay), latency_sum_(0) {
+  statistics_.matched = 0;
+  statistics_.unmatched_base = 0;
+  statistics_.unmatched_rover = 0;
+  statistics_.last_latency = 0;
+  statistics_.mean_latency = 0;
+  statistics_.max_latency = 0;
+}
+
+void MovingBaseSynchronizer::expire(const ros::Time& now) {
+  while (!base_.empty()
+         && (now - base_.begin()->second.stamp).toSec() > max_delay_) {
+    base_.erase(base_.begin());
+    ++statistics_.unmatched_base;
+  }
+  while (!rover_.empty()
+         && (now - rover_.begin()->second.stamp).toSec() > max_delay_) {
+    rover_.erase(rover_.begin());
+    ++statistics_.unmatched_rover;
+  }
+}
+
+void MovingBaseSynchronizer::addBase(const ublox_msgs::NavPVT& m) {
+  const ros::Time now = ros::Time::now();
+  boost::mutex::scoped_lock lock(mutex_);
+  expire(now);
+  std::map<uint32_t, Pending<ublox_msgs::NavRELPOSNED9> >::iterator rover =
+      rover_.find(m.iTOW);
+  if (rover == rover_.end()) {
+    Pending<ublox_msgs::NavPVT>& pending = base_[m.iTOW];
+    pending.message = m;
+    pending.stamp = now;
+    return;
+  }
+  const Pending<ublox_msgs::NavRELPOSNED9> matched = rover->second;
+  rover_.erase(rover);
+  match(m, now, matched.message, matched.stamp, lock);
+}
+
+void MovingBaseSynchronizer::addRover(const ublox_msgs::NavRELPOSNED9& m) {
+  const ros::Time now = ros::Time::now();
+  boost::mutex::scoped_lock lock(mutex_);
+  expire(now);
+  std::map<uint32_t, Pending<ublox_msgs::NavPVT> >::iterator base =
+      base_.find(m.iTow);
+  if (base == base_.end()) {
+    Pending<ublox_msgs::NavRELPOSNED9>& pending = rover_[m.iTow];
+    pending.message = m;
+    pending.stamp = now;
+    return;
+  }
+  const Pending<ublox_msgs::NavPVT> matched = base->second;
+  base_.erase(base);
+  match(matched.message, matched.stamp, m, now, lock);
+}
+
+void MovingBaseSynchronizer::match(const ublox_msgs::NavPVT& base,
+                                   const ros::Time& base_stamp,
+                                   const ublox_msgs::NavRELPOSNED9& rover,
+                                   const ros::Time& rover_stamp,
+                                   boost::mutex::scoped_lock& lock) {
+  const double latency = (rover_stamp - base_stamp).toSec();
+  ++statistics_.matched;
+  latency_sum_ += latency;
+  statistics_.last_latency = latency;
+  statistics_.mean_latency = latency_sum_ / statistics_.matched;
+  statistics_.max_latency = std::max(statistics_.max_latency,
+                                     std::fabs(latency));
+  lock.unlock();
+
+  if (!callback_)
+    return;
+  ublox_msgs::MovingBasePose pose;
+  combine(base, rover, pose);
+  pose.header.stamp = std::max(base_stamp, rover_stamp);
+  pose.latency = latency;
+  callback_(pose);
+}
+
+MovingBaseSynchronizer::Statistics
+MovingBaseSynchronizer::statistics() const {
+  boost::mutex::scoped_lock lock(mutex_);
+  return statistics_;
+}
+
+void MovingBaseSynchronizer::combine(const ublox_msgs::NavPVT& base,
+                                     const ublox_msgs::NavRELPOSNED9& rover,
+                                     ublox_msgs::MovingBasePose& pose) {
+  pose.iTOW = base.iTOW;
+
+  pose.fixType = base.fixType;
+  pose.lat = base.lat * 1e-7;
+  pose.lon = base.lon * 1e-7;
+  pose.height = base.height * 1e-3;
+  pose.hAcc = base.hAcc * 1e-3;
+  pose.vAcc = base.vAcc * 1e-3;
+
+  // Components in cm & high precision components in 0.1 mm
+  pose.relPosN = rover.relPosN * 1e-2 + rover.relPosHPN * 1e-4;
+  pose.relPosE = rover.relPosE * 1e-2 + rover.relPosHPE * 1e-4;
+  pose.relPosD = rover.relPosD * 1e-2 + rover.relPosHPD * 1e-4;
+  pose.relPosLength = rover.relPosLength * 1e-2 + rover.relPosHPLength * 1e-4;
+  pose.accN = rover.accN * 1e-4;
+  pose.accE = rover.accE * 1e-4;
+  pose.accD = rover.accD * 1e-4;
+  pose.accLength = rover.accLength * 1e-4;
+  pose.relPosValid =
+      (rover.flags & ublox_msgs::NavRELPOSNED9::FLAGS_REL_POS_VALID) != 0;
+  switch (rover.flags & ublox_msgs::NavRELPOSNED9::FLAGS_CARR_SOLN_MASK) {
+    case ublox_msgs::NavRELPOSNED9::FLAGS_CARR_SOLN_FLOAT:
+      pose.carrSoln = ublox_msgs::MovingBasePose::CARR_SOLN_FLOAT;
+      break;
+    case ublox_msgs::NavRELPOSNED9::FLAGS_CARR_SOLN_FIXED:
+      pose.carrSoln = ublox_msgs::MovingBasePose::CARR_SOLN_FIXED;
+      break;
+    default:
+      pose.carrSoln = ublox_msgs::MovingBasePose::CARR_SOLN_NONE;
+  }
+
+  // Heading in 1e-5 deg
+  pose.heading = rover.relPosHeading * 1e-5;
+  pose.headingAcc = rover.accHeading * 1e-5;
+  pose.headingValid = (rover.flags
+      & ublox_msgs::NavRELPOSNED9::FLAGS_REL_POS_HEAD_VALID) != 0;
+}
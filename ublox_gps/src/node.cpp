@@ -28,17 +28,53 @@
 //==============================================================================
 
 #include "ublox_gps/node.h"
+#include <algorithm>
 #include <cmath>
+#include <cstdio>
 #include <string>
 #include <sstream>
-#include <rtcm_msgs/Message.h>
-
-ros::Subscriber subRTCM;
 
 using namespace ublox_node;
 
+namespace {
+
+/**
+ * @brief A message which can be stored in the history.
+ */
+struct HistoryMessage {
+  const char* name; //!< The name, as in the history/messages parameter
+  uint8_t class_id; //!< The u-blox message class ID
+  uint8_t message_id; //!< The u-blox message ID
+  int itow_offset; //!< Offset of the iTOW in the payload
+};
+
+//! The messages which can be stored in the history
+const HistoryMessage kHistoryMessages[] = {
+  {"nav_pvt", ublox_msgs::Class::NAV, ublox_msgs::Message::NAV::PVT, 0},
+  {"nav_relposned", ublox_msgs::Class::NAV,
+   ublox_msgs::Message::NAV::RELPOSNED, 4},
+  {"nav_status", ublox_msgs::Class::NAV, ublox_msgs::Message::NAV::STATUS, 0},
+  {"esf_status", ublox_msgs::Class::ESF, ublox_msgs::Message::ESF::STATUS, 0},
+};
+
+/**
+ * @brief Find a message which can be stored in the history by name.
+ * @return the message or 0 if the name is unknown
+ */
+const HistoryMessage* findHistoryMessage(const std::string& name) {
+  for (std::size_t i = 0;
+       i < sizeof(kHistoryMessages) / sizeof(kHistoryMessages[0]); ++i)
+    if (name == kHistoryMessages[i].name)
+      return &kHistoryMessages[i];
+  return 0;
+}
+
+}  // namespace
+
 //! How long to wait during I/O reset [s]
 constexpr static int kResetWait = 10;
+//! The device which is bound by unique chip ID, see discoverDevices
+constexpr static char kDiscover[] = "discover";
 
 //
 // ublox_node namespace
@@ -87,10 +123,16 @@ uint8_t ublox_node::fixModeFromString(const std::string& mode) {
                            " is not a valid fix mode.");
 }
 
+void ublox_node::updateDiagnostics() {
+  if (shed_diagnostics && gps.isOverloaded()) return;
+  updater->update();
+}
+
 //
 // u-blox ROS Node
 //
-UbloxNode::UbloxNode() {
+UbloxNode::UbloxNode() : config_state_(CONFIG_PENDING), rtcm_failed_(0),
+                         ephemeris_position_valid_(false) {
   initialize();
 }
 
@@ -137,6 +179,7 @@ void UbloxNode::addProductInterface(std::string product_category,
 
 void UbloxNode::getRosParams() {
   nh->param("device", device_, std::string("/dev/ttyACM0"));
+  nh->param("redundant_device", redundant_device_, std::string(""));
   nh->param("frame_id", frame_id, std::string("gps"));
 
   // Save configuration parameters
@@ -227,16 +270,249 @@ void UbloxNode::getRosParams() {
 
   // activate/deactivate any config
   nh->param("config_on_startup", config_on_startup_flag_, true);
+  // configure the device after subscribing
+  nh->param("config_in_background", config_in_background_, false);
+  // monitor the configuration & apply it again after a reset or drift
+  if (nh->param("config_monitor/enable", false)) {
+    if (!config_on_startup_flag_)
+      throw std::runtime_error(
+          "config_monitor/enable requires config_on_startup");
+    nh->param("config_monitor/period", config_monitor_period_, 2.0);
+    if (config_monitor_period_ <= 0)
+      throw std::runtime_error("config_monitor/period must be > 0");
+    config_monitor_.reset(new ConfigMonitor(gps.getConfigShadow()));
+  }
 
   // raw data stream logging 
   rawDataStreamPa_.getRosParams();
+
+  // Dispatch time-critical messages first
+  nh->param("dispatch/prioritize", prioritize_, false);
+
+  // Overload shedding
+  nh->param("overload/enable", overload_, false);
+  getRosUint("overload/max_pending", overload_max_pending_, 16384);
+  nh->param("overload/max_lag", overload_max_lag_, 1.0);
+  nh->param("overload/restore_time", overload_restore_time_, 5.0);
+  std::vector<std::string> default_shed;
+  default_shed.push_back("nav_sat");
+  default_shed.push_back("mon");
+  default_shed.push_back("inf");
+  default_shed.push_back("diagnostics");
+  nh->param("overload/shed", overload_shed_, default_shed);
+  checkMin(overload_max_lag_, 0, "overload/max_lag");
+  checkMin(overload_restore_time_, 0, "overload/restore_time");
+
+  // Coalesce the reads to wake the I/O thread less often
+  nh->param("read/coalesce", read_coalescing_.enabled, false);
+  getRosUint("read/min_bytes", read_coalescing_.min_bytes, 256);
+  nh->param("read/max_latency", read_coalescing_.max_latency, 0.02);
+  if (read_coalescing_.enabled && read_coalescing_.max_latency <= 0)
+    throw std::runtime_error("read/max_latency must be > 0");
+  // The timing outputs are paired with the read time, a held read would add
+  // up to read/max_latency of jitter and bias
+  if (read_coalescing_.enabled) {
+    const char* timing[] = {"chrony/enable", "geotag/enable",
+                            "publish/tim/tm2"};
+    for (size_t i = 0; i < sizeof(timing) / sizeof(timing[0]); ++i) {
+      if (nh->param(timing[i], false)) {
+        ROS_WARN("read/coalesce is not compatible with %s, %s", timing[i],
+                 "disabling the read coalescing");
+        read_coalescing_.enabled = false;
+        break;
+      }
+    }
+  }
+  for (size_t i = 0; i < overload_shed_.size(); ++i) {
+    const std::string& shed = overload_shed_[i];
+    if (shed != "nav_sat" && shed != "mon" && shed != "inf" && shed != "rxm"
+        && shed != "diagnostics")
+      throw std::runtime_error("Invalid settings: overload/shed " + shed +
+          " is not one of nav_sat, mon, inf, rxm or diagnostics");
+    if (shed == "diagnostics")
+      shed_diagnostics = overload_;
+  }
+
+  // Satellite table
+  nh->param("satellite_table/enable", satellite_table_enabled_, false);
+  nh->param("satellite_table/rate", satellite_table_rate_, 1.0);
+  uint8_t cno_threshold;
+  getRosUint("satellite_table/cno_threshold", cno_threshold, 1);
+  checkMin(satellite_table_rate_, 0, "satellite_table/rate");
+  if (satellite_table_enabled_)
+    satellite_table_.reset(new SatelliteTable(cno_threshold));
+
+  // Satellite orbits & clocks
+  if (nh->param("ephemeris/enable", false)) {
+    ephemeris_.reset(new EphemerisEngine);
+    double min_elevation;
+    nh->param("ephemeris/max_residual", ephemeris_max_residual_, 100.0);
+    nh->param("ephemeris/min_elevation", min_elevation, 10.0);
+    checkMin(ephemeris_max_residual_, 0, "ephemeris/max_residual");
+    ephemeris_min_elevation_ = min_elevation * M_PI / 180;
+  }
+  // Measurement quality
+  if (nh->param("quality/enable", false)) {
+    double doppler_threshold, code_phase_threshold;
+    nh->param("quality/doppler_threshold", doppler_threshold, 1.0);
+    nh->param("quality/code_phase_threshold", code_phase_threshold, 10.0);
+    checkMin(doppler_threshold, 0, "quality/doppler_threshold");
+    checkMin(code_phase_threshold, 0, "quality/code_phase_threshold");
+    measurement_quality_.reset(
+        new MeasurementQuality(doppler_threshold, code_phase_threshold));
+  }
+  // Message history
+  nh->param("history/enable", history_enabled_, false);
+  nh->param("history/duration", history_duration_, 600.0);
+  getRosUint("history/budget", history_budget_, 1048576);
+  std::vector<std::string> default_history;
+  default_history.push_back("nav_pvt");
+  default_history.push_back("nav_relposned");
+  default_history.push_back("nav_status");
+  default_history.push_back("esf_status");
+  nh->param("history/messages", history_messages_, default_history);
+  nh->param("history/directory", history_directory_, std::string("/tmp"));
+  checkMin(history_duration_, 0, "history/duration");
+  for (size_t i = 0; i < history_messages_.size(); ++i)
+    if (!findHistoryMessage(history_messages_[i]))
+      throw std::runtime_error("Invalid settings: history/messages " +
+          history_messages_[i] + " is not one of nav_pvt, nav_relposned, " +
+          "nav_status or esf_status");
+  // Navigation data decoding
+  if (nh->param("sfrbx/decode", false)) {
+    sfrbx_decoder_.reset(new SfrbxDecoder);
+    if (ephemeris_) {
+      typedef bool (EphemerisEngine::*Update)(const Ephemeris&);
+      sfrbx_decoder_->setEphemerisCallback(boost::bind(
+          static_cast<Update>(&EphemerisEngine::update), ephemeris_, _1));
+    }
+  }
+  // Moving base receiver connected to the same node
+  nh->param("moving_base/device", moving_base_device_, std::string(""));
+  if (!moving_base_device_.empty()) {
+    getRosUint("moving_base/baudrate", moving_base_baudrate_, baudrate_);
+    double max_delay;
+    nh->param("moving_base/max_delay", max_delay, 1.0);
+    checkMin(max_delay, 0, "moving_base/max_delay");
+    moving_base_.reset(new MovingBaseSynchronizer(max_delay));
+    last_moving_base_statistics_ = moving_base_->statistics();
+    moving_base_->setCallback(boost::bind(
+        &UbloxNode::publishMovingBasePose, this, _1));
+  }
+  // Bind the receivers to the probed ports by unique chip ID
+  discover_ = device_ == kDiscover || redundant_device_ == kDiscover
+      || moving_base_device_ == kDiscover;
+  if (discover_) {
+    nh->param("unique_id", unique_id_, std::string(""));
+    nh->param("moving_base/unique_id", moving_base_unique_id_,
+              std::string(""));
+    if (!nh->getParam("discovery/ports", discovery_ports_)) {
+      discovery_ports_.push_back("/dev/ttyACM*");
+      discovery_ports_.push_back("/dev/ttyUSB*");
+    }
+    nh->param("discovery/timeout", discovery_timeout_, 0.5);
+    if (discovery_timeout_ <= 0)
+      throw std::runtime_error("discovery/timeout must be > 0");
+    if (moving_base_device_ == kDiscover && moving_base_unique_id_.empty())
+      throw std::runtime_error(std::string("moving_base/device is ") +
+          kDiscover + ", therefore moving_base/unique_id must be set");
+    if (redundant_device_ == kDiscover && device_ != kDiscover
+        && unique_id_.empty())
+      throw std::runtime_error(std::string("redundant_device is ") +
+          kDiscover + ", therefore unique_id must be set");
+  }
+  // Geotagging of the TIM-TM2 time marks
+  if (nh->param("geotag/enable", false)) {
+    int buffer, max_pending;
+    double max_gap;
+    nh->param("geotag/buffer", buffer, 32);
+    checkMin(buffer, 2, "geotag/buffer");
+    nh->param("geotag/max_pending", max_pending, 256);
+    checkMin(max_pending, 1, "geotag/max_pending");
+    nh->param("geotag/max_gap", max_gap, 1.0);
+    checkMin(max_gap, 0, "geotag/max_gap");
+    nh->param("geotag/attitude", geotag_attitude_, false);
+    geotagger_.reset(new Geotagger(buffer, max_pending, max_gap,
+                                   nh->param("geotag/falling_edge", false)));
+    geotagger_->setCallback(boost::bind(&UbloxNode::publishGeotag, this, _1));
+  }
+  // Time samples for the chrony SHM refclock
+  if (nh->param("chrony/enable", false)) {
+    int unit;
+    uint32_t max_time_acc, max_freq_acc;
+    std::string pps_device;
+    nh->param("chrony/unit", unit, 0);
+    checkMin(unit, 0, "chrony/unit");
+    nh->param("chrony/pps_device", pps_device, std::string(""));
+    // The quantization error only applies to the PPS samples
+    chrony_qerr_ = nh->param("chrony/qerr", true) && !pps_device.empty();
+    getRosUint("chrony/max_time_acc", max_time_acc, 1000);
+    getRosUint("chrony/max_freq_acc", max_freq_acc, 0);
+    chrony_.reset(new ChronyRefclock(unit, pps_device, max_time_acc,
+                                     max_freq_acc));
+    if (!chrony_->open())
+      throw std::runtime_error("Could not open the chrony SHM refclock");
+  }
+  // Odometry in a local ENU frame
+  if (nh->param("odometry/enable", false)) {
+    std::string origin;
+    nh->param("odometry/origin", origin, std::string("first_fix"));
+    nh->param("odometry/frame_id", local_frame_id, std::string("enu"));
+    if (origin == "fixed") {
+      std::vector<double> lla;
+      if (!nh->getParam("odometry/origin_lla", lla) || lla.size() != 3)
+        throw std::runtime_error(std::string("odometry/origin is fixed, ") +
+            "therefore odometry/origin_lla must be set to [lat, lon, height]");
+      local_frame.reset(new LocalFrame(LocalFrame::ORIGIN_FIXED));
+      local_frame->setOrigin(lla[0], lla[1], lla[2]);
+    } else if (origin == "first_fix") {
+      local_frame.reset(new LocalFrame(LocalFrame::ORIGIN_FIRST_FIX));
+    } else if (origin == "survey_in") {
+      local_frame.reset(new LocalFrame(LocalFrame::ORIGIN_SURVEY_IN));
+    } else {
+      throw std::runtime_error("Invalid settings: odometry/origin " + origin +
+                               " is not one of fixed, first_fix or survey_in");
+    }
+  }
+  // Retrieval of the log & batches stored on the device
+  if (nh->param("log/enable", false)) {
+    uint32_t window, max_retries;
+    getRosUint("log/window", window, ublox_msgs::LogRETRIEVE::ENTRY_COUNT_MAX);
+    checkRange(window, 1, ublox_msgs::LogRETRIEVE::ENTRY_COUNT_MAX,
+               "log/window");
+    getRosUint("log/max_retries", max_retries, 3);
+    double timeout;
+    nh->param("log/timeout", timeout, 1.0);
+    checkMin(timeout, 0, "log/timeout");
+    nh->param("log/directory", log_directory_, std::string(""));
+    log_retriever_.reset(new LogRetriever(
+        boost::bind(&UbloxNode::requestLog, this, _1), window, timeout,
+        max_retries));
+  }
+  // Callback queues
+  nh->param("rtcm_topic", rtcm_topic_, std::string("rtcm"));
+  nh->param("rtcm/queue_size", rtcm_queue_size_, 10);
+  checkMin(rtcm_queue_size_, 1, "rtcm/queue_size");
+  nh->param("spinner_threads", spinner_threads_, 1);
+  checkMin(spinner_threads_, 1, "spinner_threads");
+  // Prometheus metrics endpoint
+  if (nh->param("metrics/enable", false)) {
+    std::string address;
+    nh->param("metrics/address", address, std::string("127.0.0.1"));
+    uint16_t port;
+    getRosUint("metrics/port", port, 9150);
+    metrics.reset(new NodeMetrics);
+    metrics_exporter_.reset(new MetricsExporter(
+        address, port, boost::bind(&UbloxNode::renderMetrics, this)));
+  }
 }
 
 void UbloxNode::pollMessages(const ros::TimerEvent& event) {
+  timer_latency_.add((event.current_real - event.current_expected).toSec());
   static std::vector<uint8_t> payload(1, 1);
   if (enabled["aid_alm"])
     gps.poll(ublox_msgs::Class::AID, ublox_msgs::Message::AID::ALM, payload);
-  if (enabled["aid_eph"])
+  if (enabled["aid_eph"] || ephemeris_)
     gps.poll(ublox_msgs::Class::AID, ublox_msgs::Message::AID::EPH, payload);
   if (enabled["aid_hui"])
     gps.poll(ublox_msgs::Class::AID, ublox_msgs::Message::AID::HUI);
@@ -336,10 +612,367 @@ void UbloxNode::subscribe() {
     gps.subscribe<ublox_msgs::AidHUI>(boost::bind(
         publish<ublox_msgs::AidHUI>, _1, "aidhui"), kSubscribeRate);
 
+  // Satellite table
+  if (satellite_table_) {
+    typedef void (SatelliteTable::*SatUpdate)(const ublox_msgs::NavSAT&);
+    typedef void (SatelliteTable::*SvInfoUpdate)(
+        const ublox_msgs::NavSVINFO&);
+    typedef void (SatelliteTable::*RawxUpdate)(const ublox_msgs::RxmRAWX&);
+    if (protocol_version_ >= 15)
+      gps.subscribe<ublox_msgs::NavSAT>(boost::bind(
+          static_cast<SatUpdate>(&SatelliteTable::update), satellite_table_,
+          _1), kNavSvInfoSubscribeRate);
+    else
+      gps.subscribe<ublox_msgs::NavSVINFO>(boost::bind(
+          static_cast<SvInfoUpdate>(&SatelliteTable::update),
+          satellite_table_, _1), kNavSvInfoSubscribeRate);
+    // Only used if RXM-RAWX is enabled, does not configure the rate
+    gps.subscribe<ublox_msgs::RxmRAWX>(boost::bind(
+        static_cast<RawxUpdate>(&SatelliteTable::update), satellite_table_,
+        _1));
+    if (satellite_table_rate_ > 0)
+      satellite_table_timer_ = nh->createTimer(
+          ros::Duration(1.0 / satellite_table_rate_),
+          &UbloxNode::publishSatelliteTable, this);
+    satellite_table_service_ = nh->advertiseService(
+        "get_satellite_table", &UbloxNode::getSatelliteTable, this);
+  }
+
+  // Satellite orbits & clocks, the messages are polled or enabled by the
+  // raw data components, does not configure their rates. The receiver
+  // position to check the states against RXM-RAWX is enabled.
+  if (ephemeris_) {
+    typedef void (EphemerisEngine::*RxmEphUpdate)(const ublox_msgs::RxmEPH&);
+    typedef void (EphemerisEngine::*AidEphUpdate)(const ublox_msgs::AidEPH&);
+    gps.subscribe<ublox_msgs::RxmEPH>(boost::bind(
+        static_cast<RxmEphUpdate>(&EphemerisEngine::update), ephemeris_,
+        _1));
+    gps.subscribe<ublox_msgs::AidEPH>(boost::bind(
+        static_cast<AidEphUpdate>(&EphemerisEngine::update), ephemeris_,
+        _1));
+    gps.subscribe<ublox_msgs::RxmRAWX>(boost::bind(
+        &UbloxNode::evaluateEphemeris, this, _1));
+    gps.subscribe<ublox_msgs::NavPOSECEF>(boost::bind(
+        &UbloxNode::updateEphemerisPosition, this, _1), kSubscribeRate);
+  }
+
+  // Message history
+  if (history_enabled_)
+    subscribeHistory();
+
+  // Measurement quality
+  if (measurement_quality_)
+    gps.subscribe<ublox_msgs::RxmRAWX>(boost::bind(
+        &UbloxNode::processMeasurementQuality, this, _1), kSubscribeRate);
+
+  // Navigation data
+  if (sfrbx_decoder_)
+    gps.subscribe<ublox_msgs::RxmSFRBX>(boost::bind(
+        &SfrbxDecoder::decode, sfrbx_decoder_, _1), kSubscribeRate);
+
+  // Moving base epochs, NAV-PVT of the moving base & NAV-RELPOSNED of the
+  // rover
+  if (moving_base_) {
+    moving_base_gps_->subscribe<ublox_msgs::NavPVT>(boost::bind(
+        &MovingBaseSynchronizer::addBase, moving_base_, _1), kSubscribeRate);
+    gps.subscribe<ublox_msgs::NavRELPOSNED9>(boost::bind(
+        &MovingBaseSynchronizer::addRover, moving_base_, _1), kSubscribeRate);
+  }
+
+  // Geotagging of the time marks, the device outputs the NAV-ATT of an epoch
+  // before its NAV-PVT
+  if (geotagger_) {
+    if (protocol_version_ <= 15) {
+      ROS_WARN("Geotagging requires firmware 8 or later (NAV-PVT)");
+    } else {
+      gps.subscribe<ublox_msgs::NavPVT>(boost::bind(
+          &Geotagger::addPvt, geotagger_, _1), kSubscribeRate);
+      if (geotag_attitude_)
+        gps.subscribe<ublox_msgs::NavATT>(boost::bind(
+            &Geotagger::addAttitude, geotagger_, _1), kSubscribeRate);
+      gps.subscribe<ublox_msgs::TimTM2>(boost::bind(
+          &Geotagger::addMark, geotagger_, _1), kSubscribeRate);
+    }
+  }
+
+  // chrony refclock
+  if (chrony_) {
+    gps.subscribe<ublox_msgs::NavTIMEUTC>(boost::bind(
+        &UbloxNode::chronyTimeUtc, this, _1), kSubscribeRate);
+    gps.subscribe<ublox_msgs::NavCLOCK>(boost::bind(
+        &ChronyRefclock::addClock, chrony_, _1), kSubscribeRate);
+    if (chrony_qerr_)
+      gps.subscribe<ublox_msgs::TimTP>(boost::bind(
+          &UbloxNode::chronyTimePulse, this, _1), kSubscribeRate);
+  }
+
+  // Configuration monitor, the polled blocks & the uptime
+  if (config_monitor_) {
+    using ublox_gps::ConfigShadow;
+    gps.subscribe<ublox_msgs::CfgRATE>(boost::bind(
+        &ConfigMonitor::check<ublox_msgs::CfgRATE>, config_monitor_, _1,
+        ConfigShadow::BLOCK_RATE));
+    gps.subscribe<ublox_msgs::CfgNAV5>(boost::bind(
+        &ConfigMonitor::check<ublox_msgs::CfgNAV5>, config_monitor_, _1,
+        ConfigShadow::BLOCK_NAV5));
+    gps.subscribe<ublox_msgs::CfgTMODE3>(boost::bind(
+        &ConfigMonitor::check<ublox_msgs::CfgTMODE3>, config_monitor_, _1,
+        ConfigShadow::BLOCK_TMODE3));
+    gps.subscribe<ublox_msgs::NavSTATUS>(boost::bind(
+        &ConfigMonitor::checkStatus, config_monitor_, _1));
+  }
+
+  // Log retrieval
+  if (log_retriever_)
+    subscribeLog();
+
   for(int i = 0; i < components_.size(); i++)
     components_[i]->subscribe();
 }
 
+void UbloxNode::evaluateEphemeris(const ublox_msgs::RxmRAWX& m) {
+  // The states are only checked against a known position
+  if (!ephemeris_position_valid_)
+    return;
+  ephemeris_->check(m, ephemeris_position_, ephemeris_min_elevation_,
+                    ephemeris_residuals_);
+}
+
+void UbloxNode::updateEphemerisPosition(const ublox_msgs::NavPOSECEF& m) {
+  // Called on the I/O thread, as evaluateEphemeris
+  if (m.pAcc > kEphemerisMaxPosAcc)
+    return;
+  ephemeris_position_[0] = m.ecefX * 1e-2;
+  ephemeris_position_[1] = m.ecefY * 1e-2;
+  ephemeris_position_[2] = m.ecefZ * 1e-2;
+  ephemeris_position_valid_ = true;
+}
+
+void UbloxNode::subscribeHistory() {
+  // Store the frames as received, the rates are set by the publishers
+  for (size_t i = 0; i < history_messages_.size(); ++i) {
+    const HistoryMessage* message = findHistoryMessage(history_messages_[i]);
+    boost::shared_ptr<HistoryRing> ring = history_.add(
+        message->name, history_budget_, history_duration_,
+        message->itow_offset);
+    gps.subscribeRaw(boost::bind(&HistoryRing::add, ring, _1, _2),
+                     message->class_id, message->message_id);
+  }
+  get_history_service_ = nh->advertiseService(
+      "get_history", &UbloxNode::getHistory, this);
+  save_history_service_ = nh->advertiseService(
+      "save_history", &UbloxNode::saveHistory, this);
+}
+
+bool UbloxNode::getHistory(ublox_msgs::GetHistory::Request& req,
+                           ublox_msgs::GetHistory::Response& res) {
+  history_.query(req.messages, req.use_itow, req.start, req.end,
+                 req.start_itow, req.end_itow, res.records);
+  return true;
+}
+
+bool UbloxNode::saveHistory(ublox_msgs::SaveHistory::Request& req,
+                            ublox_msgs::SaveHistory::Response& res) {
+  res.path = req.path;
+  if (res.path.empty()) {
+    std::ostringstream path;
+    path << history_directory_ << "/ublox_history_"
+         << boost::posix_time::to_iso_string(
+                boost::posix_time::second_clock::universal_time())
+         << ".ubx";
+    res.path = path.str();
+  }
+  res.numRecords = 0;
+  res.success = history_.save(res.path, res.numRecords);
+  if (res.success)
+    ROS_INFO("Saved %u messages of the history to %s", res.numRecords,
+             res.path.c_str());
+  return true;
+}
+
+void UbloxNode::processMeasurementQuality(const ublox_msgs::RxmRAWX& m) {
+  ublox_msgs::RxmQuality quality;
+  measurement_quality_->process(m, quality);
+  quality.header.stamp = ros::Time::now();
+  quality.header.frame_id = frame_id;
+  publish(quality, "rxmquality");
+}
+
+void UbloxNode::subscribeLog() {
+  // Only sent on request, does not configure the rates
+  gps.subscribe<ublox_msgs::LogRETRIEVEPOS>(boost::bind(
+      &UbloxNode::processLogRetrievePos, this, _1));
+  gps.subscribe<ublox_msgs::LogRETRIEVEPOSEXTRA>(boost::bind(
+      &UbloxNode::processLogRetrievePosExtra, this, _1));
+  gps.subscribe<ublox_msgs::LogRETRIEVESTRING>(boost::bind(
+      &UbloxNode::processLogRetrieveString, this, _1));
+  gps.subscribe<ublox_msgs::LogBATCH>(boost::bind(
+      &UbloxNode::processLogBatch, this, _1));
+  log_timer_ = nh->createTimer(ros::Duration(1.0),
+                               &UbloxNode::checkLogRetrieval, this, false,
+                               false);
+  retrieve_log_service_ = nh->advertiseService(
+      "retrieve_log", &UbloxNode::retrieveLog, this);
+}
+
+bool UbloxNode::retrieveLog(ublox_msgs::RetrieveLog::Request& req,
+                            ublox_msgs::RetrieveLog::Response& res) {
+  res.success = false;
+  res.numEntries = 0;
+  if (log_retriever_->progress().active) {
+    ROS_WARN("U-Blox: A log retrieval is already running");
+    return true;
+  }
+  uint32_t count = 0;
+  if (!req.batch) {
+    ublox_msgs::LogINFO info;
+    if (!gps.poll(info)) {
+      ROS_WARN("U-Blox: Failed to poll LOG-INFO");
+      return true;
+    }
+    if (req.startNumber < info.entryCount)
+      count = info.entryCount - req.startNumber;
+    if (req.entryCount > 0 && req.entryCount < count)
+      count = req.entryCount;
+  }
+
+  res.path = req.path;
+  if (res.path.empty() && !log_directory_.empty()) {
+    std::ostringstream path;
+    path << log_directory_ << (req.batch ? "/ublox_batch_" : "/ublox_log_")
+         << boost::posix_time::to_iso_string(
+                boost::posix_time::second_clock::universal_time())
+         << ".ubx";
+    res.path = path.str();
+  }
+  {
+    boost::mutex::scoped_lock lock(log_file_mutex_);
+    if (log_file_.is_open())
+      log_file_.close();
+    log_path_ = res.path;
+    if (!res.path.empty()) {
+      log_file_.open(res.path.c_str(), std::ios::binary | std::ios::trunc);
+      if (!log_file_.is_open()) {
+        ROS_WARN("U-Blox: Failed to open %s", res.path.c_str());
+        return true;
+      }
+    }
+  }
+
+  if (req.batch) {
+    ublox_msgs::LogRETRIEVEBATCH m;
+    m.version = 0;
+    m.flags = 0;
+    res.success = log_retriever_->startBatch() && gps.configure(m, false);
+  } else {
+    res.success = log_retriever_->start(req.startNumber, count);
+    res.numEntries = count;
+  }
+  // Stops itself & closes the file when the retrieval ended
+  log_timer_.start();
+  if (res.success)
+    ROS_INFO("U-Blox: Retrieving %s", req.batch ? "the batched fixes" :
+             (boost::lexical_cast<std::string>(count) + " log entries").c_str());
+  return true;
+}
+
+bool UbloxNode::requestLog(const ublox_msgs::LogRETRIEVE& m) {
+  return gps.configure(m, false);
+}
+
+template <typename T>
+void UbloxNode::writeLogRecord(const T& m, const std::string& topic) {
+  publish(m, topic);
+  std::vector<unsigned char> out(ublox_gps::Gps::kWriterSize);
+  ublox::Writer writer(out.data(), out.size());
+  if (!writer.write(m))
+    return;
+  const uint32_t size = writer.end() - out.data();
+  log_retriever_->addBytes(size);
+  boost::mutex::scoped_lock lock(log_file_mutex_);
+  if (log_file_.is_open())
+    log_file_.write(reinterpret_cast<const char*>(out.data()), size);
+}
+
+void UbloxNode::processLogRetrievePos(const ublox_msgs::LogRETRIEVEPOS& m) {
+  if (log_retriever_->addEntry(m.entryIndex))
+    writeLogRecord(m, "logretrievepos");
+}
+
+void UbloxNode::processLogRetrievePosExtra(
+    const ublox_msgs::LogRETRIEVEPOSEXTRA& m) {
+  if (log_retriever_->addEntry(m.entryIndex))
+    writeLogRecord(m, "logretrieveposextra");
+}
+
+void UbloxNode::processLogRetrieveString(
+    const ublox_msgs::LogRETRIEVESTRING& m) {
+  if (log_retriever_->addEntry(m.entryIndex))
+    writeLogRecord(m, "logretrievestring");
+}
+
+void UbloxNode::processLogBatch(const ublox_msgs::LogBATCH& m) {
+  if (log_retriever_->addBatch(m.msgCnt))
+    writeLogRecord(m, "logbatch");
+}
+
+void UbloxNode::checkLogRetrieval(const ros::TimerEvent& event) {
+  log_retriever_->checkTimeout();
+  LogRetriever::Progress progress = log_retriever_->progress();
+  if (progress.active) {
+    if (progress.batch)
+      ROS_INFO_THROTTLE(10, "U-Blox: Retrieved %u batches, %.0f B/s",
+                        progress.received, progress.throughput);
+    else
+      ROS_INFO_THROTTLE(10, "U-Blox: Retrieved %u of %u log entries, %.0f B/s",
+                        progress.received, progress.total,
+                        progress.throughput);
+    return;
+  }
+  log_timer_.stop();
+  {
+    boost::mutex::scoped_lock lock(log_file_mutex_);
+    if (log_file_.is_open())
+      log_file_.close();
+  }
+  if (progress.complete)
+    ROS_INFO("U-Blox: Retrieved %u %s in %.1f s (%.0f B/s)%s%s",
+             progress.received, progress.batch ? "batches" : "log entries",
+             progress.elapsed, progress.throughput,
+             log_path_.empty() ? "" : ", saved to ", log_path_.c_str());
+  else
+    ROS_WARN("U-Blox: Log retrieval incomplete, received %u %s",
+             progress.received, progress.batch ? "batches" : "log entries");
+}
+
+void UbloxNode::publishMovingBasePose(ublox_msgs::MovingBasePose pose) {
+  pose.header.frame_id = frame_id;
+  publish(pose, "movingbase");
+}
+
+void UbloxNode::publishGeotag(ublox_msgs::Geotag geotag) {
+  geotag.header.frame_id = frame_id;
+  publish(geotag, "geotag");
+}
+
+void UbloxNode::publishSatelliteTable(const ros::TimerEvent& event) {
+  // Published without changes, so that subscribers see the node is alive
+  ublox_msgs::SatelliteTableDelta delta;
+  satellite_table_->takeDelta(delta);
+  delta.header.stamp = ros::Time::now();
+  delta.header.frame_id = frame_id;
+  publish(delta, "satellites");
+}
+
+bool UbloxNode::getSatelliteTable(
+    ublox_msgs::GetSatelliteTable::Request& req,
+    ublox_msgs::GetSatelliteTable::Response& res) {
+  res.header.stamp = ros::Time::now();
+  res.header.frame_id = frame_id;
+  satellite_table_->get(res.satellites, res.summary);
+  return true;
+}
+
 void UbloxNode::initializeRosDiagnostics() {
   if (!nh->hasParam("diagnostic_period"))
     nh->setParam("diagnostic_period", kDiagnosticPeriod);
@@ -350,10 +983,430 @@ void UbloxNode::initializeRosDiagnostics() {
   // configure diagnostic updater for frequency
   freq_diag.reset(new FixDiagnostic(std::string("fix"), kFixFreqTol,
                             kFixFreqWindow, kTimeStampStatusMin));
+  updater->add("Data Integrity", this, &UbloxNode::dataIntegrityDiagnostic);
+  updater->add("Overload", this, &UbloxNode::overloadDiagnostic);
+  updater->add("Reads", this, &UbloxNode::readDiagnostic);
+  if (ephemeris_)
+    updater->add("Ephemeris", this, &UbloxNode::ephemerisDiagnostic);
+  if (sfrbx_decoder_)
+    updater->add("Navigation Data", this,
+                 &UbloxNode::navigationDataDiagnostic);
+  if (moving_base_)
+    updater->add("Moving Base", this, &UbloxNode::movingBaseDiagnostic);
+  if (geotagger_)
+    updater->add("Geotagging", this, &UbloxNode::geotagDiagnostic);
+  if (chrony_)
+    updater->add("Chrony Refclock", this, &UbloxNode::chronyDiagnostic);
+  if (log_retriever_)
+    updater->add("Log Retrieval", this, &UbloxNode::logRetrievalDiagnostic);
+  if (config_in_background_)
+    updater->add("Configuration", this, &UbloxNode::configurationDiagnostic);
+  if (config_monitor_)
+    updater->add("Configuration Integrity", this,
+                 &UbloxNode::configIntegrityDiagnostic);
+  if (gps.hasRedundantLink())
+    updater->add("Redundant Links", this,
+                 &UbloxNode::redundantLinkDiagnostic);
+  updater->add("Callback Queues", this, &UbloxNode::callbackQueueDiagnostic);
   for(int i = 0; i < components_.size(); i++)
     components_[i]->initializeRosDiagnostics();
 }
 
+/**
+ * @brief Add the total and the rate per minute of a counter to the diagnostic.
+ * @param stat the diagnostic status
+ * @param name the name of the counter
+ * @param current the current value of the counter
+ * @param reference the value of the counter at the start of the window
+ * @param minutes the length of the window [min]
+ */
+static void addRate(diagnostic_updater::DiagnosticStatusWrapper& stat,
+                    const std::string& name, uint64_t current,
+                    uint64_t reference, double minutes) {
+  stat.add(name, current);
+  stat.add(name + " [1/min]",
+           minutes > 0 ? (current - reference) / minutes : 0.0);
+}
+
+void UbloxNode::callbackQueueDiagnostic(
+    diagnostic_updater::DiagnosticStatusWrapper& stat) {
+  const CallbackLatency::Statistics rtcm = rtcm_latency_.read();
+  const CallbackLatency::Statistics timer = timer_latency_.read();
+  const uint64_t rtcm_failed = rtcm_failed_;
+  if (rtcm_failed > 0) {
+    stat.level = diagnostic_msgs::DiagnosticStatus::WARN;
+    stat.message = "Failed to send RTCM messages";
+  } else {
+    stat.level = diagnostic_msgs::DiagnosticStatus::OK;
+    stat.message = "OK";
+  }
+  stat.add("RTCM messages", rtcm.total);
+  stat.add("RTCM messages failed", rtcm_failed);
+  stat.add("RTCM latency mean [ms]", rtcm.mean * 1e3);
+  stat.add("RTCM latency max [ms]", rtcm.max * 1e3);
+  stat.add("Timer latency mean [ms]", timer.mean * 1e3);
+  stat.add("Timer latency max [ms]", timer.max * 1e3);
+  stat.add("Spinner threads", spinner_threads_);
+}
+
+void UbloxNode::dataIntegrityDiagnostic(
+    diagnostic_updater::DiagnosticStatusWrapper& stat) {
+  ros::WallTime now = ros::WallTime::now();
+  ublox_gps::DataIntegrity current = gps.getDataIntegrity();
+  data_integrity_.push_back(std::make_pair(now, current));
+  // Keep the newest sample which is older than the window as the reference
+  while (data_integrity_.size() > 2 &&
+         (now - data_integrity_[1].first).toSec() >= kDataIntegrityWindow)
+    data_integrity_.pop_front();
+  const ublox_gps::DataIntegrity& ref = data_integrity_.front().second;
+  const double minutes = (now - data_integrity_.front().first).toSec() / 60.0;
+
+  uint64_t lost = (current.discarded_bytes - ref.discarded_bytes)
+                  + (current.decode_errors - ref.decode_errors)
+                  + (current.missing_epochs - ref.missing_epochs);
+  if (current.serial_counters_valid && ref.serial_counters_valid)
+    lost += (current.serial.overrun - ref.serial.overrun)
+            + (current.serial.buf_overrun - ref.serial.buf_overrun)
+            + (current.serial.frame - ref.serial.frame)
+            + (current.serial.parity - ref.serial.parity);
+  if (lost > 0) {
+    stat.level = diagnostic_msgs::DiagnosticStatus::WARN;
+    stat.message = "Data loss detected";
+  } else {
+    stat.level = diagnostic_msgs::DiagnosticStatus::OK;
+    stat.message = "No data loss";
+  }
+
+  if (current.serial_counters_valid) {
+    addRate(stat, "UART overruns", current.serial.overrun, ref.serial.overrun,
+            minutes);
+    addRate(stat, "Buffer overruns", current.serial.buf_overrun,
+            ref.serial.buf_overrun, minutes);
+    addRate(stat, "Framing errors", current.serial.frame, ref.serial.frame,
+            minutes);
+    addRate(stat, "Parity errors", current.serial.parity, ref.serial.parity,
+            minutes);
+  }
+  addRate(stat, "Frames", current.frames, ref.frames, minutes);
+  addRate(stat, "Discarded bytes", current.discarded_bytes,
+          ref.discarded_bytes, minutes);
+  addRate(stat, "NMEA/RTCM bytes", current.foreign_bytes, ref.foreign_bytes,
+          minutes);
+  addRate(stat, "Decoder errors", current.decode_errors, ref.decode_errors,
+          minutes);
+  addRate(stat, "Missing epochs", current.missing_epochs, ref.missing_epochs,
+          minutes);
+}
+
+void UbloxNode::overloadDiagnostic(
+    diagnostic_updater::DiagnosticStatusWrapper& stat) {
+  ublox_gps::OverloadStatus status = gps.getOverloadStatus();
+  if (!status.enabled) {
+    stat.level = diagnostic_msgs::DiagnosticStatus::OK;
+    stat.message = "Shedding disabled";
+  } else if (status.overloaded) {
+    stat.level = diagnostic_msgs::DiagnosticStatus::WARN;
+    stat.message = "Overloaded, shedding low-priority messages";
+  } else {
+    stat.level = diagnostic_msgs::DiagnosticStatus::OK;
+    stat.message = "Not overloaded";
+  }
+  stat.add("Pending bytes", status.pending_bytes);
+  stat.add("Max pending bytes", status.max_pending_bytes);
+  stat.add("Lag [s]", status.lag);
+  stat.add("Max lag [s]", status.max_lag);
+  stat.add("Shed events", status.events);
+  stat.add("Shed frames", status.shed_frames);
+}
+
+void UbloxNode::readDiagnostic(
+    diagnostic_updater::DiagnosticStatusWrapper& stat) {
+  ublox_gps::ReadStatistics statistics;
+  if (!gps.getReadStatistics(statistics)) {
+    stat.level = diagnostic_msgs::DiagnosticStatus::OK;
+    stat.message = "Not available for this link";
+    return;
+  }
+  const ros::WallTime now = ros::WallTime::now();
+  const double interval = last_read_time_.isZero() ? 0
+      : (now - last_read_time_).toSec();
+  const ublox_gps::ReadStatistics& last = last_read_statistics_;
+  stat.level = diagnostic_msgs::DiagnosticStatus::OK;
+  stat.message = read_coalescing_.enabled ? "Coalescing reads"
+                                          : "Reading immediately";
+  if (interval > 0) {
+    stat.add("Wakeups [1/s]", (statistics.wakeups - last.wakeups) / interval);
+    stat.add("Reads [1/s]", (statistics.reads - last.reads) / interval);
+  }
+  if (statistics.reads > last.reads)
+    stat.add("Bytes per read", static_cast<double>(
+        statistics.bytes - last.bytes) / (statistics.reads - last.reads));
+  stat.add("Wakeups", statistics.wakeups);
+  stat.add("Reads", statistics.reads);
+  if (statistics.delay.count > 0)
+    stat.add("Mean read delay [s]",
+             statistics.delay.sum / statistics.delay.count);
+  stat.add("Max read delay [s]", statistics.max_delay);
+  last_read_statistics_ = statistics;
+  last_read_time_ = now;
+}
+
+void UbloxNode::ephemerisDiagnostic(
+    diagnostic_updater::DiagnosticStatusWrapper& stat) {
+  EphemerisEngine::Statistics statistics = ephemeris_->statistics();
+  const std::vector<EphemerisEngine::Residual>& residuals =
+      statistics.residuals;
+  double sum = 0, max = 0;
+  std::string inconsistent;
+  for (std::size_t i = 0; i < residuals.size(); ++i) {
+    const double residual = std::fabs(residuals[i].residual);
+    sum += residual * residual;
+    max = std::max(max, residual);
+    if (residual > ephemeris_max_residual_)
+      inconsistent += " " + boost::lexical_cast<std::string>(
+          static_cast<int>(residuals[i].gnss_id)) + "/"
+          + boost::lexical_cast<std::string>(
+              static_cast<int>(residuals[i].sv_id));
+  }
+  stat.level = diagnostic_msgs::DiagnosticStatus::OK;
+  if (statistics.satellites == 0) {
+    stat.level = diagnostic_msgs::DiagnosticStatus::WARN;
+    stat.message = "No ephemerides";
+  } else if (!inconsistent.empty()) {
+    stat.level = diagnostic_msgs::DiagnosticStatus::WARN;
+    stat.message = "Inconsistent pseudoranges (gnssId/svId):" + inconsistent;
+  } else if (residuals.empty()) {
+    stat.message = "Too few satellites to check";
+  } else {
+    stat.message = "Satellite states consistent";
+  }
+  stat.add("Satellites", statistics.satellites);
+  stat.add("Ephemeris updates", statistics.updates);
+  stat.add("Evaluated epochs", statistics.epochs);
+  if (statistics.time > 0)
+    stat.add("Throughput [SV/s]", statistics.evaluated / statistics.time);
+  if (statistics.epochs > 0)
+    stat.add("Mean epoch time [s]", statistics.time / statistics.epochs);
+  stat.add("Checked epochs", statistics.checks);
+  stat.add("Checked satellites", residuals.size());
+  if (!residuals.empty()) {
+    stat.add("Residual RMS [m]", std::sqrt(sum / residuals.size()));
+    stat.add("Max residual [m]", max);
+  }
+}
+
+void UbloxNode::navigationDataDiagnostic(
+    diagnostic_updater::DiagnosticStatusWrapper& stat) {
+  SfrbxDecoder::Statistics statistics = sfrbx_decoder_->statistics();
+  if (statistics.subframes == 0) {
+    stat.level = diagnostic_msgs::DiagnosticStatus::WARN;
+    stat.message = "No navigation data";
+  } else {
+    stat.level = diagnostic_msgs::DiagnosticStatus::OK;
+    stat.message = "Decoding navigation data";
+  }
+  stat.add("Subframes", statistics.subframes);
+  stat.add("Parity errors", statistics.parity_errors);
+  stat.add("Unsupported", statistics.unsupported);
+  stat.add("Ephemerides", statistics.ephemerides);
+  stat.add("GPS almanacs", statistics.almanacs);
+  IonosphereParams iono = sfrbx_decoder_->ionosphere();
+  stat.add("Klobuchar parameters", iono.klobuchar_valid);
+  stat.add("NeQuick parameters", iono.nequick_valid);
+  UtcParams utc = sfrbx_decoder_->utc(0);
+  if (utc.valid)
+    stat.add("Leap seconds [s]", static_cast<int>(utc.dt_ls));
+}
+
+void UbloxNode::movingBaseDiagnostic(
+    diagnostic_updater::DiagnosticStatusWrapper& stat) {
+  MovingBaseSynchronizer::Statistics statistics = moving_base_->statistics();
+  // The status reflects the epochs since the last update
+  const MovingBaseSynchronizer::Statistics& last =
+      last_moving_base_statistics_;
+  const uint32_t matched = statistics.matched - last.matched;
+  const uint32_t unmatched_base =
+      statistics.unmatched_base - last.unmatched_base;
+  const uint32_t unmatched_rover =
+      statistics.unmatched_rover - last.unmatched_rover;
+  last_moving_base_statistics_ = statistics;
+  if (matched == 0) {
+    stat.level = diagnostic_msgs::DiagnosticStatus::WARN;
+    stat.message = "No matched epochs";
+  } else if (unmatched_base > 0 || unmatched_rover > 0) {
+    stat.level = diagnostic_msgs::DiagnosticStatus::WARN;
+    stat.message = "Unmatched epochs";
+  } else {
+    stat.level = diagnostic_msgs::DiagnosticStatus::OK;
+    stat.message = "Receivers synchronized";
+  }
+  stat.add("Matched epochs", statistics.matched);
+  stat.add("Unmatched moving base epochs", statistics.unmatched_base);
+  stat.add("Unmatched rover epochs", statistics.unmatched_rover);
+  stat.add("Matched epochs since the last update", matched);
+  stat.add("Unmatched epochs since the last update",
+           unmatched_base + unmatched_rover);
+  stat.add("Last latency [s]", statistics.last_latency);
+  stat.add("Mean latency [s]", statistics.mean_latency);
+  stat.add("Max latency [s]", statistics.max_latency);
+}
+
+void UbloxNode::geotagDiagnostic(
+    diagnostic_updater::DiagnosticStatusWrapper& stat) {
+  Geotagger::Statistics statistics = geotagger_->statistics();
+  const uint32_t dropped = statistics.dropped_old + statistics.dropped_gap
+      + statistics.dropped_overflow;
+  if (statistics.marks == 0) {
+    stat.level = diagnostic_msgs::DiagnosticStatus::OK;
+    stat.message = "No time marks";
+  } else if (dropped > 0 || statistics.rejected > 0) {
+    stat.level = diagnostic_msgs::DiagnosticStatus::WARN;
+    stat.message = "Untagged time marks";
+  } else {
+    stat.level = diagnostic_msgs::DiagnosticStatus::OK;
+    stat.message = "Time marks tagged";
+  }
+  stat.add("Time marks", statistics.marks);
+  stat.add("Tagged", statistics.tagged);
+  stat.add("Rejected (no GPS time)", statistics.rejected);
+  stat.add("Dropped (older than buffer)", statistics.dropped_old);
+  stat.add("Dropped (epoch gap)", statistics.dropped_gap);
+  stat.add("Dropped (queue full)", statistics.dropped_overflow);
+  stat.add("Last interval [s]", statistics.last_interval);
+}
+
+void UbloxNode::chronyTimeUtc(const ublox_msgs::NavTIMEUTC& m) {
+  chrony_->addTimeUtc(m, gps.getArrivalTime());
+}
+
+void UbloxNode::chronyTimePulse(const ublox_msgs::TimTP& m) {
+  chrony_->addTimePulse(m, gps.getArrivalTime());
+}
+
+void UbloxNode::chronyDiagnostic(
+    diagnostic_updater::DiagnosticStatusWrapper& stat) {
+  ChronyRefclock::Statistics statistics = chrony_->statistics();
+  if (statistics.samples == 0) {
+    stat.level = diagnostic_msgs::DiagnosticStatus::WARN;
+    stat.message = "No samples written";
+  } else {
+    stat.level = diagnostic_msgs::DiagnosticStatus::OK;
+    stat.message = "Writing samples";
+  }
+  stat.add("SHM unit", chrony_->unit());
+  stat.add("Samples", statistics.samples);
+  stat.add("PPS samples", statistics.pps_samples);
+  stat.add("Rejected epochs", statistics.rejected);
+  stat.add("Last offset [s]", statistics.last_offset);
+  stat.add("Last qErr [ps]", statistics.last_qerr);
+  stat.add("Clock drift [ns/s]", statistics.clock_drift);
+  stat.add("Time accuracy [ns]", statistics.time_acc);
+  stat.add("Frequency accuracy [ps/s]", statistics.freq_acc);
+}
+
+void UbloxNode::logRetrievalDiagnostic(
+    diagnostic_updater::DiagnosticStatusWrapper& stat) {
+  LogRetriever::Progress progress = log_retriever_->progress();
+  if (progress.active) {
+    stat.level = diagnostic_msgs::DiagnosticStatus::OK;
+    stat.message = "Retrieving";
+  } else if (progress.requests == 0 || progress.complete) {
+    stat.level = diagnostic_msgs::DiagnosticStatus::OK;
+    stat.message = "Idle";
+  } else {
+    stat.level = diagnostic_msgs::DiagnosticStatus::WARN;
+    stat.message = "Last retrieval incomplete";
+  }
+  stat.add("Batches", progress.batch);
+  if (!progress.batch)
+    stat.add("Entries", progress.total);
+  stat.add("Received", progress.received);
+  stat.add("Requests", progress.requests);
+  stat.add("Retries", progress.retries);
+  if (progress.batch)
+    stat.add("Missing batches", progress.missing);
+  stat.add("Bytes", progress.bytes);
+  stat.add("Elapsed [s]", progress.elapsed);
+  stat.add("Throughput [B/s]", progress.throughput);
+}
+
+void UbloxNode::configurationDiagnostic(
+    diagnostic_updater::DiagnosticStatusWrapper& stat) {
+  switch (config_state_) {
+    case CONFIG_PENDING:
+      stat.level = diagnostic_msgs::DiagnosticStatus::WARN;
+      stat.message = "Configuration pending";
+      break;
+    case CONFIG_DONE:
+      stat.level = diagnostic_msgs::DiagnosticStatus::OK;
+      stat.message = "Configured";
+      break;
+    default:
+      stat.level = diagnostic_msgs::DiagnosticStatus::ERROR;
+      stat.message = "Configuration failed";
+  }
+}
+
+void UbloxNode::configIntegrityDiagnostic(
+    diagnostic_updater::DiagnosticStatusWrapper& stat) {
+  ConfigMonitor::Statistics statistics = config_monitor_->statistics();
+  bool reset;
+  uint32_t blocks;
+  if (config_monitor_->pending(reset, blocks)) {
+    stat.level = statistics.failed_recoveries > 0
+        ? diagnostic_msgs::DiagnosticStatus::ERROR
+        : diagnostic_msgs::DiagnosticStatus::WARN;
+    stat.message = reset ? "Receiver reset, reconfiguring"
+                         : "Configuration drift, reapplying";
+  } else if (statistics.checks > 1
+             && statistics.unanswered == statistics.checks - 1) {
+    stat.level = diagnostic_msgs::DiagnosticStatus::WARN;
+    stat.message = "No response to the configuration polls";
+  } else {
+    stat.level = diagnostic_msgs::DiagnosticStatus::OK;
+    stat.message = "Configuration intact";
+  }
+  stat.add("Poll rounds", statistics.checks);
+  stat.add("Unanswered poll rounds", statistics.unanswered);
+  stat.add("Resets", statistics.resets);
+  stat.add("Drifted blocks", statistics.drifts);
+  stat.add("Recoveries", statistics.recoveries);
+  stat.add("Failed recoveries", statistics.failed_recoveries);
+  stat.add("Last detection time [s]", statistics.last_detection);
+  stat.add("Last recovery time [s]", statistics.last_recovery);
+}
+
+void UbloxNode::redundantLinkDiagnostic(
+    diagnostic_updater::DiagnosticStatusWrapper& stat) {
+  const std::string names[] = {device_, redundant_device_};
+  const boost::posix_time::ptime now =
+      boost::posix_time::microsec_clock::universal_time();
+  stat.level = diagnostic_msgs::DiagnosticStatus::OK;
+  stat.message = "Both links receiving";
+  for (std::size_t i = 0; i < 2; ++i) {
+    ublox_gps::LinkStatistics link = gps.getLinkStatistics(i);
+    double age = -1;
+    if (!link.last_frame.is_not_a_date_time())
+      age = (now - link.last_frame).total_milliseconds() * 1e-3;
+    ublox_gps::ReadErrors errors = gps.getReadErrors(i);
+    if (errors.failing) {
+      stat.level = diagnostic_msgs::DiagnosticStatus::ERROR;
+      stat.message = "Link " + names[i] + " failed: " + errors.message;
+    } else if (age < 0 || age > kLinkFailedTimeout) {
+      if (stat.level < diagnostic_msgs::DiagnosticStatus::WARN)
+        stat.level = diagnostic_msgs::DiagnosticStatus::WARN;
+      if (stat.level == diagnostic_msgs::DiagnosticStatus::WARN)
+        stat.message = "Link " + names[i] + " is not receiving";
+    }
+    stat.add(names[i] + " frames", link.frames);
+    stat.add(names[i] + " frames first", link.first);
+    stat.add(names[i] + " mean advantage [ms]", link.matched > 0 ?
+             link.advantage / link.matched * 1e3 : 0.0);
+    stat.add(names[i] + " missed frames", link.missed);
+    stat.add(names[i] + " last frame [s ago]", age);
+    stat.add(names[i] + " read errors", errors.count);
+  }
+}
 
 void UbloxNode::processMonVer() {
   ublox_msgs::MonVER monVer;
@@ -492,6 +1545,61 @@ bool UbloxNode::configureUblox() {
   return true;
 }
 
+void UbloxNode::checkConfiguration(const ros::TimerEvent& event) {
+  // Wait for the background configuration
+  if (config_in_background_ && config_state_ != CONFIG_DONE)
+    return;
+  bool reset;
+  uint32_t blocks;
+  if (config_monitor_->pending(reset, blocks)) {
+    const bool success = recoverConfiguration(reset, blocks);
+    config_monitor_->recovered(success);
+    if (success)
+      ROS_INFO("U-Blox: Configuration recovered");
+    else
+      ROS_ERROR("U-Blox: Failed to recover the configuration, retrying");
+  }
+
+  using ublox_gps::ConfigShadow;
+  const uint32_t polled = config_monitor_->startRound();
+  if (polled & ConfigShadow::BLOCK_RATE)
+    gps.poll(ublox_msgs::CfgRATE::CLASS_ID, ublox_msgs::CfgRATE::MESSAGE_ID);
+  if (polled & ConfigShadow::BLOCK_NAV5)
+    gps.poll(ublox_msgs::CfgNAV5::CLASS_ID, ublox_msgs::CfgNAV5::MESSAGE_ID);
+  if (polled & ConfigShadow::BLOCK_TMODE3)
+    gps.poll(ublox_msgs::CfgTMODE3::CLASS_ID,
+             ublox_msgs::CfgTMODE3::MESSAGE_ID);
+  gps.poll(ublox_msgs::NavSTATUS::CLASS_ID, ublox_msgs::NavSTATUS::MESSAGE_ID);
+}
+
+bool UbloxNode::recoverConfiguration(bool reset, uint32_t blocks) {
+  if (reset) {
+    // The device is in its default configuration, configure it as on startup
+    ROS_WARN("U-Blox: Receiver reset detected, configuring the device");
+    bool result = configureUblox();
+    result = gps.reapplyRates() && result;
+    configureInf();
+    return result;
+  }
+  // Apply only the drifted blocks
+  using ublox_gps::ConfigShadow;
+  const ConfigShadow& shadow = gps.getConfigShadow();
+  bool result = true;
+  if (blocks & ConfigShadow::BLOCK_RATE) {
+    ROS_WARN("U-Blox: CfgRATE differs from the configuration, reapplying");
+    result = gps.configure(shadow.rate()) && result;
+  }
+  if (blocks & ConfigShadow::BLOCK_NAV5) {
+    ROS_WARN("U-Blox: CfgNAV5 differs from the configuration, reapplying");
+    result = gps.configure(shadow.nav5()) && result;
+  }
+  if (blocks & ConfigShadow::BLOCK_TMODE3) {
+    ROS_WARN("U-Blox: CfgTMODE3 differs from the configuration, reapplying");
+    result = gps.configure(shadow.tmode3()) && result;
+  }
+  return result;
+}
+
 void UbloxNode::configureInf() {
   ublox_msgs::CfgINF msg;
   // Subscribe to UBX INF messages
@@ -525,10 +1633,59 @@ void UbloxNode::configureInf() {
 
 void UbloxNode::initializeIo() {
   gps.setConfigOnStartup(config_on_startup_flag_);
+  // raw data stream logging, set before the I/O is initialized to capture
+  // the configuration of the port
+  if (rawDataStreamPa_.isEnabled()) {
+    gps.setRawDataCallback(
+      boost::bind(&RawDataStreamPa::ubloxCallback,&rawDataStreamPa_, _1, _2));
+    if (rawDataStreamPa_.isCapturing())
+      gps.setSentDataCallback(boost::bind(&RawDataStreamPa::sentCallback,
+                                          &rawDataStreamPa_, _1, _2));
+    rawDataStreamPa_.initialize();
+  }
+  // Expected iTOW increment, updated when the rate is configured
+  gps.setNavPeriod(meas_rate, nav_rate);
+  gps.setReadCoalescing(read_coalescing_);
+  // Dispatch time-critical messages ahead of bulk messages
+  if (prioritize_) {
+    gps.setPriority(ublox_msgs::Class::NAV, ublox_msgs::Message::NAV::PVT);
+    gps.setPriority(ublox_msgs::Class::NAV,
+                    ublox_msgs::Message::NAV::RELPOSNED);
+    gps.setPriority(ublox_msgs::Class::HNR, ublox_msgs::Message::HNR::PVT);
+    gps.setPriority(ublox_msgs::Class::ESF, ublox_msgs::Message::ESF::MEAS);
+    gps.setPriority(ublox_msgs::Class::TIM, ublox_msgs::Message::TIM::TM2);
+  }
+  // Shed low-priority messages when the dispatch falls behind
+  if (overload_) {
+    gps.setOverloadLimits(overload_max_pending_, overload_max_lag_,
+                          overload_restore_time_);
+    for (size_t i = 0; i < overload_shed_.size(); ++i) {
+      if (overload_shed_[i] == "nav_sat") {
+        gps.shedOnOverload(ublox_msgs::Class::NAV,
+                           ublox_msgs::Message::NAV::SAT);
+        gps.shedOnOverload(ublox_msgs::Class::NAV,
+                           ublox_msgs::Message::NAV::SVINFO);
+      } else if (overload_shed_[i] == "mon") {
+        gps.shedOnOverload(ublox_msgs::Class::MON);
+      } else if (overload_shed_[i] == "inf") {
+        gps.shedOnOverload(ublox_msgs::Class::INF);
+      } else if (overload_shed_[i] == "rxm") {
+        gps.shedOnOverload(ublox_msgs::Class::RXM);
+      }
+    }
+  }
+
+  if (discover_)
+    discoverDevices();
 
   boost::smatch match;
-  if (boost::regex_match(device_, match,
-                         boost::regex("(tcp|udp)://(.+):(\\d+)"))) {
+  if (boost::regex_match(device_, match, boost::regex("replay://(.+)"))) {
+    double speed;
+    nh->param("replay/speed", speed, 1.0);
+    checkMin(speed, 0, "replay/speed");
+    gps.initializeReplay(match[1], speed);
+  } else if (boost::regex_match(device_, match,
+                                boost::regex("(tcp|udp)://(.+):(\\d+)"))) {
     std::string proto(match[1]);
     if (proto == "tcp") {
       std::string host(match[2]);
@@ -541,14 +1698,111 @@ void UbloxNode::initializeIo() {
     }
   } else {
     gps.initializeSerial(device_, baudrate_, uart_in_, uart_out_);
+    // 8N1, 10 bits per byte
+    link_capacity_ = baudrate_ / 10.0;
+  }
+  // Second link to the same receiver, e.g. UART1 in addition to USB
+  if (!redundant_device_.empty())
+    gps.initializeRedundantSerial(redundant_device_, baudrate_);
+  // Moving base receiver, configured with the same UART protocols
+  if (moving_base_) {
+    moving_base_gps_.reset(new ublox_gps::Gps);
+    moving_base_gps_->setExclusive(discover_);
+    moving_base_gps_->setReadCoalescing(read_coalescing_);
+    moving_base_gps_->initializeSerial(moving_base_device_,
+                                       moving_base_baudrate_, uart_in_,
+                                       uart_out_);
   }
 
-  // raw data stream logging
-  if (rawDataStreamPa_.isEnabled()) {
-    gps.setRawDataCallback(
-      boost::bind(&RawDataStreamPa::ubloxCallback,&rawDataStreamPa_, _1, _2));
-    rawDataStreamPa_.initialize();
+  if (metrics_exporter_)
+    metrics_exporter_->start();
+}
+
+void UbloxNode::discoverDevices() {
+  using ublox_gps::PortDiscovery;
+  using ublox_gps::ProbeResult;
+  using ublox_gps::findReceiver;
+  using ublox_gps::kBaudrates;
+  std::vector<std::string> ports = PortDiscovery::expand(discovery_ports_);
+  if (ports.empty())
+    throw std::runtime_error("No serial port matches discovery/ports");
+  // The configured baudrates first, then from the fastest
+  std::vector<unsigned int> baudrates(1, baudrate_);
+  if (moving_base_)
+    baudrates.push_back(moving_base_baudrate_);
+  for (int i = sizeof(kBaudrates) / sizeof(kBaudrates[0]) - 1; i >= 0; --i)
+    baudrates.push_back(kBaudrates[i]);
+  for (std::size_t i = 1; i < baudrates.size(); ++i) {
+    if (std::find(baudrates.begin(), baudrates.begin() + i, baudrates[i])
+        != baudrates.begin() + i)
+      baudrates.erase(baudrates.begin() + i--);
+  }
+
+  ROS_INFO("U-Blox: Probing %zu serial ports", ports.size());
+  PortDiscovery discovery(baudrates, boost::posix_time::milliseconds(
+      static_cast<int>(discovery_timeout_ * 1000)));
+  std::vector<ProbeResult> results = discovery.probe(ports);
+  std::string found;
+  for (std::size_t i = 0; i < results.size(); ++i) {
+    if (!results[i].found) {
+      ROS_DEBUG("U-Blox: %s: %s", results[i].port.c_str(),
+                results[i].error.c_str());
+      continue;
+    }
+    ROS_INFO("U-Blox: %s: %s, %s at %u baud, unique ID %s",
+             results[i].port.c_str(), results[i].hw_version.c_str(),
+             results[i].sw_version.c_str(), results[i].baudrate,
+             results[i].unique_id.empty() ? "unknown"
+                                          : results[i].unique_id.c_str());
+    found += " " + results[i].port + " (" + results[i].unique_id + ")";
+  }
+
+  if (moving_base_device_ == kDiscover) {
+    int i = findReceiver(results, moving_base_unique_id_);
+    if (i < 0)
+      throw std::runtime_error("No moving base receiver with unique ID " +
+                               moving_base_unique_id_ + ", found:" + found);
+    moving_base_device_ = results[i].port;
+    ROS_INFO("U-Blox: Bound the moving base receiver to %s",
+             moving_base_device_.c_str());
+  }
+  if (device_ == kDiscover) {
+    int index = -1;
+    if (!unique_id_.empty()) {
+      index = findReceiver(results, unique_id_);
+    } else {
+      // The only receiver, other than the moving base
+      for (std::size_t i = 0; i < results.size(); ++i) {
+        if (!results[i].found || results[i].port == moving_base_device_
+            || (moving_base_ && !results[i].unique_id.empty()
+                && boost::iequals(results[i].unique_id,
+                                  moving_base_unique_id_)))
+          continue;
+        if (index >= 0)
+          throw std::runtime_error(
+              "Several receivers found, set unique_id to one of:" + found);
+        index = i;
+      }
+    }
+    if (index < 0)
+      throw std::runtime_error((unique_id_.empty() ? "No receiver"
+          : "No receiver with unique ID " + unique_id_) + ", found:" + found);
+    device_ = results[index].port;
+    unique_id_ = results[index].unique_id;
+    ROS_INFO("U-Blox: Bound the receiver to %s", device_.c_str());
   }
+  if (redundant_device_ == kDiscover) {
+    int i = unique_id_.empty() ? -1
+                               : findReceiver(results, unique_id_, device_);
+    if (i < 0)
+      throw std::runtime_error("No second port of the receiver " +
+                               unique_id_ + ", found:" + found);
+    redundant_device_ = results[i].port;
+    ROS_INFO("U-Blox: Bound the redundant link to %s",
+             redundant_device_.c_str());
+  }
+  // Keep other nodes from probing the bound ports
+  gps.setExclusive(true);
 }
 
 void UbloxNode::initialize() {
@@ -567,28 +1821,225 @@ void UbloxNode::initialize() {
   // Do this last
   initializeRosDiagnostics();
 
-  if (configureUblox()) {
+  if (config_in_background_) {
+    // Publish the messages the device already outputs while it is configured
+    gps.setDeferRates(true);
+    subscribe();
+    config_thread_.reset(new boost::thread(
+        boost::bind(&UbloxNode::configureInBackground, this)));
+    spin();
+  } else if (configureUblox()) {
     ROS_INFO("U-Blox configured successfully.");
     // Subscribe to all U-Blox messages
     subscribe();
     // Configure INF messages (needs INF params, call after subscribing)
     configureInf();
-
-    ros::Timer poller;
-    poller = nh->createTimer(ros::Duration(kPollDuration),
-                             &UbloxNode::pollMessages,
-                             this);
-    poller.start();
-    ros::spin();
+    spin();
   }
   shutdown();
 }
 
+void UbloxNode::configureInBackground() {
+  if (!configureUblox()) {
+    config_state_ = CONFIG_FAILED;
+    return;
+  }
+  if (!gps.setDeferredRates())
+    ROS_WARN("U-Blox: Failed to configure the rates of some messages");
+  // Configure INF messages (needs INF params, call after subscribing)
+  configureInf();
+  ROS_INFO("U-Blox configured successfully.");
+  config_state_ = CONFIG_DONE;
+}
+
+void UbloxNode::spin() {
+  // Subscribe to the RTCM corrections on a dedicated queue & thread, so they
+  // are not delayed by the other callbacks
+  ros::SubscribeOptions options;
+  options.initByFullCallbackType<
+      const ros::MessageEvent<rtcm_msgs::Message const>&>(
+          rtcm_topic_, rtcm_queue_size_,
+          boost::bind(&UbloxNode::rtcmCallback, this, _1));
+  options.callback_queue = &rtcm_queue_;
+  options.transport_hints = ros::TransportHints().tcpNoDelay();
+  rtcm_sub_ = nh->subscribe(options);
+  ros::AsyncSpinner rtcm_spinner(1, &rtcm_queue_);
+  rtcm_spinner.start();
+
+  ros::Timer poller;
+  poller = nh->createTimer(ros::Duration(kPollDuration),
+                           &UbloxNode::pollMessages,
+                           this);
+  poller.start();
+  ros::Timer config_monitor_timer;
+  if (config_monitor_)
+    config_monitor_timer = nh->createTimer(
+        ros::Duration(config_monitor_period_), &UbloxNode::checkConfiguration,
+        this);
+  // Timers, services & diagnostics
+  ros::AsyncSpinner spinner(spinner_threads_);
+  spinner.start();
+  ros::waitForShutdown();
+}
+
+void UbloxNode::rtcmCallback(
+    const ros::MessageEvent<rtcm_msgs::Message const>& event) {
+  const ros::Time now = ros::Time::now();
+  const double latency = (now - event.getReceiptTime()).toSec();
+  rtcm_latency_.add(latency);
+  const std::vector<uint8_t>& message = event.getMessage()->message;
+  if (!gps.sendRtcm(message))
+    ++rtcm_failed_;
+  if (metrics) {
+    metrics->rtcm_latency.observe(latency);
+    metrics->last_rtcm = now.toSec();
+    ++metrics->rtcm_messages;
+    metrics->rtcm_bytes += message.size();
+  }
+}
+
+std::string UbloxNode::renderMetrics() {
+  MetricsWriter writer;
+  // Frames & bytes per message type
+  std::vector<ublox_gps::FrameCount> counts;
+  gps.getFrameCounters().snapshot(counts);
+  std::vector<std::string> labels(counts.size());
+  for (std::size_t i = 0; i < counts.size(); ++i) {
+    char label[32];
+    snprintf(label, sizeof(label), "class=\"0x%02x\",id=\"0x%02x\"",
+             counts[i].class_id, counts[i].message_id);
+    labels[i] = label;
+  }
+  writer.family("ublox_frames_total", "counter",
+                "u-blox frames received per message type.");
+  for (std::size_t i = 0; i < counts.size(); ++i)
+    writer.sample("ublox_frames_total", counts[i].frames, labels[i]);
+  writer.family("ublox_frame_bytes_total", "counter",
+                "u-blox frame bytes received per message type.");
+  for (std::size_t i = 0; i < counts.size(); ++i)
+    writer.sample("ublox_frame_bytes_total", counts[i].bytes, labels[i]);
+
+  // Parser, without the serial counters, which need an ioctl
+  const ublox_gps::DataIntegrity integrity = gps.getDataIntegrity(false);
+  writer.family("ublox_parse_errors_total", "counter",
+                "Frames with checksum errors or which failed to decode.");
+  writer.sample("ublox_parse_errors_total", integrity.decode_errors);
+  writer.family("ublox_discarded_bytes_total", "counter",
+                "Bytes skipped while searching for u-blox frames.");
+  writer.sample("ublox_discarded_bytes_total", integrity.discarded_bytes);
+  writer.family("ublox_missing_epochs_total", "counter",
+                "Navigation epochs missing from periodic NAV messages.");
+  writer.sample("ublox_missing_epochs_total", integrity.missing_epochs);
+  writer.histogram("ublox_ack_latency_seconds",
+                   "Latency of the ACKs of configuration messages.",
+                   gps.getAckLatency().snapshot());
+
+  // Reads of the I/O thread
+  ublox_gps::ReadStatistics reads;
+  if (gps.getReadStatistics(reads)) {
+    writer.family("ublox_read_wakeups_total", "counter",
+                  "Wakeups of the I/O thread for reading.");
+    writer.sample("ublox_read_wakeups_total", reads.wakeups);
+    writer.family("ublox_reads_total", "counter",
+                  "Reads which returned data.");
+    writer.sample("ublox_reads_total", reads.reads);
+    writer.histogram("ublox_read_delay_seconds",
+                     "Longest time the bytes of each read waited in the "
+                     "kernel.", reads.delay);
+  }
+
+  // Link & queues
+  uint64_t link_bytes = integrity.discarded_bytes;
+  for (std::size_t i = 0; i < counts.size(); ++i)
+    link_bytes += counts[i].bytes;
+  writer.family("ublox_link_bytes_total", "counter",
+                "Bytes received from the device.");
+  writer.sample("ublox_link_bytes_total", link_bytes);
+  if (link_capacity_ > 0) {
+    writer.family("ublox_link_capacity_bytes_per_second", "gauge",
+                  "Capacity of the serial link.");
+    writer.sample("ublox_link_capacity_bytes_per_second", link_capacity_);
+  }
+  writer.family("ublox_pending_bytes", "gauge",
+                "Undecoded bytes when the last frame was dispatched.");
+  writer.sample("ublox_pending_bytes", gps.getPendingBytes());
+  writer.family("ublox_dispatch_lag_seconds", "gauge",
+                "Age of the last frame when it was dispatched.");
+  writer.sample("ublox_dispatch_lag_seconds", gps.getDispatchLag());
+
+  // Fix
+  writer.family("ublox_fix_type", "gauge", "Fix type, see NavPVT.");
+  writer.sample("ublox_fix_type", metrics->fix_type);
+  writer.family("ublox_fix_ok", "gauge",
+                "Whether the fix is within the DOP & accuracy masks.");
+  writer.sample("ublox_fix_ok", metrics->fix_ok ? 1 : 0);
+  writer.family("ublox_satellites_used", "gauge",
+                "Satellites used in the navigation solution.");
+  writer.sample("ublox_satellites_used", metrics->num_sv);
+  writer.family("ublox_h_acc_meters", "gauge",
+                "Horizontal accuracy estimate.");
+  writer.sample("ublox_h_acc_meters", metrics->h_acc);
+  writer.family("ublox_v_acc_meters", "gauge", "Vertical accuracy estimate.");
+  writer.sample("ublox_v_acc_meters", metrics->v_acc);
+
+  // Corrections
+  writer.family("ublox_rtcm_messages_total", "counter",
+                "RTCM messages sent to the device.");
+  writer.sample("ublox_rtcm_messages_total", metrics->rtcm_messages);
+  writer.family("ublox_rtcm_bytes_total", "counter",
+                "RTCM bytes sent to the device.");
+  writer.sample("ublox_rtcm_bytes_total", metrics->rtcm_bytes);
+  const double last_rtcm = metrics->last_rtcm;
+  if (last_rtcm > 0) {
+    writer.family("ublox_correction_age_seconds", "gauge",
+                  "Time since the last RTCM message was received.");
+    writer.sample("ublox_correction_age_seconds",
+                  ros::Time::now().toSec() - last_rtcm);
+  }
+  writer.histogram("ublox_rtcm_latency_seconds",
+                   "Time RTCM messages waited in the callback queue.",
+                   metrics->rtcm_latency.snapshot());
+
+  // Configuration integrity
+  if (config_monitor_) {
+    const ConfigMonitor::Statistics config = config_monitor_->statistics();
+    writer.family("ublox_config_resets_total", "counter",
+                  "Detected receiver resets.");
+    writer.sample("ublox_config_resets_total", config.resets);
+    writer.family("ublox_config_drifts_total", "counter",
+                  "Detected configuration blocks which differed.");
+    writer.sample("ublox_config_drifts_total", config.drifts);
+    writer.family("ublox_config_recoveries_total", "counter",
+                  "Configuration recoveries.");
+    writer.sample("ublox_config_recoveries_total", config.recoveries,
+                  "result=\"success\"");
+    writer.sample("ublox_config_recoveries_total", config.failed_recoveries,
+                  "result=\"failure\"");
+    writer.family("ublox_config_detection_seconds", "gauge",
+                  "Time from the last reset or drift to its detection.");
+    writer.sample("ublox_config_detection_seconds", config.last_detection);
+    writer.family("ublox_config_recovery_seconds", "gauge",
+                  "Time from the last detection to the recovery.");
+    writer.sample("ublox_config_recovery_seconds", config.last_recovery);
+  }
+  return writer.str();
+}
+
 void UbloxNode::shutdown() {
+  // The metrics are rendered from the connection
+  if (metrics_exporter_)
+    metrics_exporter_->stop();
+  // Wait for the configuration, it uses the connection
+  if (config_thread_)
+    config_thread_->join();
   if (gps.isInitialized()) {
     gps.close();
     ROS_INFO("Closed connection to %s.", device_.c_str());
   }
+  if (moving_base_gps_ && moving_base_gps_->isInitialized()) {
+    moving_base_gps_->close();
+    ROS_INFO("Closed connection to %s.", moving_base_device_.c_str());
+  }
 }
 
 //
@@ -747,6 +2198,8 @@ void UbloxFirmware6::callbackNavPosLlh(const ublox_msgs::NavPOSLLH& m) {
   fix_.latitude = m.lat * 1e-7;
   fix_.longitude = m.lon * 1e-7;
   fix_.altitude = m.height * 1e-3;
+  if (metrics)
+    metrics->setAccuracy(m.hAcc * 1e-3, m.vAcc * 1e-3);
 
   if (last_nav_sol_.gpsFix >= last_nav_sol_.GPS_2D_FIX)
     fix_.status.status = fix_.status.STATUS_FIX;
@@ -768,7 +2221,7 @@ void UbloxFirmware6::callbackNavPosLlh(const ublox_msgs::NavPOSLLH& m) {
   last_nav_pos_ = m;
   //  update diagnostics
   freq_diag->diagnostic->tick(fix_.header.stamp);
-  updater->update();
+  updateDiagnostics();
 }
 
 void UbloxFirmware6::callbackNavVelNed(const ublox_msgs::NavVELNED& m) {
@@ -812,6 +2265,8 @@ void UbloxFirmware6::callbackNavSol(const ublox_msgs::NavSOL& m) {
     publisher.publish(m);
   }
   last_nav_sol_ = m;
+  if (metrics)
+    metrics->setFix(m.gpsFix, m.flags & m.FLAGS_GPS_FIX_OK, m.numSV);
 }
 
 //
@@ -1001,12 +2456,17 @@ void UbloxFirmware7::subscribe() {
 //
 // Ublox Version 8
 //
-UbloxFirmware8::UbloxFirmware8() {}
+UbloxFirmware8::UbloxFirmware8() : stable_epochs_(0) {}
 
 void UbloxFirmware8::getRosParams() {
   // UPD SOS configuration
   nh->param("clear_bbr", clear_bbr_, false);
-  gps.setSaveOnShutdown(nh->param("save_on_shutdown", false));
+  nh->param("save_on_shutdown", save_on_shutdown_, false);
+  gps.setSaveOnShutdown(save_on_shutdown_);
+  nh->param("sos_backup/period", sos_backup_period_, 0.0); // [s]
+  checkMin(sos_backup_period_, 0, "sos_backup/period");
+  nh->param("sos_backup/stop_gnss", sos_backup_stop_gnss_, false);
+  getRosUint("sos_backup/stable_epochs", sos_backup_stable_epochs_, 10);
 
   // GNSS enable/disable
   nh->param("gnss/gps", enable_gps_, true);
@@ -1115,6 +2575,95 @@ void UbloxFirmware8::getRosParams() {
 }
 
 
+void UbloxFirmware8::initializeRosDiagnostics() {
+  UbloxFirmware::initializeRosDiagnostics();
+  if (sos_backup_period_ > 0 || save_on_shutdown_) {
+    updater->add("UPD-SOS Backup", this,
+                 &UbloxFirmware8::sosBackupDiagnostics);
+    updater->force_update();
+  }
+}
+
+void UbloxFirmware8::callbackSosNavPvt(const ublox_msgs::NavPVT& m) {
+  const bool valid = (m.flags & m.FLAGS_GNSS_FIX_OK) &&
+      (m.fixType == m.FIX_TYPE_3D ||
+       m.fixType == m.FIX_TYPE_GNSS_DEAD_RECKONING_COMBINED ||
+       m.fixType == m.FIX_TYPE_TIME_ONLY);
+  if (valid)
+    ++stable_epochs_;
+  else
+    stable_epochs_ = 0;
+}
+
+void UbloxFirmware8::checkSosBackup(const ros::TimerEvent& event) {
+  // Get the TTFF once, the receiver measures it from startup
+  if (ttff_ < 0 && stable_epochs_ > 0) {
+    ublox_msgs::NavSTATUS status;
+    if (gps.poll(status) && status.ttff > 0) {
+      ttff_ = status.ttff * 1e-3; // to [s]
+      ROS_INFO("u-blox time to first fix: %.3f s (%s)", ttff_,
+               sos_restore_response_ ==
+                   ublox_msgs::UpdSOS_Ack::SYSTEM_RESTORED_RESPONSE_RESTORED ?
+                   "restored from backup" : "not restored from backup");
+    }
+  }
+
+  if (sos_backup_period_ <= 0)
+    return;
+  const ros::WallTime now = ros::WallTime::now();
+  if (!last_sos_backup_.isZero() &&
+      (now - last_sos_backup_).toSec() < sos_backup_period_)
+    return;
+  if (stable_epochs_ < sos_backup_stable_epochs_)
+    return;
+  last_sos_backup_ = now;
+  if (gps.createBackup(sos_backup_stop_gnss_)) {
+    ++sos_backups_;
+    last_sos_backup_ok_ = now;
+    ROS_DEBUG("u-blox BBR backed up to flash");
+  } else {
+    ++sos_backups_failed_;
+    ROS_WARN("u-blox failed to back up the BBR to flash");
+  }
+}
+
+void UbloxFirmware8::sosBackupDiagnostics(
+    diagnostic_updater::DiagnosticStatusWrapper& stat) {
+  typedef ublox_msgs::UpdSOS_Ack Sos;
+  if (sos_backup_period_ > 0 && sos_backups_failed_ > 0 &&
+      last_sos_backup_ok_ < last_sos_backup_) {
+    stat.level = diagnostic_msgs::DiagnosticStatus::WARN;
+    stat.message = "Last backup failed";
+  } else if (sos_restore_response_ == Sos::SYSTEM_RESTORED_RESPONSE_FAILED) {
+    stat.level = diagnostic_msgs::DiagnosticStatus::WARN;
+    stat.message = "Failed to restore from backup";
+  } else {
+    stat.level = diagnostic_msgs::DiagnosticStatus::OK;
+    stat.message = "OK";
+  }
+  switch (sos_restore_response_) {
+    case Sos::SYSTEM_RESTORED_RESPONSE_RESTORED:
+      stat.add("Restore", "Restored from backup");
+      break;
+    case Sos::SYSTEM_RESTORED_RESPONSE_NOT_RESTORED:
+      stat.add("Restore", "No backup");
+      break;
+    case Sos::SYSTEM_RESTORED_RESPONSE_FAILED:
+      stat.add("Restore", "Failed");
+      break;
+    default:
+      stat.add("Restore", "Unknown");
+  }
+  if (ttff_ >= 0)
+    stat.add("TTFF [s]", ttff_);
+  stat.add("Stable epochs", static_cast<uint32_t>(stable_epochs_));
+  stat.add("Backups", sos_backups_);
+  stat.add("Failed backups", sos_backups_failed_);
+  if (!last_sos_backup_ok_.isZero())
+    stat.add("Last backup age [s]",
+             (ros::WallTime::now() - last_sos_backup_ok_).toSec());
+}
+
 bool UbloxFirmware8::configureUblox() {
   if(clear_bbr_) {
     // clear flash memory
@@ -1215,12 +2764,43 @@ void UbloxFirmware8::subscribe() {
   gps.subscribe<ublox_msgs::NavPVT>(
     boost::bind(&UbloxFirmware7Plus::callbackNavPvt, this, _1), kSubscribeRate);
 
+  // High precision position, only supported by high precision GNSS devices
+  nh->param("high_precision_fix", high_precision_fix_, false);
+  nh->param("publish/nav/hpposllh", enabled["nav_hpposllh"], false);
+  if (high_precision_fix_ || enabled["nav_hpposllh"])
+    gps.subscribe<ublox_msgs::NavHPPOSLLH>(boost::bind(
+        &UbloxFirmware7Plus::callbackNavHpPosLlh, this, _1), kSubscribeRate);
+  // The fix merges NavPVT with NavHPPOSLLH, dispatch them together
+  if (high_precision_fix_ && nh->param("dispatch/prioritize", false))
+    gps.setPriority(ublox_msgs::Class::NAV,
+                    ublox_msgs::Message::NAV::HPPOSLLH);
+  nh->param("publish/nav/hpposecef", enabled["nav_hpposecef"], false);
+  if (enabled["nav_hpposecef"])
+    gps.subscribe<ublox_msgs::NavHPPOSECEF>(boost::bind(
+        publish<ublox_msgs::NavHPPOSECEF>, _1, "navhpposecef"),
+        kSubscribeRate);
+
   // Subscribe to Nav SAT messages
   nh->param("publish/nav/sat", enabled["nav_sat"], enabled["nav"]);
   if (enabled["nav_sat"])
     gps.subscribe<ublox_msgs::NavSAT>(boost::bind(
         publish<ublox_msgs::NavSAT>, _1, "navsat"), kNavSvInfoSubscribeRate);
 
+  // Periodic UPD-SOS backup & TTFF after a restore
+  if (sos_backup_period_ > 0 || save_on_shutdown_) {
+    ublox_msgs::UpdSOS_Ack sos;
+    if (gps.poll(sos) && sos.cmd == sos.CMD_SYSTEM_RESTORED) {
+      sos_restore_response_ = sos.response;
+      ROS_INFO("u-blox UPD-SOS restore response: %u", sos.response);
+    } else {
+      ROS_WARN("Failed to poll the u-blox UPD-SOS restore status");
+    }
+    gps.subscribe<ublox_msgs::NavPVT>(boost::bind(
+        &UbloxFirmware8::callbackSosNavPvt, this, _1));
+    sos_timer_ = nh->createTimer(ros::Duration(1.0),
+                                 &UbloxFirmware8::checkSosBackup, this);
+  }
+
   // Subscribe to Mon HW
   nh->param("publish/mon/hw", enabled["mon_hw"], enabled["mon"]);
   if (enabled["mon_hw"])
@@ -1448,6 +3028,7 @@ void AdrUdrProduct::callbackEsfMEAS(const ublox_msgs::EsfMEAS &m) {
 // u-blox High Precision GNSS Reference Station
 //
 void HpgRefProduct::getRosParams() {
+  start_time_ = ros::WallTime::now();
   if (config_on_startup_flag_) {
     if(nav_rate * meas_rate != 1000)
       ROS_WARN("For HPG Ref devices, nav_rate should be exactly 1 Hz.");
@@ -1478,6 +3059,27 @@ void HpgRefProduct::getRosParams() {
       if(!nh->getParam("sv_in/acc_lim", sv_in_acc_lim_))
         throw std::runtime_error(std::string("Invalid settings: sv_in/acc_lim ")
                                 + "must be set if TMODE3 is survey-in");
+      // Stored survey-in results
+      bool store;
+      nh->param("sv_in/store/enable", store, false);
+      if (store) {
+        const char* home = getenv("HOME");
+        std::string directory;
+        nh->param("sv_in/store/directory", directory,
+                  std::string(home ? home : "/tmp") + "/.ros");
+        sv_in_store_.reset(new SurveyInStore(directory));
+        nh->param("sv_in/store/site", sv_in_site_, std::string("default"));
+        double max_age;
+        nh->param("sv_in/store/max_age", max_age, 30.0); // [days]
+        checkMin(max_age, 0, "sv_in/store/max_age");
+        sv_in_store_max_age_ = max_age * 86400; // to [s]
+        nh->param("sv_in/store/max_acc", sv_in_store_max_acc_,
+                  static_cast<double>(sv_in_acc_lim_));
+        nh->param("sv_in/store/tolerance", sv_in_store_tolerance_, 10.0);
+        checkMin(sv_in_store_tolerance_, 0, "sv_in/store/tolerance");
+        nh->param("sv_in/store/fix_timeout", sv_in_store_fix_timeout_, 60.0);
+        checkMin(sv_in_store_fix_timeout_, 0, "sv_in/store/fix_timeout");
+      }
     } else if(tmode3_ != ublox_msgs::CfgTMODE3::FLAGS_MODE_DISABLED) {
       throw std::runtime_error(std::string("tmode3 param invalid. See CfgTMODE3")
                               + " flag constants for possible values.");
@@ -1498,8 +3100,13 @@ bool HpgRefProduct::configureUblox() {
     if(!gps.configRtcm(rtcm_ids, rtcm_rates))
       throw std::runtime_error("Failed to set RTCM rates");
     mode_ = FIXED;
+    recordTimeToCorrections();
   } else if(tmode3_ == ublox_msgs::CfgTMODE3::FLAGS_MODE_SURVEY_IN) {
-    if(!svin_reset_) {
+    // Skip the survey-in if a valid result is stored for the site
+    bool reset = svin_reset_;
+    if(sv_in_store_ && configStoredSurveyIn(reset))
+      return true;
+    if(!reset) {
       ublox_msgs::NavSVIN nav_svin;
       if(!gps.poll(nav_svin))
         throw std::runtime_error(std::string("Failed to poll NavSVIN while") +
@@ -1566,10 +3173,47 @@ void HpgRefProduct::callbackNavSvIn(ublox_msgs::NavSVIN m) {
   last_nav_svin_ = m;
 
   if(!m.active && m.valid && mode_ == SURVEY_IN) {
-    setTimeMode();
+    if (sv_in_store_) {
+      SurveyInResult result = SurveyInStore::fromNavSvIn(
+          sv_in_site_, m, ros::WallTime::now().toSec());
+      if (sv_in_store_->save(result))
+        ROS_INFO("Stored the survey-in result of site %s in %s",
+                 sv_in_site_.c_str(), sv_in_store_->path(sv_in_site_).c_str());
+      // Applied again without a new survey-in after a receiver reset
+      stored_sv_in_ = result;
+      sv_in_validated_ = true;
+    }
+    // Configure off the I/O thread, which has to dispatch the ACKs
+    mode_ = TIME;
+    time_mode_timer_ = nh->createTimer(ros::Duration(0),
+                                       &HpgRefProduct::configTimeMode, this,
+                                       true);
   }
 
-  updater->update();
+  if (!m.active && m.valid) {
+    const double ecef[3] = {m.meanX * 1e-2 + m.meanXHP * 1e-4,
+                            m.meanY * 1e-2 + m.meanYHP * 1e-4,
+                            m.meanZ * 1e-2 + m.meanZHP * 1e-4};
+    setSurveyInOrigin(ecef);
+  }
+
+  updateDiagnostics();
+}
+
+void HpgRefProduct::setSurveyInOrigin(const double ecef[3]) {
+  // The survey-in position is the origin of the odometry
+  if (!local_frame || local_frame->valid() ||
+      local_frame->source() != LocalFrame::ORIGIN_SURVEY_IN)
+    return;
+  local_frame->setOriginEcef(ecef);
+  double lla[3];
+  local_frame->origin(lla);
+  ROS_INFO("Odometry origin set to the survey-in position: %.9f, %.9f, %.3f",
+           lla[0], lla[1], lla[2]);
+}
+
+void HpgRefProduct::configTimeMode(const ros::TimerEvent& event) {
+  setTimeMode();
 }
 
 bool HpgRefProduct::setTimeMode() {
@@ -1586,9 +3230,109 @@ bool HpgRefProduct::setTimeMode() {
     ROS_ERROR("Failed to configure RTCM IDs");
     return false;
   }
+  recordTimeToCorrections();
+  return true;
+}
+
+bool HpgRefProduct::configStoredSurveyIn(bool& reset) {
+  SurveyInResult result;
+  if (sv_in_validated_) {
+    // A receiver reset doesn't move the antenna, so the configuration
+    // recovery applies the result of this run again without waiting for a fix
+    result = stored_sv_in_;
+  } else {
+    if (!sv_in_store_->load(sv_in_site_, result)) {
+      ROS_INFO("No stored survey-in result for site %s, starting survey-in",
+               sv_in_site_.c_str());
+      return false;
+    }
+    // The receiver may still be fixed at the stored result of the last run,
+    // so a rejected result always needs a new survey-in
+    reset = true;
+    if (!validateStoredSurveyIn(result))
+      return false;
+  }
+
+  if (!gps.configTmode3FixedEcef(result.ecef, result.accuracy)) {
+    ROS_ERROR("Failed to set TMODE3 to the stored survey-in result");
+    return false;
+  }
+  if(!gps.configRtcm(rtcm_ids, rtcm_rates))
+    throw std::runtime_error("Failed to set RTCM rates");
+  stored_sv_in_ = result;
+  stored_sv_in_used_ = true;
+  sv_in_validated_ = true;
+  mode_ = FIXED;
+  const double age = ros::WallTime::now().toSec() - result.stamp; // [s]
+  ROS_INFO("TMODE3 fixed at the stored survey-in result of site %s (%.1f h %s",
+           sv_in_site_.c_str(), age / 3600, "old)");
+  setSurveyInOrigin(result.ecef);
+  recordTimeToCorrections();
   return true;
 }
 
+bool HpgRefProduct::validateStoredSurveyIn(const SurveyInResult& result) {
+  const double age = ros::WallTime::now().toSec() - result.stamp; // [s]
+  if (age < 0 || age > sv_in_store_max_age_) {
+    ROS_WARN("Stored survey-in result of site %s is %.1f days old, %s",
+             sv_in_site_.c_str(), age / 86400, "starting survey-in");
+    return false;
+  }
+  if (result.accuracy > sv_in_store_max_acc_) {
+    ROS_WARN("Stored survey-in result of site %s has an accuracy of %.3f m, %s",
+             sv_in_site_.c_str(), result.accuracy, "starting survey-in");
+    return false;
+  }
+  // The receiver can't survey while fixed and reports the fixed position in
+  // time mode, so disable TMODE3 and validate the stored result against a
+  // standalone 3D fix to detect a moved antenna
+  if (!gps.disableTmode3()) {
+    ROS_WARN("Failed to disable TMODE3 to validate the stored survey-in %s",
+             "result, starting survey-in");
+    return false;
+  }
+  mode_ = DISABLED;
+  const ros::WallTime deadline = ros::WallTime::now()
+      + ros::WallDuration(sv_in_store_fix_timeout_);
+  ublox_msgs::NavPVT nav_pvt;
+  bool fix = false;
+  while (ros::ok()) {
+    // The fix must be accurate enough to compare it with the tolerance
+    fix = gps.poll(nav_pvt) && nav_pvt.flags & nav_pvt.FLAGS_GNSS_FIX_OK
+        && nav_pvt.fixType == nav_pvt.FIX_TYPE_3D
+        && sqrt(pow(nav_pvt.hAcc * 1e-3, 2) + pow(nav_pvt.vAcc * 1e-3, 2))
+            <= sv_in_store_tolerance_;
+    if (fix || ros::WallTime::now() >= deadline)
+      break;
+    ros::WallDuration(1.0).sleep();
+  }
+  if (!fix) {
+    ROS_WARN("No 3D fix within %.0f s to validate the stored survey-in %s %s%s",
+             sv_in_store_fix_timeout_, "result of site", sv_in_site_.c_str(),
+             ", starting survey-in");
+    return false;
+  }
+  double ecef[3];
+  LocalFrame::toEcef(nav_pvt.lat * 1e-7, nav_pvt.lon * 1e-7,
+                     nav_pvt.height * 1e-3, ecef);
+  const double distance = sqrt(pow(ecef[0] - result.ecef[0], 2)
+                               + pow(ecef[1] - result.ecef[1], 2)
+                               + pow(ecef[2] - result.ecef[2], 2));
+  if (distance > sv_in_store_tolerance_) {
+    ROS_WARN("Stored survey-in result of site %s is %.1f m from the %s",
+             sv_in_site_.c_str(), distance, "current fix, starting survey-in");
+    return false;
+  }
+  return true;
+}
+
+void HpgRefProduct::recordTimeToCorrections() {
+  if (time_to_corrections_ >= 0)
+    return;
+  time_to_corrections_ = (ros::WallTime::now() - start_time_).toSec();
+  ROS_INFO("Base time to corrections: %.1f s", time_to_corrections_);
+}
+
 void HpgRefProduct::initializeRosDiagnostics() {
   updater->add("TMODE3", this, &HpgRefProduct::tmode3Diagnostics);
   updater->force_update();
@@ -1634,6 +3378,16 @@ void HpgRefProduct::tmode3Diagnostics(
     stat.level = diagnostic_msgs::DiagnosticStatus::OK;
     stat.message = "Time";
   }
+
+  if (time_to_corrections_ >= 0)
+    stat.add("Time to corrections [s]", time_to_corrections_);
+  if (stored_sv_in_used_) {
+    stat.message += " (stored survey-in)";
+    stat.add("Site", stored_sv_in_.site);
+    stat.add("Stored survey-in age [h]",
+             (ros::WallTime::now().toSec() - stored_sv_in_.stamp) / 3600);
+    stat.add("Stored survey-in accuracy [m]", stored_sv_in_.accuracy);
+  }
 }
 
 //
@@ -1711,7 +3465,7 @@ void HpgRovProduct::callbackNavRelPosNed(const ublox_msgs::NavRELPOSNED &m) {
   }
 
   last_rel_pos_ = m;
-  updater->update();
+  updateDiagnostics();
 }
 
 //
@@ -1768,7 +3522,7 @@ void HpPosRecProduct::callbackNavRelPosNed(const ublox_msgs::NavRELPOSNED9 &m) {
   }
 
   last_rel_pos_ = m;
-  updater->update();
+  updateDiagnostics();
 }
 
 //
@@ -1846,21 +3600,10 @@ void TimProduct::initializeRosDiagnostics() {
   updater->force_update();
 }
 
-void rtcmCallback(const rtcm_msgs::Message::ConstPtr &msg)
-{
-  gps.sendRtcm(msg->message);
-}
-
 int main(int argc, char** argv) {
   ros::init(argc, argv, "ublox_gps");
   nh.reset(new ros::NodeHandle("~"));
   nh->param("debug", ublox_gps::debug, 1);
-  
-  ros::NodeHandle param_nh("~");
-  std::string rtcm_topic;
-  param_nh.param("rtcm_topic", rtcm_topic, std::string("rtcm"));
-  subRTCM = nh->subscribe(rtcm_topic, 10, rtcmCallback);
-  
   if(ublox_gps::debug) {
     if (ros::console::set_logger_level(ROSCONSOLE_DEFAULT_NAME,
                                        ros::console::levels::Debug))
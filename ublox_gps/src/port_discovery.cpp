@@ -0,0 +1,143 @@
+//==============================================================================
+// Copyright (c) 2012, Johannes Meyer, TU Darmstadt
+// All rights reserved.
+
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//     * Neither the name of the Flight Systems and Automatic Control group,
+//       TU Darmstadt, nor the names of its contributors may be used to
+//       endorse or promote products derived from this software without
+//       specific prior written permission.
+
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" 
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE 
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE 
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER BE LIABLE FOR ANY
+// DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+// (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+// LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+// ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+// SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//==============================================================================
+
+#include "ublox_gps/port_discovery.h"
+#include <glob.h>
+#include <limits.h>
+#include <stdlib.h>
+#include <algorithm>
+#include <map>
+#include <boost/algorithm/string.hpp>
+#include <boost/bind.hpp>
+#include <boost/format.hpp>
+#include <boost/thread.hpp>
+#include <ublox_gps/gps.h>
+
+namespace ublox_gps {
+
+namespace {
+
+/**
+ * @brief Convert a zero-terminated character array to a string.
+ */
+template <typename Array>
+std::string toString(const Array& array) {
+  return std::string(array.begin(),
+                     std::find(array.begin(), array.end(), '\0'));
+}
+
+}  // namespace
+
+PortDiscovery::PortDiscovery(const std::vector<unsigned int>& baudrates,
+                             const boost::posix_time::time_duration& timeout)
+    : baudrates_(baudrates), timeout_(timeout) {}
+
+std::vector<std::string> PortDiscovery::expand(
+    const std::vector<std::string>& patterns) {
+  // The first name of each device, by its resolved path
+  std::map<std::string, std::string> devices;
+  for (std::size_t i = 0; i < patterns.size(); ++i) {
+    glob_t matches;
+    if (glob(patterns[i].c_str(), 0, NULL, &matches) == 0) {
+      for (std::size_t j = 0; j < matches.gl_pathc; ++j) {
+        char resolved[PATH_MAX];
+        const std::string name(matches.gl_pathv[j]);
+        devices.insert(std::make_pair(
+            realpath(name.c_str(), resolved) ? std::string(resolved) : name,
+            name));
+      }
+    }
+    globfree(&matches);
+  }
+  std::vector<std::string> ports;
+  for (std::map<std::string, std::string>::const_iterator it =
+           devices.begin(); it != devices.end(); ++it)
+    ports.push_back(it->second);
+  std::sort(ports.begin(), ports.end());
+  return ports;
+}
+
+std::vector<ProbeResult> PortDiscovery::probe(
+    const std::vector<std::string>& ports) const {
+  std::vector<ProbeResult> results(ports.size());
+  boost::thread_group threads;
+  for (std::size_t i = 0; i < ports.size(); ++i)
+    threads.create_thread(boost::bind(&PortDiscovery::probePort, this,
+                                      ports[i], &results[i]));
+  threads.join_all();
+  return results;
+}
+
+void PortDiscovery::probePort(const std::string& port,
+                              ProbeResult* result) const {
+  result->port = port;
+  result->found = false;
+  result->baudrate = 0;
+  for (std::size_t i = 0; i < baudrates_.size(); ++i) {
+    // Reopen the port for each baudrate, the probe does not configure it
+    Gps gps;
+    gps.setConfigOnStartup(false);
+    try {
+      gps.initializeProbe(port, baudrates_[i]);
+    } catch (std::runtime_error& e) {
+      result->error = e.what();
+      return;
+    }
+
+    ublox_msgs::MonVER version;
+    if (!gps.poll(version, std::vector<uint8_t>(), timeout_))
+      continue;
+    result->found = true;
+    result->baudrate = baudrates_[i];
+    result->sw_version = toString(version.swVersion);
+    result->hw_version = toString(version.hwVersion);
+
+    // Not supported by older firmware
+    ublox_msgs::SecUNIQID id;
+    if (gps.poll(id, std::vector<uint8_t>(), timeout_)) {
+      for (std::size_t j = 0; j < id.uniqueId.size(); ++j)
+        result->unique_id += (boost::format("%02x") %
+                              static_cast<unsigned int>(id.uniqueId[j])).str();
+    }
+    return;
+  }
+  result->error = "No answer to MON-VER";
+}
+
+int findReceiver(const std::vector<ProbeResult>& results,
+                 const std::string& unique_id, const std::string& exclude) {
+  for (std::size_t i = 0; i < results.size(); ++i) {
+    if (results[i].found && !results[i].unique_id.empty()
+        && results[i].port != exclude
+        && boost::iequals(results[i].unique_id, unique_id))
+      return i;
+  }
+  return -1;
+}
+
+}  // namespace ublox_gps
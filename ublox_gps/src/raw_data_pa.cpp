@@ -50,6 +50,7 @@ using namespace ublox_node;
 RawDataStreamPa::RawDataStreamPa(bool is_ros_subscriber) :
   pnh_(ros::NodeHandle("~")),
   flag_publish_(false),
+  flag_capture_(false),
   is_ros_subscriber_(is_ros_subscriber) {
 
 }
@@ -61,6 +62,7 @@ void RawDataStreamPa::getRosParams() {
     } else {
         pnh_.param<std::string>("raw_data_stream/dir", file_dir_, "");
         pnh_.param("raw_data_stream/publish", flag_publish_, false);
+        pnh_.param("raw_data_stream/capture", flag_capture_, false);
     }
 }
 
@@ -73,6 +75,11 @@ bool RawDataStreamPa::isEnabled() {
     }
 }
 
+bool RawDataStreamPa::isCapturing() {
+
+    return flag_capture_ && !is_ros_subscriber_ && !file_dir_.empty();
+}
+
 
 void RawDataStreamPa::initialize() {
 
@@ -118,9 +125,21 @@ void RawDataStreamPa::initialize() {
               filename << time_struct.tm_hour;
             filename.width(2); filename.fill('0');
               filename << time_struct.tm_min ;
-            filename.width(0); filename << ".log";
+            filename.width(0);
+              filename << (isCapturing() ? ".ubxcap" : ".log");
             file_name_ = file_dir_ + filename.str();
 
+            if (isCapturing()) {
+                if (capture_.open(file_name_)) {
+                    ROS_INFO("Capturing raw data to file \"%s\"",
+                      file_name_.c_str());
+                } else {
+                    ROS_ERROR("Can't capture raw data to file. "
+                      "Can't create file \"%s\".", file_name_.c_str());
+                }
+                return;
+            }
+
             try {
                 file_handle_.open(file_name_);
                 ROS_INFO("Logging raw data to file \"%s\"",
@@ -136,6 +155,14 @@ void RawDataStreamPa::initialize() {
 void RawDataStreamPa::ubloxCallback(const unsigned char* data,
   const std::size_t size) {
 
+    if (isCapturing()) {
+        // Written without copying the data
+        capture_.write(ublox_gps::CaptureRecord::RX, data, size);
+        if (!flag_publish_) {
+            return;
+        }
+    }
+
     std::string str((const char*) data, size);
 
     if (flag_publish_) {
@@ -145,6 +172,14 @@ void RawDataStreamPa::ubloxCallback(const unsigned char* data,
     saveToFile(str);
 }
 
+void RawDataStreamPa::sentCallback(const unsigned char* data,
+  const std::size_t size) {
+
+    if (isCapturing()) {
+        capture_.write(ublox_gps::CaptureRecord::TX, data, size);
+    }
+}
+
 void RawDataStreamPa::msgCallback(
   const std_msgs::UInt8MultiArray::ConstPtr& msg) {
 
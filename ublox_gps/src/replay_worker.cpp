@@ -0,0 +1,161 @@
+//==============================================================================
+// Copyright (c) 2012, Johannes Meyer, TU Darmstadt
+// All rights reserved.
+
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//     * Neither the name of the Flight Systems and Automatic Control group,
+//       TU Darmstadt, nor the names of its contributors may be used to
+//       endorse or promote products derived from this software without
+//       specific prior written permission.
+
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" 
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE 
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE 
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER BE LIABLE FOR ANY
+// DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+// (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+// LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+// ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+// SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//==============================================================================
+
+#include "ublox_gps/replay_worker.h"
+#include <cstring>
+#include <stdexcept>
+#include <ros/console.h>
+
+using namespace ublox_gps;
+
+namespace {
+
+//! Maximum number of sent chunks waiting to be compared with the capture
+const std::size_t kMaxSent = 64;
+
+}  // namespace
+
+ReplayWorker::ReplayWorker(const std::string& path, double speed,
+                           const boost::posix_time::time_duration& sync_timeout)
+    : speed_(speed), sync_timeout_(sync_timeout), stopping_(false),
+      open_(true), mismatches_(0), in_(8192), in_buffer_size_(0) {
+  if (!reader_.open(path))
+    throw std::runtime_error("U-Blox: Could not open capture file " + path);
+}
+
+ReplayWorker::~ReplayWorker() {
+  {
+    boost::mutex::scoped_lock lock(mutex_);
+    stopping_ = true;
+  }
+  condition_.notify_all();
+  if (thread_)
+    thread_->join();
+}
+
+void ReplayWorker::setCallback(const Callback& callback) {
+  read_callback_ = callback;
+  if (!thread_)
+    thread_.reset(new boost::thread(boost::bind(&ReplayWorker::run, this)));
+}
+
+bool ReplayWorker::send(const unsigned char* data, const unsigned int size) {
+  {
+    boost::mutex::scoped_lock lock(mutex_);
+    sent_.push_back(std::vector<unsigned char>(data, data + size));
+    if (sent_.size() > kMaxSent)
+      sent_.pop_front();
+  }
+  condition_.notify_all();
+  return true;
+}
+
+void ReplayWorker::wait(const boost::posix_time::time_duration& timeout) {
+  boost::mutex::scoped_lock lock(read_mutex_);
+  read_condition_.timed_wait(lock, timeout);
+}
+
+bool ReplayWorker::isOpen() const {
+  boost::mutex::scoped_lock lock(mutex_);
+  return open_;
+}
+
+void ReplayWorker::run() {
+  CaptureRecord record;
+  // The capture & replay time of the last sent chunk, or of the start
+  uint64_t base_capture = 0;
+  boost::system_time base_time;
+  bool first = true;
+  while (reader_.read(record)) {
+    if (first) {
+      base_capture = record.monotonic;
+      base_time = boost::get_system_time();
+      first = false;
+    }
+    if (record.direction == CaptureRecord::TX) {
+      synchronize(record);
+      base_capture = record.monotonic;
+      base_time = boost::get_system_time();
+    } else if (record.direction == CaptureRecord::RX) {
+      if (speed_ > 0 && record.monotonic > base_capture) {
+        const boost::system_time due = base_time
+            + boost::posix_time::microseconds(static_cast<int64_t>(
+                (record.monotonic - base_capture) * 1e-3 / speed_));
+        boost::mutex::scoped_lock lock(mutex_);
+        while (!stopping_ && condition_.timed_wait(lock, due)) {}
+      }
+      deliver(record);
+    }
+    boost::mutex::scoped_lock lock(mutex_);
+    if (stopping_)
+      return;
+  }
+
+  boost::mutex::scoped_lock lock(mutex_);
+  open_ = false;
+  ROS_INFO("U-Blox: Replay finished, %u sent messages differed from the "
+           "capture", mismatches_);
+}
+
+void ReplayWorker::synchronize(const CaptureRecord& record) {
+  boost::mutex::scoped_lock lock(mutex_);
+  const boost::system_time timeout = boost::get_system_time() + sync_timeout_;
+  while (!stopping_ && sent_.empty())
+    if (!condition_.timed_wait(lock, timeout))
+      break;
+  if (stopping_)
+    return;
+  if (sent_.empty()) {
+    ROS_WARN("U-Blox: Replay timed out waiting for the %zu bytes sent "
+             "during the capture", record.data.size());
+    return;
+  }
+  if (sent_.front() != record.data) {
+    ++mismatches_;
+    ROS_WARN("U-Blox: Replay received %zu sent bytes, which differ from the "
+             "%zu bytes sent during the capture", sent_.front().size(),
+             record.data.size());
+  }
+  sent_.pop_front();
+}
+
+void ReplayWorker::deliver(const CaptureRecord& record) {
+  boost::mutex::scoped_lock lock(read_mutex_);
+  std::size_t size = record.data.size();
+  if (in_buffer_size_ + size > in_.size())
+    in_.resize(in_buffer_size_ + size);
+  unsigned char* start = in_.data() + in_buffer_size_;
+  std::memcpy(start, record.data.data(), size);
+  in_buffer_size_ += size;
+
+  if (write_callback_)
+    write_callback_(start, size);
+  if (read_callback_)
+    read_callback_(in_.data(), in_buffer_size_);
+  read_condition_.notify_all();
+}
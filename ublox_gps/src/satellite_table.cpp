@@ -0,0 +1,280 @@
+//==============================================================================
+// Copyright (c) 2012, Johannes Meyer, TU Darmstadt
+// All rights reserved.
+
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//     * Neither the name of the Flight Systems and Automatic Control group,
+//       TU Darmstadt, nor the names of its contributors may be used to
+//       endorse or promote products derived from this software without
+//       specific prior written permission.
+
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" 
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE 
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE 
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER BE LIABLE FOR ANY
+// DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+// (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+// LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+// ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+// SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//==============================================================================
+
+#include "ublox_gps/satellite_table.h"
+#include <algorithm>
+#include <cstdlib>
+
+using namespace ublox_node;
+
+SatelliteTable::SatelliteTable(uint8_t cno_threshold)
+    : cno_threshold_(cno_threshold), index_(kNumGnss * kNumSv, -1),
+      epoch_(0) {}
+
+bool SatelliteTable::fromSvInfoId(uint8_t svid, uint8_t& gnss_id,
+                                  uint8_t& sv_id) {
+  // See Satellite Numbering in the u-blox protocol specification
+  if (svid >= 1 && svid <= 32) {
+    gnss_id = 0;  // GPS
+    sv_id = svid;
+  } else if (svid >= 33 && svid <= 64) {
+    gnss_id = 3;  // BeiDou B6-B37
+    sv_id = svid - 27;
+  } else if (svid >= 65 && svid <= 96) {
+    gnss_id = 6;  // GLONASS
+    sv_id = svid - 64;
+  } else if (svid >= 120 && svid <= 158) {
+    gnss_id = 1;  // SBAS
+    sv_id = svid;
+  } else if (svid >= 159 && svid <= 163) {
+    gnss_id = 3;  // BeiDou B1-B5
+    sv_id = svid - 158;
+  } else if (svid >= 173 && svid <= 182) {
+    gnss_id = 4;  // IMES
+    sv_id = svid - 172;
+  } else if (svid >= 193 && svid <= 202) {
+    gnss_id = 5;  // QZSS
+    sv_id = svid - 192;
+  } else if (svid >= 211 && svid <= 246) {
+    gnss_id = 2;  // Galileo
+    sv_id = svid - 210;
+  } else {
+    return false;
+  }
+  return true;
+}
+
+std::size_t SatelliteTable::row(uint8_t gnss_id, uint8_t sv_id) {
+  int16_t& i = index_[gnss_id * kNumSv + sv_id];
+  if (i >= 0)
+    return i;
+  i = gnss_id_.size();
+  gnss_id_.push_back(gnss_id);
+  sv_id_.push_back(sv_id);
+  cno_.push_back(0);
+  published_cno_.push_back(0);
+  elev_.push_back(0);
+  azim_.push_back(0);
+  pr_res_.push_back(0);
+  quality_.push_back(0);
+  used_.push_back(false);
+  carrier_valid_.push_back(false);
+  locktime_.push_back(0);
+  epoch_seen_.push_back(epoch_);
+  dirty_.push_back(ADDED);
+  return i;
+}
+
+void SatelliteTable::set(std::size_t i, uint8_t cno, int8_t elev,
+                         int16_t azim, float pr_res, uint8_t quality,
+                         bool used) {
+  if (!(dirty_[i] & ADDED)
+      && (used_[i] != used || quality_[i] != quality || elev_[i] != elev
+          || std::abs(cno - published_cno_[i]) >= cno_threshold_))
+    dirty_[i] |= CHANGED;
+  cno_[i] = cno;
+  elev_[i] = elev;
+  azim_[i] = azim;
+  pr_res_[i] = pr_res;
+  quality_[i] = quality;
+  used_[i] = used;
+  epoch_seen_[i] = epoch_;
+}
+
+void SatelliteTable::removeUnseen() {
+  std::size_t i = 0;
+  while (i < gnss_id_.size()) {
+    if (epoch_seen_[i] == epoch_) {
+      ++i;
+      continue;
+    }
+    // Satellites added since the last delta were never published
+    if (!(dirty_[i] & ADDED))
+      removed_.push_back(state(i));
+    // Move the last row to this row
+    const std::size_t last = gnss_id_.size() - 1;
+    index_[gnss_id_[i] * kNumSv + sv_id_[i]] = -1;
+    if (i != last) {
+      index_[gnss_id_[last] * kNumSv + sv_id_[last]] = i;
+      gnss_id_[i] = gnss_id_[last];
+      sv_id_[i] = sv_id_[last];
+      cno_[i] = cno_[last];
+      published_cno_[i] = published_cno_[last];
+      elev_[i] = elev_[last];
+      azim_[i] = azim_[last];
+      pr_res_[i] = pr_res_[last];
+      quality_[i] = quality_[last];
+      used_[i] = used_[last];
+      carrier_valid_[i] = carrier_valid_[last];
+      locktime_[i] = locktime_[last];
+      epoch_seen_[i] = epoch_seen_[last];
+      dirty_[i] = dirty_[last];
+    }
+    gnss_id_.pop_back();
+    sv_id_.pop_back();
+    cno_.pop_back();
+    published_cno_.pop_back();
+    elev_.pop_back();
+    azim_.pop_back();
+    pr_res_.pop_back();
+    quality_.pop_back();
+    used_.pop_back();
+    carrier_valid_.pop_back();
+    locktime_.pop_back();
+    epoch_seen_.pop_back();
+    dirty_.pop_back();
+  }
+}
+
+void SatelliteTable::update(const ublox_msgs::NavSAT& m) {
+  boost::mutex::scoped_lock lock(mutex_);
+  ++epoch_;
+  for (std::size_t j = 0; j < m.sv.size(); ++j) {
+    const ublox_msgs::NavSAT_SV& sv = m.sv[j];
+    if (sv.gnssId >= kNumGnss)
+      continue;
+    set(row(sv.gnssId, sv.svId), sv.cno, sv.elev, sv.azim, sv.prRes * 0.1f,
+        sv.flags & sv.FLAGS_QUALITY_IND_MASK,
+        sv.flags & sv.FLAGS_SV_USED);
+  }
+  removeUnseen();
+}
+
+void SatelliteTable::update(const ublox_msgs::NavSVINFO& m) {
+  boost::mutex::scoped_lock lock(mutex_);
+  ++epoch_;
+  for (std::size_t j = 0; j < m.sv.size(); ++j) {
+    const ublox_msgs::NavSVINFO_SV& sv = m.sv[j];
+    uint8_t gnss_id, sv_id;
+    if (!fromSvInfoId(sv.svid, gnss_id, sv_id))
+      continue;
+    set(row(gnss_id, sv_id), sv.cno, sv.elev, sv.azim, sv.prRes * 0.01f,
+        sv.quality & 0x0F, sv.flags & sv.FLAGS_SV_USED);
+  }
+  removeUnseen();
+}
+
+void SatelliteTable::update(const ublox_msgs::RxmRAWX& m) {
+  boost::mutex::scoped_lock lock(mutex_);
+  // Combine the signals of each satellite
+  std::vector<uint8_t> valid(gnss_id_.size(), false);
+  std::vector<uint16_t> locktime(gnss_id_.size(), 0);
+  std::vector<uint8_t> seen(gnss_id_.size(), false);
+  for (std::size_t j = 0; j < m.meas.size(); ++j) {
+    const ublox_msgs::RxmRAWX_Meas& meas = m.meas[j];
+    if (meas.gnssId >= kNumGnss)
+      continue;
+    int16_t i = index_[meas.gnssId * kNumSv + meas.svId];
+    if (i < 0)
+      continue;
+    seen[i] = true;
+    if (meas.trkStat & meas.TRK_STAT_CP_VALID) {
+      valid[i] = true;
+      locktime[i] = std::max(locktime[i], meas.locktime);
+    }
+  }
+  for (std::size_t i = 0; i < gnss_id_.size(); ++i) {
+    if (!seen[i])
+      continue;
+    if (!(dirty_[i] & ADDED) && carrier_valid_[i] != valid[i])
+      dirty_[i] |= CHANGED;
+    carrier_valid_[i] = valid[i];
+    locktime_[i] = locktime[i];
+  }
+}
+
+ublox_msgs::SatelliteState SatelliteTable::state(std::size_t i) const {
+  ublox_msgs::SatelliteState sv;
+  sv.gnssId = gnss_id_[i];
+  sv.svId = sv_id_[i];
+  sv.cno = cno_[i];
+  sv.cnoTrend = (dirty_[i] & ADDED) ? 0 : cno_[i] - published_cno_[i];
+  sv.elev = elev_[i];
+  sv.azim = azim_[i];
+  sv.prRes = pr_res_[i];
+  sv.quality = quality_[i];
+  sv.used = used_[i];
+  sv.carrierValid = carrier_valid_[i];
+  sv.locktime = locktime_[i];
+  return sv;
+}
+
+void SatelliteTable::summarize(
+    std::vector<ublox_msgs::SatelliteSummary>& summary) const {
+  std::vector<uint32_t> cno_sum(kNumGnss, 0);
+  std::vector<ublox_msgs::SatelliteSummary> gnss(kNumGnss);
+  for (std::size_t i = 0; i < gnss_id_.size(); ++i) {
+    ublox_msgs::SatelliteSummary& s = gnss[gnss_id_[i]];
+    if (s.numTracked == 0 || cno_[i] < s.minCno)
+      s.minCno = cno_[i];
+    s.maxCno = std::max(s.maxCno, cno_[i]);
+    ++s.numTracked;
+    s.numUsed += used_[i];
+    cno_sum[gnss_id_[i]] += cno_[i];
+  }
+  summary.clear();
+  for (std::size_t g = 0; g < kNumGnss; ++g) {
+    if (gnss[g].numTracked == 0)
+      continue;
+    gnss[g].gnssId = g;
+    gnss[g].meanCno = static_cast<float>(cno_sum[g]) / gnss[g].numTracked;
+    summary.push_back(gnss[g]);
+  }
+}
+
+bool SatelliteTable::takeDelta(ublox_msgs::SatelliteTableDelta& delta) {
+  boost::mutex::scoped_lock lock(mutex_);
+  delta.added.clear();
+  delta.changed.clear();
+  delta.removed.swap(removed_);
+  removed_.clear();
+  for (std::size_t i = 0; i < gnss_id_.size(); ++i) {
+    if (dirty_[i] & ADDED)
+      delta.added.push_back(state(i));
+    else if (dirty_[i] & CHANGED)
+      delta.changed.push_back(state(i));
+    else
+      continue;
+    published_cno_[i] = cno_[i];
+    dirty_[i] = 0;
+  }
+  summarize(delta.summary);
+  return !delta.added.empty() || !delta.changed.empty()
+      || !delta.removed.empty();
+}
+
+void SatelliteTable::get(
+    std::vector<ublox_msgs::SatelliteState>& satellites,
+    std::vector<ublox_msgs::SatelliteSummary>& summary) const {
+  boost::mutex::scoped_lock lock(mutex_);
+  satellites.clear();
+  satellites.reserve(gnss_id_.size());
+  for (std::size_t i = 0; i < gnss_id_.size(); ++i)
+    satellites.push_back(state(i));
+  summarize(summary);
+}
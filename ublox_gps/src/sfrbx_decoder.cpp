@@ -0,0 +1,441 @@
+//==============================================================================
+// Copyright (c) 2012, Johannes Meyer, TU Darmstadt
+// All rights reserved.
+
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//     * Neither the name of the Flight Systems and Automatic Control group,
+//       TU Darmstadt, nor the names of its contributors may be used to
+//       endorse or promote products derived from this software without
+//       specific prior written permission.
+
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" 
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE 
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE 
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER BE LIABLE FOR ANY
+// DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+// (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+// LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+// ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+// SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//==============================================================================
+
+#include "ublox_gps/sfrbx_decoder.h"
+#include <cmath>
+
+using namespace ublox_node;
+
+namespace {
+
+//! GPS LNAV telemetry word preamble
+const uint32_t kLnavPreamble = 0x8B;
+//! Pi as defined in the GPS and Galileo ICDs
+const double kGpsPi = 3.1415926535898;
+//! GPS subframe 4 page with the ionosphere & UTC parameters
+const uint32_t kLnavIonoUtcPage = 56;
+//! Galileo I/NAV word type of the last ephemeris part
+const uint32_t kInavLastEphemerisType = 4;
+
+/**
+ * @brief Lookup tables of the parity & CRC checks.
+ */
+struct Tables {
+  uint8_t parity[256]; //!< Parity of each byte
+  uint32_t crc24q[256]; //!< CRC-24Q of each byte
+
+  Tables() {
+    for (int i = 0; i < 256; ++i) {
+      int bits = 0;
+      for (int b = 0; b < 8; ++b)
+        bits += (i >> b) & 1;
+      parity[i] = bits & 1;
+      uint32_t crc = i << 16;
+      for (int b = 0; b < 8; ++b) {
+        crc <<= 1;
+        if (crc & 0x1000000)
+          crc ^= 0x1864CFB;
+      }
+      crc24q[i] = crc & 0xFFFFFF;
+    }
+  }
+};
+
+const Tables& tables() {
+  static const Tables tables;
+  return tables;
+}
+
+/**
+ * @brief Get the parity of a 32-bit value.
+ */
+uint32_t parity(uint32_t v) {
+  const uint8_t* p = tables().parity;
+  return p[v & 0xFF] ^ p[(v >> 8) & 0xFF] ^ p[(v >> 16) & 0xFF] ^ p[v >> 24];
+}
+
+/**
+ * @brief Check the parity of a GPS LNAV word.
+ *
+ * @details The data bits are not inverted by D30* of the previous word, as
+ * output by the receiver.
+ * @param word the 30-bit word
+ * @param previous the previous word, for D29* and D30*
+ */
+bool checkLnavParity(uint32_t word, uint32_t previous) {
+  // Parity equations of IS-GPS-200 20.3.5.2, for D29* D30* d1..d24 in
+  // bits 31..6
+  static const uint32_t kHamming[6] = {
+    0xBB1F3480, 0x5D8F9A40, 0xAEC7CD00, 0x5763E680, 0x6BB1F340, 0x8B7A89C0
+  };
+  const uint32_t w = (previous & 3) << 30 | (word & 0x3FFFFFC0);
+  uint32_t expected = 0;
+  for (int i = 0; i < 6; ++i)
+    expected = expected << 1 | parity(w & kHamming[i]);
+  return expected == (word & 0x3F);
+}
+
+/**
+ * @brief Compute the CRC-24Q of a byte buffer.
+ */
+uint32_t crc24q(const uint8_t* data, std::size_t size) {
+  const uint32_t* table = tables().crc24q;
+  uint32_t crc = 0;
+  for (std::size_t i = 0; i < size; ++i)
+    crc = ((crc << 8) & 0xFFFFFF) ^ table[(crc >> 16) ^ data[i]];
+  return crc;
+}
+
+/**
+ * @brief Get bits of a stream of 32-bit words, MSB first.
+ * @param words the words
+ * @param pos the position of the first bit
+ * @param length the number of bits, at most 32
+ */
+uint32_t getBits(const std::vector<uint32_t>& words, std::size_t pos,
+                 int length) {
+  uint32_t value = 0;
+  for (int i = 0; i < length; ++i, ++pos)
+    value = value << 1 | ((words[pos / 32] >> (31 - pos % 32)) & 1);
+  return value;
+}
+
+/**
+ * @brief Set bits of a stream of 32-bit words, MSB first.
+ */
+void setBits(std::vector<uint32_t>& words, std::size_t pos, int length,
+             uint32_t value) {
+  for (int i = length - 1; i >= 0; --i, ++pos) {
+    const uint32_t mask = 1u << (31 - pos % 32);
+    if ((value >> i) & 1)
+      words[pos / 32] |= mask;
+    else
+      words[pos / 32] &= ~mask;
+  }
+}
+
+/**
+ * @brief Get the bits of a GPS LNAV data word.
+ * @param data the 24-bit data words 3 to 10 of the subframe
+ * @param word the word number as in the ICD, 3 to 10
+ * @param first the first bit, 1 is the MSB as in the ICD
+ * @param length the number of bits
+ */
+uint32_t lnavBits(const std::vector<uint32_t>& data, int word, int first,
+                  int length) {
+  return (data[word - 3] >> (25 - first - length)) & ((1u << length) - 1);
+}
+
+/**
+ * @brief Sign extend a two's complement value.
+ */
+int32_t signed_(uint32_t value, int length) {
+  if (length < 32 && (value & (1u << (length - 1))))
+    value |= ~((1u << length) - 1);
+  return static_cast<int32_t>(value);
+}
+
+}  // namespace
+
+SfrbxDecoder::SfrbxDecoder()
+    : parts_(kNumGnss * kNumSv), almanacs_(33), utc_(kNumGnss) {
+  for (std::size_t i = 0; i < parts_.size(); ++i) {
+    parts_[i].received = 0;
+    parts_[i].iode = 0xFFFF;
+    parts_[i].toe = -1;
+  }
+  for (std::size_t i = 0; i < almanacs_.size(); ++i)
+    almanacs_[i].sv_id = 0;
+  ionosphere_.klobuchar_valid = false;
+  ionosphere_.nequick_valid = false;
+  for (std::size_t i = 0; i < utc_.size(); ++i)
+    utc_[i].valid = false;
+  statistics_.subframes = 0;
+  statistics_.parity_errors = 0;
+  statistics_.unsupported = 0;
+  statistics_.ephemerides = 0;
+  statistics_.almanacs = 0;
+}
+
+void SfrbxDecoder::decode(const ublox_msgs::RxmSFRBX& m) {
+  std::vector<Ephemeris> ephemerides;
+  {
+    boost::mutex::scoped_lock lock(mutex_);
+    if (m.svId >= kNumSv) {
+      ++statistics_.unsupported;
+      return;
+    }
+    if ((m.gnssId == 0 || m.gnssId == 5) && m.dwrd.size() == 10)
+      decodeLnav(m);
+    else if (m.gnssId == 2 && m.dwrd.size() == 8)
+      decodeInav(m);
+    else
+      ++statistics_.unsupported;
+    ephemerides.swap(pending_);
+  }
+  // Call outside the lock
+  if (ephemeris_callback_)
+    for (std::size_t i = 0; i < ephemerides.size(); ++i)
+      ephemeris_callback_(ephemerides[i]);
+}
+
+void SfrbxDecoder::decodeLnav(const ublox_msgs::RxmSFRBX& m) {
+  // Words 2 & 10 end with 00, so D29* & D30* of word 1 are 0
+  uint32_t previous = 0;
+  std::vector<uint32_t> data(8);
+  for (std::size_t i = 0; i < 10; ++i) {
+    const uint32_t word = m.dwrd[i] & 0x3FFFFFFF;
+    if (!checkLnavParity(word, previous)) {
+      ++statistics_.parity_errors;
+      return;
+    }
+    if (i >= 2)
+      data[i - 2] = word >> 6;
+    previous = word;
+  }
+  if ((m.dwrd[0] >> 22 & 0xFF) != kLnavPreamble) {
+    ++statistics_.parity_errors;
+    return;
+  }
+  ++statistics_.subframes;
+
+  const uint32_t subframe = (m.dwrd[1] >> 8) & 7;
+  if (subframe >= 1 && subframe <= 3) {
+    Parts& parts = parts_[m.gnssId * kNumSv + m.svId];
+    parts.data.resize(3);
+    parts.data[subframe - 1] = data;
+    parts.received |= 1 << (subframe - 1);
+    Ephemeris eph;
+    if (parts.received == 7
+        && decodeGpsEphemeris(m.svId, parts.data[0], parts.data[1],
+                              parts.data[2], eph)) {
+      eph.gnss_id = m.gnssId;
+      publish(parts, eph);
+    }
+    return;
+  }
+  // The almanac, ionosphere & UTC pages of QZSS differ from GPS
+  if (m.gnssId != 0)
+    return;
+
+  const uint32_t page = lnavBits(data, 3, 3, 6);
+  if ((subframe == 5 && page >= 1 && page <= 24)
+      || (subframe == 4 && page >= 25 && page <= 32)) {
+    GpsAlmanac& alm = almanacs_[page];
+    if (alm.sv_id == 0)
+      ++statistics_.almanacs;
+    alm.sv_id = page;
+    alm.e = lnavBits(data, 3, 9, 16) * std::pow(2.0, -21);
+    alm.toa = lnavBits(data, 4, 1, 8) * 4096.0;
+    alm.delta_i = signed_(lnavBits(data, 4, 9, 16), 16) * std::pow(2.0, -19)
+        * kGpsPi;
+    alm.omega_dot = signed_(lnavBits(data, 5, 1, 16), 16)
+        * std::pow(2.0, -38) * kGpsPi;
+    alm.health = lnavBits(data, 5, 17, 8);
+    alm.sqrt_a = lnavBits(data, 6, 1, 24) * std::pow(2.0, -11);
+    alm.omega0 = signed_(lnavBits(data, 7, 1, 24), 24) * std::pow(2.0, -23)
+        * kGpsPi;
+    alm.omega = signed_(lnavBits(data, 8, 1, 24), 24) * std::pow(2.0, -23)
+        * kGpsPi;
+    alm.m0 = signed_(lnavBits(data, 9, 1, 24), 24) * std::pow(2.0, -23)
+        * kGpsPi;
+    alm.af0 = signed_(lnavBits(data, 10, 1, 8) << 3
+                      | lnavBits(data, 10, 20, 3), 11) * std::pow(2.0, -20);
+    alm.af1 = signed_(lnavBits(data, 10, 9, 11), 11) * std::pow(2.0, -38);
+  } else if (subframe == 4 && page == kLnavIonoUtcPage) {
+    IonosphereParams& iono = ionosphere_;
+    iono.alpha[0] = signed_(lnavBits(data, 3, 9, 8), 8) * std::pow(2.0, -30);
+    iono.alpha[1] = signed_(lnavBits(data, 3, 17, 8), 8)
+        * std::pow(2.0, -27);
+    iono.alpha[2] = signed_(lnavBits(data, 4, 1, 8), 8) * std::pow(2.0, -24);
+    iono.alpha[3] = signed_(lnavBits(data, 4, 9, 8), 8) * std::pow(2.0, -24);
+    iono.beta[0] = signed_(lnavBits(data, 4, 17, 8), 8) * std::pow(2.0, 11);
+    iono.beta[1] = signed_(lnavBits(data, 5, 1, 8), 8) * std::pow(2.0, 14);
+    iono.beta[2] = signed_(lnavBits(data, 5, 9, 8), 8) * std::pow(2.0, 16);
+    iono.beta[3] = signed_(lnavBits(data, 5, 17, 8), 8) * std::pow(2.0, 16);
+    iono.klobuchar_valid = true;
+
+    UtcParams& utc = utc_[0];
+    utc.a1 = signed_(lnavBits(data, 6, 1, 24), 24) * std::pow(2.0, -50);
+    utc.a0 = signed_(lnavBits(data, 7, 1, 24) << 8 | lnavBits(data, 8, 1, 8),
+                     32) * std::pow(2.0, -30);
+    utc.tot = lnavBits(data, 8, 9, 8) * 4096;
+    utc.wnt = lnavBits(data, 8, 17, 8);
+    utc.dt_ls = signed_(lnavBits(data, 9, 1, 8), 8);
+    utc.wn_lsf = lnavBits(data, 9, 9, 8);
+    utc.dn = lnavBits(data, 9, 17, 8);
+    utc.dt_lsf = signed_(lnavBits(data, 10, 1, 8), 8);
+    utc.valid = true;
+  }
+}
+
+void SfrbxDecoder::decodeInav(const ublox_msgs::RxmSFRBX& m) {
+  // Even page part in bits 0-127, odd page part in bits 128-255
+  const std::vector<uint32_t>& page = m.dwrd;
+  // Skip alert pages
+  if (getBits(page, 1, 1) || getBits(page, 129, 1))
+    return;
+  if (getBits(page, 0, 1) != 0 || getBits(page, 128, 1) != 1) {
+    ++statistics_.parity_errors;
+    return;
+  }
+  // CRC over 4 padding bits, 114 bits of the even & 82 of the odd part
+  std::vector<uint32_t> crc_data(7, 0);
+  for (std::size_t i = 0; i < 114; ++i)
+    setBits(crc_data, 4 + i, 1, getBits(page, i, 1));
+  for (std::size_t i = 0; i < 82; ++i)
+    setBits(crc_data, 118 + i, 1, getBits(page, 128 + i, 1));
+  uint8_t bytes[25];
+  for (std::size_t i = 0; i < sizeof(bytes); ++i)
+    bytes[i] = getBits(crc_data, i * 8, 8);
+  if (crc24q(bytes, sizeof(bytes)) != getBits(page, 128 + 82, 24)) {
+    ++statistics_.parity_errors;
+    return;
+  }
+  ++statistics_.subframes;
+
+  // 128-bit word: 112 bits of the even & 16 of the odd part
+  std::vector<uint32_t> w(4, 0);
+  for (std::size_t i = 0; i < 112; i += 16)
+    setBits(w, i, 16, getBits(page, 2 + i, 16));
+  setBits(w, 112, 16, getBits(page, 130, 16));
+
+  const uint32_t type = getBits(w, 0, 6);
+  Parts& parts = parts_[m.gnssId * kNumSv + m.svId];
+  if (type >= 1 && type <= 5) {
+    parts.data.resize(5);
+    parts.data[type - 1] = w;
+    parts.received |= 1 << (type - 1);
+  }
+  if (type == 5) {
+    IonosphereParams& iono = ionosphere_;
+    iono.ai[0] = getBits(w, 6, 11) * std::pow(2.0, -2);
+    iono.ai[1] = signed_(getBits(w, 17, 11), 11) * std::pow(2.0, -8);
+    iono.ai[2] = signed_(getBits(w, 28, 14), 14) * std::pow(2.0, -15);
+    iono.nequick_valid = true;
+  } else if (type == 6) {
+    UtcParams& utc = utc_[2];
+    utc.a0 = signed_(getBits(w, 6, 32), 32) * std::pow(2.0, -30);
+    utc.a1 = signed_(getBits(w, 38, 24), 24) * std::pow(2.0, -50);
+    utc.dt_ls = signed_(getBits(w, 62, 8), 8);
+    utc.tot = getBits(w, 70, 8) * 3600;
+    utc.wnt = getBits(w, 78, 8);
+    utc.wn_lsf = getBits(w, 86, 8);
+    utc.dn = getBits(w, 94, 3);
+    utc.dt_lsf = signed_(getBits(w, 97, 8), 8);
+    utc.valid = true;
+  }
+
+  const uint8_t all = (1 << kInavLastEphemerisType) - 1;
+  if (type > kInavLastEphemerisType || (parts.received & all) != all)
+    return;
+  const std::vector<uint32_t>& w1 = parts.data[0];
+  const std::vector<uint32_t>& w2 = parts.data[1];
+  const std::vector<uint32_t>& w3 = parts.data[2];
+  const std::vector<uint32_t>& w4 = parts.data[3];
+  // All parts must have the same IODnav
+  const uint32_t iod = getBits(w1, 6, 10);
+  if (getBits(w2, 6, 10) != iod || getBits(w3, 6, 10) != iod
+      || getBits(w4, 6, 10) != iod)
+    return;
+
+  Ephemeris eph;
+  eph.gnss_id = m.gnssId;
+  eph.sv_id = m.svId;
+  eph.iode = iod;
+  eph.toe = getBits(w1, 16, 14) * 60.0;
+  eph.m0 = signed_(getBits(w1, 30, 32), 32) * std::pow(2.0, -31) * kGpsPi;
+  eph.e = getBits(w1, 62, 32) * std::pow(2.0, -33);
+  eph.sqrt_a = getBits(w1, 94, 32) * std::pow(2.0, -19);
+  eph.omega0 = signed_(getBits(w2, 16, 32), 32) * std::pow(2.0, -31)
+      * kGpsPi;
+  eph.i0 = signed_(getBits(w2, 48, 32), 32) * std::pow(2.0, -31) * kGpsPi;
+  eph.omega = signed_(getBits(w2, 80, 32), 32) * std::pow(2.0, -31) * kGpsPi;
+  eph.idot = signed_(getBits(w2, 112, 14), 14) * std::pow(2.0, -43) * kGpsPi;
+  eph.omega_dot = signed_(getBits(w3, 16, 24), 24) * std::pow(2.0, -43)
+      * kGpsPi;
+  eph.delta_n = signed_(getBits(w3, 40, 16), 16) * std::pow(2.0, -43)
+      * kGpsPi;
+  eph.cuc = signed_(getBits(w3, 56, 16), 16) * std::pow(2.0, -29);
+  eph.cus = signed_(getBits(w3, 72, 16), 16) * std::pow(2.0, -29);
+  eph.crc = signed_(getBits(w3, 88, 16), 16) * std::pow(2.0, -5);
+  eph.crs = signed_(getBits(w3, 104, 16), 16) * std::pow(2.0, -5);
+  eph.cic = signed_(getBits(w4, 22, 16), 16) * std::pow(2.0, -29);
+  eph.cis = signed_(getBits(w4, 38, 16), 16) * std::pow(2.0, -29);
+  eph.toc = getBits(w4, 54, 14) * 60.0;
+  eph.af0 = signed_(getBits(w4, 68, 31), 31) * std::pow(2.0, -34);
+  eph.af1 = signed_(getBits(w4, 99, 21), 21) * std::pow(2.0, -46);
+  eph.af2 = signed_(getBits(w4, 120, 6), 6) * std::pow(2.0, -59);
+  // Week & E1-E5b group delay from word type 5, if received
+  eph.week = 0;
+  eph.tgd = 0;
+  if (parts.received & (1 << 4)) {
+    const std::vector<uint32_t>& w5 = parts.data[4];
+    eph.week = getBits(w5, 73, 12);
+    eph.tgd = signed_(getBits(w5, 57, 10), 10) * std::pow(2.0, -32);
+  }
+  publish(parts, eph);
+}
+
+void SfrbxDecoder::publish(Parts& parts, const Ephemeris& eph) {
+  if (parts.iode == eph.iode && parts.toe == eph.toe)
+    return;
+  parts.iode = eph.iode;
+  parts.toe = eph.toe;
+  ++statistics_.ephemerides;
+  pending_.push_back(eph);
+}
+
+std::vector<GpsAlmanac> SfrbxDecoder::almanacs() const {
+  boost::mutex::scoped_lock lock(mutex_);
+  std::vector<GpsAlmanac> almanacs;
+  for (std::size_t i = 0; i < almanacs_.size(); ++i)
+    if (almanacs_[i].sv_id != 0)
+      almanacs.push_back(almanacs_[i]);
+  return almanacs;
+}
+
+IonosphereParams SfrbxDecoder::ionosphere() const {
+  boost::mutex::scoped_lock lock(mutex_);
+  return ionosphere_;
+}
+
+UtcParams SfrbxDecoder::utc(uint8_t gnss_id) const {
+  boost::mutex::scoped_lock lock(mutex_);
+  if (gnss_id >= utc_.size()) {
+    UtcParams utc;
+    utc.valid = false;
+    return utc;
+  }
+  return utc_[gnss_id];
+}
+
+SfrbxDecoder::Statistics SfrbxDecoder::statistics() const {
+  boost::mutex::scoped_lock lock(mutex_);
+  return statistics_;
+}
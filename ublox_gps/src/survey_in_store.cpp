@@ -0,0 +1,129 @@
+//==============================================================================
+// Copyright (c) 2012, Johannes Meyer, TU Darmstadt
+// All rights reserved.
+
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//     * Neither the name of the Flight Systems and Automatic Control group,
+//       TU Darmstadt, nor the names of its contributors may be used to
+//       endorse or promote products derived from this software without
+//       specific prior written permission.
+
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" 
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE 
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE 
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER BE LIABLE FOR ANY
+// DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+// (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+// LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+// ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+// SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//==============================================================================
+
+#include "ublox_gps/survey_in_store.h"
+#include <cstdio>
+#include <fstream>
+#include <iomanip>
+#include <ros/console.h>
+
+using namespace ublox_node;
+
+SurveyInStore::SurveyInStore(const std::string& directory) :
+    directory_(directory) {}
+
+std::string SurveyInStore::path(const std::string& site) const {
+  return directory_ + "/ublox_svin_" + site + ".txt";
+}
+
+bool SurveyInStore::load(const std::string& site,
+                         SurveyInResult& result) const {
+  std::ifstream file(path(site).c_str());
+  if (!file)
+    return false;
+  result.site = site;
+  // Optional keys
+  result.duration = 0;
+  result.observations = 0;
+  std::string key;
+  bool has_stamp = false, has_ecef = false, has_accuracy = false;
+  while (file >> key) {
+    if (key == "stamp") {
+      has_stamp = static_cast<bool>(file >> result.stamp);
+    } else if (key == "ecef") {
+      has_ecef = static_cast<bool>(file >> result.ecef[0] >> result.ecef[1]
+                                        >> result.ecef[2]);
+    } else if (key == "accuracy") {
+      has_accuracy = static_cast<bool>(file >> result.accuracy);
+    } else if (key == "duration") {
+      file >> result.duration;
+    } else if (key == "observations") {
+      file >> result.observations;
+    } else {
+      // skip unknown keys
+      std::string line;
+      std::getline(file, line);
+    }
+    if (!file)
+      break;
+  }
+  if (!has_stamp || !has_ecef || !has_accuracy) {
+    ROS_WARN("Stored survey-in result %s is incomplete, ignoring it",
+             path(site).c_str());
+    return false;
+  }
+  return true;
+}
+
+bool SurveyInStore::save(const SurveyInResult& result) const {
+  // Write to a temporary file first, so a crash never leaves a partial result
+  const std::string final_path = path(result.site);
+  const std::string tmp_path = final_path + ".tmp";
+  {
+    std::ofstream file(tmp_path.c_str(), std::ios::trunc);
+    if (!file) {
+      ROS_ERROR("Could not open %s to store the survey-in result",
+                tmp_path.c_str());
+      return false;
+    }
+    file << std::fixed << std::setprecision(4)
+         << "site " << result.site << "\n"
+         << "stamp " << result.stamp << "\n"
+         << "ecef " << result.ecef[0] << " " << result.ecef[1] << " "
+         << result.ecef[2] << "\n"
+         << "accuracy " << result.accuracy << "\n"
+         << "duration " << result.duration << "\n"
+         << "observations " << result.observations << "\n";
+    if (!file) {
+      ROS_ERROR("Could not write the survey-in result to %s",
+                tmp_path.c_str());
+      return false;
+    }
+  }
+  if (std::rename(tmp_path.c_str(), final_path.c_str()) != 0) {
+    ROS_ERROR("Could not move the survey-in result to %s",
+              final_path.c_str());
+    return false;
+  }
+  return true;
+}
+
+SurveyInResult SurveyInStore::fromNavSvIn(const std::string& site,
+                                          const ublox_msgs::NavSVIN& m,
+                                          double stamp) {
+  SurveyInResult result;
+  result.site = site;
+  result.stamp = stamp;
+  result.ecef[0] = m.meanX * 1e-2 + m.meanXHP * 1e-4; // to [m]
+  result.ecef[1] = m.meanY * 1e-2 + m.meanYHP * 1e-4; // to [m]
+  result.ecef[2] = m.meanZ * 1e-2 + m.meanZHP * 1e-4; // to [m]
+  result.accuracy = m.meanAcc * 1e-4; // to [m]
+  result.duration = m.dur;
+  result.observations = m.obs;
+  return result;
+}
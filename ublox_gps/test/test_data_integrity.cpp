@@ -0,0 +1,101 @@
+//==============================================================================
+// Copyright (c) 2012, Johannes Meyer, TU Darmstadt
+// All rights reserved.
+
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//     * Neither the name of the Flight Systems and Automatic Control group,
+//       TU Darmstadt, nor the names of its contributors may be used to
+//       endorse or promote products derived from this software without
+//       specific prior written permission.
+
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" 
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE 
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE 
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER BE LIABLE FOR ANY
+// DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+// (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+// LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+// ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+// SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//==============================================================================
+
+#include <vector>
+#include <gtest/gtest.h>
+#include <ublox_gps/data_integrity.h>
+
+using ublox_gps::ItowContinuity;
+
+namespace {
+
+//! Navigation period of the tests [ms]
+const uint32_t kPeriod = 100;
+
+/**
+ * @brief Create a payload with the iTOW at the given offset.
+ */
+std::vector<uint8_t> payload(uint32_t itow, int offset, std::size_t size) {
+  std::vector<uint8_t> data(size, 0);
+  for (int i = 0; i < 4; ++i)
+    data[offset + i] = itow >> (8 * i);
+  return data;
+}
+
+/**
+ * @brief Feed epochs of a message, skipping the given number of epochs after
+ * the third epoch, and return the counted missing epochs.
+ */
+uint64_t countMissing(uint8_t message_id, int offset, std::size_t size,
+                      uint32_t skipped) {
+  ItowContinuity continuity;
+  continuity.setNavPeriod(kPeriod);
+  continuity.setRate(ublox_msgs::Class::NAV, message_id, 1);
+  uint32_t itow = 1000;
+  for (int i = 0; i < 6; ++i) {
+    std::vector<uint8_t> data = payload(itow, offset, size);
+    continuity.update(ublox_msgs::Class::NAV, message_id, data.data(),
+                      data.size());
+    itow += kPeriod * (i == 2 ? skipped + 1 : 1);
+  }
+  return continuity.missing();
+}
+
+}  // namespace
+
+TEST(ItowContinuity, Offsets) {
+  namespace NAV = ublox_msgs::Message::NAV;
+  const uint8_t nav = ublox_msgs::Class::NAV;
+  EXPECT_EQ(0, ItowContinuity::itowOffset(nav, NAV::PVT));
+  EXPECT_EQ(4, ItowContinuity::itowOffset(nav, NAV::RELPOSNED));
+  EXPECT_EQ(4, ItowContinuity::itowOffset(nav, NAV::SVIN));
+  EXPECT_EQ(4, ItowContinuity::itowOffset(nav, NAV::HPPOSECEF));
+  EXPECT_EQ(4, ItowContinuity::itowOffset(nav, NAV::HPPOSLLH));
+  EXPECT_EQ(-1, ItowContinuity::itowOffset(ublox_msgs::Class::RXM,
+                                           ublox_msgs::Message::RXM::RAWX));
+}
+
+TEST(ItowContinuity, ContinuousHighPrecisionStreams) {
+  EXPECT_EQ(0u, countMissing(ublox_msgs::Message::NAV::HPPOSLLH, 4, 36, 0));
+  EXPECT_EQ(0u, countMissing(ublox_msgs::Message::NAV::HPPOSECEF, 4, 28, 0));
+}
+
+TEST(ItowContinuity, MissingHighPrecisionEpochs) {
+  EXPECT_EQ(2u, countMissing(ublox_msgs::Message::NAV::HPPOSLLH, 4, 36, 2));
+  EXPECT_EQ(3u, countMissing(ublox_msgs::Message::NAV::HPPOSECEF, 4, 28, 3));
+}
+
+TEST(ItowContinuity, MissingPvtEpochs) {
+  EXPECT_EQ(0u, countMissing(ublox_msgs::Message::NAV::PVT, 0, 92, 0));
+  EXPECT_EQ(1u, countMissing(ublox_msgs::Message::NAV::PVT, 0, 92, 1));
+}
+
+int main(int argc, char** argv) {
+  testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
@@ -877,6 +877,58 @@ struct Serializer<ublox_msgs::EsfSTATUS_<ContainerAllocator> > {
   }
 };
 
+///
+/// @brief Serializes the LogRETRIEVESTRING message which has a repeated block.
+///
+template <typename ContainerAllocator>
+struct Serializer<ublox_msgs::LogRETRIEVESTRING_<ContainerAllocator> > {
+  typedef ublox_msgs::LogRETRIEVESTRING_<ContainerAllocator> Msg;
+  typedef boost::call_traits<Msg> CallTraits;
+
+  static void read(const uint8_t *data, uint32_t count,
+                   typename CallTraits::reference m) {
+    ros::serialization::IStream stream(const_cast<uint8_t *>(data), count);
+    stream.next(m.entryIndex);
+    stream.next(m.version);
+    stream.next(m.reserved1);
+    stream.next(m.year);
+    stream.next(m.month);
+    stream.next(m.day);
+    stream.next(m.hour);
+    stream.next(m.minute);
+    stream.next(m.second);
+    stream.next(m.reserved2);
+    stream.next(m.byteCount);
+    m.bytes.resize(m.byteCount);
+    for(std::size_t i = 0; i < m.bytes.size(); ++i)
+      ros::serialization::deserialize(stream, m.bytes[i]);
+  }
+
+  static uint32_t serializedLength (typename CallTraits::param_type m) {
+    return 16 + m.byteCount;
+  }
+
+  static void write(uint8_t *data, uint32_t size,
+                    typename CallTraits::param_type m) {
+    if(m.bytes.size() != m.byteCount) {
+      ROS_ERROR("LogRETRIEVESTRING byteCount must equal bytes size");
+    }
+    ros::serialization::OStream stream(data, size);
+    stream.next(m.entryIndex);
+    stream.next(m.version);
+    stream.next(m.reserved1);
+    stream.next(m.year);
+    stream.next(m.month);
+    stream.next(m.day);
+    stream.next(m.hour);
+    stream.next(m.minute);
+    stream.next(m.second);
+    stream.next(m.reserved2);
+    stream.next(static_cast<typename Msg::_byteCount_type>(m.bytes.size()));
+    for(std::size_t i = 0; i < m.bytes.size(); ++i)
+      ros::serialization::serialize(stream, m.bytes[i]);
+  }
+};
 
 } // namespace ublox
 
@@ -33,6 +33,8 @@
 #include <ublox_msgs/NavCLOCK.h>
 #include <ublox_msgs/NavDGPS.h>
 #include <ublox_msgs/NavDOP.h>
+#include <ublox_msgs/NavHPPOSECEF.h>
+#include <ublox_msgs/NavHPPOSLLH.h>
 #include <ublox_msgs/NavPOSECEF.h>
 #include <ublox_msgs/NavPOSLLH.h>
 #include <ublox_msgs/NavRELPOSNED.h>
@@ -108,6 +110,17 @@
 #include <ublox_msgs/HnrPVT.h>
 
 #include <ublox_msgs/TimTM2.h>
+#include <ublox_msgs/TimTP.h>
+
+#include <ublox_msgs/LogBATCH.h>
+#include <ublox_msgs/LogINFO.h>
+#include <ublox_msgs/LogRETRIEVE.h>
+#include <ublox_msgs/LogRETRIEVEBATCH.h>
+#include <ublox_msgs/LogRETRIEVEPOS.h>
+#include <ublox_msgs/LogRETRIEVEPOSEXTRA.h>
+#include <ublox_msgs/LogRETRIEVESTRING.h>
+
+#include <ublox_msgs/SecUNIQID.h>
 
 namespace ublox_msgs {
 
@@ -156,6 +169,8 @@ namespace Message {
     static const uint8_t CLOCK = NavCLOCK::MESSAGE_ID;
     static const uint8_t DGPS = NavDGPS::MESSAGE_ID;
     static const uint8_t DOP = NavDOP::MESSAGE_ID;
+    static const uint8_t HPPOSECEF = NavHPPOSECEF::MESSAGE_ID;
+    static const uint8_t HPPOSLLH = NavHPPOSLLH::MESSAGE_ID;
     static const uint8_t POSECEF = NavPOSECEF::MESSAGE_ID;
     static const uint8_t POSLLH = NavPOSLLH::MESSAGE_ID;
     static const uint8_t RELPOSNED = NavRELPOSNED::MESSAGE_ID;
@@ -251,6 +266,21 @@ namespace Message {
 
   namespace TIM {
     static const uint8_t TM2 = TimTM2::MESSAGE_ID;
+    static const uint8_t TP = TimTP::MESSAGE_ID;
+  }
+
+  namespace LOG {
+    static const uint8_t BATCH = LogBATCH::MESSAGE_ID;
+    static const uint8_t INFO = LogINFO::MESSAGE_ID;
+    static const uint8_t RETRIEVE = LogRETRIEVE::MESSAGE_ID;
+    static const uint8_t RETRIEVEBATCH = LogRETRIEVEBATCH::MESSAGE_ID;
+    static const uint8_t RETRIEVEPOS = LogRETRIEVEPOS::MESSAGE_ID;
+    static const uint8_t RETRIEVEPOSEXTRA = LogRETRIEVEPOSEXTRA::MESSAGE_ID;
+    static const uint8_t RETRIEVESTRING = LogRETRIEVESTRING::MESSAGE_ID;
+  }
+
+  namespace SEC {
+    static const uint8_t UNIQID = SecUNIQID::MESSAGE_ID;
   }
 }
 
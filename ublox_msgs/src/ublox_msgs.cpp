@@ -39,6 +39,12 @@ DECLARE_UBLOX_MESSAGE(ublox_msgs::Class::NAV, ublox_msgs::Message::NAV::DGPS,
                       ublox_msgs, NavDGPS);
 DECLARE_UBLOX_MESSAGE(ublox_msgs::Class::NAV, ublox_msgs::Message::NAV::DOP, 
                       ublox_msgs, NavDOP);
+DECLARE_UBLOX_MESSAGE(ublox_msgs::Class::NAV,
+                      ublox_msgs::Message::NAV::HPPOSECEF,
+                      ublox_msgs, NavHPPOSECEF);
+DECLARE_UBLOX_MESSAGE(ublox_msgs::Class::NAV,
+                      ublox_msgs::Message::NAV::HPPOSLLH,
+                      ublox_msgs, NavHPPOSLLH);
 DECLARE_UBLOX_MESSAGE(ublox_msgs::Class::NAV, ublox_msgs::Message::NAV::POSECEF, 
                       ublox_msgs, NavPOSECEF);
 DECLARE_UBLOX_MESSAGE(ublox_msgs::Class::NAV, ublox_msgs::Message::NAV::POSLLH, 
@@ -197,4 +203,30 @@ DECLARE_UBLOX_MESSAGE(ublox_msgs::Class::HNR, ublox_msgs::Message::HNR::PVT,
 // TIM messages
 DECLARE_UBLOX_MESSAGE(ublox_msgs::Class::TIM, ublox_msgs::Message::TIM::TM2,
 		      ublox_msgs, TimTM2);
-
+DECLARE_UBLOX_MESSAGE(ublox_msgs::Class::TIM, ublox_msgs::Message::TIM::TP,
+                      ublox_msgs, TimTP);
+
+// LOG messages
+DECLARE_UBLOX_MESSAGE(ublox_msgs::Class::LOG, ublox_msgs::Message::LOG::BATCH,
+                      ublox_msgs, LogBATCH);
+DECLARE_UBLOX_MESSAGE(ublox_msgs::Class::LOG, ublox_msgs::Message::LOG::INFO,
+                      ublox_msgs, LogINFO);
+DECLARE_UBLOX_MESSAGE(ublox_msgs::Class::LOG,
+                      ublox_msgs::Message::LOG::RETRIEVE,
+                      ublox_msgs, LogRETRIEVE);
+DECLARE_UBLOX_MESSAGE(ublox_msgs::Class::LOG,
+                      ublox_msgs::Message::LOG::RETRIEVEBATCH,
+                      ublox_msgs, LogRETRIEVEBATCH);
+DECLARE_UBLOX_MESSAGE(ublox_msgs::Class::LOG,
+                      ublox_msgs::Message::LOG::RETRIEVEPOS,
+                      ublox_msgs, LogRETRIEVEPOS);
+DECLARE_UBLOX_MESSAGE(ublox_msgs::Class::LOG,
+                      ublox_msgs::Message::LOG::RETRIEVEPOSEXTRA,
+                      ublox_msgs, LogRETRIEVEPOSEXTRA);
+DECLARE_UBLOX_MESSAGE(ublox_msgs::Class::LOG,
+                      ublox_msgs::Message::LOG::RETRIEVESTRING,
+                      ublox_msgs, LogRETRIEVESTRING);
+
+// SEC messages
+DECLARE_UBLOX_MESSAGE(ublox_msgs::Class::SEC, ublox_msgs::Message::SEC::UNIQID,
+                      ublox_msgs, SecUNIQID);